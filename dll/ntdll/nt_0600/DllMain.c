@@ -13,12 +13,6 @@
 #define NDEBUG
 #include <debug.h>
 
-VOID
-RtlpInitializeKeyedEvent(VOID);
-
-VOID
-RtlpCloseKeyedEvent(VOID);
-
 BOOL
 WINAPI
 DllMain(HANDLE hDll,
@@ -28,11 +22,6 @@ DllMain(HANDLE hDll,
     if (dwReason == DLL_PROCESS_ATTACH)
     {
         LdrDisableThreadCalloutsForDll(hDll);
-        RtlpInitializeKeyedEvent();
-    }
-    else if (dwReason == DLL_PROCESS_DETACH)
-    {
-        RtlpCloseKeyedEvent();
     }
     return TRUE;
 }
@@ -55,6 +55,19 @@ RtlpGetMode(VOID)
    return UserMode;
 }
 
+VOID
+NTAPI
+RtlpRunInParallel(IN PRTLP_PARALLEL_ROUTINE Routine,
+                  IN PVOID Context,
+                  IN ULONG Count)
+{
+    ULONG Index;
+
+    /* User-mode callers get the work done inline */
+    for (Index = 0; Index < Count; Index++)
+        Routine(Context, Index);
+}
+
 /*
  * @implemented
  */
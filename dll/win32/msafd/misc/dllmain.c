@@ -2490,6 +2490,9 @@ WSPIoctl(IN  SOCKET Handle,
                 GUID ConnectExGUID = WSAID_CONNECTEX;
                 GUID DisconnectExGUID = WSAID_DISCONNECTEX;
                 GUID GetAcceptExSockaddrsGUID = WSAID_GETACCEPTEXSOCKADDRS;
+                GUID PollSetCreateGUID = WSAID_POLLSETCREATE;
+                GUID PollSetControlGUID = WSAID_POLLSETCONTROL;
+                GUID PollSetWaitGUID = WSAID_POLLSETWAIT;
 
                 if (IsEqualGUID(&AcceptExGUID, lpvInBuffer))
                 {
@@ -2524,6 +2527,27 @@ WSPIoctl(IN  SOCKET Handle,
                     ERR("SIO_GET_EXTENSION_FUNCTION_POINTER UNIMPLEMENTED\n");
                     Ret = SOCKET_ERROR;
                 }
+                else if (IsEqualGUID(&PollSetCreateGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPPollSetCreate;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
+                else if (IsEqualGUID(&PollSetControlGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPPollSetControl;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
+                else if (IsEqualGUID(&PollSetWaitGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPPollSetWait;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
                 else
                 {
                     ERR("Querying unknown extension function: %x\n", ((GUID*)lpvInBuffer)->Data1);
@@ -2899,10 +2923,6 @@ WSPSetSockOpt(
                   return SOCKET_ERROR;
               }
 
-              /* FIXME: We should not have to limit the packet receive buffer size like this. workaround for CORE-15804 */
-              if (*(PULONG)optval > 0x2000)
-                  *(PULONG)optval = 0x2000;
-
               SetSocketInformation(Socket,
                                    AFD_INFO_RECEIVE_WINDOW_SIZE,
                                    NULL,
@@ -0,0 +1,268 @@
+/*
+ * COPYRIGHT:   See COPYING in the top level directory
+ * PROJECT:     ReactOS Ancillary Function Driver DLL
+ * FILE:        dll/win32/msafd/misc/pollset.c
+ * PURPOSE:     Readiness set extension functions
+ */
+
+#include <msafd.h>
+
+/* The set is an AFD control channel, all the state lives in the driver */
+static
+NTSTATUS
+PollSetIoControl(
+    IN HANDLE PollSet,
+    IN ULONG IoControlCode,
+    IN PVOID InputBuffer,
+    IN ULONG InputBufferLength,
+    OUT PVOID OutputBuffer,
+    IN ULONG OutputBufferLength)
+{
+    IO_STATUS_BLOCK IOSB;
+    HANDLE SockEvent;
+    NTSTATUS Status;
+
+    Status = NtCreateEvent(&SockEvent,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           SynchronizationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        ERR("NtCreateEvent failed, 0x%08x\n", Status);
+        return Status;
+    }
+
+    Status = NtDeviceIoControlFile(PollSet,
+                                   SockEvent,
+                                   NULL,
+                                   NULL,
+                                   &IOSB,
+                                   IoControlCode,
+                                   InputBuffer,
+                                   InputBufferLength,
+                                   OutputBuffer,
+                                   OutputBufferLength);
+
+    /* Wait for Completion */
+    if (Status == STATUS_PENDING)
+    {
+        WaitForSingleObject(SockEvent, INFINITE);
+        Status = IOSB.Status;
+    }
+
+    NtClose(SockEvent);
+
+    return Status;
+}
+
+static
+INT
+PollSetTranslateStatus(
+    IN NTSTATUS Status)
+{
+    switch (Status)
+    {
+        case STATUS_OBJECT_NAME_COLLISION:
+            return WSAEALREADY;
+
+        case STATUS_NOT_FOUND:
+        case STATUS_OBJECT_TYPE_MISMATCH:
+        case STATUS_INVALID_HANDLE:
+            return WSAENOTSOCK;
+
+        default:
+            return TranslateNtStatusError(Status);
+    }
+}
+
+HANDLE
+PASCAL FAR
+WSPPollSetCreate(VOID)
+{
+    UNICODE_STRING DevName = RTL_CONSTANT_STRING(L"\\Device\\Afd\\PollSet");
+    OBJECT_ATTRIBUTES Object;
+    IO_STATUS_BLOCK IOSB;
+    HANDLE PollSet;
+    NTSTATUS Status;
+
+    TRACE("Called\n");
+
+    InitializeObjectAttributes(&Object,
+                               &DevName,
+                               OBJ_CASE_INSENSITIVE,
+                               0,
+                               0);
+
+    /* No EA, AFD makes it a control channel */
+    Status = NtCreateFile(&PollSet,
+                          GENERIC_READ | GENERIC_WRITE | SYNCHRONIZE,
+                          &Object,
+                          &IOSB,
+                          NULL,
+                          0,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          FILE_OPEN_IF,
+                          0,
+                          NULL,
+                          0);
+    if (!NT_SUCCESS(Status))
+    {
+        ERR("Failed to open the poll set. Status 0x%08x\n", Status);
+        WSASetLastError(TranslateNtStatusError(Status));
+        return NULL;
+    }
+
+    return PollSet;
+}
+
+INT
+PASCAL FAR
+WSPPollSetControl(
+    IN HANDLE hPollSet,
+    IN INT iOperation,
+    IN SOCKET s,
+    IN LONG lNetworkEvents,
+    IN ULONG_PTR Context)
+{
+    AFD_POLL_SET_UPDATE_INFO UpdateInfo;
+    NTSTATUS Status;
+
+    TRACE("WSPPollSetControl (%p) %d %lx %lx\n", hPollSet, iOperation, s, lNetworkEvents);
+
+    if (iOperation != WSA_POLLSET_ADD &&
+        iOperation != WSA_POLLSET_MODIFY &&
+        iOperation != WSA_POLLSET_REMOVE)
+    {
+        WSASetLastError(WSAEINVAL);
+        return SOCKET_ERROR;
+    }
+
+    UpdateInfo.Handle = s;
+    UpdateInfo.Operation = iOperation;
+    UpdateInfo.Context = Context;
+    UpdateInfo.Events = 0;
+
+    /* Same mapping as WSPEventSelect */
+    if (lNetworkEvents & FD_READ)
+        UpdateInfo.Events |= AFD_EVENT_RECEIVE;
+
+    if (lNetworkEvents & FD_WRITE)
+        UpdateInfo.Events |= AFD_EVENT_SEND;
+
+    if (lNetworkEvents & FD_OOB)
+        UpdateInfo.Events |= AFD_EVENT_OOB_RECEIVE;
+
+    if (lNetworkEvents & FD_ACCEPT)
+        UpdateInfo.Events |= AFD_EVENT_ACCEPT;
+
+    if (lNetworkEvents & FD_CONNECT)
+        UpdateInfo.Events |= AFD_EVENT_CONNECT | AFD_EVENT_CONNECT_FAIL;
+
+    if (lNetworkEvents & FD_CLOSE)
+        UpdateInfo.Events |= AFD_EVENT_DISCONNECT | AFD_EVENT_ABORT | AFD_EVENT_CLOSE;
+
+    Status = PollSetIoControl(hPollSet,
+                              IOCTL_AFD_POLL_SET_UPDATE,
+                              &UpdateInfo,
+                              sizeof(UpdateInfo),
+                              NULL,
+                              0);
+    if (!NT_SUCCESS(Status))
+    {
+        ERR("Got status 0x%08x.\n", Status);
+        WSASetLastError(PollSetTranslateStatus(Status));
+        return SOCKET_ERROR;
+    }
+
+    return 0;
+}
+
+INT
+PASCAL FAR
+WSPPollSetWait(
+    IN HANDLE hPollSet,
+    OUT LPWSAPOLLSET_EVENT lpEvents,
+    IN INT iMaxEvents,
+    IN INT iTimeout)
+{
+    PAFD_POLL_SET_WAIT_INFO WaitInfo;
+    ULONG WaitInfoSize;
+    NTSTATUS Status;
+    ULONG Events;
+    INT i;
+
+    TRACE("WSPPollSetWait (%p) %d %d\n", hPollSet, iMaxEvents, iTimeout);
+
+    if (!lpEvents || iMaxEvents <= 0)
+    {
+        WSASetLastError(WSAEINVAL);
+        return SOCKET_ERROR;
+    }
+
+    WaitInfoSize = FIELD_OFFSET(AFD_POLL_SET_WAIT_INFO, Events) +
+                   iMaxEvents * sizeof(AFD_POLL_SET_EVENT);
+    WaitInfo = HeapAlloc(GlobalHeap, 0, WaitInfoSize);
+    if (!WaitInfo)
+    {
+        WSASetLastError(WSAENOBUFS);
+        return SOCKET_ERROR;
+    }
+
+    /* Convert Timeout to NT Format */
+    if (iTimeout < 0)
+        WaitInfo->Timeout.QuadPart = MAXLONGLONG;
+    else
+        WaitInfo->Timeout.QuadPart = Int32x32To64(iTimeout, -10000);
+    WaitInfo->EventCount = iMaxEvents;
+
+    Status = PollSetIoControl(hPollSet,
+                              IOCTL_AFD_POLL_SET_WAIT,
+                              WaitInfo,
+                              WaitInfoSize,
+                              WaitInfo,
+                              WaitInfoSize);
+
+    /* STATUS_TIMEOUT is a success code and comes back with no events */
+    if (!NT_SUCCESS(Status))
+    {
+        ERR("Got status 0x%08x.\n", Status);
+        HeapFree(GlobalHeap, 0, WaitInfo);
+        WSASetLastError(PollSetTranslateStatus(Status));
+        return SOCKET_ERROR;
+    }
+
+    if (Status == STATUS_TIMEOUT)
+        WaitInfo->EventCount = 0;
+
+    for (i = 0; i < (INT)WaitInfo->EventCount; i++)
+    {
+        Events = WaitInfo->Events[i].Events;
+
+        lpEvents[i].Socket = WaitInfo->Events[i].Handle;
+        lpEvents[i].Context = WaitInfo->Events[i].Context;
+        lpEvents[i].NetworkEvents = 0;
+
+        if (Events & AFD_EVENT_RECEIVE)
+            lpEvents[i].NetworkEvents |= FD_READ;
+
+        if (Events & AFD_EVENT_SEND)
+            lpEvents[i].NetworkEvents |= FD_WRITE;
+
+        if (Events & AFD_EVENT_OOB_RECEIVE)
+            lpEvents[i].NetworkEvents |= FD_OOB;
+
+        if (Events & AFD_EVENT_ACCEPT)
+            lpEvents[i].NetworkEvents |= FD_ACCEPT;
+
+        if (Events & (AFD_EVENT_CONNECT | AFD_EVENT_CONNECT_FAIL))
+            lpEvents[i].NetworkEvents |= FD_CONNECT;
+
+        if (Events & (AFD_EVENT_DISCONNECT | AFD_EVENT_ABORT | AFD_EVENT_CLOSE))
+            lpEvents[i].NetworkEvents |= FD_CLOSE;
+    }
+
+    HeapFree(GlobalHeap, 0, WaitInfo);
+
+    return i;
+}
@@ -28,6 +28,7 @@
 #include <tdi.h>
 #include <afd/shared.h>
 #include <mswsock.h>
+#include <winsock/wspollset.h>
 
 #include <wine/debug.h>
 WINE_DEFAULT_DEBUG_CHANNEL(msafd);
@@ -469,6 +470,27 @@ WSPGetAcceptExSockaddrs(
     OUT struct sockaddr **RemoteSockaddr,
     OUT LPINT RemoteSockaddrLength);
 
+HANDLE
+PASCAL FAR
+WSPPollSetCreate(VOID);
+
+INT
+PASCAL FAR
+WSPPollSetControl(
+    IN HANDLE hPollSet,
+    IN INT iOperation,
+    IN SOCKET s,
+    IN LONG lNetworkEvents,
+    IN ULONG_PTR Context);
+
+INT
+PASCAL FAR
+WSPPollSetWait(
+    IN HANDLE hPollSet,
+    OUT LPWSAPOLLSET_EVENT lpEvents,
+    IN INT iMaxEvents,
+    IN INT iTimeout);
+
 PSOCKET_INFORMATION GetSocketStructure(
 	SOCKET Handle
 );
@@ -526,6 +526,8 @@ NtfsDirFindFile(PNTFS_VCB Vcb,
     PWSTR Colon, OldColon;
     PNTFS_ATTR_CONTEXT DataContext;
     USHORT Length = 0;
+    WCHAR FullPathBuffer[MAX_PATH];
+    UNICODE_STRING FullPath;
 
     DPRINT("NtfsDirFindFile(%p, %p, %S, %s, %p)\n",
            Vcb,
@@ -566,10 +568,48 @@ NtfsDirFindFile(PNTFS_VCB Vcb,
         DPRINT1("Will now look for file '%wZ' with stream '%S'\n", &File, Colon);
     }
 
-    Status = NtfsLookupFileAt(Vcb, &File, CaseSensitive, &FileRecord, &MFTIndex, CurrentDir);
-    if (!NT_SUCCESS(Status))
+    /* Only case insensitive lookups go through the path cache */
+    RtlInitEmptyUnicodeString(&FullPath, FullPathBuffer, sizeof(FullPathBuffer));
+    if (!CaseSensitive)
     {
-        return Status;
+        if (!NT_SUCCESS(RtlAppendUnicodeToString(&FullPath, DirectoryFcb->PathName)) ||
+            (!NtfsFCBIsRoot(DirectoryFcb) && !NT_SUCCESS(RtlAppendUnicodeToString(&FullPath, L"\\"))) ||
+            !NT_SUCCESS(RtlAppendUnicodeStringToString(&FullPath, &File)))
+        {
+            FullPath.Length = 0;
+        }
+    }
+
+    /* If we resolved this path before, skip the walk through the directory index */
+    FileRecord = NULL;
+    if (FullPath.Length != 0 && NtfsLookupCachedPath(Vcb, &FullPath, &MFTIndex))
+    {
+        FileRecord = ExAllocateFromNPagedLookasideList(&Vcb->FileRecLookasideList);
+        if (FileRecord == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        Status = ReadFileRecord(Vcb, MFTIndex, FileRecord);
+        if (!NT_SUCCESS(Status) || !(FileRecord->Flags & FRH_IN_USE))
+        {
+            ExFreeToNPagedLookasideList(&Vcb->FileRecLookasideList, FileRecord);
+            FileRecord = NULL;
+        }
+    }
+
+    if (FileRecord == NULL)
+    {
+        Status = NtfsLookupFileAt(Vcb, &File, CaseSensitive, &FileRecord, &MFTIndex, CurrentDir);
+        if (!NT_SUCCESS(Status))
+        {
+            return Status;
+        }
+
+        if (FullPath.Length != 0)
+        {
+            NtfsCachePath(Vcb, &FullPath, CurrentDir, MFTIndex);
+        }
     }
 
     if (Length != 0)
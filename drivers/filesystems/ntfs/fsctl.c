@@ -459,6 +459,8 @@ NtfsMountVolume(PDEVICE_OBJECT DeviceObject,
     Vcb->Identifier.Type = NTFS_TYPE_VCB;
     Vcb->Identifier.Size = sizeof(NTFS_TYPE_VCB);
 
+    NtfsInitializeCaches(Vcb);
+
     Status = NtfsGetVolumeData(DeviceToMount,
                                Vcb);
     if (!NT_SUCCESS(Status))
@@ -567,6 +569,9 @@ ByeBye:
         if (Lookaside)
             ExDeleteNPagedLookasideList(&Vcb->FileRecLookasideList);
 
+        if (Vcb)
+            NtfsPurgeCaches(Vcb);
+
         if (NewDeviceObject)
             IoDeleteDevice(NewDeviceObject);
     }
@@ -881,6 +886,9 @@ LockOrUnlockVolume(PDEVICE_EXTENSION DeviceExt,
         return STATUS_ACCESS_DENIED;
     }
 
+    /* Whoever locks the volume may write to it behind our back */
+    NtfsPurgeCaches(DeviceExt);
+
     /* Finally, proceed */
     if (Lock)
     {
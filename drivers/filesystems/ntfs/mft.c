@@ -1340,6 +1340,19 @@ WriteAttribute(PDEVICE_EXTENSION Vcb,
 
     *RealLengthWritten = 0;
 
+    // drop what we cached of the data before it changes on disk
+    if (Context == Vcb->MFTContext && Length != 0)
+    {
+        NtfsInvalidateCachedRecords(Vcb,
+                                    Offset / Vcb->NtfsInfo.BytesPerFileRecord,
+                                    (Offset + Length - 1) / Vcb->NtfsInfo.BytesPerFileRecord);
+    }
+    else if (Context->pRecord->Type == AttributeIndexAllocation ||
+             Context->pRecord->Type == AttributeBitmap)
+    {
+        NtfsInvalidateCachedIndex(Vcb, Context->FileMFTIndex);
+    }
+
     // is this a resident attribute?
     if (!Context->pRecord->IsNonResident)
     {
@@ -1633,9 +1646,16 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
                PFILE_RECORD_HEADER file)
 {
     ULONGLONG BytesRead;
+    NTSTATUS Status;
 
     DPRINT("ReadFileRecord(%p, %I64x, %p)\n", Vcb, index, file);
 
+    /* Cached records already had their fixups applied */
+    if (NtfsReadCachedRecord(Vcb, index, file))
+    {
+        return STATUS_SUCCESS;
+    }
+
     BytesRead = ReadAttribute(Vcb, Vcb->MFTContext, index * Vcb->NtfsInfo.BytesPerFileRecord, (PCHAR)file, Vcb->NtfsInfo.BytesPerFileRecord);
     if (BytesRead != Vcb->NtfsInfo.BytesPerFileRecord)
     {
@@ -1645,7 +1665,13 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
 
     /* Apply update sequence array fixups. */
     DPRINT("Sequence number: %u\n", file->SequenceNumber);
-    return FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    Status = FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    if (NT_SUCCESS(Status))
+    {
+        NtfsCacheRecord(Vcb, index, file);
+    }
+
+    return Status;
 }
 
 
@@ -1957,6 +1983,18 @@ UpdateFileRecord(PDEVICE_EXTENSION Vcb,
     // remove the fixup array (so the file record pointer can still be used)
     FixupUpdateSequenceArray(Vcb, &FileRecord->Ntfs);
 
+    // WriteAttribute() dropped the cached copy, keep the one we just wrote
+    if (NT_SUCCESS(Status))
+    {
+        NtfsCacheRecord(Vcb, MftIndex, FileRecord);
+    }
+
+    // the index root of a directory lives in its file record
+    if (FileRecord->Flags & FRH_DIRECTORY)
+    {
+        NtfsInvalidateCachedIndex(Vcb, MftIndex);
+    }
+
     return Status;
 }
 
@@ -2894,25 +2932,33 @@ BrowseSubNodeIndexEntries(PNTFS_VCB Vcb,
     // Calculate offset of index record
     Offset = VCN * Vcb->NtfsInfo.BytesPerCluster;
 
-    // Read the index record
-    BytesRead = ReadAttribute(Vcb, IndexAllocationContext, Offset, (PCHAR)IndexRecord, IndexBlockSize);
-    if (BytesRead != IndexBlockSize)
+    // Read the index record, unless we have it cached with its fixups applied
+    if (!NtfsReadCachedIndexBuffer(Vcb, IndexAllocationContext->FileMFTIndex, VCN, IndexRecord, IndexBlockSize))
     {
-        DPRINT1("Unable to read index record!\n");
-        ExFreePoolWithTag(IndexRecord, TAG_NTFS);
-        return STATUS_UNSUCCESSFUL;
-    }
+        BytesRead = ReadAttribute(Vcb, IndexAllocationContext, Offset, (PCHAR)IndexRecord, IndexBlockSize);
+        if (BytesRead != IndexBlockSize)
+        {
+            DPRINT1("Unable to read index record!\n");
+            ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+            return STATUS_UNSUCCESSFUL;
+        }
 
-    // Assert that we're dealing with an index record here
-    ASSERT(IndexRecord->Ntfs.Type == NRH_INDX_TYPE);
+        // Assert that we're dealing with an index record here
+        ASSERT(IndexRecord->Ntfs.Type == NRH_INDX_TYPE);
 
-    // Apply the fixup array to the index record
-    Status = FixupUpdateSequenceArray(Vcb, &((PFILE_RECORD_HEADER)IndexRecord)->Ntfs);
-    if (!NT_SUCCESS(Status))
-    {
-        ExFreePoolWithTag(IndexRecord, TAG_NTFS);
-        DPRINT1("Failed to apply fixup array!\n");
-        return Status;
+        // Apply the fixup array to the index record
+        Status = FixupUpdateSequenceArray(Vcb, &((PFILE_RECORD_HEADER)IndexRecord)->Ntfs);
+        if (!NT_SUCCESS(Status))
+        {
+            ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+            DPRINT1("Failed to apply fixup array!\n");
+            return Status;
+        }
+
+        if (IndexRecord->Ntfs.Type == NRH_INDX_TYPE)
+        {
+            NtfsCacheIndexBuffer(Vcb, IndexAllocationContext->FileMFTIndex, VCN, IndexRecord, IndexBlockSize);
+        }
     }
 
     ASSERT(IndexRecord->Header.AllocatedSize + FIELD_OFFSET(INDEX_BUFFER, Header) == IndexBlockSize);
@@ -3049,15 +3095,23 @@ BrowseIndexEntries(PDEVICE_EXTENSION Vcb,
         // RtlInitializeBitmap() wants a pointer that's ULONG-aligned.
         BitmapPtr = (PULONG)ALIGN_UP_BY((ULONG_PTR)BitmapMem, sizeof(ULONG));
 
-        // Read the existing bitmap data
-        Status = ReadAttribute(Vcb, BitmapContext, 0, (PCHAR)BitmapPtr, BitmapLength);
-        if (!NT_SUCCESS(Status))
+        // Read the existing bitmap data, unless we have it cached
+        if (!NtfsReadCachedIndexBitmap(Vcb, IndexAllocationContext->FileMFTIndex, BitmapPtr, (ULONG)BitmapLength))
         {
-            DPRINT1("ERROR: Failed to read bitmap attribute!\n");
-            ExFreePoolWithTag(BitmapMem, TAG_NTFS);
-            ReleaseAttributeContext(BitmapContext);
-            ReleaseAttributeContext(IndexAllocationContext);
-            return Status;
+            Status = ReadAttribute(Vcb, BitmapContext, 0, (PCHAR)BitmapPtr, BitmapLength);
+            if (!NT_SUCCESS(Status))
+            {
+                DPRINT1("ERROR: Failed to read bitmap attribute!\n");
+                ExFreePoolWithTag(BitmapMem, TAG_NTFS);
+                ReleaseAttributeContext(BitmapContext);
+                ReleaseAttributeContext(IndexAllocationContext);
+                return Status;
+            }
+
+            if ((ULONGLONG)Status == BitmapLength)
+            {
+                NtfsCacheIndexBitmap(Vcb, IndexAllocationContext->FileMFTIndex, BitmapPtr, (ULONG)BitmapLength);
+            }
         }
 
         // Initialize bitmap
@@ -0,0 +1,517 @@
+/*
+ * PROJECT:     ReactOS NTFS filesystem driver
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Cache of MFT records, index buffers and resolved paths
+ */
+
+/*
+ * The record and index caches only ever hold buffers whose update sequence
+ * array was successfully applied, so a hit can be handed out as if it was
+ * just read from the disk. Every write to the MFT or to an index goes
+ * through WriteAttribute()/UpdateFileRecord(), which drop the matching
+ * entries before the data hits the disk.
+ *
+ * The path cache maps the full path of a file to its MFT index. An entry
+ * remembers the directory the last component was found in, so that any
+ * change to that directory's index drops it.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "ntfs.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* Index cache key of the $I30 bitmap of a directory */
+#define NTFS_CACHE_BITMAP_VCN   ((ULONGLONG)-1)
+
+typedef struct _NTFS_BUFFER_CACHE_ENTRY
+{
+    LIST_ENTRY HashLinks;
+    LIST_ENTRY LruLinks;
+    /* The record, or the directory the index buffer belongs to */
+    ULONGLONG MFTIndex;
+    ULONGLONG VCN;
+    ULONG Length;
+    UCHAR Data[ANYSIZE_ARRAY];
+} NTFS_BUFFER_CACHE_ENTRY, *PNTFS_BUFFER_CACHE_ENTRY;
+
+typedef struct _NTFS_PATH_CACHE_ENTRY
+{
+    LIST_ENTRY HashLinks;
+    LIST_ENTRY LruLinks;
+    ULONGLONG ParentMFTIndex;
+    ULONGLONG MFTIndex;
+    UNICODE_STRING Path;
+    WCHAR PathBuffer[ANYSIZE_ARRAY];
+} NTFS_PATH_CACHE_ENTRY, *PNTFS_PATH_CACHE_ENTRY;
+
+/* FUNCTIONS ****************************************************************/
+
+static
+VOID
+NtfsInitializeCache(PNTFS_CACHE Cache,
+                    ULONG MaxEntries)
+{
+    ULONG i;
+
+    ExInitializeFastMutex(&Cache->Lock);
+    for (i = 0; i < NTFS_CACHE_HASH_BUCKETS; i++)
+    {
+        InitializeListHead(&Cache->HashTable[i]);
+    }
+    InitializeListHead(&Cache->LruList);
+    Cache->EntryCount = 0;
+    Cache->MaxEntries = MaxEntries;
+    Cache->Hits = 0;
+    Cache->Misses = 0;
+}
+
+VOID
+NtfsInitializeCaches(PNTFS_VCB Vcb)
+{
+    NtfsInitializeCache(&Vcb->RecordCache, NTFS_RECORD_CACHE_ENTRIES);
+    NtfsInitializeCache(&Vcb->IndexCache, NTFS_INDEX_CACHE_ENTRIES);
+    NtfsInitializeCache(&Vcb->PathCache, NTFS_PATH_CACHE_ENTRIES);
+}
+
+/* Both entry types start with their hash and LRU links */
+static
+VOID
+NtfsRemoveCacheEntry(PNTFS_CACHE Cache,
+                     PNTFS_BUFFER_CACHE_ENTRY Entry)
+{
+    RemoveEntryList(&Entry->HashLinks);
+    RemoveEntryList(&Entry->LruLinks);
+    Cache->EntryCount--;
+    ExFreePoolWithTag(Entry, TAG_MFT_CACHE);
+}
+
+static
+VOID
+NtfsInsertCacheEntry(PNTFS_CACHE Cache,
+                     PNTFS_BUFFER_CACHE_ENTRY Entry,
+                     ULONG Bucket)
+{
+    /* Make room by throwing away the least recently used entry */
+    if (Cache->EntryCount >= Cache->MaxEntries)
+    {
+        NtfsRemoveCacheEntry(Cache, CONTAINING_RECORD(Cache->LruList.Blink,
+                                                      NTFS_BUFFER_CACHE_ENTRY,
+                                                      LruLinks));
+    }
+
+    InsertHeadList(&Cache->HashTable[Bucket], &Entry->HashLinks);
+    InsertHeadList(&Cache->LruList, &Entry->LruLinks);
+    Cache->EntryCount++;
+}
+
+static
+VOID
+NtfsPurgeCache(PNTFS_CACHE Cache)
+{
+    ExAcquireFastMutex(&Cache->Lock);
+    while (!IsListEmpty(&Cache->LruList))
+    {
+        NtfsRemoveCacheEntry(Cache, CONTAINING_RECORD(Cache->LruList.Flink,
+                                                      NTFS_BUFFER_CACHE_ENTRY,
+                                                      LruLinks));
+    }
+    ExReleaseFastMutex(&Cache->Lock);
+}
+
+/*
+ * FUNCTION: Throws away everything cached for a volume, for instance because
+ * someone else is about to write to it behind our back
+ */
+VOID
+NtfsPurgeCaches(PNTFS_VCB Vcb)
+{
+    NtfsPurgeCache(&Vcb->RecordCache);
+    NtfsPurgeCache(&Vcb->IndexCache);
+    NtfsPurgeCache(&Vcb->PathCache);
+}
+
+static
+ULONG
+NtfsHashBuffer(ULONGLONG MFTIndex,
+               ULONGLONG VCN)
+{
+    return (ULONG)((MFTIndex * 31 + VCN) % NTFS_CACHE_HASH_BUCKETS);
+}
+
+static
+PNTFS_BUFFER_CACHE_ENTRY
+NtfsFindCachedBuffer(PNTFS_CACHE Cache,
+                     ULONGLONG MFTIndex,
+                     ULONGLONG VCN)
+{
+    PLIST_ENTRY ListEntry;
+    PLIST_ENTRY Bucket = &Cache->HashTable[NtfsHashBuffer(MFTIndex, VCN)];
+
+    for (ListEntry = Bucket->Flink; ListEntry != Bucket; ListEntry = ListEntry->Flink)
+    {
+        PNTFS_BUFFER_CACHE_ENTRY Entry = CONTAINING_RECORD(ListEntry, NTFS_BUFFER_CACHE_ENTRY, HashLinks);
+
+        if (Entry->MFTIndex == MFTIndex && Entry->VCN == VCN)
+            return Entry;
+    }
+
+    return NULL;
+}
+
+static
+BOOLEAN
+NtfsReadCachedBuffer(PNTFS_CACHE Cache,
+                     ULONGLONG MFTIndex,
+                     ULONGLONG VCN,
+                     PVOID Buffer,
+                     ULONG Length)
+{
+    PNTFS_BUFFER_CACHE_ENTRY Entry;
+    BOOLEAN Found = FALSE;
+
+    ExAcquireFastMutex(&Cache->Lock);
+
+    Entry = NtfsFindCachedBuffer(Cache, MFTIndex, VCN);
+    if (Entry != NULL)
+    {
+        if (Entry->Length == Length)
+        {
+            RtlCopyMemory(Buffer, Entry->Data, Length);
+
+            /* Move it to the head of the LRU list */
+            RemoveEntryList(&Entry->LruLinks);
+            InsertHeadList(&Cache->LruList, &Entry->LruLinks);
+            Found = TRUE;
+        }
+        else
+        {
+            /* The caller expects a different size, this one is stale */
+            NtfsRemoveCacheEntry(Cache, Entry);
+        }
+    }
+
+    if (Found)
+        Cache->Hits++;
+    else
+        Cache->Misses++;
+
+    ExReleaseFastMutex(&Cache->Lock);
+
+    return Found;
+}
+
+static
+VOID
+NtfsCacheBuffer(PNTFS_CACHE Cache,
+                ULONGLONG MFTIndex,
+                ULONGLONG VCN,
+                PVOID Buffer,
+                ULONG Length)
+{
+    PNTFS_BUFFER_CACHE_ENTRY Entry, OldEntry;
+
+    /* Allocate and fill the entry before taking the lock */
+    Entry = ExAllocatePoolWithTag(NonPagedPool,
+                                  FIELD_OFFSET(NTFS_BUFFER_CACHE_ENTRY, Data[Length]),
+                                  TAG_MFT_CACHE);
+    if (Entry == NULL)
+        return;
+
+    Entry->MFTIndex = MFTIndex;
+    Entry->VCN = VCN;
+    Entry->Length = Length;
+    RtlCopyMemory(Entry->Data, Buffer, Length);
+
+    ExAcquireFastMutex(&Cache->Lock);
+
+    /* Someone may have cached it meanwhile, the newer copy wins */
+    OldEntry = NtfsFindCachedBuffer(Cache, MFTIndex, VCN);
+    if (OldEntry != NULL)
+        NtfsRemoveCacheEntry(Cache, OldEntry);
+
+    NtfsInsertCacheEntry(Cache, Entry, NtfsHashBuffer(MFTIndex, VCN));
+
+    ExReleaseFastMutex(&Cache->Lock);
+}
+
+/*
+ * FUNCTION: Copies a file record from the cache, with its fixups applied
+ * RETURNS: TRUE if the record was cached, FALSE if it has to be read
+ */
+BOOLEAN
+NtfsReadCachedRecord(PNTFS_VCB Vcb,
+                     ULONGLONG MFTIndex,
+                     PFILE_RECORD_HEADER FileRecord)
+{
+    return NtfsReadCachedBuffer(&Vcb->RecordCache, MFTIndex, 0, FileRecord, Vcb->NtfsInfo.BytesPerFileRecord);
+}
+
+/*
+ * FUNCTION: Adds a file record to the cache. The record must have its fixups applied.
+ */
+VOID
+NtfsCacheRecord(PNTFS_VCB Vcb,
+                ULONGLONG MFTIndex,
+                PFILE_RECORD_HEADER FileRecord)
+{
+    NtfsCacheBuffer(&Vcb->RecordCache, MFTIndex, 0, FileRecord, Vcb->NtfsInfo.BytesPerFileRecord);
+}
+
+/*
+ * FUNCTION: Drops the cached copies of the given range of file records
+ */
+VOID
+NtfsInvalidateCachedRecords(PNTFS_VCB Vcb,
+                            ULONGLONG FirstMFTIndex,
+                            ULONGLONG LastMFTIndex)
+{
+    PNTFS_CACHE Cache = &Vcb->RecordCache;
+    PNTFS_BUFFER_CACHE_ENTRY Entry;
+    ULONGLONG MFTIndex;
+
+    ExAcquireFastMutex(&Cache->Lock);
+
+    if (LastMFTIndex - FirstMFTIndex < Cache->EntryCount)
+    {
+        /* Few records, look them up */
+        for (MFTIndex = FirstMFTIndex; MFTIndex <= LastMFTIndex; MFTIndex++)
+        {
+            Entry = NtfsFindCachedBuffer(Cache, MFTIndex, 0);
+            if (Entry != NULL)
+                NtfsRemoveCacheEntry(Cache, Entry);
+        }
+    }
+    else
+    {
+        PLIST_ENTRY ListEntry = Cache->LruList.Flink;
+
+        /* Large write to the MFT, go through the whole cache instead */
+        while (ListEntry != &Cache->LruList)
+        {
+            Entry = CONTAINING_RECORD(ListEntry, NTFS_BUFFER_CACHE_ENTRY, LruLinks);
+            ListEntry = ListEntry->Flink;
+
+            if (Entry->MFTIndex >= FirstMFTIndex && Entry->MFTIndex <= LastMFTIndex)
+                NtfsRemoveCacheEntry(Cache, Entry);
+        }
+    }
+
+    ExReleaseFastMutex(&Cache->Lock);
+}
+
+/*
+ * FUNCTION: Copies an index buffer of a directory from the cache, with its fixups applied
+ * RETURNS: TRUE if the buffer was cached, FALSE if it has to be read
+ */
+BOOLEAN
+NtfsReadCachedIndexBuffer(PNTFS_VCB Vcb,
+                          ULONGLONG DirectoryMFTIndex,
+                          ULONGLONG VCN,
+                          PINDEX_BUFFER IndexBuffer,
+                          ULONG Length)
+{
+    /* Pre-XP records don't know their own index, we can't tell directories apart */
+    if (DirectoryMFTIndex == NTFS_FILE_MFT)
+        return FALSE;
+
+    return NtfsReadCachedBuffer(&Vcb->IndexCache, DirectoryMFTIndex, VCN, IndexBuffer, Length);
+}
+
+/*
+ * FUNCTION: Adds an index buffer of a directory to the cache. It must have its fixups applied.
+ */
+VOID
+NtfsCacheIndexBuffer(PNTFS_VCB Vcb,
+                     ULONGLONG DirectoryMFTIndex,
+                     ULONGLONG VCN,
+                     PINDEX_BUFFER IndexBuffer,
+                     ULONG Length)
+{
+    if (DirectoryMFTIndex == NTFS_FILE_MFT)
+        return;
+
+    NtfsCacheBuffer(&Vcb->IndexCache, DirectoryMFTIndex, VCN, IndexBuffer, Length);
+}
+
+/*
+ * FUNCTION: Copies the $I30 bitmap of a directory from the cache
+ */
+BOOLEAN
+NtfsReadCachedIndexBitmap(PNTFS_VCB Vcb,
+                          ULONGLONG DirectoryMFTIndex,
+                          PVOID Bitmap,
+                          ULONG Length)
+{
+    if (DirectoryMFTIndex == NTFS_FILE_MFT || Length > NTFS_MAX_CACHED_BITMAP)
+        return FALSE;
+
+    return NtfsReadCachedBuffer(&Vcb->IndexCache, DirectoryMFTIndex, NTFS_CACHE_BITMAP_VCN, Bitmap, Length);
+}
+
+/*
+ * FUNCTION: Adds the $I30 bitmap of a directory to the cache
+ */
+VOID
+NtfsCacheIndexBitmap(PNTFS_VCB Vcb,
+                     ULONGLONG DirectoryMFTIndex,
+                     PVOID Bitmap,
+                     ULONG Length)
+{
+    if (DirectoryMFTIndex == NTFS_FILE_MFT || Length > NTFS_MAX_CACHED_BITMAP)
+        return;
+
+    NtfsCacheBuffer(&Vcb->IndexCache, DirectoryMFTIndex, NTFS_CACHE_BITMAP_VCN, Bitmap, Length);
+}
+
+/*
+ * FUNCTION: Drops everything cached about the index of a directory: its
+ * index buffers, its bitmap, and the paths that were resolved through it
+ */
+VOID
+NtfsInvalidateCachedIndex(PNTFS_VCB Vcb,
+                          ULONGLONG DirectoryMFTIndex)
+{
+    PNTFS_CACHE Cache;
+    PLIST_ENTRY ListEntry;
+
+    Cache = &Vcb->IndexCache;
+    ExAcquireFastMutex(&Cache->Lock);
+    ListEntry = Cache->LruList.Flink;
+    while (ListEntry != &Cache->LruList)
+    {
+        PNTFS_BUFFER_CACHE_ENTRY Entry = CONTAINING_RECORD(ListEntry, NTFS_BUFFER_CACHE_ENTRY, LruLinks);
+        ListEntry = ListEntry->Flink;
+
+        if (Entry->MFTIndex == DirectoryMFTIndex)
+            NtfsRemoveCacheEntry(Cache, Entry);
+    }
+    ExReleaseFastMutex(&Cache->Lock);
+
+    Cache = &Vcb->PathCache;
+    ExAcquireFastMutex(&Cache->Lock);
+    ListEntry = Cache->LruList.Flink;
+    while (ListEntry != &Cache->LruList)
+    {
+        PNTFS_PATH_CACHE_ENTRY Entry = CONTAINING_RECORD(ListEntry, NTFS_PATH_CACHE_ENTRY, LruLinks);
+        ListEntry = ListEntry->Flink;
+
+        if (Entry->ParentMFTIndex == DirectoryMFTIndex)
+            NtfsRemoveCacheEntry(Cache, (PNTFS_BUFFER_CACHE_ENTRY)Entry);
+    }
+    ExReleaseFastMutex(&Cache->Lock);
+}
+
+static
+ULONG
+NtfsHashPath(PCUNICODE_STRING Path)
+{
+    ULONG Hash = 0;
+    ULONG i;
+
+    /* Paths are looked up case insensitively */
+    for (i = 0; i < Path->Length / sizeof(WCHAR); i++)
+    {
+        Hash = Hash * 31 + RtlUpcaseUnicodeChar(Path->Buffer[i]);
+    }
+
+    return Hash % NTFS_CACHE_HASH_BUCKETS;
+}
+
+static
+PNTFS_PATH_CACHE_ENTRY
+NtfsFindCachedPath(PNTFS_CACHE Cache,
+                   PCUNICODE_STRING Path,
+                   ULONG Bucket)
+{
+    PLIST_ENTRY ListEntry;
+
+    for (ListEntry = Cache->HashTable[Bucket].Flink;
+         ListEntry != &Cache->HashTable[Bucket];
+         ListEntry = ListEntry->Flink)
+    {
+        PNTFS_PATH_CACHE_ENTRY Entry = CONTAINING_RECORD(ListEntry, NTFS_PATH_CACHE_ENTRY, HashLinks);
+
+        if (RtlEqualUnicodeString(&Entry->Path, Path, TRUE))
+            return Entry;
+    }
+
+    return NULL;
+}
+
+/*
+ * FUNCTION: Looks up the MFT index a path was resolved to before
+ * RETURNS: TRUE if the path was cached, FALSE if it has to be looked up in the indexes
+ */
+BOOLEAN
+NtfsLookupCachedPath(PNTFS_VCB Vcb,
+                     PCUNICODE_STRING Path,
+                     PULONGLONG MFTIndex)
+{
+    PNTFS_CACHE Cache = &Vcb->PathCache;
+    PNTFS_PATH_CACHE_ENTRY Entry;
+
+    ExAcquireFastMutex(&Cache->Lock);
+
+    Entry = NtfsFindCachedPath(Cache, Path, NtfsHashPath(Path));
+    if (Entry != NULL)
+    {
+        *MFTIndex = Entry->MFTIndex;
+
+        RemoveEntryList(&Entry->LruLinks);
+        InsertHeadList(&Cache->LruList, &Entry->LruLinks);
+        Cache->Hits++;
+    }
+    else
+    {
+        Cache->Misses++;
+    }
+
+    ExReleaseFastMutex(&Cache->Lock);
+
+    return (Entry != NULL);
+}
+
+/*
+ * FUNCTION: Remembers that a path was resolved to the given MFT index,
+ * by finding its last component in the directory ParentMFTIndex
+ */
+VOID
+NtfsCachePath(PNTFS_VCB Vcb,
+              PCUNICODE_STRING Path,
+              ULONGLONG ParentMFTIndex,
+              ULONGLONG MFTIndex)
+{
+    PNTFS_CACHE Cache = &Vcb->PathCache;
+    PNTFS_PATH_CACHE_ENTRY Entry, OldEntry;
+    ULONG Bucket;
+
+    Entry = ExAllocatePoolWithTag(NonPagedPool,
+                                  FIELD_OFFSET(NTFS_PATH_CACHE_ENTRY, PathBuffer) + Path->Length,
+                                  TAG_MFT_CACHE);
+    if (Entry == NULL)
+        return;
+
+    Entry->ParentMFTIndex = ParentMFTIndex;
+    Entry->MFTIndex = MFTIndex;
+    Entry->Path.Buffer = Entry->PathBuffer;
+    Entry->Path.Length = Path->Length;
+    Entry->Path.MaximumLength = Path->Length;
+    RtlCopyMemory(Entry->PathBuffer, Path->Buffer, Path->Length);
+
+    Bucket = NtfsHashPath(Path);
+
+    ExAcquireFastMutex(&Cache->Lock);
+
+    OldEntry = NtfsFindCachedPath(Cache, Path, Bucket);
+    if (OldEntry != NULL)
+        NtfsRemoveCacheEntry(Cache, (PNTFS_BUFFER_CACHE_ENTRY)OldEntry);
+
+    NtfsInsertCacheEntry(Cache, (PNTFS_BUFFER_CACHE_ENTRY)Entry, Bucket);
+
+    ExReleaseFastMutex(&Cache->Lock);
+}
+
+/* EOF */
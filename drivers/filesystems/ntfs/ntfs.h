@@ -15,6 +15,7 @@
 #define TAG_IRP_CTXT 'iftN'
 #define TAG_ATT_CTXT 'aftN'
 #define TAG_FILE_REC 'rftN'
+#define TAG_MFT_CACHE 'mftN'
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 #define ROUND_DOWN(N, S) ((N) - ((N) % (S)))
@@ -84,6 +85,24 @@ typedef struct _NTFS_INFO
     ULONG MftZoneReservation;
 } NTFS_INFO, *PNTFS_INFO;
 
+#define NTFS_CACHE_HASH_BUCKETS     64
+#define NTFS_RECORD_CACHE_ENTRIES   256
+#define NTFS_INDEX_CACHE_ENTRIES    64
+#define NTFS_PATH_CACHE_ENTRIES     256
+#define NTFS_MAX_CACHED_BITMAP      PAGE_SIZE
+
+/* Bounded LRU cache of on-disk structures, see mftcache.c */
+typedef struct _NTFS_CACHE
+{
+    FAST_MUTEX Lock;
+    LIST_ENTRY HashTable[NTFS_CACHE_HASH_BUCKETS];
+    LIST_ENTRY LruList;
+    ULONG EntryCount;
+    ULONG MaxEntries;
+    ULONG Hits;
+    ULONG Misses;
+} NTFS_CACHE, *PNTFS_CACHE;
+
 #define NTFS_TYPE_CCB         '20SF'
 #define NTFS_TYPE_FCB         '30SF'
 #define NTFS_TYPE_VCB         '50SF'
@@ -118,6 +137,10 @@ typedef struct
 
     NPAGED_LOOKASIDE_LIST FileRecLookasideList;
 
+    NTFS_CACHE RecordCache;
+    NTFS_CACHE IndexCache;
+    NTFS_CACHE PathCache;
+
     ULONG MftDataOffset;
     ULONG Flags;
     ULONG OpenHandleCount;
@@ -1220,6 +1243,72 @@ NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
                   BOOLEAN CaseSensitive,
                   ULONGLONG *OutMFTIndex);
 
+
+/* mftcache.c */
+
+VOID
+NtfsInitializeCaches(PNTFS_VCB Vcb);
+
+VOID
+NtfsPurgeCaches(PNTFS_VCB Vcb);
+
+BOOLEAN
+NtfsReadCachedRecord(PNTFS_VCB Vcb,
+                     ULONGLONG MFTIndex,
+                     PFILE_RECORD_HEADER FileRecord);
+
+VOID
+NtfsCacheRecord(PNTFS_VCB Vcb,
+                ULONGLONG MFTIndex,
+                PFILE_RECORD_HEADER FileRecord);
+
+VOID
+NtfsInvalidateCachedRecords(PNTFS_VCB Vcb,
+                            ULONGLONG FirstMFTIndex,
+                            ULONGLONG LastMFTIndex);
+
+BOOLEAN
+NtfsReadCachedIndexBuffer(PNTFS_VCB Vcb,
+                          ULONGLONG DirectoryMFTIndex,
+                          ULONGLONG VCN,
+                          PINDEX_BUFFER IndexBuffer,
+                          ULONG Length);
+
+VOID
+NtfsCacheIndexBuffer(PNTFS_VCB Vcb,
+                     ULONGLONG DirectoryMFTIndex,
+                     ULONGLONG VCN,
+                     PINDEX_BUFFER IndexBuffer,
+                     ULONG Length);
+
+BOOLEAN
+NtfsReadCachedIndexBitmap(PNTFS_VCB Vcb,
+                          ULONGLONG DirectoryMFTIndex,
+                          PVOID Bitmap,
+                          ULONG Length);
+
+VOID
+NtfsCacheIndexBitmap(PNTFS_VCB Vcb,
+                     ULONGLONG DirectoryMFTIndex,
+                     PVOID Bitmap,
+                     ULONG Length);
+
+VOID
+NtfsInvalidateCachedIndex(PNTFS_VCB Vcb,
+                          ULONGLONG DirectoryMFTIndex);
+
+BOOLEAN
+NtfsLookupCachedPath(PNTFS_VCB Vcb,
+                     PCUNICODE_STRING Path,
+                     PULONGLONG MFTIndex);
+
+VOID
+NtfsCachePath(PNTFS_VCB Vcb,
+              PCUNICODE_STRING Path,
+              ULONGLONG ParentMFTIndex,
+              ULONGLONG MFTIndex);
+
+
 /* misc.c */
 
 BOOLEAN
@@ -1024,6 +1024,7 @@ FATDelEntry(
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
+        FsRtlTruncateLargeMcb(&pFcb->ClusterMcb, 0);
         while (CurrentCluster && CurrentCluster != 0xffffffff)
         {
             GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
@@ -1103,6 +1104,7 @@ FATXDelEntry(
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
+        FsRtlTruncateLargeMcb(&pFcb->ClusterMcb, 0);
         while (CurrentCluster && CurrentCluster != 0xffffffff)
         {
             GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
@@ -416,7 +416,11 @@ FAT12CountAvailableClusters(
         }
 
         if (Entry == 0)
+        {
             ulCount++;
+            if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+        }
     }
 
     CcUnpinData(Context);
@@ -467,7 +471,11 @@ FAT16CountAvailableClusters(
         while (Block < BlockEnd && i < FatLength)
         {
             if (*Block == 0)
+            {
                 ulCount++;
+                if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                    RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+            }
             Block++;
             i++;
         }
@@ -523,7 +531,11 @@ FAT32CountAvailableClusters(
         while (Block < BlockEnd && i < FatLength)
         {
             if ((*Block & 0x0fffffff) == 0)
+            {
                 ulCount++;
+                if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                    RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+            }
             Block++;
             i++;
         }
@@ -543,6 +555,17 @@ CountAvailableClusters(
     PLARGE_INTEGER Clusters)
 {
     NTSTATUS Status = STATUS_SUCCESS;
+
+    /* Once counted, every FAT write keeps the counter up to date */
+    if (DeviceExt->AvailableClustersValid)
+    {
+        if (Clusters != NULL)
+        {
+            Clusters->QuadPart = DeviceExt->AvailableClusters;
+        }
+        return STATUS_SUCCESS;
+    }
+
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     if (!DeviceExt->AvailableClustersValid)
     {
@@ -562,6 +585,185 @@ CountAvailableClusters(
     return Status;
 }
 
+/*
+ * FUNCTION: Builds the in-memory bitmap of the clusters in use with a single
+ *           pass over the FAT, and counts the free ones on the way
+ */
+NTSTATUS
+InitializeFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    ULONG NumberOfBits;
+    PULONG Buffer;
+    NTSTATUS Status;
+
+    /* Clusters 0 and 1 don't exist, keep them marked as in use */
+    NumberOfBits = DeviceExt->FatInfo.NumberOfClusters + 2;
+    Buffer = ExAllocatePoolWithTag(PagedPool, ROUND_UP(NumberOfBits, 32) / 8, TAG_BITMAP);
+    if (Buffer != NULL)
+    {
+        RtlInitializeBitMap(&DeviceExt->FreeClusterBitmap, Buffer, NumberOfBits);
+        RtlSetAllBits(&DeviceExt->FreeClusterBitmap);
+    }
+    else
+    {
+        /* Not fatal, allocations will scan the FAT instead */
+        DPRINT1("Failed to allocate the free cluster bitmap (%u clusters)\n", NumberOfBits);
+        RtlZeroMemory(&DeviceExt->FreeClusterBitmap, sizeof(DeviceExt->FreeClusterBitmap));
+    }
+
+    DeviceExt->AvailableClustersValid = FALSE;
+    Status = CountAvailableClusters(DeviceExt, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        UninitializeFreeClusterBitmap(DeviceExt);
+    }
+
+    return Status;
+}
+
+VOID
+UninitializeFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+    {
+        ExFreePoolWithTag(DeviceExt->FreeClusterBitmap.Buffer, TAG_BITMAP);
+        RtlZeroMemory(&DeviceExt->FreeClusterBitmap, sizeof(DeviceExt->FreeClusterBitmap));
+    }
+}
+
+/*
+ * FUNCTION: Allocates up to ClusterCount contiguous clusters, chains them and
+ *           appends them to PreviousCluster (unless it is 0). The run right
+ *           after PreviousCluster is preferred so that the file stays
+ *           contiguous, then the smallest free run holding the whole request,
+ *           then the largest free run. RunLength receives the number of
+ *           clusters actually allocated.
+ */
+NTSTATUS
+AllocateClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG PreviousCluster,
+    ULONG ClusterCount,
+    PULONG FirstCluster,
+    PULONG RunLength)
+{
+    PRTL_BITMAP Bitmap = &DeviceExt->FreeClusterBitmap;
+    ULONG Index, Start, Length;
+    ULONG BestStart, BestLength;
+    ULONG i;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    ASSERT(ClusterCount != 0);
+
+    *FirstCluster = 0;
+    *RunLength = 0;
+
+    ExAcquireResourceExclusiveLite(&DeviceExt->FatResource, TRUE);
+
+    if (Bitmap->Buffer == NULL)
+    {
+        /* No bitmap, scan the FAT for one cluster, it comes back marked as the end of chain */
+        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &BestStart);
+        if (!NT_SUCCESS(Status))
+        {
+            ExReleaseResourceLite(&DeviceExt->FatResource);
+            return Status;
+        }
+        BestLength = 1;
+    }
+    else
+    {
+        BestStart = 0;
+        BestLength = 0;
+
+        if (PreviousCluster >= 2 && PreviousCluster + 1 < Bitmap->SizeOfBitMap &&
+            !RtlTestBit(Bitmap, PreviousCluster + 1))
+        {
+            BestLength = RtlFindNextForwardRunClear(Bitmap, PreviousCluster + 1, &BestStart);
+        }
+        else if (ClusterCount == 1)
+        {
+            /* Any free cluster fits, go on from the last one we handed out */
+            BestStart = RtlFindClearBits(Bitmap, 1, DeviceExt->LastAvailableCluster);
+            if (BestStart != MAXULONG)
+                BestLength = 1;
+        }
+        else
+        {
+            for (Index = 2; Index < Bitmap->SizeOfBitMap; Index = Start + Length)
+            {
+                Length = RtlFindNextForwardRunClear(Bitmap, Index, &Start);
+                if (Length == 0)
+                    break;
+
+                if (Length >= ClusterCount)
+                {
+                    if (BestLength < ClusterCount || Length < BestLength)
+                    {
+                        BestStart = Start;
+                        BestLength = Length;
+                    }
+
+                    /* Can't do better than an exact fit */
+                    if (Length == ClusterCount)
+                        break;
+                }
+                else if (Length > BestLength)
+                {
+                    BestStart = Start;
+                    BestLength = Length;
+                }
+            }
+        }
+
+        if (BestLength == 0)
+        {
+            ExReleaseResourceLite(&DeviceExt->FatResource);
+            return STATUS_DISK_FULL;
+        }
+
+        BestLength = min(BestLength, ClusterCount);
+
+        /* Chain the run, WriteCluster updates the bitmap and the counter */
+        for (i = 0; i < BestLength; i++)
+        {
+            Status = WriteCluster(DeviceExt, BestStart + i,
+                                  (i + 1 < BestLength) ? BestStart + i + 1 : 0xffffffff);
+            if (!NT_SUCCESS(Status))
+                break;
+        }
+
+        if (!NT_SUCCESS(Status))
+        {
+            while (i-- > 0)
+            {
+                WriteCluster(DeviceExt, BestStart + i, 0);
+            }
+            ExReleaseResourceLite(&DeviceExt->FatResource);
+            return Status;
+        }
+
+        DeviceExt->LastAvailableCluster = BestStart + BestLength - 1;
+    }
+
+    if (PreviousCluster != 0)
+    {
+        Status = WriteCluster(DeviceExt, PreviousCluster, BestStart);
+    }
+
+    if (NT_SUCCESS(Status))
+    {
+        DPRINT("Allocated %u clusters at 0x%x\n", BestLength, BestStart);
+        *FirstCluster = BestStart;
+        *RunLength = BestLength;
+    }
+
+    ExReleaseResourceLite(&DeviceExt->FatResource);
+    return Status;
+}
+
 
 /*
  * FUNCTION: Writes a cluster to the FAT12 physical and in-memory tables
@@ -712,12 +914,20 @@ WriteCluster(
 
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     Status = DeviceExt->WriteCluster(DeviceExt, ClusterToWrite, NewValue, &OldValue);
-    if (DeviceExt->AvailableClustersValid)
+    if (NT_SUCCESS(Status) && DeviceExt->AvailableClustersValid)
     {
         if (OldValue && NewValue == 0)
+        {
             InterlockedIncrement((PLONG)&DeviceExt->AvailableClusters);
+            if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                RtlClearBit(&DeviceExt->FreeClusterBitmap, ClusterToWrite);
+        }
         else if (OldValue == 0 && NewValue)
+        {
             InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
+            if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                RtlSetBit(&DeviceExt->FreeClusterBitmap, ClusterToWrite);
+        }
     }
     ExReleaseResourceLite(&DeviceExt->FatResource);
     return Status;
@@ -776,6 +986,7 @@ GetNextClusterExtend(
     PULONG NextCluster)
 {
     ULONG NewCluster;
+    ULONG RunLength;
     NTSTATUS Status;
 
     DPRINT("GetNextClusterExtend(DeviceExt %p, CurrentCluster %x)\n",
@@ -788,7 +999,7 @@ GetNextClusterExtend(
      */
     if (CurrentCluster == 0)
     {
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
+        Status = AllocateClusterRun(DeviceExt, 0, 1, &NewCluster, &RunLength);
         if (!NT_SUCCESS(Status))
         {
             ExReleaseResourceLite(&DeviceExt->FatResource);
@@ -804,19 +1015,16 @@ GetNextClusterExtend(
 
     if ((*NextCluster) == 0xFFFFFFFF)
     {
-        /* We are after last existing cluster, we must add one to file */
-        /* Firstly, find the next available open allocation unit and
-           mark it as end of file */
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
+        /* We are after last existing cluster, we must add one to file:
+           find the next available allocation unit, mark it as end of file
+           and link the last cluster to it */
+        Status = AllocateClusterRun(DeviceExt, CurrentCluster, 1, &NewCluster, &RunLength);
         if (!NT_SUCCESS(Status))
         {
             ExReleaseResourceLite(&DeviceExt->FatResource);
             return Status;
         }
 
-        /* Now, write the AU of the LastCluster with the value of the newly
-           found AU */
-        WriteCluster(DeviceExt, CurrentCluster, NewCluster);
         *NextCluster = NewCluster;
     }
 
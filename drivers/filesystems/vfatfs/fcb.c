@@ -151,6 +151,7 @@ vfatNewFCB(
     ExInitializeResourceLite(&rcFCB->MainResource);
     FsRtlInitializeFileLock(&rcFCB->FileLock, NULL, NULL);
     ExInitializeFastMutex(&rcFCB->LastMutex);
+    FsRtlInitializeLargeMcb(&rcFCB->ClusterMcb, NonPagedPool);
     rcFCB->RFCB.PagingIoResource = &rcFCB->PagingIoResource;
     rcFCB->RFCB.Resource = &rcFCB->MainResource;
     rcFCB->RFCB.IsFastIoPossible = FastIoIsNotPossible;
@@ -276,6 +277,7 @@ vfatDestroyFCB(
 #endif
 
     FsRtlUninitializeFileLock(&pFCB->FileLock);
+    FsRtlUninitializeLargeMcb(&pFCB->ClusterMcb);
 
     if (!vfatFCBIsRoot(pFCB) &&
         !BooleanFlagOn(pFCB->Flags, FCB_IS_FAT) && !BooleanFlagOn(pFCB->Flags, FCB_IS_VOLUME))
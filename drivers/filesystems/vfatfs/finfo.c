@@ -1249,10 +1249,12 @@ VfatSetAllocationSizeInformation(
         if (FirstCluster == 0)
         {
             Fcb->LastCluster = Fcb->LastOffset = 0;
-            Status = NextCluster(DeviceExt, FirstCluster, &FirstCluster, TRUE);
+            /* Try to get the whole allocation as a single run */
+            Status = AllocateClusterRun(DeviceExt, 0, (NewSize - 1) / ClusterSize + 1,
+                                        &FirstCluster, &NCluster);
             if (!NT_SUCCESS(Status))
             {
-                DPRINT1("NextCluster failed. Status = %x\n", Status);
+                DPRINT1("AllocateClusterRun failed. Status = %x\n", Status);
                 return Status;
             }
 
@@ -1335,6 +1337,8 @@ VfatSetAllocationSizeInformation(
             if (NCluster == 0xffffffff || !NT_SUCCESS(Status))
             {
                 /* disk is full */
+                FsRtlTruncateLargeMcb(&Fcb->ClusterMcb,
+                                      Fcb->RFCB.AllocationSize.u.LowPart / ClusterSize);
                 NCluster = Cluster;
                 Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
                 WriteCluster(DeviceExt, Cluster, 0xffffffff);
@@ -1364,6 +1368,7 @@ VfatSetAllocationSizeInformation(
         AllocSizeChanged = TRUE;
         /* FIXME: Use the cached cluster/offset better way. */
         Fcb->LastCluster = Fcb->LastOffset = 0;
+        FsRtlTruncateLargeMcb(&Fcb->ClusterMcb, (NewSize > 0) ? (NewSize - 1) / ClusterSize + 1 : 0);
         UpdateFileSize(FileObject, Fcb, NewSize, ClusterSize, vfatVolumeIsFatX(DeviceExt));
         if (NewSize > 0)
         {
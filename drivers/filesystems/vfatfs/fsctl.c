@@ -721,8 +721,8 @@ VfatMount(
     _SEH2_END;
 
     DeviceExt->LastAvailableCluster = 2;
-    CountAvailableClusters(DeviceExt, NULL);
     ExInitializeResourceLite(&DeviceExt->FatResource);
+    InitializeFreeClusterBitmap(DeviceExt);
 
     InitializeListHead(&DeviceExt->FcbListHead);
 
@@ -809,6 +809,8 @@ ByeBye:
         }
         if (Fcb)
             vfatDestroyFCB(Fcb);
+        if (DeviceExt)
+            UninitializeFreeClusterBitmap(DeviceExt);
         if (DeviceExt && DeviceExt->SpareVPB)
             ExFreePoolWithTag(DeviceExt->SpareVPB, TAG_VPB);
         if (DeviceExt && DeviceExt->Statistics)
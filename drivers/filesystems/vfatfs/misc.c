@@ -660,6 +660,7 @@ VfatCheckForDismount(
 
         /* Release resources */
         ExFreePoolWithTag(DeviceExt->Statistics, TAG_STATS);
+        UninitializeFreeClusterBitmap(DeviceExt);
         ExDeleteResourceLite(&DeviceExt->DirResource);
         ExDeleteResourceLite(&DeviceExt->FatResource);
 
@@ -64,6 +64,9 @@ OffsetToCluster(
     BOOLEAN Extend)
 {
     ULONG CurrentCluster;
+    ULONG NextCluster;
+    ULONG ClusterCount;
+    ULONG RunLength;
     ULONG i;
     NTSTATUS Status;
 /*
@@ -89,11 +92,29 @@ OffsetToCluster(
         CurrentCluster = FirstCluster;
         if (Extend)
         {
-            for (i = 0; i < FileOffset / DeviceExt->FatInfo.BytesPerCluster; i++)
+            ClusterCount = FileOffset / DeviceExt->FatInfo.BytesPerCluster;
+            for (i = 0; i < ClusterCount;)
             {
-                Status = GetNextClusterExtend (DeviceExt, CurrentCluster, &CurrentCluster);
+                Status = GetNextCluster (DeviceExt, CurrentCluster, &NextCluster);
                 if (!NT_SUCCESS(Status))
                     return Status;
+
+                if (NextCluster == 0xffffffff)
+                {
+                    /* End of the chain: allocate what is missing in as few runs as possible */
+                    Status = AllocateClusterRun(DeviceExt, CurrentCluster, ClusterCount - i,
+                                                &NextCluster, &RunLength);
+                    if (!NT_SUCCESS(Status))
+                        return Status;
+
+                    CurrentCluster = NextCluster + RunLength - 1;
+                    i += RunLength;
+                }
+                else
+                {
+                    CurrentCluster = NextCluster;
+                    i++;
+                }
             }
             *Cluster = CurrentCluster;
         }
@@ -111,6 +132,113 @@ OffsetToCluster(
    }
 }
 
+/*
+ * Return the cluster holding FileOffset and how many clusters follow it
+ * contiguously on disk, up to the end of the transfer. The chain is read
+ * from the FAT only once and kept in the FCB extent map, so later lookups
+ * don't walk it again. Cluster is 0xffffffff if the chain ends before
+ * FileOffset.
+ */
+static
+NTSTATUS
+VfatGetClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG FileOffset,
+    ULONG Length,
+    PULONG Cluster,
+    PULONG ClusterCount)
+{
+    ULONG BytesPerCluster = DeviceExt->FatInfo.BytesPerCluster;
+    LONGLONG Vcn, EndVcn, MappedVcn, Lcn, RunCount;
+    LONGLONG RunVcn, RunLcn;
+    ULONG CurrentCluster;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    ASSERT(Length > 0);
+
+    if (FirstCluster == 0)
+    {
+        *Cluster = 0xffffffff;
+        *ClusterCount = 0;
+        return STATUS_SUCCESS;
+    }
+
+    Vcn = FileOffset / BytesPerCluster;
+    EndVcn = ((ULONGLONG)FileOffset + Length - 1) / BytesPerCluster;
+
+    /* Extend the map from its end until it covers the whole transfer */
+    if (!FsRtlLookupLastLargeMcbEntry(&Fcb->ClusterMcb, &MappedVcn, &Lcn))
+    {
+        MappedVcn = 0;
+        Lcn = FirstCluster;
+        FsRtlAddLargeMcbEntry(&Fcb->ClusterMcb, 0, FirstCluster, 1);
+    }
+
+    if (MappedVcn < EndVcn)
+    {
+        CurrentCluster = (ULONG)Lcn;
+        RunVcn = MappedVcn + 1;
+        RunLcn = RunCount = 0;
+
+        while (MappedVcn < EndVcn)
+        {
+            Status = GetNextCluster(DeviceExt, CurrentCluster, &CurrentCluster);
+            if (!NT_SUCCESS(Status) || CurrentCluster == 0xffffffff)
+                break;
+
+            MappedVcn++;
+            if (RunCount != 0 && RunLcn + RunCount != CurrentCluster)
+            {
+                FsRtlAddLargeMcbEntry(&Fcb->ClusterMcb, RunVcn, RunLcn, RunCount);
+                RunCount = 0;
+            }
+            if (RunCount == 0)
+            {
+                RunVcn = MappedVcn;
+                RunLcn = CurrentCluster;
+            }
+            RunCount++;
+        }
+
+        if (RunCount != 0)
+        {
+            FsRtlAddLargeMcbEntry(&Fcb->ClusterMcb, RunVcn, RunLcn, RunCount);
+        }
+
+        if (!NT_SUCCESS(Status))
+        {
+            return Status;
+        }
+    }
+
+    if (!FsRtlLookupLargeMcbEntry(&Fcb->ClusterMcb, Vcn, &Lcn, &RunCount, NULL, NULL, NULL) ||
+        Lcn == -1)
+    {
+        *Cluster = 0xffffffff;
+        *ClusterCount = 0;
+        return STATUS_SUCCESS;
+    }
+
+    *Cluster = (ULONG)Lcn;
+    *ClusterCount = (ULONG)min(RunCount, EndVcn - Vcn + 1);
+
+#ifdef DEBUG_VERIFY_OFFSET_CACHING
+    /* DEBUG VERIFICATION */
+    {
+        ULONG CorrectCluster;
+        OffsetToCluster(DeviceExt, FirstCluster,
+                        ROUND_DOWN(FileOffset, BytesPerCluster),
+                        &CorrectCluster, FALSE);
+        if (CorrectCluster != *Cluster)
+            KeBugCheck(FAT_FILE_SYSTEM);
+    }
+#endif
+
+    return STATUS_SUCCESS;
+}
+
 /*
  * FUNCTION: Reads data from a file
  */
@@ -122,20 +250,16 @@ VfatReadFileData(
     LARGE_INTEGER ReadOffset,
     PULONG LengthRead)
 {
-    ULONG CurrentCluster;
     ULONG FirstCluster;
     ULONG StartCluster;
     ULONG ClusterCount;
     LARGE_INTEGER StartOffset;
     PDEVICE_EXTENSION DeviceExt;
-    BOOLEAN First = TRUE;
     PVFATFCB Fcb;
-    NTSTATUS Status;
+    NTSTATUS Status = STATUS_SUCCESS;
     ULONG BytesDone;
     ULONG BytesPerSector;
     ULONG BytesPerCluster;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -192,8 +316,7 @@ VfatReadFileData(
     }
 
     /* Find the first cluster */
-    FirstCluster =
-    CurrentCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
+    FirstCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
 
     if (FirstCluster == 1)
     {
@@ -213,87 +336,24 @@ VfatReadFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
-    /* Find the cluster to start the read from */
-    if (LastCluster > 0 && ReadOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
-#ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
-    {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
-    }
-
-    if (!NT_SUCCESS(Status))
-    {
-        return Status;
-    }
-
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    Fcb->LastCluster = CurrentCluster;
-    Fcb->LastOffset = ROUND_DOWN (ReadOffset.u.LowPart, BytesPerCluster);
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     KeInitializeEvent(&IrpContext->Event, NotificationEvent, FALSE);
     IrpContext->RefCount = 1;
 
-    while (Length > 0 && CurrentCluster != 0xffffffff)
+    while (Length > 0)
     {
-        StartCluster = CurrentCluster;
-        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector;
-        BytesDone = 0;
-        ClusterCount = 0;
-
-        do
+        /* Read as many contiguous clusters as possible at once */
+        Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster, ReadOffset.u.LowPart, Length,
+                                   &StartCluster, &ClusterCount);
+        if (!NT_SUCCESS(Status) || StartCluster == 0xffffffff)
         {
-            ClusterCount++;
-            if (First)
-            {
-                BytesDone =  min (Length, BytesPerCluster - (ReadOffset.u.LowPart % BytesPerCluster));
-                StartOffset.QuadPart += ReadOffset.u.LowPart % BytesPerCluster;
-                First = FALSE;
-            }
-            else
-            {
-                if (Length - BytesDone > BytesPerCluster)
-                {
-                    BytesDone += BytesPerCluster;
-                }
-                else
-                {
-                    BytesDone = Length;
-                }
-            }
-            Status = NextCluster(DeviceExt, FirstCluster, &CurrentCluster, FALSE);
+            break;
         }
-        while (StartCluster + ClusterCount == CurrentCluster && NT_SUCCESS(Status) && Length > BytesDone);
-        DPRINT("start %08x, next %08x, count %u\n",
-               StartCluster, CurrentCluster, ClusterCount);
 
-        ExAcquireFastMutex(&Fcb->LastMutex);
-        Fcb->LastCluster = StartCluster + (ClusterCount - 1);
-        Fcb->LastOffset = ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
-        ExReleaseFastMutex(&Fcb->LastMutex);
+        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector +
+                               ReadOffset.u.LowPart % BytesPerCluster;
+        BytesDone = (ULONG)min((ULONGLONG)Length,
+                               (ULONGLONG)ClusterCount * BytesPerCluster - ReadOffset.u.LowPart % BytesPerCluster);
+        DPRINT("start %08x, count %u\n", StartCluster, ClusterCount);
 
         /* Fire up the read command */
         Status = VfatReadDiskPartial (IrpContext, &StartOffset, BytesDone, *LengthRead, FALSE);
@@ -337,18 +397,14 @@ VfatWriteFileData(
     PVFATFCB Fcb;
     ULONG Count;
     ULONG FirstCluster;
-    ULONG CurrentCluster;
     ULONG BytesDone;
     ULONG StartCluster;
     ULONG ClusterCount;
     NTSTATUS Status = STATUS_SUCCESS;
-    BOOLEAN First = TRUE;
     ULONG BytesPerSector;
     ULONG BytesPerCluster;
     LARGE_INTEGER StartOffset;
     ULONG BufferOffset;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -413,8 +469,7 @@ VfatWriteFileData(
     /*
      * Find the first cluster
      */
-    FirstCluster =
-    CurrentCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
+    FirstCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
 
     if (FirstCluster == 1)
     {
@@ -426,89 +481,24 @@ VfatWriteFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
-    /*
-     * Find the cluster to start the write from
-     */
-    if (LastCluster > 0 && WriteOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
-#ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
-    {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
-    }
-
-    if (!NT_SUCCESS(Status))
-    {
-        return Status;
-    }
-
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    Fcb->LastCluster = CurrentCluster;
-    Fcb->LastOffset = ROUND_DOWN (WriteOffset.u.LowPart, BytesPerCluster);
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     IrpContext->RefCount = 1;
     BufferOffset = 0;
 
-    while (Length > 0 && CurrentCluster != 0xffffffff)
+    while (Length > 0)
     {
-        StartCluster = CurrentCluster;
-        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector;
-        BytesDone = 0;
-        ClusterCount = 0;
-
-        do
+        /* Write as many contiguous clusters as possible at once */
+        Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster, WriteOffset.u.LowPart, Length,
+                                   &StartCluster, &ClusterCount);
+        if (!NT_SUCCESS(Status) || StartCluster == 0xffffffff)
         {
-            ClusterCount++;
-            if (First)
-            {
-                BytesDone =  min (Length, BytesPerCluster - (WriteOffset.u.LowPart % BytesPerCluster));
-                StartOffset.QuadPart += WriteOffset.u.LowPart % BytesPerCluster;
-                First = FALSE;
-            }
-            else
-            {
-                if (Length - BytesDone > BytesPerCluster)
-                {
-                    BytesDone += BytesPerCluster;
-                }
-                else
-                {
-                    BytesDone = Length;
-                }
-            }
-            Status = NextCluster(DeviceExt, FirstCluster, &CurrentCluster, FALSE);
+            break;
         }
-        while (StartCluster + ClusterCount == CurrentCluster && NT_SUCCESS(Status) && Length > BytesDone);
-        DPRINT("start %08x, next %08x, count %u\n",
-               StartCluster, CurrentCluster, ClusterCount);
-
-        ExAcquireFastMutex(&Fcb->LastMutex);
-        Fcb->LastCluster = StartCluster + (ClusterCount - 1);
-        Fcb->LastOffset = ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
-        ExReleaseFastMutex(&Fcb->LastMutex);
+
+        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector +
+                               WriteOffset.u.LowPart % BytesPerCluster;
+        BytesDone = (ULONG)min((ULONGLONG)Length,
+                               (ULONGLONG)ClusterCount * BytesPerCluster - WriteOffset.u.LowPart % BytesPerCluster);
+        DPRINT("start %08x, count %u\n", StartCluster, ClusterCount);
 
         // Fire up the write command
         Status = VfatWriteDiskPartial (IrpContext, &StartOffset, BytesDone, BufferOffset, FALSE);
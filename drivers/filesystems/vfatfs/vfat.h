@@ -325,6 +325,8 @@ typedef struct DEVICE_EXTENSION
     ULONG LastAvailableCluster;
     ULONG AvailableClusters;
     BOOLEAN AvailableClustersValid;
+    /* In-memory copy of the FAT allocation state, set bits are clusters in use */
+    RTL_BITMAP FreeClusterBitmap;
     ULONG Flags;
     struct _VFATFCB *VolumeFcb;
     struct _VFATFCB *RootFcb;
@@ -520,14 +522,21 @@ typedef struct _VFATFCB
     FILE_LOCK FileLock;
 
     /*
-     * Optimization: caching of last read/write cluster+offset pair. Can't
-     * be in VFATCCB because it must be reset everytime the allocated clusters
-     * change.
+     * Optimization: caching of the last cluster+offset pair seen when the
+     * allocation grows. Can't be in VFATCCB because it must be reset
+     * everytime the allocated clusters change.
      */
     FAST_MUTEX LastMutex;
     ULONG LastCluster;
     ULONG LastOffset;
 
+    /*
+     * Cluster chain of the file as runs of file cluster index to volume
+     * cluster, filled on demand by reads and writes. It must be truncated
+     * whenever clusters are removed from the chain.
+     */
+    LARGE_MCB ClusterMcb;
+
     struct _VFAT_CLOSE_CONTEXT * CloseContext;
 } VFATFCB, *PVFATFCB;
 
@@ -553,6 +562,7 @@ typedef struct _VFATCCB
 #define TAG_NAME 'ntaF'
 #define TAG_SEARCH 'LtaF'
 #define TAG_DIRENT 'DtaF'
+#define TAG_BITMAP 'BtaF'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -926,6 +936,22 @@ CountAvailableClusters(
     PDEVICE_EXTENSION DeviceExt,
     PLARGE_INTEGER Clusters);
 
+NTSTATUS
+InitializeFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
+VOID
+UninitializeFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
+NTSTATUS
+AllocateClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG PreviousCluster,
+    ULONG ClusterCount,
+    PULONG FirstCluster,
+    PULONG RunLength);
+
 NTSTATUS
 WriteCluster(
     PDEVICE_EXTENSION DeviceExt,
@@ -299,6 +299,12 @@ MakeSocketIntoConnection(PAFD_FCB FCB) {
 
     FCB->State = SOCKET_STATE_CONNECTED;
 
+    /* Hand the transport the buffer sizes set before it had a connection */
+    if (FCB->RecvWindowSize)
+        AfdSetConnectionBufferSize(FCB, TCP_SOCKET_WINDOW, FCB->RecvWindowSize);
+    if (FCB->SendWindowSize)
+        AfdSetConnectionBufferSize(FCB, TCP_SOCKET_SEND_BUFFER, FCB->SendWindowSize);
+
     Status = TdiReceive( &FCB->ReceiveIrp.InFlightRequest,
                          FCB->Connection.Object,
                          TDI_RECEIVE_NORMAL,
@@ -10,6 +10,35 @@
 
 #include "afd.h"
 
+#include <tdiinfo.h>
+
+/* FIXME: We should not have to limit the packet receive buffer size like this. workaround for CORE-15804 */
+#define AFD_MAX_RECV_BUFFER_SIZE 0x2000
+
+VOID
+AfdSetConnectionBufferSize(PAFD_FCB FCB, ULONG Id, ULONG Size)
+{
+    NTSTATUS Status;
+
+    /* Only connection oriented transports keep per connection buffers */
+    if ((FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS) || !FCB->Connection.Object)
+        return;
+
+    Status = TdiSetInformationEx(FCB->Connection.Object,
+                                 CO_TL_ENTITY,
+                                 0,
+                                 INFO_CLASS_PROTOCOL,
+                                 INFO_TYPE_CONNECTION,
+                                 Id,
+                                 &Size,
+                                 sizeof(Size));
+    if (!NT_SUCCESS(Status))
+    {
+        /* Not fatal, the transport keeps its default size */
+        AFD_DbgPrint(MIN_TRACE,("Transport did not take buffer size %u (0x%x)\n", Size, Status));
+    }
+}
+
 NTSTATUS NTAPI
 AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             PIO_STACK_LOCATION IrpSp ) {
@@ -106,6 +135,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     PFILE_OBJECT FileObject = IrpSp->FileObject;
     PAFD_FCB FCB = FileObject->FsContext;
     PCHAR NewBuffer;
+    ULONG Size;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
@@ -124,21 +154,33 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 FCB->OobInline = InfoReq->Information.Boolean;
                 break;
             case AFD_INFO_RECEIVE_WINDOW_SIZE:
+                /* The transport gets the full size for its receive window,
+                   only our own buffer is limited. Without a connection yet,
+                   MakeSocketIntoConnection hands it over once there is one */
+                if (InfoReq->Information.Ulong > 0)
+                {
+                    FCB->RecvWindowSize = InfoReq->Information.Ulong;
+                    if (FCB->State == SOCKET_STATE_CONNECTED)
+                        AfdSetConnectionBufferSize(FCB, TCP_SOCKET_WINDOW, InfoReq->Information.Ulong);
+                }
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
+                    Size = min(InfoReq->Information.Ulong, AFD_MAX_RECV_BUFFER_SIZE);
+
                     /* FIXME: likely not right, check tcpip.sys for TDI_QUERY_MAX_DATAGRAM_INFO */
-                    if (InfoReq->Information.Ulong > 0 && InfoReq->Information.Ulong < 0xFFFF &&
-                        InfoReq->Information.Ulong != FCB->Recv.Size)
+                    if (Size > 0 && Size < 0xFFFF &&
+                        Size != FCB->Recv.Size)
                     {
                         NewBuffer = ExAllocatePoolWithTag(PagedPool,
-                                                          InfoReq->Information.Ulong,
+                                                          Size,
                                                           TAG_AFD_DATA_BUFFER);
 
                         if (NewBuffer)
                         {
-                            if (FCB->Recv.Content > InfoReq->Information.Ulong)
-                                FCB->Recv.Content = InfoReq->Information.Ulong;
+                            if (FCB->Recv.Content > Size)
+                                FCB->Recv.Content = Size;
 
                             if (FCB->Recv.Window)
                             {
@@ -149,7 +191,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                                 ExFreePoolWithTag(FCB->Recv.Window, TAG_AFD_DATA_BUFFER);
                             }
 
-                            FCB->Recv.Size = InfoReq->Information.Ulong;
+                            FCB->Recv.Size = Size;
                             FCB->Recv.Window = NewBuffer;
 
                             Status = STATUS_SUCCESS;
@@ -164,12 +206,28 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                         Status = STATUS_SUCCESS;
                     }
                 }
+                else if (InfoReq->Information.Ulong > 0)
+                {
+                    /* No buffer to resize yet, just size the one we'll allocate */
+                    Size = min(InfoReq->Information.Ulong, AFD_MAX_RECV_BUFFER_SIZE);
+                    if (Size < 0xFFFF && !FCB->Recv.Window)
+                        FCB->Recv.Size = Size;
+
+                    Status = STATUS_SUCCESS;
+                }
                 else
                 {
                     Status = STATUS_INVALID_PARAMETER;
                 }
                 break;
             case AFD_INFO_SEND_WINDOW_SIZE:
+                if (InfoReq->Information.Ulong > 0)
+                {
+                    FCB->SendWindowSize = InfoReq->Information.Ulong;
+                    if (FCB->State == SOCKET_STATE_CONNECTED)
+                        AfdSetConnectionBufferSize(FCB, TCP_SOCKET_SEND_BUFFER, InfoReq->Information.Ulong);
+                }
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
@@ -209,6 +267,13 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                         Status = STATUS_SUCCESS;
                     }
                 }
+                else if (InfoReq->Information.Ulong > 0)
+                {
+                    if (InfoReq->Information.Ulong < 0xFFFF && !FCB->Send.Window)
+                        FCB->Send.Size = InfoReq->Information.Ulong;
+
+                    Status = STATUS_SUCCESS;
+                }
                 else
                 {
                     Status = STATUS_INVALID_PARAMETER;
@@ -12,6 +12,7 @@
 
 static NTSTATUS SatisfyAccept( PAFD_DEVICE_EXTENSION DeviceExt,
                                PIRP Irp,
+                               PAFD_FCB ListenFCB,
                                PFILE_OBJECT NewFileObject,
                                PAFD_TDI_OBJECT_QELT Qelt ) {
     PAFD_FCB FCB = NewFileObject->FsContext;
@@ -35,6 +36,13 @@ static NTSTATUS SatisfyAccept( PAFD_DEVICE_EXTENSION DeviceExt,
     FCB->RemoteAddress =
         TaCopyTransportAddress( Qelt->ConnInfo->RemoteAddress );
 
+    /* Buffer sizes set on the listening socket carry over to the accepted
+       one, unless it was given its own */
+    if (!FCB->RecvWindowSize)
+        FCB->RecvWindowSize = ListenFCB->RecvWindowSize;
+    if (!FCB->SendWindowSize)
+        FCB->SendWindowSize = ListenFCB->SendWindowSize;
+
     if( !FCB->RemoteAddress )
         Status = STATUS_NO_MEMORY;
     else
@@ -379,7 +387,7 @@ NTSTATUS AfdAccept( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             ASSERT(NewFileObject->FsContext != FCB);
 
             /* We have a pending connection ... complete this irp right away */
-            Status = SatisfyAccept( DeviceExt, Irp, NewFileObject, PendingConnObj );
+            Status = SatisfyAccept( DeviceExt, Irp, FCB, NewFileObject, PendingConnObj );
 
             ObDereferenceObject( NewFileObject );
 
@@ -367,6 +367,7 @@ AfdCreateSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
     InitializeListHead( &FCB->DatagramList );
     InitializeListHead( &FCB->PendingConnections );
+    InitializeListHead( &FCB->PollSetEntries );
 
     AFD_DbgPrint(MID_TRACE,("%p: Checking command channel\n", FCB));
 
@@ -453,6 +454,8 @@ AfdCleanupSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
     KillSelectsForFCB( FCB->DeviceExt, FileObject, FALSE );
 
+    PollSetCleanup( FCB );
+
     return UnlockAndMaybeComplete(FCB, STATUS_SUCCESS, Irp, 0);
 }
 
@@ -582,6 +585,13 @@ AfdCloseSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         ExFreePoolWithTag(FCB->TdiDeviceName.Buffer, TAG_AFD_TRANSPORT_ADDRESS);
     }
 
+    if (FCB->PollSet)
+    {
+        ASSERT(IsListEmpty(&FCB->PollSet->Entries));
+        ASSERT(IsListEmpty(&FCB->PollSet->Waits));
+        ExFreePoolWithTag(FCB->PollSet, TAG_AFD_POLL_SET);
+    }
+
     ExFreePoolWithTag(FCB, TAG_AFD_FCB);
 
     Irp->IoStatus.Status = STATUS_SUCCESS;
@@ -968,6 +978,12 @@ AfdDispatch(PDEVICE_OBJECT DeviceObject, PIRP Irp)
         case IOCTL_AFD_ENUM_NETWORK_EVENTS:
             return AfdEnumEvents( DeviceObject, Irp, IrpSp );
 
+        case IOCTL_AFD_POLL_SET_UPDATE:
+            return AfdPollSetUpdate( DeviceObject, Irp, IrpSp );
+
+        case IOCTL_AFD_POLL_SET_WAIT:
+            return AfdPollSetWait( DeviceObject, Irp, IrpSp );
+
         case IOCTL_AFD_RECV_DATAGRAM:
             return AfdPacketSocketReadData( DeviceObject, Irp, IrpSp );
 
@@ -1264,6 +1280,11 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
             DbgPrint("WARNING!!! IRP cancellation race could lead to a process hang! (IOCTL_AFD_SELECT)\n");
             return;
 
+        case IOCTL_AFD_POLL_SET_WAIT:
+            PollSetCancelWait(FCB, Irp);
+            SocketStateUnlock(FCB);
+            return;
+
         case IOCTL_AFD_DISCONNECT:
             Function = FUNCTION_DISCONNECT;
             break;
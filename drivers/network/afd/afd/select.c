@@ -404,9 +404,12 @@ static BOOLEAN UpdatePollWithFCB( PAFD_ACTIVE_POLL Poll, PFILE_OBJECT FileObject
     return Signalled ? 1 : 0;
 }
 
+static VOID PollSetQueueEntry( PAFD_POLL_SET_ENTRY Entry, PAFD_FCB FCB );
+
 VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
     PAFD_ACTIVE_POLL Poll = NULL;
     PLIST_ENTRY ThePollEnt = NULL;
+    PAFD_POLL_SET_ENTRY Entry;
     PAFD_FCB FCB;
     KIRQL OldIrql;
     PAFD_POLL_INFO PollReq;
@@ -440,6 +443,16 @@ VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
             ThePollEnt = ThePollEnt->Flink;
     }
 
+    /* Queue the socket on the readiness sets watching it */
+    ThePollEnt = FCB->PollSetEntries.Flink;
+
+    while( ThePollEnt != &FCB->PollSetEntries ) {
+        Entry = CONTAINING_RECORD( ThePollEnt, AFD_POLL_SET_ENTRY, SocketLink );
+        ThePollEnt = ThePollEnt->Flink;
+
+        PollSetQueueEntry( Entry, FCB );
+    }
+
     KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
 
     if((FCB->EventSelect) &&
@@ -453,3 +466,527 @@ VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
 
     AFD_DbgPrint(MID_TRACE,("Leaving\n"));
 }
+
+/* * * Readiness sets * * *
+ *
+ * A readiness set is an AFD control channel on which sockets are registered
+ * once. Every registration is linked both to the set and to the socket, so
+ * PollReeval only has to look at the sets watching the socket whose state
+ * changed, and a wait only looks at the sockets that were queued as ready.
+ * All of it is protected by the device extension lock. */
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static BOOLEAN PollSetPrune( PAFD_POLL_SET Set ) {
+    PAFD_POLL_SET_ENTRY Entry;
+    PAFD_FCB FCB;
+
+    while( !IsListEmpty( &Set->ReadyList ) ) {
+        Entry = CONTAINING_RECORD( Set->ReadyList.Flink, AFD_POLL_SET_ENTRY, ReadyLink );
+        FCB = Entry->FileObject->FsContext;
+
+        if( Entry->Events & FCB->PollState )
+            return TRUE;
+
+        /* The state went away again since the socket was queued */
+        RemoveEntryList( &Entry->ReadyLink );
+        Entry->Ready = FALSE;
+    }
+
+    return FALSE;
+}
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static ULONG PollSetHarvest( PAFD_POLL_SET Set,
+                             PAFD_POLL_SET_WAIT_INFO WaitInfo,
+                             ULONG MaxEvents ) {
+    LIST_ENTRY Harvested;
+    PAFD_POLL_SET_ENTRY Entry;
+    PAFD_FCB FCB;
+    ULONG Count = 0, Events;
+
+    InitializeListHead( &Harvested );
+
+    while( Count < MaxEvents && !IsListEmpty( &Set->ReadyList ) ) {
+        Entry = CONTAINING_RECORD( RemoveHeadList( &Set->ReadyList ),
+                                   AFD_POLL_SET_ENTRY, ReadyLink );
+        FCB = Entry->FileObject->FsContext;
+
+        Events = Entry->Events & FCB->PollState;
+        if( !Events ) {
+            Entry->Ready = FALSE;
+            continue;
+        }
+
+        WaitInfo->Events[Count].Handle = Entry->Handle;
+        WaitInfo->Events[Count].Events = Events;
+        WaitInfo->Events[Count].Context = Entry->Context;
+        Count++;
+
+        InsertTailList( &Harvested, &Entry->ReadyLink );
+    }
+
+    /* Like select, this is level triggered: the sockets stay queued behind
+     * the others until a later wait finds that they are no longer ready */
+    while( !IsListEmpty( &Harvested ) )
+        InsertTailList( &Set->ReadyList, RemoveHeadList( &Harvested ) );
+
+    WaitInfo->EventCount = Count;
+
+    return Count;
+}
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static VOID PollSetCompleteWait( PAFD_POLL_SET_WAITER Wait, NTSTATUS Status ) {
+    PIRP Irp = Wait->Irp;
+    PAFD_POLL_SET_WAIT_INFO WaitInfo = Irp->AssociatedIrp.SystemBuffer;
+
+    AFD_DbgPrint(MID_TRACE,("Completing wait %p with %x (%u events)\n",
+                            Wait, Status, WaitInfo->EventCount));
+
+    RemoveEntryList( &Wait->ListEntry );
+
+    /* A timeout DPC that is already queued frees the wait itself */
+    if( !Wait->TimerSet || KeCancelTimer( &Wait->Timer ) )
+        ExFreePoolWithTag( Wait, TAG_AFD_POLL_SET );
+    else
+        Wait->Irp = NULL;
+
+    Irp->IoStatus.Status = Status;
+    Irp->IoStatus.Information =
+        FIELD_OFFSET(AFD_POLL_SET_WAIT_INFO, Events) +
+        sizeof(AFD_POLL_SET_EVENT) * WaitInfo->EventCount;
+    IoCompleteRequest( Irp, IO_NETWORK_INCREMENT );
+}
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static VOID PollSetSignal( PAFD_POLL_SET Set ) {
+    PLIST_ENTRY ListEntry = Set->Waits.Flink;
+    PAFD_POLL_SET_WAITER Wait;
+
+    while( ListEntry != &Set->Waits && PollSetPrune( Set ) ) {
+        Wait = CONTAINING_RECORD( ListEntry, AFD_POLL_SET_WAITER, ListEntry );
+        ListEntry = ListEntry->Flink;
+
+        /* Leave the waits being cancelled to the cancel routine */
+        if( !IoSetCancelRoutine( Wait->Irp, NULL ) )
+            continue;
+
+        PollSetHarvest( Set, Wait->Irp->AssociatedIrp.SystemBuffer, Wait->MaxEvents );
+        PollSetCompleteWait( Wait, STATUS_SUCCESS );
+    }
+}
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static VOID PollSetQueueEntry( PAFD_POLL_SET_ENTRY Entry, PAFD_FCB FCB ) {
+    if( Entry->Ready || !(Entry->Events & FCB->PollState) )
+        return;
+
+    AFD_DbgPrint(MID_TRACE,("Queueing %p on set %p with %x\n",
+                            FCB, Entry->Set, FCB->PollState));
+
+    InsertTailList( &Entry->Set->ReadyList, &Entry->ReadyLink );
+    Entry->Ready = TRUE;
+
+    PollSetSignal( Entry->Set );
+}
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static PAFD_POLL_SET_ENTRY PollSetFindEntry( PAFD_POLL_SET Set, PAFD_FCB FCB ) {
+    PLIST_ENTRY ListEntry;
+    PAFD_POLL_SET_ENTRY Entry;
+
+    /* Sockets are rarely watched by more than one set */
+    for( ListEntry = FCB->PollSetEntries.Flink;
+         ListEntry != &FCB->PollSetEntries;
+         ListEntry = ListEntry->Flink ) {
+        Entry = CONTAINING_RECORD( ListEntry, AFD_POLL_SET_ENTRY, SocketLink );
+        if( Entry->Set == Set )
+            return Entry;
+    }
+
+    return NULL;
+}
+
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static PAFD_POLL_SET PollSetAttach( PAFD_FCB FCB, PAFD_POLL_SET *NewSet ) {
+    if( FCB->PollSetsClosed )
+        return NULL;
+
+    if( !FCB->PollSet && *NewSet ) {
+        InitializeListHead( &(*NewSet)->Entries );
+        InitializeListHead( &(*NewSet)->ReadyList );
+        InitializeListHead( &(*NewSet)->Waits );
+        FCB->PollSet = *NewSet;
+        *NewSet = NULL;
+    }
+
+    return FCB->PollSet;
+}
+
+static KDEFERRED_ROUTINE PollSetTimeout;
+static VOID NTAPI PollSetTimeout( PKDPC Dpc,
+                                  PVOID DeferredContext,
+                                  PVOID SystemArgument1,
+                                  PVOID SystemArgument2 ) {
+    PAFD_POLL_SET_WAITER Wait = DeferredContext;
+    PAFD_DEVICE_EXTENSION DeviceExt = Wait->DeviceExt;
+    PAFD_POLL_SET_WAIT_INFO WaitInfo;
+    KIRQL OldIrql;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
+
+    /* Whoever completes the IRP from now on frees the wait */
+    Wait->TimerSet = FALSE;
+
+    if( !Wait->Irp ) {
+        KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+        ExFreePoolWithTag( Wait, TAG_AFD_POLL_SET );
+        return;
+    }
+
+    if( IoSetCancelRoutine( Wait->Irp, NULL ) ) {
+        WaitInfo = Wait->Irp->AssociatedIrp.SystemBuffer;
+        WaitInfo->EventCount = 0;
+        PollSetCompleteWait( Wait, STATUS_TIMEOUT );
+    }
+
+    KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+}
+
+NTSTATUS NTAPI
+AfdPollSetUpdate( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                  PIO_STACK_LOCATION IrpSp ) {
+    PAFD_FCB FCB = IrpSp->FileObject->FsContext;
+    PAFD_DEVICE_EXTENSION DeviceExt = DeviceObject->DeviceExtension;
+    PAFD_POLL_SET_UPDATE_INFO UpdateInfo = Irp->AssociatedIrp.SystemBuffer;
+    PAFD_POLL_SET Set, NewSet = NULL;
+    PAFD_POLL_SET_ENTRY Entry, NewEntry = NULL, OldEntry = NULL;
+    PFILE_OBJECT FileObject;
+    PAFD_FCB SocketFCB;
+    NTSTATUS Status;
+    KIRQL OldIrql;
+
+    /* Only control channels can be used as readiness sets */
+    if( IrpSp->Parameters.DeviceIoControl.InputBufferLength < sizeof(*UpdateInfo) ||
+        FCB->TdiDeviceName.Buffer ) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto Complete;
+    }
+
+    AFD_DbgPrint(MID_TRACE,("Called (Handle %p Operation %u Events %x)\n",
+                            (PVOID)UpdateInfo->Handle,
+                            UpdateInfo->Operation,
+                            UpdateInfo->Events));
+
+    Status = ObReferenceObjectByHandle( (HANDLE)UpdateInfo->Handle,
+                                        0,
+                                        *IoFileObjectType,
+                                        Irp->RequestorMode,
+                                        (PVOID *)&FileObject,
+                                        NULL );
+    if( !NT_SUCCESS(Status) )
+        goto Complete;
+
+    SocketFCB = FileObject->FsContext;
+    if( FileObject->DeviceObject != DeviceObject || !SocketFCB ||
+        !SocketFCB->TdiDeviceName.Buffer ) {
+        ObDereferenceObject( FileObject );
+        Status = STATUS_INVALID_HANDLE;
+        goto Complete;
+    }
+
+    if( !FCB->PollSet )
+        NewSet = ExAllocatePoolWithTag( NonPagedPool, sizeof(*NewSet), TAG_AFD_POLL_SET );
+
+    if( UpdateInfo->Operation == AFD_POLL_SET_ADD )
+        NewEntry = ExAllocatePoolWithTag( NonPagedPool, sizeof(*NewEntry), TAG_AFD_POLL_SET );
+
+    KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
+
+    Set = PollSetAttach( FCB, &NewSet );
+    if( !Set ) {
+        Status = FCB->PollSetsClosed ? STATUS_FILE_CLOSED : STATUS_NO_MEMORY;
+        goto Unlock;
+    }
+
+    Entry = PollSetFindEntry( Set, SocketFCB );
+
+    switch( UpdateInfo->Operation ) {
+    case AFD_POLL_SET_ADD:
+        if( Entry ) {
+            Status = STATUS_OBJECT_NAME_COLLISION;
+            break;
+        }
+
+        if( SocketFCB->PollSetsClosed ) {
+            Status = STATUS_FILE_CLOSED;
+            break;
+        }
+
+        if( !NewEntry ) {
+            Status = STATUS_NO_MEMORY;
+            break;
+        }
+
+        /* The registration keeps the reference until it is removed */
+        Entry = NewEntry;
+        NewEntry = NULL;
+        Entry->Set = Set;
+        Entry->FileObject = FileObject;
+        Entry->Handle = UpdateInfo->Handle;
+        Entry->Events = UpdateInfo->Events;
+        Entry->Context = UpdateInfo->Context;
+        Entry->Ready = FALSE;
+        FileObject = NULL;
+
+        InsertTailList( &Set->Entries, &Entry->SetLink );
+        InsertTailList( &SocketFCB->PollSetEntries, &Entry->SocketLink );
+
+        PollSetQueueEntry( Entry, SocketFCB );
+        break;
+
+    case AFD_POLL_SET_MODIFY:
+        if( !Entry ) {
+            Status = STATUS_NOT_FOUND;
+            break;
+        }
+
+        Entry->Events = UpdateInfo->Events;
+        Entry->Context = UpdateInfo->Context;
+
+        PollSetQueueEntry( Entry, SocketFCB );
+        break;
+
+    case AFD_POLL_SET_REMOVE:
+        if( !Entry ) {
+            Status = STATUS_NOT_FOUND;
+            break;
+        }
+
+        RemoveEntryList( &Entry->SetLink );
+        RemoveEntryList( &Entry->SocketLink );
+        if( Entry->Ready )
+            RemoveEntryList( &Entry->ReadyLink );
+        OldEntry = Entry;
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+Unlock:
+    KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+
+    if( NewSet )
+        ExFreePoolWithTag( NewSet, TAG_AFD_POLL_SET );
+
+    if( NewEntry )
+        ExFreePoolWithTag( NewEntry, TAG_AFD_POLL_SET );
+
+    if( OldEntry ) {
+        ObDereferenceObject( OldEntry->FileObject );
+        ExFreePoolWithTag( OldEntry, TAG_AFD_POLL_SET );
+    }
+
+    if( FileObject )
+        ObDereferenceObject( FileObject );
+
+Complete:
+    AFD_DbgPrint(MID_TRACE,("Returning %x\n", Status));
+
+    Irp->IoStatus.Status = Status;
+    Irp->IoStatus.Information = 0;
+    IoCompleteRequest( Irp, IO_NETWORK_INCREMENT );
+
+    return Status;
+}
+
+NTSTATUS NTAPI
+AfdPollSetWait( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                PIO_STACK_LOCATION IrpSp ) {
+    PAFD_FCB FCB = IrpSp->FileObject->FsContext;
+    PAFD_DEVICE_EXTENSION DeviceExt = DeviceObject->DeviceExtension;
+    PAFD_POLL_SET_WAIT_INFO WaitInfo = Irp->AssociatedIrp.SystemBuffer;
+    ULONG OutputLength = IrpSp->Parameters.DeviceIoControl.OutputBufferLength;
+    PAFD_POLL_SET Set, NewSet = NULL;
+    PAFD_POLL_SET_WAITER Wait;
+    LARGE_INTEGER Timeout;
+    ULONG MaxEvents;
+    NTSTATUS Status;
+    KIRQL OldIrql;
+
+    if( IrpSp->Parameters.DeviceIoControl.InputBufferLength < FIELD_OFFSET(AFD_POLL_SET_WAIT_INFO, Events) ||
+        OutputLength < FIELD_OFFSET(AFD_POLL_SET_WAIT_INFO, Events) + sizeof(AFD_POLL_SET_EVENT) ||
+        !WaitInfo->EventCount || FCB->TdiDeviceName.Buffer ) {
+        Irp->IoStatus.Status = STATUS_INVALID_PARAMETER;
+        Irp->IoStatus.Information = 0;
+        IoCompleteRequest( Irp, IO_NETWORK_INCREMENT );
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    MaxEvents = (OutputLength - FIELD_OFFSET(AFD_POLL_SET_WAIT_INFO, Events)) /
+                sizeof(AFD_POLL_SET_EVENT);
+    MaxEvents = MIN(MaxEvents, WaitInfo->EventCount);
+    Timeout = WaitInfo->Timeout;
+
+    AFD_DbgPrint(MID_TRACE,("Called (MaxEvents %u Timeout %d)\n",
+                            MaxEvents, (INT)Timeout.QuadPart));
+
+    if( !FCB->PollSet )
+        NewSet = ExAllocatePoolWithTag( NonPagedPool, sizeof(*NewSet), TAG_AFD_POLL_SET );
+
+    Wait = ExAllocatePoolWithTag( NonPagedPool, sizeof(*Wait), TAG_AFD_POLL_SET );
+
+    KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
+
+    Set = PollSetAttach( FCB, &NewSet );
+    if( !Set || !Wait ) {
+        Status = (FCB->PollSetsClosed) ? STATUS_FILE_CLOSED : STATUS_NO_MEMORY;
+        WaitInfo->EventCount = 0;
+    } else if( PollSetHarvest( Set, WaitInfo, MaxEvents ) ) {
+        Status = STATUS_SUCCESS;
+    } else if( !Timeout.QuadPart ) {
+        Status = STATUS_TIMEOUT;
+    } else {
+        Wait->Irp = Irp;
+        Wait->DeviceExt = DeviceExt;
+        Wait->MaxEvents = MaxEvents;
+        Wait->TimerSet = (Timeout.QuadPart != MAXLONGLONG);
+
+        KeInitializeTimerEx( &Wait->Timer, NotificationTimer );
+        KeInitializeDpc( &Wait->TimeoutDpc, PollSetTimeout, Wait );
+
+        InsertTailList( &Set->Waits, &Wait->ListEntry );
+
+        IoMarkIrpPending( Irp );
+        (void)IoSetCancelRoutine( Irp, AfdCancelHandler );
+
+        if( Irp->Cancel && IoSetCancelRoutine( Irp, NULL ) ) {
+            /* Cancelled before the cancel routine was set */
+            Wait->TimerSet = FALSE;
+            PollSetCompleteWait( Wait, STATUS_CANCELLED );
+        } else if( Wait->TimerSet ) {
+            KeSetTimer( &Wait->Timer, Timeout, &Wait->TimeoutDpc );
+        }
+
+        KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+
+        if( NewSet )
+            ExFreePoolWithTag( NewSet, TAG_AFD_POLL_SET );
+
+        return STATUS_PENDING;
+    }
+
+    KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+
+    if( NewSet )
+        ExFreePoolWithTag( NewSet, TAG_AFD_POLL_SET );
+
+    if( Wait )
+        ExFreePoolWithTag( Wait, TAG_AFD_POLL_SET );
+
+    AFD_DbgPrint(MID_TRACE,("Returning %x (%u events)\n", Status, WaitInfo->EventCount));
+
+    Irp->IoStatus.Status = Status;
+    Irp->IoStatus.Information =
+        FIELD_OFFSET(AFD_POLL_SET_WAIT_INFO, Events) +
+        sizeof(AFD_POLL_SET_EVENT) * WaitInfo->EventCount;
+    IoCompleteRequest( Irp, IO_NETWORK_INCREMENT );
+
+    return Status;
+}
+
+VOID PollSetCancelWait( PAFD_FCB FCB, PIRP Irp ) {
+    PAFD_DEVICE_EXTENSION DeviceExt = FCB->DeviceExt;
+    PAFD_POLL_SET_WAIT_INFO WaitInfo;
+    PAFD_POLL_SET_WAITER Wait;
+    PLIST_ENTRY ListEntry;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
+
+    if( FCB->PollSet ) {
+        for( ListEntry = FCB->PollSet->Waits.Flink;
+             ListEntry != &FCB->PollSet->Waits;
+             ListEntry = ListEntry->Flink ) {
+            Wait = CONTAINING_RECORD( ListEntry, AFD_POLL_SET_WAITER, ListEntry );
+
+            if( Wait->Irp == Irp ) {
+                WaitInfo = Irp->AssociatedIrp.SystemBuffer;
+                WaitInfo->EventCount = 0;
+                PollSetCompleteWait( Wait, STATUS_CANCELLED );
+                KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+                return;
+            }
+        }
+    }
+
+    KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+
+    DbgPrint("WARNING!!! IRP cancellation race could lead to a process hang! (IOCTL_AFD_POLL_SET_WAIT)\n");
+}
+
+VOID PollSetCleanup( PAFD_FCB FCB ) {
+    PAFD_DEVICE_EXTENSION DeviceExt = FCB->DeviceExt;
+    PAFD_POLL_SET Set = FCB->PollSet;
+    PAFD_POLL_SET_ENTRY Entry;
+    PAFD_POLL_SET_WAITER Wait;
+    PAFD_POLL_SET_WAIT_INFO WaitInfo;
+    PLIST_ENTRY ListEntry;
+    LIST_ENTRY Released;
+    KIRQL OldIrql;
+
+    InitializeListHead( &Released );
+
+    KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
+
+    FCB->PollSetsClosed = TRUE;
+
+    /* Drop the socket from the sets watching it */
+    while( !IsListEmpty( &FCB->PollSetEntries ) ) {
+        Entry = CONTAINING_RECORD( RemoveHeadList( &FCB->PollSetEntries ),
+                                   AFD_POLL_SET_ENTRY, SocketLink );
+        RemoveEntryList( &Entry->SetLink );
+        if( Entry->Ready )
+            RemoveEntryList( &Entry->ReadyLink );
+        InsertTailList( &Released, &Entry->SetLink );
+    }
+
+    /* Release the sockets registered in this set. The set itself stays
+     * around for the cancel routine until the handle is closed. */
+    if( Set ) {
+        while( !IsListEmpty( &Set->Entries ) ) {
+            Entry = CONTAINING_RECORD( RemoveHeadList( &Set->Entries ),
+                                       AFD_POLL_SET_ENTRY, SetLink );
+            RemoveEntryList( &Entry->SocketLink );
+            InsertTailList( &Released, &Entry->SetLink );
+        }
+        InitializeListHead( &Set->ReadyList );
+
+        ListEntry = Set->Waits.Flink;
+        while( ListEntry != &Set->Waits ) {
+            Wait = CONTAINING_RECORD( ListEntry, AFD_POLL_SET_WAITER, ListEntry );
+            ListEntry = ListEntry->Flink;
+
+            if( IoSetCancelRoutine( Wait->Irp, NULL ) ) {
+                WaitInfo = Wait->Irp->AssociatedIrp.SystemBuffer;
+                WaitInfo->EventCount = 0;
+                PollSetCompleteWait( Wait, STATUS_CANCELLED );
+            }
+        }
+    }
+
+    KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+
+    while( !IsListEmpty( &Released ) ) {
+        Entry = CONTAINING_RECORD( RemoveHeadList( &Released ),
+                                   AFD_POLL_SET_ENTRY, SetLink );
+        ObDereferenceObject( Entry->FileObject );
+        ExFreePoolWithTag( Entry, TAG_AFD_POLL_SET );
+    }
+}
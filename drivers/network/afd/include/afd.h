@@ -47,10 +47,12 @@
 #define TAG_AFD_POLL_HANDLE                'hpfA'
 #define TAG_AFD_FCB                        'cffA'
 #define TAG_AFD_ACTIVE_POLL                'pafA'
+#define TAG_AFD_POLL_SET                   'spfA'
 #define TAG_AFD_EA_INFO                    'aefA'
 #define TAG_AFD_STORED_DATAGRAM            'gsfA'
 #define TAG_AFD_SNMP_ADDRESS_INFO          'asfA'
 #define TAG_AFD_TDI_CONNECTION_INFORMATION 'cTfA'
+#define TAG_AFD_TDI_SET_INFORMATION        'sTfA'
 #define TAG_AFD_WSA_BUFFER                 'bWfA'
 
 typedef struct IPADDR_ENTRY {
@@ -123,6 +125,34 @@ typedef struct _AFD_ACTIVE_POLL {
     BOOLEAN Exclusive;
 } AFD_ACTIVE_POLL, *PAFD_ACTIVE_POLL;
 
+typedef struct _AFD_POLL_SET {
+    LIST_ENTRY Entries;
+    LIST_ENTRY ReadyList;
+    LIST_ENTRY Waits;
+} AFD_POLL_SET, *PAFD_POLL_SET;
+
+typedef struct _AFD_POLL_SET_ENTRY {
+    LIST_ENTRY SetLink;
+    LIST_ENTRY SocketLink;
+    LIST_ENTRY ReadyLink;
+    PAFD_POLL_SET Set;
+    PFILE_OBJECT FileObject;
+    SOCKET Handle;
+    ULONG Events;
+    ULONG_PTR Context;
+    BOOLEAN Ready;
+} AFD_POLL_SET_ENTRY, *PAFD_POLL_SET_ENTRY;
+
+typedef struct _AFD_POLL_SET_WAITER {
+    LIST_ENTRY ListEntry;
+    PIRP Irp;
+    PAFD_DEVICE_EXTENSION DeviceExt;
+    ULONG MaxEvents;
+    KDPC TimeoutDpc;
+    KTIMER Timer;
+    BOOLEAN TimerSet;
+} AFD_POLL_SET_WAITER, *PAFD_POLL_SET_WAITER;
+
 typedef struct _IRP_LIST {
     LIST_ENTRY ListEntry;
     PIRP Irp;
@@ -176,6 +206,7 @@ typedef struct _AFD_FCB {
     AFD_TDI_OBJECT AddressFile, Connection;
     AFD_IN_FLIGHT_REQUEST ConnectIrp, ListenIrp, ReceiveIrp, SendIrp, DisconnectIrp;
     AFD_DATA_WINDOW Send, Recv;
+    ULONG RecvWindowSize, SendWindowSize; /* Transport buffer sizes set by the user */
     KMUTEX Mutex;
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
@@ -201,6 +232,9 @@ typedef struct _AFD_FCB {
     LIST_ENTRY PendingIrpList[MAX_FUNCTIONS];
     LIST_ENTRY DatagramList;
     LIST_ENTRY PendingConnections;
+    PAFD_POLL_SET PollSet;
+    LIST_ENTRY PollSetEntries;
+    BOOLEAN PollSetsClosed;
 } AFD_FCB, *PAFD_FCB;
 
 /* bind.c */
@@ -250,6 +284,9 @@ AfdSetContext( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
 /* info.c */
 
+VOID
+AfdSetConnectionBufferSize(PAFD_FCB FCB, ULONG Id, ULONG Size);
+
 NTSTATUS NTAPI
 AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 	    PIO_STACK_LOCATION IrpSp );
@@ -336,6 +373,14 @@ VOID ZeroEvents( PAFD_HANDLE HandleArray,
 VOID SignalSocket(
    PAFD_ACTIVE_POLL Poll OPTIONAL, PIRP _Irp OPTIONAL,
    PAFD_POLL_INFO PollReq, NTSTATUS Status);
+NTSTATUS NTAPI
+AfdPollSetUpdate( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                  PIO_STACK_LOCATION IrpSp );
+NTSTATUS NTAPI
+AfdPollSetWait( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                PIO_STACK_LOCATION IrpSp );
+VOID PollSetCancelWait( PAFD_FCB FCB, PIRP Irp );
+VOID PollSetCleanup( PAFD_FCB FCB );
 
 /* tdi.c */
 
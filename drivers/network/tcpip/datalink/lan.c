@@ -313,6 +313,7 @@ VOID LanReceiveWorker( PVOID Context ) {
     IP_PACKET IPPacket;
     BOOLEAN LegacyReceive;
     PIP_INTERFACE Interface;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
 
     TI_DbgPrint(DEBUG_DATALINK, ("Called.\n"));
 
@@ -358,6 +359,22 @@ VOID LanReceiveWorker( PVOID Context ) {
 
         /* Calculate packet size (excluding media header) */
         NdisQueryPacketLength(IPPacket.NdisPacket, &IPPacket.TotalSize);
+
+        /* Checksums the miniport already verified */
+        if (Interface->ChecksumOffload) {
+            ChecksumInfo.Value =
+                PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo));
+
+            if ((Interface->ChecksumOffload & IP_CHECKSUM_OFFLOAD_RX_IP) &&
+                ChecksumInfo.Receive.NdisPacketIpChecksumSucceeded)
+                IPPacket.Flags |= IP_PACKET_FLAG_IP_CHECKSUM_VALID;
+
+            if (((Interface->ChecksumOffload & IP_CHECKSUM_OFFLOAD_RX_TCP) &&
+                 ChecksumInfo.Receive.NdisPacketTcpChecksumSucceeded) ||
+                ((Interface->ChecksumOffload & IP_CHECKSUM_OFFLOAD_RX_UDP) &&
+                 ChecksumInfo.Receive.NdisPacketUdpChecksumSucceeded))
+                IPPacket.Flags |= IP_PACKET_FLAG_TRANSPORT_CHECKSUM_VALID;
+        }
     }
 
     TI_DbgPrint
@@ -1006,6 +1023,10 @@ VOID LANTransmit(
 
     RtlCopyMemory(Data + Adapter->HeaderSize, OldData, OldSize);
 
+    /* Carry over the checksum offload request */
+    NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpIpChecksumPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpIpChecksumPacketInfo);
+
     (*PC(NdisPacket)->DLComplete)(PC(NdisPacket)->Context, NdisPacket, NDIS_STATUS_SUCCESS);
 
     switch (Adapter->Media) {
@@ -1309,6 +1330,121 @@ VOID GetName( PUNICODE_STRING RegistryKey,
     AppendUnicodeString( OutName, &PartialRegistryKey, FALSE );
 }
 
+ULONG LANEnableChecksumOffload(
+    PLAN_ADAPTER Adapter)
+/*
+ * FUNCTION: Negotiates TCP/IP checksum offload with the miniport
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ * RETURNS:
+ *     IP_CHECKSUM_OFFLOAD_* flags of the tasks that were enabled
+ */
+{
+    UCHAR Buffer[256];
+    PNDIS_TASK_OFFLOAD_HEADER Header = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    PNDIS_TASK_OFFLOAD Task;
+    PNDIS_TASK_TCP_IP_CHECKSUM Supported = NULL;
+    NDIS_TASK_TCP_IP_CHECKSUM Enabled;
+    NDIS_STATUS NdisStatus;
+    ULONG Offset, Offload = 0;
+
+    if (Adapter->Media != NdisMedium802_3)
+        return 0;
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+    Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Header->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Header->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    Header->EncapsulationFormat.Flags.FixedHeaderSize = 1;
+    Header->EncapsulationFormat.EncapsulationHeaderSize = Adapter->HeaderSize;
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestQueryInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          sizeof(Buffer));
+    if (NdisStatus != NDIS_STATUS_SUCCESS || !Header->OffsetFirstTask)
+        return 0;
+
+    /* Look for the checksum task */
+    Offset = Header->OffsetFirstTask;
+    while (Offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) <= sizeof(Buffer)) {
+        Task = (PNDIS_TASK_OFFLOAD)(Buffer + Offset);
+
+        if (Task->Task == TcpIpChecksumNdisTask &&
+            Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_IP_CHECKSUM) &&
+            Offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+            sizeof(NDIS_TASK_TCP_IP_CHECKSUM) <= sizeof(Buffer)) {
+            Supported = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+            break;
+        }
+
+        if (!Task->OffsetNextTask)
+            break;
+        Offset += Task->OffsetNextTask;
+    }
+
+    if (!Supported)
+        return 0;
+
+    /* We always send TCP options, so only take segments the miniport fully handles */
+    RtlZeroMemory(&Enabled, sizeof(Enabled));
+    if (Supported->V4Transmit.TcpChecksum && Supported->V4Transmit.TcpOptionsSupported) {
+        Enabled.V4Transmit.TcpOptionsSupported = 1;
+        Enabled.V4Transmit.TcpChecksum = 1;
+        Offload |= IP_CHECKSUM_OFFLOAD_TX_TCP;
+    }
+    if (Supported->V4Transmit.UdpChecksum) {
+        Enabled.V4Transmit.UdpChecksum = 1;
+        Offload |= IP_CHECKSUM_OFFLOAD_TX_UDP;
+    }
+    if (Supported->V4Receive.IpChecksum && Supported->V4Receive.IpOptionsSupported) {
+        Enabled.V4Receive.IpOptionsSupported = 1;
+        Enabled.V4Receive.IpChecksum = 1;
+        Offload |= IP_CHECKSUM_OFFLOAD_RX_IP;
+    }
+    if (Supported->V4Receive.TcpChecksum && Supported->V4Receive.TcpOptionsSupported) {
+        Enabled.V4Receive.TcpOptionsSupported = 1;
+        Enabled.V4Receive.TcpChecksum = 1;
+        Offload |= IP_CHECKSUM_OFFLOAD_RX_TCP;
+    }
+    if (Supported->V4Receive.UdpChecksum) {
+        Enabled.V4Receive.UdpChecksum = 1;
+        Offload |= IP_CHECKSUM_OFFLOAD_RX_UDP;
+    }
+
+    if (!Offload)
+        return 0;
+
+    /* Hand back a single task with the subset we use */
+    RtlZeroMemory(Buffer + sizeof(NDIS_TASK_OFFLOAD_HEADER),
+                  sizeof(Buffer) - sizeof(NDIS_TASK_OFFLOAD_HEADER));
+    Header->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Task = (PNDIS_TASK_OFFLOAD)(Buffer + Header->OffsetFirstTask);
+    Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+    Task->Task = TcpIpChecksumNdisTask;
+    Task->OffsetNextTask = 0;
+    Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+    RtlCopyMemory(Task->TaskBuffer, &Enabled, sizeof(Enabled));
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestSetInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          Header->OffsetFirstTask +
+                          FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+                          sizeof(NDIS_TASK_TCP_IP_CHECKSUM));
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(MIN_TRACE, ("Could not enable checksum offload (0x%X).\n", NdisStatus));
+        return 0;
+    }
+
+    TI_DbgPrint(DEBUG_DATALINK, ("Checksum offload enabled (0x%X).\n", Offload));
+
+    return Offload;
+}
+
 BOOLEAN BindAdapter(
     PLAN_ADAPTER Adapter,
     PNDIS_STRING RegistryPath)
@@ -1410,6 +1546,9 @@ BOOLEAN BindAdapter(
     if (NdisStatus != NDIS_STATUS_SUCCESS)
         return FALSE;
 
+    /* Let the miniport compute checksums it supports */
+    IF->ChecksumOffload = LANEnableChecksumOffload(Adapter);
+
     /* Register interface with IP layer */
     IPRegisterInterface(IF);
 
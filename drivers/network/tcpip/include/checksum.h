@@ -10,11 +10,64 @@
 ULONG ChecksumFold(
   ULONG Sum);
 
+typedef ULONG (*CHECKSUM_ROUTINE)(
+    PVOID Data,
+    UINT Count,
+    ULONG Seed);
+
+typedef ULONG (*CHECKSUM_COPY_ROUTINE)(
+    PVOID Destination,
+    PVOID Source,
+    UINT Count,
+    ULONG Seed);
+
+VOID ChecksumInit(VOID);
+
 ULONG ChecksumCompute(
     PVOID Data,
     UINT Count,
     ULONG Seed);
 
+ULONG ChecksumCopy(
+    PVOID Destination,
+    PVOID Source,
+    UINT Count,
+    ULONG Seed);
+
+ULONG ChecksumCombine(
+    ULONG Sum,
+    ULONG PartialSum,
+    UINT Offset);
+
+ULONG ChecksumComputeGeneric(
+    PVOID Data,
+    UINT Count,
+    ULONG Seed);
+
+ULONG ChecksumCopyGeneric(
+    PVOID Destination,
+    PVOID Source,
+    UINT Count,
+    ULONG Seed);
+
+#if defined(_M_AMD64)
+ULONG ChecksumComputeSse2(
+    PVOID Data,
+    UINT Count,
+    ULONG Seed);
+
+ULONG ChecksumCopySse2(
+    PVOID Destination,
+    PVOID Source,
+    UINT Count,
+    ULONG Seed);
+#endif
+
+ULONG IPv4PseudoHeaderChecksum(
+    PIPv4_HEADER IPHeader,
+    UCHAR Protocol,
+    ULONG Length);
+
 unsigned int
 csum_partial(
   const unsigned char * buff,
@@ -88,9 +88,14 @@ typedef struct _IP_PACKET {
     PNDIS_PACKET NdisPacket;            /* Pointer to NDIS packet */
     IP_ADDRESS SrcAddr;                 /* Source address */
     IP_ADDRESS DstAddr;                 /* Destination address */
+    ULONG DataChecksum;                 /* Checksum of the payload (see IP_PACKET_FLAG_DATA_CHECKSUM) */
 } IP_PACKET, *PIP_PACKET;
 
-#define IP_PACKET_FLAG_RAW      0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_RAW                      0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_IP_CHECKSUM_VALID        0x02    /* Miniport validated the IP header checksum */
+#define IP_PACKET_FLAG_TRANSPORT_CHECKSUM_VALID 0x04    /* Miniport validated the TCP or UDP checksum */
+#define IP_PACKET_FLAG_DATA_CHECKSUM            0x08    /* DataChecksum was computed while copying the payload */
+#define IP_PACKET_FLAG_CHECKSUM_OFFLOAD         0x10    /* Miniport completes the TCP or UDP checksum */
 
 
 /* Packet context */
@@ -168,8 +173,15 @@ typedef struct _IP_INTERFACE {
     LL_TRANSMIT_ROUTINE Transmit; /* Pointer to transmit function */
     PVOID TCPContext;             /* TCP Content for this interface */
     SEND_RECV_STATS Stats;        /* Send/Receive statistics */
+    ULONG ChecksumOffload;        /* Checksums done by the miniport (see IP_CHECKSUM_OFFLOAD_xx below) */
 } IP_INTERFACE, *PIP_INTERFACE;
 
+#define IP_CHECKSUM_OFFLOAD_TX_TCP  0x01
+#define IP_CHECKSUM_OFFLOAD_TX_UDP  0x02
+#define IP_CHECKSUM_OFFLOAD_RX_IP   0x04
+#define IP_CHECKSUM_OFFLOAD_RX_TCP  0x08
+#define IP_CHECKSUM_OFFLOAD_RX_UDP  0x10
+
 typedef struct _IP_SET_ADDRESS {
     ULONG NteIndex;
     IPv4_RAW_ADDRESS Address;
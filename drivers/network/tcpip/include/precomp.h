@@ -4,6 +4,7 @@
 #include <tags.h>
 #include <tcpip.h>
 #include <loopback.h>
+#include <checksum.h>
 #include <routines.h>
 #include <info.h>
 #include <route.h>
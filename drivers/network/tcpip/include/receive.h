@@ -20,6 +20,7 @@ typedef struct IP_FRAGMENT {
     UINT PacketOffset;    /* Offset into NDIS packet where data is */
     UINT Offset;          /* Offset into datagram where this fragment is */
     UINT Size;            /* Size of this fragment */
+    BOOLEAN ChecksumValid; /* Miniport validated the TCP or UDP checksum */
 } IP_FRAGMENT, *PIP_FRAGMENT;
 
 /* IP datagram hole descriptor. Used to reassemble IP datagrams */
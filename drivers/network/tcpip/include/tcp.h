@@ -188,6 +188,8 @@ BOOLEAN TCPRemoveIRP( PCONNECTION_ENDPOINT Connection, PIRP Irp );
 
 NTSTATUS TCPSetNoDelay(PCONNECTION_ENDPOINT Connection, BOOLEAN Set);
 
+NTSTATUS TCPSetBuffers(PCONNECTION_ENDPOINT Connection, ULONG Window, ULONG SendBuffer);
+
 VOID
 TCPUpdateInterfaceLinkStatus(PIP_INTERFACE IF);
 
@@ -1,37 +1,95 @@
 #include <lwip/netif.h>
 #include <lwip/tcpip.h>
 
+#include "lwip_glue.h"
+
 typedef struct netif* PNETIF;
 
+typedef struct _IP_PBUF
+{
+    struct pbuf_custom Pbuf;
+    PVOID Buffer;
+} IP_PBUF, *PIP_PBUF;
+
+static NPAGED_LOOKASIDE_LIST IpPbufLookasideList;
+
 void
 sys_shutdown(void);
 
+void
+memp_shutdown(void);
+
+static
+void
+LibIPFreePbuf(struct pbuf *p)
+{
+    PIP_PBUF IpPbuf = (PIP_PBUF)p;
+
+    ExFreePoolWithTag(IpPbuf->Buffer, PACKET_BUFFER_TAG);
+    ExFreeToNPagedLookasideList(&IpPbufLookasideList, IpPbuf);
+}
+
 void
 LibIPInsertPacket(void *ifarg,
-                  const void *const data,
-                  const u32_t size)
+                  PIP_PACKET IPPacket)
 {
-    struct pbuf *p;
+    struct pbuf *p = NULL;
+    PIP_PBUF IpPbuf;
 
     ASSERT(ifarg);
-    ASSERT(data);
-    ASSERT(size > 0);
+    ASSERT(IPPacket->Header);
+    ASSERT(IPPacket->TotalSize > 0);
 
-    p = pbuf_alloc(PBUF_RAW, size, PBUF_RAM);
-    if (p)
+    /* The reassembled datagram is in a buffer of its own, so lwIP
+     * can take it over instead of having it copied into a new pbuf */
+    if (!IPPacket->MappedHeader)
     {
-        ASSERT(p->tot_len == p->len);
-        ASSERT(p->len == size);
+        IpPbuf = ExAllocateFromNPagedLookasideList(&IpPbufLookasideList);
+        if (IpPbuf)
+        {
+            IpPbuf->Pbuf.custom_free_function = LibIPFreePbuf;
+            IpPbuf->Buffer = IPPacket->Header;
 
-        RtlCopyMemory(p->payload, data, p->len);
+            p = pbuf_alloced_custom(PBUF_RAW,
+                                    IPPacket->TotalSize,
+                                    PBUF_REF,
+                                    &IpPbuf->Pbuf,
+                                    IPPacket->Header,
+                                    IPPacket->TotalSize);
+            ASSERT(p);
 
-        ((PNETIF)ifarg)->input(p, (PNETIF)ifarg);
+            /* The buffer now belongs to the pbuf */
+            IPPacket->Header = NULL;
+        }
     }
+
+    if (!p)
+    {
+        p = pbuf_alloc(PBUF_RAW, IPPacket->TotalSize, PBUF_RAM);
+        if (!p)
+            return;
+
+        ASSERT(p->tot_len == p->len);
+        ASSERT(p->len == IPPacket->TotalSize);
+
+        RtlCopyMemory(p->payload, IPPacket->Header, p->len);
+    }
+
+    if (((PNETIF)ifarg)->input(p, (PNETIF)ifarg) != ERR_OK)
+        pbuf_free(p);
 }
 
 void
 LibIPInitialize(void)
 {
+    ExInitializeNPagedLookasideList(&IpPbufLookasideList,
+                                    NULL,
+                                    NULL,
+                                    0,
+                                    sizeof(IP_PBUF),
+                                    LWIP_PBUF_TAG,
+                                    0);
+
     /* This completes asynchronously */
     tcpip_init(NULL, NULL);
 }
@@ -41,4 +99,8 @@ LibIPShutdown(void)
 {
     /* This is synchronous */
     sys_shutdown();
+
+    memp_shutdown();
+
+    ExDeleteNPagedLookasideList(&IpPbufLookasideList);
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
     #define LWIP_TAG         'PIwl'
     #define LWIP_MESSAGE_TAG 'sMwl'
     #define LWIP_QUEUE_TAG   'uQwl'
+    #define LWIP_PBUF_TAG    'bPwl'
 #endif
 
 typedef struct tcp_pcb* PTCP_PCB;
@@ -62,6 +63,11 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             int Callback;
         } Close;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            u32_t Window;
+            u32_t SendBuffer;
+        } SetBuffers;
     } Input;
 
     /* Output */
@@ -88,6 +94,9 @@ struct lwip_callback_msg
         struct {
             err_t Error;
         } Close;
+        struct {
+            err_t Error;
+        } SetBuffers;
     } Output;
 };
 
@@ -114,10 +123,11 @@ err_t       LibTCPGetPeerName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t
 err_t       LibTCPGetHostName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
 void        LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg);
 void        LibTCPSetNoDelay(PTCP_PCB pcb, BOOLEAN Set);
+err_t       LibTCPSetBuffers(PCONNECTION_ENDPOINT Connection, const u32_t window, const u32_t sndbuf);
 void        LibTCPGetSocketStatus(PTCP_PCB pcb, PULONG State);
 
 /* IP functions */
-void LibIPInsertPacket(void *ifarg, const void *const data, const u32_t size);
+void LibIPInsertPacket(void *ifarg, PIP_PACKET IPPacket);
 void LibIPInitialize(void);
 void LibIPShutdown(void);
 
@@ -1,9 +1,34 @@
 #include <lwip/mem.h>
+#include <lwip/memp.h>
 
 #ifndef LWIP_TAG
     #define LWIP_TAG 'PIwl'
 #endif
 
+#ifndef LWIP_MEMP_TAG
+    #define LWIP_MEMP_TAG 'pMwl'
+#endif
+
+typedef struct _MEMP_COUNTERS
+{
+    LONG Allocations;
+    LONG Frees;
+    LONG Failures;
+} MEMP_COUNTERS, *PMEMP_COUNTERS;
+
+/* One lookaside list per memp type for each processor */
+static PNPAGED_LOOKASIDE_LIST MempLookasideLists;
+static ULONG MempProcessors;
+
+static MEMP_COUNTERS MempCounters[MEMP_MAX];
+
+#if DBG
+static const char * const MempNames[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name,num,size,desc) (desc),
+#include <lwip/memp_std.h>
+};
+#endif
+
 void *
 malloc(mem_size_t size)
 {
@@ -32,8 +57,6 @@ free(void *mem)
 void *
 realloc(void *mem, size_t size)
 {
-    void* new_mem;
-
     /* realloc() with a NULL mem pointer acts like a call to malloc() */
     if (mem == NULL) {
         return malloc(size);
@@ -45,19 +68,124 @@ realloc(void *mem, size_t size)
         return NULL;
     }
 
-    /* Allocate the new buffer first */
-    new_mem = malloc(size);
-    if (new_mem == NULL) {
-        /* The old buffer is still intact */
+    /* The block is already big enough for the trimmed data, and the pool
+     * gives all of it back on free(), so there is nothing to copy */
+    return mem;
+}
+
+static PNPAGED_LOOKASIDE_LIST
+MempGetLookasideList(memp_t type)
+{
+    ULONG Processor = KeGetCurrentProcessorNumber();
+
+    /* Processors that came online after memp_init() share the first list */
+    if (Processor >= MempProcessors)
+        Processor = 0;
+
+    return &MempLookasideLists[Processor * MEMP_MAX + type];
+}
+
+void
+memp_init(void)
+{
+    ULONG Processor, Type;
+
+    RtlZeroMemory(MempCounters, sizeof(MempCounters));
+
+    MempProcessors = KeNumberProcessors;
+    MempLookasideLists = ExAllocatePoolWithTag(NonPagedPool,
+                                               MempProcessors * MEMP_MAX * sizeof(NPAGED_LOOKASIDE_LIST),
+                                               LWIP_MEMP_TAG);
+    if (!MempLookasideLists)
+    {
+        /* memp_malloc() falls back to the pool */
+        TI_DbgPrint(MIN_TRACE, ("Failed to allocate the memp lookaside lists\n"));
+        return;
+    }
+
+    for (Processor = 0; Processor < MempProcessors; Processor++)
+    {
+        for (Type = 0; Type < MEMP_MAX; Type++)
+        {
+            ExInitializeNPagedLookasideList(&MempLookasideLists[Processor * MEMP_MAX + Type],
+                                            NULL,
+                                            NULL,
+                                            0,
+                                            memp_sizes[Type],
+                                            LWIP_MEMP_TAG,
+                                            0);
+        }
+    }
+}
+
+void *
+memp_malloc(memp_t type)
+{
+    void *mem;
+
+    ASSERT(type < MEMP_MAX);
+
+    if (MempLookasideLists)
+        mem = ExAllocateFromNPagedLookasideList(MempGetLookasideList(type));
+    else
+        mem = ExAllocatePoolWithTag(NonPagedPool, memp_sizes[type], LWIP_MEMP_TAG);
+
+    if (!mem)
+    {
+        InterlockedIncrement(&MempCounters[type].Failures);
         return NULL;
     }
 
-    /* Copy the data over */
-    RtlCopyMemory(new_mem, mem, size);
+    InterlockedIncrement(&MempCounters[type].Allocations);
+
+    return mem;
+}
+
+void
+memp_free(memp_t type, void *mem)
+{
+    ASSERT(type < MEMP_MAX);
+    ASSERT(mem);
+
+    InterlockedIncrement(&MempCounters[type].Frees);
+
+    /* The lists are interchangeable, the block may go back to another processor's */
+    if (MempLookasideLists)
+        ExFreeToNPagedLookasideList(MempGetLookasideList(type), mem);
+    else
+        ExFreePoolWithTag(mem, LWIP_MEMP_TAG);
+}
+
+void
+memp_shutdown(void)
+{
+    ULONG Processor, Type;
+
+    for (Type = 0; Type < MEMP_MAX; Type++)
+    {
+        TI_DbgPrint(DEBUG_MEMORY, ("%s: %ld allocations, %ld frees, %ld failures\n",
+                                   MempNames[Type],
+                                   MempCounters[Type].Allocations,
+                                   MempCounters[Type].Frees,
+                                   MempCounters[Type].Failures));
+
+        if (MempCounters[Type].Allocations != MempCounters[Type].Frees)
+        {
+            TI_DbgPrint(MIN_TRACE, ("%ld %s objects were leaked\n",
+                                    MempCounters[Type].Allocations - MempCounters[Type].Frees,
+                                    MempNames[Type]));
+        }
+    }
+
+    if (!MempLookasideLists)
+        return;
 
-    /* Deallocate the old buffer */
-    free(mem);
+    for (Processor = 0; Processor < MempProcessors; Processor++)
+    {
+        for (Type = 0; Type < MEMP_MAX; Type++)
+            ExDeleteNPagedLookasideList(&MempLookasideLists[Processor * MEMP_MAX + Type]);
+    }
 
-    /* Return the newly allocated block */
-    return new_mem;
-}
\ No newline at end of file
+    ExFreePoolWithTag(MempLookasideLists, LWIP_MEMP_TAG);
+    MempLookasideLists = NULL;
+}
@@ -875,6 +875,62 @@ LibTCPSetNoDelay(
         pcb->flags &= ~TF_NODELAY;
 }
 
+static
+void
+LibTCPSetBuffersCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PTCP_PCB pcb = msg->Input.SetBuffers.Connection->SocketContext;
+
+    if (!pcb || pcb->state == LISTEN)
+    {
+        msg->Output.SetBuffers.Error = ERR_CLSD;
+        goto done;
+    }
+
+    /* A size of 0 leaves the corresponding buffer alone */
+    if (msg->Input.SetBuffers.Window)
+        tcp_setrcvwnd(pcb, msg->Input.SetBuffers.Window);
+
+    if (msg->Input.SetBuffers.SendBuffer)
+        tcp_setsndbuf(pcb, msg->Input.SetBuffers.SendBuffer);
+
+    msg->Output.SetBuffers.Error = ERR_OK;
+
+done:
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPSetBuffers(PCONNECTION_ENDPOINT Connection, const u32_t window, const u32_t sndbuf)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+
+        msg->Input.SetBuffers.Connection = Connection;
+        msg->Input.SetBuffers.Window = window;
+        msg->Input.SetBuffers.SendBuffer = sndbuf;
+
+        tcpip_callback_with_block(LibTCPSetBuffersCallback, msg, 1);
+
+        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.SetBuffers.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
 void
 LibTCPGetSocketStatus(
     PTCP_PCB pcb,
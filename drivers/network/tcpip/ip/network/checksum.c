@@ -9,8 +9,13 @@
  *   CSH 01/08-2000 Created
  */
 
+#ifndef UNIT_TEST
 #include "precomp.h"
+#endif
 
+#if defined(_M_AMD64)
+#include <emmintrin.h>
+#endif
 
 ULONG ChecksumFold(
   ULONG Sum)
@@ -24,34 +29,323 @@ ULONG ChecksumFold(
   return Sum;
 }
 
-ULONG ChecksumCompute(
+static __inline ULONG ChecksumReduce(
+  ULONG64 Sum)
+{
+  /* Fold the 64-bit accumulator back to 32 bits, end-around carry included */
+  Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
+  Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
+
+  return (ULONG)Sum;
+}
+
+ULONG ChecksumComputeGeneric(
   PVOID Data,
   UINT Count,
   ULONG Seed)
 /*
- * FUNCTION: Calculate checksum of a buffer
+ * FUNCTION: Calculate checksum of a buffer, 32 bits at a time
  * ARGUMENTS:
  *     Data  = Pointer to buffer with data
  *     Count = Number of bytes in buffer
  *     Seed  = Previously calculated checksum (if any)
  * RETURNS:
- *     Checksum of buffer
+ *     Checksum of buffer, to be folded with ChecksumFold
  */
 {
-  register ULONG Sum = Seed;
+  PUCHAR Buffer = Data;
+  ULONG64 Sum = Seed;
+
+  /* The carries pile up in the upper half and are folded back at the end */
+  while (Count >= 16)
+    {
+      Sum += ((PULONG)Buffer)[0];
+      Sum += ((PULONG)Buffer)[1];
+      Sum += ((PULONG)Buffer)[2];
+      Sum += ((PULONG)Buffer)[3];
+      Buffer += 16;
+      Count -= 16;
+    }
+
+  while (Count >= 4)
+    {
+      Sum += *(PULONG)Buffer;
+      Buffer += 4;
+      Count -= 4;
+    }
 
-  while (Count > 1)
+  if (Count >= 2)
     {
-      Sum += *(PUSHORT)Data;
+      Sum += *(PUSHORT)Buffer;
+      Buffer += 2;
       Count -= 2;
-      Data = (PVOID)((ULONG_PTR) Data + 2);
     }
 
   /* Add left-over byte, if any */
   if (Count > 0)
     {
-      Sum += *(PUCHAR)Data;
+      Sum += *Buffer;
+    }
+
+  return ChecksumReduce(Sum);
+}
+
+ULONG ChecksumCopyGeneric(
+  PVOID Destination,
+  PVOID Source,
+  UINT Count,
+  ULONG Seed)
+/*
+ * FUNCTION: Copy a buffer and calculate its checksum in the same pass
+ * ARGUMENTS:
+ *     Destination = Pointer to destination buffer
+ *     Source      = Pointer to buffer with data
+ *     Count       = Number of bytes to copy
+ *     Seed        = Previously calculated checksum (if any)
+ * RETURNS:
+ *     Checksum of buffer, to be folded with ChecksumFold
+ */
+{
+  PUCHAR Dst = Destination, Src = Source;
+  ULONG64 Sum = Seed;
+  ULONG Word0, Word1, Word2, Word3;
+
+  while (Count >= 16)
+    {
+      Word0 = ((PULONG)Src)[0];
+      Word1 = ((PULONG)Src)[1];
+      Word2 = ((PULONG)Src)[2];
+      Word3 = ((PULONG)Src)[3];
+      ((PULONG)Dst)[0] = Word0;
+      ((PULONG)Dst)[1] = Word1;
+      ((PULONG)Dst)[2] = Word2;
+      ((PULONG)Dst)[3] = Word3;
+      Sum += Word0;
+      Sum += Word1;
+      Sum += Word2;
+      Sum += Word3;
+      Src += 16;
+      Dst += 16;
+      Count -= 16;
+    }
+
+  while (Count >= 4)
+    {
+      Word0 = *(PULONG)Src;
+      *(PULONG)Dst = Word0;
+      Sum += Word0;
+      Src += 4;
+      Dst += 4;
+      Count -= 4;
+    }
+
+  if (Count >= 2)
+    {
+      *(PUSHORT)Dst = *(PUSHORT)Src;
+      Sum += *(PUSHORT)Src;
+      Src += 2;
+      Dst += 2;
+      Count -= 2;
+    }
+
+  if (Count > 0)
+    {
+      *Dst = *Src;
+      Sum += *Src;
+    }
+
+  return ChecksumReduce(Sum);
+}
+
+#if defined(_M_AMD64)
+
+/*
+ * SSE2 is part of the amd64 baseline and the XMM registers may be used in
+ * kernel mode there, so no floating point state has to be saved around it.
+ * Each 16 byte block is widened to two vectors of 64-bit lanes so the sums
+ * cannot overflow.
+ */
+
+static __inline ULONG64 ChecksumSse2Lanes(
+  __m128i Sum0,
+  __m128i Sum1)
+{
+  ULONG64 Lanes[2];
+
+  _mm_storeu_si128((__m128i *)Lanes, _mm_add_epi64(Sum0, Sum1));
+
+  return (Lanes[0] & 0xFFFFFFFF) + (Lanes[0] >> 32) +
+         (Lanes[1] & 0xFFFFFFFF) + (Lanes[1] >> 32);
+}
+
+ULONG ChecksumComputeSse2(
+  PVOID Data,
+  UINT Count,
+  ULONG Seed)
+{
+  PUCHAR Buffer = Data;
+  __m128i Zero = _mm_setzero_si128();
+  __m128i Sum0 = Zero, Sum1 = Zero, Block;
+  ULONG64 Sum;
+
+  while (Count >= 32)
+    {
+      Block = _mm_loadu_si128((const __m128i *)Buffer);
+      Sum0 = _mm_add_epi64(Sum0, _mm_unpacklo_epi32(Block, Zero));
+      Sum1 = _mm_add_epi64(Sum1, _mm_unpackhi_epi32(Block, Zero));
+      Block = _mm_loadu_si128((const __m128i *)(Buffer + 16));
+      Sum0 = _mm_add_epi64(Sum0, _mm_unpacklo_epi32(Block, Zero));
+      Sum1 = _mm_add_epi64(Sum1, _mm_unpackhi_epi32(Block, Zero));
+      Buffer += 32;
+      Count -= 32;
+    }
+
+  /* Seed and tail are handled by the generic routine */
+  Sum = ChecksumSse2Lanes(Sum0, Sum1);
+  Sum += ChecksumComputeGeneric(Buffer, Count, Seed);
+
+  return ChecksumReduce(Sum);
+}
+
+ULONG ChecksumCopySse2(
+  PVOID Destination,
+  PVOID Source,
+  UINT Count,
+  ULONG Seed)
+{
+  PUCHAR Dst = Destination, Src = Source;
+  __m128i Zero = _mm_setzero_si128();
+  __m128i Sum0 = Zero, Sum1 = Zero, Block0, Block1;
+  ULONG64 Sum;
+
+  while (Count >= 32)
+    {
+      Block0 = _mm_loadu_si128((const __m128i *)Src);
+      Block1 = _mm_loadu_si128((const __m128i *)(Src + 16));
+      _mm_storeu_si128((__m128i *)Dst, Block0);
+      _mm_storeu_si128((__m128i *)(Dst + 16), Block1);
+      Sum0 = _mm_add_epi64(Sum0, _mm_unpacklo_epi32(Block0, Zero));
+      Sum1 = _mm_add_epi64(Sum1, _mm_unpackhi_epi32(Block0, Zero));
+      Sum0 = _mm_add_epi64(Sum0, _mm_unpacklo_epi32(Block1, Zero));
+      Sum1 = _mm_add_epi64(Sum1, _mm_unpackhi_epi32(Block1, Zero));
+      Src += 32;
+      Dst += 32;
+      Count -= 32;
+    }
+
+  Sum = ChecksumSse2Lanes(Sum0, Sum1);
+  Sum += ChecksumCopyGeneric(Dst, Src, Count, Seed);
+
+  return ChecksumReduce(Sum);
+}
+
+#endif /* _M_AMD64 */
+
+ULONG ChecksumCombine(
+  ULONG Sum,
+  ULONG PartialSum,
+  UINT Offset)
+/*
+ * FUNCTION: Add the checksum of a block to a running checksum
+ * ARGUMENTS:
+ *     Sum        = Running checksum
+ *     PartialSum = Checksum of the block
+ *     Offset     = Offset of the block from the start of the checksummed data
+ * RETURNS:
+ *     Combined checksum, to be folded with ChecksumFold
+ * NOTES:
+ *     A block that starts at an odd offset was summed with its bytes
+ *     paired the wrong way round, so its sum is byte-swapped first
+ */
+{
+  PartialSum = ChecksumFold(PartialSum);
+
+  if (Offset & 1)
+    {
+      PartialSum = ((PartialSum & 0xFF) << 8) | (PartialSum >> 8);
+    }
+
+  return ChecksumFold(Sum) + PartialSum;
+}
+
+#ifndef UNIT_TEST
+
+static CHECKSUM_ROUTINE ChecksumComputeRoutine = ChecksumComputeGeneric;
+static CHECKSUM_COPY_ROUTINE ChecksumCopyRoutine = ChecksumCopyGeneric;
+
+VOID ChecksumInit(VOID)
+/*
+ * FUNCTION: Select the checksum routines for this processor
+ */
+{
+#if defined(_M_AMD64)
+  if (ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+    {
+      ChecksumComputeRoutine = ChecksumComputeSse2;
+      ChecksumCopyRoutine = ChecksumCopySse2;
     }
+#endif
+
+  TI_DbgPrint(MIN_TRACE, ("Using %s checksum routines\n",
+      (ChecksumComputeRoutine == ChecksumComputeGeneric) ? "generic" : "SSE2"));
+}
+
+ULONG ChecksumCompute(
+  PVOID Data,
+  UINT Count,
+  ULONG Seed)
+/*
+ * FUNCTION: Calculate checksum of a buffer
+ * ARGUMENTS:
+ *     Data  = Pointer to buffer with data
+ *     Count = Number of bytes in buffer
+ *     Seed  = Previously calculated checksum (if any)
+ * RETURNS:
+ *     Checksum of buffer
+ */
+{
+  return ChecksumComputeRoutine(Data, Count, Seed);
+}
+
+ULONG ChecksumCopy(
+  PVOID Destination,
+  PVOID Source,
+  UINT Count,
+  ULONG Seed)
+/*
+ * FUNCTION: Copy a buffer and calculate its checksum
+ * ARGUMENTS:
+ *     Destination = Pointer to destination buffer
+ *     Source      = Pointer to buffer with data
+ *     Count       = Number of bytes to copy
+ *     Seed        = Previously calculated checksum (if any)
+ * RETURNS:
+ *     Checksum of buffer
+ */
+{
+  return ChecksumCopyRoutine(Destination, Source, Count, Seed);
+}
+
+ULONG
+IPv4PseudoHeaderChecksum(
+  PIPv4_HEADER IPHeader,
+  UCHAR Protocol,
+  ULONG Length)
+/*
+ * FUNCTION: Calculate checksum of the TCP/UDP pseudo header
+ * ARGUMENTS:
+ *     IPHeader = Pointer to IPv4 header with the addresses
+ *     Protocol = Transport protocol number
+ *     Length   = Length of transport header and data
+ * RETURNS:
+ *     Checksum in the same form as ChecksumCompute
+ */
+{
+  ULONG Sum;
+
+  Sum  = (IPHeader->SrcAddr & 0xFFFF) + (IPHeader->SrcAddr >> 16);
+  Sum += (IPHeader->DstAddr & 0xFFFF) + (IPHeader->DstAddr >> 16);
+  Sum += WH2N((USHORT)Protocol) + WH2N((USHORT)Length);
 
   return Sum;
 }
@@ -62,44 +356,14 @@ UDPv4ChecksumCalculate(
   PUCHAR PacketBuffer,
   ULONG DataLength)
 {
-  ULONG Sum = 0;
-  USHORT TmpSum;
-  ULONG i;
-  BOOLEAN Pad;
-
-  /* Pad the data if needed */
-  Pad = (DataLength & 1);
-  if (Pad)
-      DataLength++;
-
-  /* Add from the UDP header and data */
-  for (i = 0; i < DataLength; i += 2)
-  {
-       TmpSum = ((PacketBuffer[i] << 8) & 0xFF00) +
-                ((Pad && i == DataLength - 2) ? 0 : (PacketBuffer[i+1] & 0x00FF));
-       Sum += TmpSum;
-  }
-
-  /* Add the source address */
-  for (i = 0; i < sizeof(IPv4_RAW_ADDRESS); i += 2)
-  {
-       TmpSum = ((((PUCHAR)&IPHeader->SrcAddr)[i] << 8) & 0xFF00) +
-                (((PUCHAR)&IPHeader->SrcAddr)[i+1] & 0x00FF);
-       Sum += TmpSum;
-  }
-
-  /* Add the destination address */
-  for (i = 0; i < sizeof(IPv4_RAW_ADDRESS); i += 2)
-  {
-       TmpSum = ((((PUCHAR)&IPHeader->DstAddr)[i] << 8) & 0xFF00) +
-                (((PUCHAR)&IPHeader->DstAddr)[i+1] & 0x00FF);
-       Sum += TmpSum;
-  }
-
-  /* Add the proto number and length */
-  Sum += IPPROTO_UDP + (DataLength - (Pad ? 1 : 0));
-
-  /* Fold the checksum and return the one's complement */
-  return ~ChecksumFold(Sum);
+  ULONG Sum;
+
+  Sum = ChecksumCompute(PacketBuffer,
+                        DataLength,
+                        IPv4PseudoHeaderChecksum(IPHeader, IPPROTO_UDP, DataLength));
+
+  /* Fold the checksum and return the one's complement in host byte order */
+  return ~(ULONG)WN2H((USHORT)ChecksumFold(Sum));
 }
 
+#endif /* UNIT_TEST */
@@ -417,6 +417,9 @@ NTSTATUS IPStartup(PUNICODE_STRING RegistryPath)
 
     TI_DbgPrint(MAX_TRACE, ("Called.\n"));
 
+    /* Pick the checksum routines for this processor */
+    ChecksumInit();
+
     /* Initialize lookaside lists */
     ExInitializeNPagedLookasideList(
       &IPDRList,                      /* Lookaside list */
@@ -201,6 +201,7 @@ ReassembleDatagram(
   PLIST_ENTRY CurrentEntry;
   PIP_FRAGMENT Fragment;
   PCHAR Data;
+  ULONG Sum, FragmentSum;
 
   PAGED_CODE();
 
@@ -229,20 +230,41 @@ ReassembleDatagram(
   Data = (PVOID)((ULONG_PTR)IPPacket->Header + IPDR->HeaderSize);
   IPPacket->Data = Data;
 
-  /* Copy data from all fragments into buffer */
+  /* The miniport can only validate the transport checksum of a datagram
+     that was not fragmented */
+  Fragment = CONTAINING_RECORD(IPDR->FragmentListHead.Flink, IP_FRAGMENT, ListEntry);
+  if (Fragment->ListEntry.Flink == &IPDR->FragmentListHead && Fragment->ChecksumValid) {
+    CopyPacketToBuffer(Data,
+                       Fragment->Packet,
+                       Fragment->PacketOffset,
+                       Fragment->Size);
+
+    IPPacket->Flags |= IP_PACKET_FLAG_TRANSPORT_CHECKSUM_VALID;
+    return TRUE;
+  }
+
+  /* Copy data from all fragments into buffer, summing the payload for the
+     transport checksum on the way */
+  Sum = 0;
   CurrentEntry = IPDR->FragmentListHead.Flink;
   while (CurrentEntry != &IPDR->FragmentListHead) {
     Fragment = CONTAINING_RECORD(CurrentEntry, IP_FRAGMENT, ListEntry);
 
     /* Copy fragment data into datagram buffer */
-    CopyPacketToBuffer(Data + Fragment->Offset,
-                       Fragment->Packet,
-                       Fragment->PacketOffset,
-                       Fragment->Size);
+    CopyPacketToBufferChecksum(Data + Fragment->Offset,
+                               Fragment->Packet,
+                               Fragment->PacketOffset,
+                               Fragment->Size,
+                               &FragmentSum);
+
+    Sum = ChecksumCombine(Sum, FragmentSum, Fragment->Offset);
 
     CurrentEntry = CurrentEntry->Flink;
   }
 
+  IPPacket->DataChecksum = Sum;
+  IPPacket->Flags |= IP_PACKET_FLAG_DATA_CHECKSUM;
+
   return TRUE;
 }
 
@@ -434,6 +456,7 @@ VOID ProcessFragment(
     Fragment->ReturnPacket = IPPacket->ReturnPacket;
     Fragment->PacketOffset = IPPacket->Position + IPPacket->HeaderSize;
     Fragment->Offset = FragFirst;
+    Fragment->ChecksumValid = (IPPacket->Flags & IP_PACKET_FLAG_TRANSPORT_CHECKSUM_VALID) != 0;
 
     /* Disassociate the NDIS packet so it isn't freed upon return from IPReceive() */
     IPPacket->NdisPacket = NULL;
@@ -611,8 +634,9 @@ VOID IPv4Receive(PIP_INTERFACE IF, PIP_PACKET IPPacket)
         return;
     }
 
-    /* Checksum IPv4 header */
-    if (!IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
+    /* Checksum IPv4 header, unless the miniport already did */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_IP_CHECKSUM_VALID) &&
+        !IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
         TI_DbgPrint(MIN_TRACE, ("Datagram received with bad checksum. Checksum field (0x%X)\n",
 	      WN2H(((PIPv4_HEADER)IPPacket->Header)->Checksum)));
         /* Discard packet */
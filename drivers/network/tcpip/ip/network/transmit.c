@@ -59,6 +59,34 @@ NTSTATUS IPSendFragment(
     return NBQueuePacket(NCE, NdisPacket, IPSendComplete, IFC);
 }
 
+VOID CompleteTransportChecksum(
+    PIP_PACKET IPPacket)
+/*
+ * FUNCTION: Computes a TCP or UDP checksum that was left to the miniport
+ * ARGUMENTS:
+ *     IPPacket = Pointer to an IP packet with IP_PACKET_FLAG_CHECKSUM_OFFLOAD
+ * NOTES:
+ *     The checksum field holds the pseudo header sum at this point
+ */
+{
+    PIPv4_HEADER Header = IPPacket->Header;
+    PUCHAR Data = (PUCHAR)IPPacket->Header + IPPacket->HeaderSize;
+    USHORT Checksum;
+
+    Checksum = (USHORT)~ChecksumFold(ChecksumCompute(Data,
+                                                     IPPacket->TotalSize - IPPacket->HeaderSize,
+                                                     0));
+
+    if (Header->Protocol == IPPROTO_TCP) {
+        ((PTCPv4_HEADER)Data)->Checksum = Checksum;
+    } else {
+        /* Zero means that no checksum was computed */
+        ((PUDP_HEADER)Data)->Checksum = Checksum ? Checksum : 0xFFFF;
+    }
+
+    IPPacket->Flags &= ~IP_PACKET_FLAG_CHECKSUM_OFFLOAD;
+}
+
 BOOLEAN PrepareNextFragment(
     PIPFRAGMENT_CONTEXT IFC)
 /*
@@ -150,6 +178,7 @@ NTSTATUS SendFragments(
     PVOID Data;
     UINT BufferSize = PathMTU, InSize;
     PCHAR InData;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
 
     TI_DbgPrint(MAX_TRACE, ("Called. IPPacket (0x%X)  NCE (0x%X)  PathMTU (%d).\n",
         IPPacket, NCE, PathMTU));
@@ -179,6 +208,24 @@ NTSTATUS SendFragments(
 
     GetDataPtr( IFC->NdisPacket, 0, (PCHAR *)&Data, &InSize );
 
+    if (IPPacket->Flags & IP_PACKET_FLAG_CHECKSUM_OFFLOAD) {
+        if (IPPacket->TotalSize <= PathMTU) {
+            /* Single fragment, the miniport fills in the checksum */
+            ChecksumInfo.Value = 0;
+            ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+            if (((PIPv4_HEADER)IPPacket->Header)->Protocol == IPPROTO_TCP)
+                ChecksumInfo.Transmit.NdisPacketTcpChecksum = 1;
+            else
+                ChecksumInfo.Transmit.NdisPacketUdpChecksum = 1;
+
+            NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpIpChecksumPacketInfo) =
+                UlongToPtr(ChecksumInfo.Value);
+        } else {
+            /* The path MTU shrank since the sender checked it */
+            CompleteTransportChecksum(IPPacket);
+        }
+    }
+
     IFC->Header       = ((PCHAR)Data);
     IFC->Datagram     = IPPacket->NdisPacket;
     IFC->DatagramData = ((PCHAR)IPPacket->Header) + IPPacket->HeaderSize;
@@ -15,8 +15,13 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     IP_PACKET Packet;
     IP_ADDRESS RemoteAddress, LocalAddress;
     PIPv4_HEADER Header;
+    PTCPv4_HEADER TCPHeader;
     ULONG Length;
     ULONG TotalLength;
+    ULONG HeaderSize;
+    ULONG Skip;
+    ULONG Sum;
+    BOOLEAN ChecksumOffload;
 
     /* The caller frees the pbuf struct */
 
@@ -53,19 +58,69 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
 
     ASSERT(Packet.TotalSize == p->tot_len);
 
+    HeaderSize = (Header->VerIHL & 0x0F) << 2;
     TotalLength = p->tot_len;
+
+    /* lwIP does not generate checksums, the miniport or the copy below does */
+    ChecksumOffload = Header->Protocol == IPPROTO_TCP &&
+                      (NCE->Interface->ChecksumOffload & IP_CHECKSUM_OFFLOAD_TX_TCP) &&
+                      TotalLength <= NCE->Interface->MTU;
+
+    Sum = 0;
     Length = 0;
     while (Length < TotalLength)
     {
         ASSERT(p->len <= TotalLength - Length);
         ASSERT(p->tot_len == TotalLength - Length);
-        RtlCopyMemory((PCHAR)Packet.Header + Length, p->payload, p->len);
+
+        /* The IP header is checksummed separately when it is sent */
+        Skip = (Length < HeaderSize) ? min(HeaderSize - Length, p->len) : 0;
+        if (Skip)
+            RtlCopyMemory((PCHAR)Packet.Header + Length, p->payload, Skip);
+
+        if (ChecksumOffload || Header->Protocol != IPPROTO_TCP)
+        {
+            RtlCopyMemory((PCHAR)Packet.Header + Length + Skip,
+                          (PCHAR)p->payload + Skip,
+                          p->len - Skip);
+        }
+        else
+        {
+            Sum = ChecksumCombine(Sum,
+                                  ChecksumCopy((PCHAR)Packet.Header + Length + Skip,
+                                               (PCHAR)p->payload + Skip,
+                                               p->len - Skip,
+                                               0),
+                                  Length + Skip - HeaderSize);
+        }
+
         Length += p->len;
         p = p->next;
     }
     ASSERT(Length == TotalLength);
 
-    Packet.HeaderSize = sizeof(IPv4_HEADER);
+    if (Header->Protocol == IPPROTO_TCP)
+    {
+        Header = Packet.Header;
+        TCPHeader = (PTCPv4_HEADER)((PCHAR)Packet.Header + HeaderSize);
+
+        /* lwIP left the field zeroed */
+        Sum = ChecksumFold(Sum + IPv4PseudoHeaderChecksum(Header,
+                                                          IPPROTO_TCP,
+                                                          TotalLength - HeaderSize));
+        if (ChecksumOffload)
+        {
+            /* The miniport expects the pseudo header sum in the field */
+            TCPHeader->Checksum = (USHORT)Sum;
+            Packet.Flags |= IP_PACKET_FLAG_CHECKSUM_OFFLOAD;
+        }
+        else
+        {
+            TCPHeader->Checksum = (USHORT)~Sum;
+        }
+    }
+
+    Packet.HeaderSize = HeaderSize;
     Packet.TotalSize = TotalLength;
     Packet.SrcAddr = LocalAddress;
     Packet.DstAddr = RemoteAddress;
@@ -198,11 +198,35 @@ VOID TCPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
  *     This is the low level interface for receiving TCP data
  */
 {
+    ULONG Length = IPPacket->TotalSize - IPPacket->HeaderSize;
+    ULONG Sum;
+
+    /* lwIP leaves the checksum to us, unless the miniport already did it */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_TRANSPORT_CHECKSUM_VALID))
+    {
+        if (IPPacket->Flags & IP_PACKET_FLAG_DATA_CHECKSUM)
+        {
+            /* The payload was summed when it was reassembled */
+            Sum = IPPacket->DataChecksum;
+        }
+        else
+        {
+            Sum = ChecksumCompute(IPPacket->Data, Length, 0);
+        }
+
+        Sum += IPv4PseudoHeaderChecksum(IPPacket->Header, IPPROTO_TCP, Length);
+        if (ChecksumFold(Sum) != 0xFFFF)
+        {
+            TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+            return;
+        }
+    }
+
     TI_DbgPrint(DEBUG_TCP,("Sending packet %d (%d) to lwIP\n",
                            IPPacket->TotalSize,
                            IPPacket->HeaderSize));
 
-    LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize);
+    LibIPInsertPacket(Interface->TCPContext, IPPacket);
 }
 
 NTSTATUS TCPStartup(VOID)
@@ -745,6 +769,21 @@ TCPSetNoDelay(
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+TCPSetBuffers(
+    PCONNECTION_ENDPOINT Connection,
+    ULONG Window,
+    ULONG SendBuffer)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_UNSUCCESSFUL;
+
+    return TCPTranslateError(LibTCPSetBuffers(Connection, Window, SendBuffer));
+}
+
 NTSTATUS
 TCPGetSocketStatus(
     PCONNECTION_ENDPOINT Connection,
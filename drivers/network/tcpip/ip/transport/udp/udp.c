@@ -21,20 +21,23 @@ NTSTATUS AddUDPHeaderIPv4(
     USHORT LocalPort,
     PIP_PACKET IPPacket,
     PVOID Data,
-    UINT DataLength)
+    UINT DataLength,
+    BOOLEAN ChecksumOffload)
 /*
  * FUNCTION: Adds an IPv4 and UDP header to an IP packet
  * ARGUMENTS:
- *     SendRequest  = Pointer to send request
- *     LocalAddress = Pointer to our local address
- *     LocalPort    = The port we send this datagram from
- *     IPPacket     = Pointer to IP packet
+ *     SendRequest     = Pointer to send request
+ *     LocalAddress    = Pointer to our local address
+ *     LocalPort       = The port we send this datagram from
+ *     IPPacket        = Pointer to IP packet
+ *     ChecksumOffload = TRUE if the miniport computes the UDP checksum
  * RETURNS:
  *     Status of operation
  */
 {
     PUDP_HEADER UDPHeader;
     NTSTATUS Status;
+    ULONG Sum;
 
     TI_DbgPrint(MID_TRACE, ("Packet: %x NdisPacket %x\n",
 			    IPPacket, IPPacket->NdisPacket));
@@ -51,20 +54,35 @@ NTSTATUS AddUDPHeaderIPv4(
     /* Port values are already big-endian values */
     UDPHeader->SourcePort = LocalPort;
     UDPHeader->DestPort   = RemotePort;
-    UDPHeader->Checksum   = 0;
     /* Length of UDP header and data */
     UDPHeader->Length     = WH2N(DataLength + sizeof(UDP_HEADER));
+    /* The miniport completes the checksum from the pseudo header sum */
+    UDPHeader->Checksum   = (USHORT)ChecksumFold(
+        IPv4PseudoHeaderChecksum((PIPv4_HEADER)IPPacket->Header,
+                                 IPPROTO_UDP,
+                                 DataLength + sizeof(UDP_HEADER)));
 
     TI_DbgPrint(MID_TRACE, ("Copying data (hdr %x data %x (%d))\n",
 			    IPPacket->Header, IPPacket->Data,
 			    (PCHAR)IPPacket->Data - (PCHAR)IPPacket->Header));
 
-    RtlCopyMemory(IPPacket->Data, Data, DataLength);
+    if (ChecksumOffload)
+    {
+        RtlCopyMemory(IPPacket->Data, Data, DataLength);
+        IPPacket->Flags |= IP_PACKET_FLAG_CHECKSUM_OFFLOAD;
+    }
+    else
+    {
+        /* Sum the data while it is copied, then add the header */
+        Sum = ChecksumCopy(IPPacket->Data, Data, DataLength, 0);
+        Sum = ChecksumCompute(UDPHeader, sizeof(UDP_HEADER), Sum);
 
-    UDPHeader->Checksum = UDPv4ChecksumCalculate((PIPv4_HEADER)IPPacket->Header,
-                                                 (PUCHAR)UDPHeader,
-                                                 DataLength + sizeof(UDP_HEADER));
-    UDPHeader->Checksum = WH2N(UDPHeader->Checksum);
+        UDPHeader->Checksum = (USHORT)~ChecksumFold(Sum);
+
+        /* Zero means that no checksum was computed */
+        if (UDPHeader->Checksum == 0)
+            UDPHeader->Checksum = 0xFFFF;
+    }
 
     TI_DbgPrint(MID_TRACE, ("Packet: %d ip %d udp %d payload\n",
 			    (PCHAR)UDPHeader - (PCHAR)IPPacket->Header,
@@ -83,14 +101,16 @@ NTSTATUS BuildUDPPacket(
     PIP_ADDRESS LocalAddress,
     USHORT LocalPort,
     PCHAR DataBuffer,
-    UINT DataLen )
+    UINT DataLen,
+    BOOLEAN ChecksumOffload )
 /*
  * FUNCTION: Builds an UDP packet
  * ARGUMENTS:
- *     Context      = Pointer to context information (DATAGRAM_SEND_REQUEST)
- *     LocalAddress = Pointer to our local address
- *     LocalPort    = The port we send this datagram from
- *     IPPacket     = Address of pointer to IP packet
+ *     Context         = Pointer to context information (DATAGRAM_SEND_REQUEST)
+ *     LocalAddress    = Pointer to our local address
+ *     LocalPort       = The port we send this datagram from
+ *     IPPacket        = Address of pointer to IP packet
+ *     ChecksumOffload = TRUE if the miniport computes the UDP checksum
  * RETURNS:
  *     Status of operation
  */
@@ -122,7 +142,8 @@ NTSTATUS BuildUDPPacket(
     switch (RemoteAddress->Type) {
         case IP_ADDRESS_V4:
             Status = AddUDPHeaderIPv4(AddrFile, RemoteAddress, RemotePort,
-                                      LocalAddress, LocalPort, Packet, DataBuffer, DataLen);
+                                      LocalAddress, LocalPort, Packet, DataBuffer, DataLen,
+                                      ChecksumOffload);
             break;
         case IP_ADDRESS_V6:
             /* FIXME: Support IPv6 */
@@ -171,6 +192,7 @@ NTSTATUS UDPSendDatagram(
     USHORT RemotePort;
     NTSTATUS Status;
     PNEIGHBOR_CACHE_ENTRY NCE;
+    BOOLEAN ChecksumOffload;
 
     LockObject(AddrFile);
 
@@ -213,6 +235,10 @@ NTSTATUS UDPSendDatagram(
         }
     }
 
+    /* The miniport can't checksum a datagram that has to be fragmented */
+    ChecksumOffload = (NCE->Interface->ChecksumOffload & IP_CHECKSUM_OFFLOAD_TX_UDP) &&
+                      sizeof(IPv4_HEADER) + sizeof(UDP_HEADER) + DataSize <= NCE->Interface->MTU;
+
     Status = BuildUDPPacket( AddrFile,
 							 &Packet,
 							 &RemoteAddress,
@@ -220,7 +246,8 @@ NTSTATUS UDPSendDatagram(
 							 &LocalAddress,
 							 AddrFile->Port,
 							 BufferData,
-							 DataSize );
+							 DataSize,
+							 ChecksumOffload );
 
     UnlockObject(AddrFile);
 
@@ -254,6 +281,7 @@ VOID UDPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
   PUDP_HEADER UDPHeader;
   PIP_ADDRESS DstAddress, SrcAddress;
   UINT DataSize, i;
+  BOOLEAN Valid;
 
   TI_DbgPrint(MAX_TRACE, ("Called.\n"));
 
@@ -278,16 +306,6 @@ VOID UDPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
 
   UDPHeader = (PUDP_HEADER)IPPacket->Data;
 
-  /* Calculate and validate UDP checksum */
-  i = UDPv4ChecksumCalculate(IPv4Header,
-                             (PUCHAR)UDPHeader,
-                             WH2N(UDPHeader->Length));
-  if (i != DH2N(0x0000FFFF) && UDPHeader->Checksum != 0)
-  {
-      TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
-      return;
-  }
-
   /* Sanity checks */
   i = WH2N(UDPHeader->Length);
   if ((i < sizeof(UDP_HEADER)) || (i > IPPacket->TotalSize - IPPacket->Position)) {
@@ -296,6 +314,29 @@ VOID UDPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
     return;
   }
 
+  /* Calculate and validate UDP checksum, unless the miniport already did */
+  if (UDPHeader->Checksum != 0 &&
+      !(IPPacket->Flags & IP_PACKET_FLAG_TRANSPORT_CHECKSUM_VALID))
+  {
+      if ((IPPacket->Flags & IP_PACKET_FLAG_DATA_CHECKSUM) &&
+          i == IPPacket->TotalSize - IPPacket->HeaderSize)
+      {
+          /* The payload was summed when it was reassembled */
+          Valid = ChecksumFold(IPPacket->DataChecksum +
+                               IPv4PseudoHeaderChecksum(IPv4Header, IPPROTO_UDP, i)) == 0xFFFF;
+      }
+      else
+      {
+          Valid = UDPv4ChecksumCalculate(IPv4Header, (PUCHAR)UDPHeader, i) == DH2N(0x0000FFFF);
+      }
+
+      if (!Valid)
+      {
+          TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+          return;
+      }
+  }
+
   DataSize = i - sizeof(UDP_HEADER);
 
   /* Go to UDP data area */
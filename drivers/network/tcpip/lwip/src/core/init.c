@@ -109,8 +109,23 @@
   #error "MEMP_NUM_REASSDATA > IP_REASS_MAX_PBUFS doesn't make sense since each struct ip_reassdata must hold 2 pbufs at least!"
 #endif
 #endif /* !MEMP_MEM_MALLOC */
+#if !LWIP_WND_SCALE
 #if (LWIP_TCP && (TCP_WND > 0xffff))
-  #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
+  #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h (or enable window scaling)"
+#endif
+#if (LWIP_TCP && (TCP_SND_BUF > 0xffff))
+  #error "If you want to use TCP, TCP_SND_BUF must fit in an u16_t, so, you have to reduce it in your lwipopts.h (or enable window scaling)"
+#endif
+#else /* !LWIP_WND_SCALE */
+#if (LWIP_TCP && (TCP_RCV_SCALE > 14))
+  #error "TCP_RCV_SCALE must be in the range of [0..14], see RFC 7323"
+#endif
+#if (LWIP_TCP && (TCP_WND > (0xFFFFUL << TCP_RCV_SCALE)))
+  #error "TCP_WND is bigger than the configured TCP_RCV_SCALE allows to announce"
+#endif
+#endif /* !LWIP_WND_SCALE */
+#if (LWIP_TCP && LWIP_TCP_SACK_OUT && !TCP_QUEUE_OOSEQ)
+  #error "LWIP_TCP_SACK_OUT needs TCP_QUEUE_OOSEQ to know which segments to report"
 #endif
 #if (LWIP_TCP && (TCP_SND_QUEUELEN > 0xffff))
   #error "If you want to use TCP, TCP_SND_QUEUELEN must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
@@ -172,7 +172,7 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
   err_t err;
 
   if (rst_on_unacked_data && ((pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT))) {
-    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND)) {
+    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND_MAX(pcb))) {
       /* Not all data received by application, send RST to tell the remote
          side about this. */
       LWIP_ASSERT("pcb->flags & TF_RXCLOSED", pcb->flags & TF_RXCLOSED);
@@ -580,7 +580,7 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 {
   u32_t new_right_edge = pcb->rcv_nxt + pcb->rcv_wnd;
 
-  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND / 2), pcb->mss))) {
+  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND_MAX(pcb) / 2), pcb->mss))) {
     /* we can advertise more window */
     pcb->rcv_ann_wnd = pcb->rcv_wnd;
     return new_right_edge - pcb->rcv_ann_right_edge;
@@ -592,8 +592,10 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
     } else {
       /* keep the right edge of window constant */
       u32_t new_rcv_ann_wnd = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+#if !LWIP_WND_SCALE
       LWIP_ASSERT("new_rcv_ann_wnd <= 0xffff", new_rcv_ann_wnd <= 0xffff);
-      pcb->rcv_ann_wnd = (u16_t)new_rcv_ann_wnd;
+#endif
+      pcb->rcv_ann_wnd = (tcpwnd_size_t)new_rcv_ann_wnd;
     }
     return 0;
   }
@@ -610,23 +612,26 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 void
 tcp_recved(struct tcp_pcb *pcb, u16_t len)
 {
-  int wnd_inflation;
+  u32_t wnd_inflation;
+  tcpwnd_size_t rcv_wnd;
 
   /* pcb->state LISTEN not allowed here */
   LWIP_ASSERT("don't call tcp_recved for listen-pcbs",
     pcb->state != LISTEN);
-  LWIP_ASSERT("tcp_recved: len would wrap rcv_wnd\n",
-              len <= 0xffff - pcb->rcv_wnd );
 
-  pcb->rcv_wnd += len;
-  if (pcb->rcv_wnd > TCP_WND) {
-    pcb->rcv_wnd = TCP_WND;
+  rcv_wnd = (tcpwnd_size_t)(pcb->rcv_wnd + len);
+  if ((rcv_wnd > TCP_WND_MAX(pcb)) || (rcv_wnd < pcb->rcv_wnd)) {
+    /* window got too big or tcpwnd_size_t overflow */
+    LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: window got too big or tcpwnd_size_t overflow\n"));
+    pcb->rcv_wnd = TCP_WND_MAX(pcb);
+  } else {
+    pcb->rcv_wnd = rcv_wnd;
   }
 
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
 
   /* If the change in the right edge of window is significant (default
-   * watermark is TCP_WND/4), then send an explicit update now.
+   * watermark is TCP_WND/4 or 4 segments), then send an explicit update now.
    * Otherwise wait for a packet to be sent in the normal course of
    * events (or more window to be available later) */
   if (wnd_inflation >= TCP_WND_UPDATE_THRESHOLD) {
@@ -634,8 +639,87 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
     tcp_output(pcb);
   }
 
-  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"U16_F" (%"U16_F").\n",
-         len, pcb->rcv_wnd, TCP_WND - pcb->rcv_wnd));
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"TCPWNDSIZE_F" (%"TCPWNDSIZE_F").\n",
+         len, pcb->rcv_wnd, (tcpwnd_size_t)(TCP_WND_MAX(pcb) - pcb->rcv_wnd)));
+}
+
+/**
+ * Sets the size of the receive window of a connection, e.g. from the
+ * SO_RCVBUF socket option. The window grows or shrinks by the difference
+ * to the previous size; data already in flight is not affected.
+ * Without window scaling the window is limited to 0xffff bytes, with it
+ * to what TCP_RCV_SCALE allows to announce.
+ *
+ * @param pcb the tcp_pcb to manipulate
+ * @param wnd new receive window size in bytes
+ */
+void
+tcp_setrcvwnd(struct tcp_pcb *pcb, tcpwnd_size_t wnd)
+{
+  tcpwnd_size_t old_wnd_max;
+  tcpwnd_size_t new_wnd_max;
+
+  LWIP_ASSERT("don't call tcp_setrcvwnd for listen-pcbs",
+    pcb->state != LISTEN);
+
+#if LWIP_WND_SCALE
+  wnd = LWIP_MIN(wnd, ((tcpwnd_size_t)0xFFFF << TCP_RCV_SCALE));
+#endif
+  wnd = LWIP_MAX(wnd, 2 * TCP_MSS);
+
+  old_wnd_max = TCP_WND_MAX(pcb);
+  pcb->rcv_wnd_max = wnd;
+  new_wnd_max = TCP_WND_MAX(pcb);
+
+  if (new_wnd_max >= old_wnd_max) {
+    pcb->rcv_wnd += new_wnd_max - old_wnd_max;
+  } else if (pcb->rcv_wnd > old_wnd_max - new_wnd_max) {
+    pcb->rcv_wnd -= old_wnd_max - new_wnd_max;
+  } else {
+    /* the application still holds more than the new window, it will be
+       reopened by tcp_recved() */
+    pcb->rcv_wnd = 0;
+  }
+
+  if (pcb->state == CLOSED || pcb->state == SYN_SENT) {
+    /* nothing announced yet, the window goes out with the SYN */
+    pcb->rcv_ann_wnd = pcb->rcv_wnd;
+  } else if (tcp_update_rcv_ann_wnd(pcb) >= TCP_WND_UPDATE_THRESHOLD) {
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+  }
+
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_setrcvwnd: wnd %"TCPWNDSIZE_F" (max %"TCPWNDSIZE_F").\n",
+         pcb->rcv_wnd, new_wnd_max));
+}
+
+/**
+ * Sets the size of the send buffer of a connection, e.g. from the
+ * SO_SNDBUF socket option. TCP_SND_BUF is the upper limit, as the
+ * segment queue length is sized from it.
+ *
+ * @param pcb the tcp_pcb to manipulate
+ * @param size new send buffer size in bytes
+ */
+void
+tcp_setsndbuf(struct tcp_pcb *pcb, tcpwnd_size_t size)
+{
+  LWIP_ASSERT("don't call tcp_setsndbuf for listen-pcbs",
+    pcb->state != LISTEN);
+
+  size = LWIP_MIN(size, TCP_SND_BUF);
+  size = LWIP_MAX(size, 2 * TCP_MSS);
+
+  if (size >= pcb->snd_buf_max) {
+    pcb->snd_buf += size - pcb->snd_buf_max;
+  } else if (pcb->snd_buf > pcb->snd_buf_max - size) {
+    pcb->snd_buf -= pcb->snd_buf_max - size;
+  } else {
+    /* more than the new size is queued already, tcp_receive() clamps
+       snd_buf again once that data is acknowledged */
+    pcb->snd_buf = 0;
+  }
+  pcb->snd_buf_max = size;
 }
 
 /**
@@ -743,10 +827,10 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
   pcb->snd_nxt = iss;
   pcb->lastack = iss - 1;
   pcb->snd_lbb = iss - 1;
-  pcb->rcv_wnd = TCP_WND;
-  pcb->rcv_ann_wnd = TCP_WND;
+  pcb->rcv_wnd = TCP_WND_MAX(pcb);
+  pcb->rcv_ann_wnd = TCP_WND_MAX(pcb);
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
-  pcb->snd_wnd = TCP_WND;
+  pcb->snd_wnd = TCPWND16(TCP_WND);
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
      The send MSS is updated when an MSS option is received. */
   pcb->mss = (TCP_MSS > 536) ? 536 : TCP_MSS;
@@ -788,7 +872,7 @@ void
 tcp_slowtmr(void)
 {
   struct tcp_pcb *pcb, *prev;
-  u16_t eff_wnd;
+  tcpwnd_size_t eff_wnd;
   u8_t pcb_remove;      /* flag if a PCB should be removed */
   u8_t pcb_reset;       /* flag if a RST should be sent when removing */
   err_t err;
@@ -867,8 +951,8 @@ tcp_slowtmr_start:
             pcb->ssthresh = (pcb->mss << 1);
           }
           pcb->cwnd = pcb->mss;
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"U16_F
-                                       " ssthresh %"U16_F"\n",
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
+                                       " ssthresh %"TCPWNDSIZE_F"\n",
                                        pcb->cwnd, pcb->ssthresh));
 
           /* The following needs to be called AFTER cwnd is set to one
@@ -1098,7 +1182,7 @@ tcp_process_refused_data(struct tcp_pcb *pcb)
     if (refused_flags & PBUF_FLAG_TCP_FIN) {
       /* correct rcv_wnd as the application won't call tcp_recved()
          for the FIN's seqno */
-      if (pcb->rcv_wnd != TCP_WND) {
+      if (pcb->rcv_wnd != TCP_WND_MAX(pcb)) {
         pcb->rcv_wnd++;
       }
       TCP_EVENT_CLOSED(pcb, err);
@@ -1307,9 +1391,13 @@ tcp_alloc(u8_t prio)
     memset(pcb, 0, sizeof(struct tcp_pcb));
     pcb->prio = prio;
     pcb->snd_buf = TCP_SND_BUF;
+    pcb->snd_buf_max = TCP_SND_BUF;
     pcb->snd_queuelen = 0;
-    pcb->rcv_wnd = TCP_WND;
-    pcb->rcv_ann_wnd = TCP_WND;
+    /* Start with a window that can be announced unscaled; it is opened up
+       to rcv_wnd_max once the remote host agreed to window scaling. */
+    pcb->rcv_wnd_max = TCP_WND;
+    pcb->rcv_wnd = TCPWND16(TCP_WND);
+    pcb->rcv_ann_wnd = TCPWND16(TCP_WND);
     pcb->tos = 0;
     pcb->ttl = TCP_TTL;
     /* As initial send MSS, we use TCP_MSS but limit it to 536.
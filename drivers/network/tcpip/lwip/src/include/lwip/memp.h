@@ -81,12 +81,23 @@ extern const u16_t memp_sizes[MEMP_MAX];
 
 #if MEMP_MEM_MALLOC
 
+#if MEMP_PORT_POOLS
+
+/* The port keeps its own pool for each type, sized from memp_sizes */
+void  memp_init(void);
+void *memp_malloc(memp_t type);
+void  memp_free(memp_t type, void *mem);
+
+#else /* MEMP_PORT_POOLS */
+
 #include "mem.h"
 
 #define memp_init()
 #define memp_malloc(type)     mem_malloc(memp_sizes[type])
 #define memp_free(type, mem)  mem_free(mem)
 
+#endif /* MEMP_PORT_POOLS */
+
 #else /* MEMP_MEM_MALLOC */
 
 #if MEM_USE_POOLS
@@ -115,6 +115,15 @@
 #define MEMP_MEM_MALLOC                 0
 #endif
 
+/**
+ * MEMP_PORT_POOLS==1: With MEMP_MEM_MALLOC, let the port implement memp_init,
+ * memp_malloc and memp_free itself instead of forwarding them to mem_malloc.
+ * This allows it to keep a fixed-size pool for each memp type.
+ */
+#ifndef MEMP_PORT_POOLS
+#define MEMP_PORT_POOLS                 0
+#endif
+
 /**
  * MEM_ALIGNMENT: should be set to the alignment of the CPU
  *    4 byte alignment -> #define MEM_ALIGNMENT 4
@@ -1060,12 +1069,36 @@
 #define LWIP_TCP_TIMESTAMPS             0
 #endif
 
+/**
+ * LWIP_WND_SCALE and TCP_RCV_SCALE:
+ * Set LWIP_WND_SCALE to 1 to enable window scaling (RFC 7323).
+ * Set TCP_RCV_SCALE to the desired scaling factor (shift count in the
+ * range of [0..14]).
+ * When LWIP_WND_SCALE is enabled but TCP_RCV_SCALE is 0, we can use a large
+ * send window while having a small receive window only.
+ */
+#ifndef LWIP_WND_SCALE
+#define LWIP_WND_SCALE                  0
+#endif
+#ifndef TCP_RCV_SCALE
+#define TCP_RCV_SCALE                   0
+#endif
+
+/**
+ * LWIP_TCP_SACK_OUT==1: offer selective acknowledgements (RFC 2018) on
+ * outgoing SYNs and report the out-of-sequence segments queued on
+ * ->ooseq in the ACKs we send. Requires TCP_QUEUE_OOSEQ.
+ */
+#ifndef LWIP_TCP_SACK_OUT
+#define LWIP_TCP_SACK_OUT               0
+#endif
+
 /**
  * TCP_WND_UPDATE_THRESHOLD: difference in window to trigger an
  * explicit window update
  */
 #ifndef TCP_WND_UPDATE_THRESHOLD
-#define TCP_WND_UPDATE_THRESHOLD   (TCP_WND / 4)
+#define TCP_WND_UPDATE_THRESHOLD   LWIP_MIN((TCP_WND / 4), (TCP_MSS * 4))
 #endif
 
 /**
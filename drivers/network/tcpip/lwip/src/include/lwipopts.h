@@ -8,6 +8,9 @@
 #define MEM_LIBC_MALLOC                 1
 #define MEMP_MEM_MALLOC                 1
 
+/* ... but keep a lookaside list per memp type for the fixed-size objects */
+#define MEMP_PORT_POOLS                 1
+
 /* Define LWIP_COMPAT_MUTEX if the port has no mutexes and binary semaphores
  should be used instead */
 #define LWIP_COMPAT_MUTEX               1
@@ -64,10 +67,19 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+/* Default receive window and send buffer of a connection; AFD resizes them
+ * per socket from SO_RCVBUF and SO_SNDBUF. Windows beyond 64k need the
+ * window scale option, TCP_RCV_SCALE 3 lets us announce up to 512k. */
+#define TCP_WND                         0x40000
 
 #define TCP_SND_BUF                     TCP_WND
 
+#define LWIP_WND_SCALE                  1
+
+#define TCP_RCV_SCALE                   3
+
+#define LWIP_TCP_SACK_OUT               1
+
 #define TCP_MAXRTX                      8
 
 #define TCP_SYNMAXRTX                   4
@@ -76,6 +88,16 @@
 
 #define LWIP_TCP_TIMESTAMPS             1
 
+/* tcpip verifies and generates the IP and TCP checksums itself, while it
+ * copies the segments or with the help of the miniport */
+#define CHECKSUM_GEN_IP                 0
+
+#define CHECKSUM_GEN_TCP                0
+
+#define CHECKSUM_CHECK_IP               0
+
+#define CHECKSUM_CHECK_TCP              0
+
 #define LWIP_CALLBACK_API               1
 
 #define LWIP_NETIF_API                  1
@@ -205,6 +205,70 @@ UINT CopyPacketToBuffer(
 }
 
 
+UINT CopyPacketToBufferChecksum(
+    PCHAR DstData,
+    PNDIS_PACKET SrcPacket,
+    UINT SrcOffset,
+    UINT Length,
+    PULONG Checksum)
+/*
+ * FUNCTION: Copies data from an NDIS packet to a buffer and calculates
+ *           its checksum in the same pass
+ * ARGUMENTS:
+ *     DstData   = Pointer to destination buffer
+ *     SrcPacket = Pointer to source NDIS packet
+ *     SrcOffset = Source start offset
+ *     Length    = Number of bytes to copy
+ *     Checksum  = Address of a variable that on return will contain the
+ *                 checksum of the copied data (see ChecksumCompute)
+ * RETURNS:
+ *     Number of bytes copied to destination buffer
+ */
+{
+    PNDIS_BUFFER SrcBuffer;
+    PCHAR SrcData;
+    UINT SrcSize, BytesCopied, BytesToCopy, Total;
+    ULONG Sum = 0;
+
+    TI_DbgPrint(DEBUG_PBUFFER, ("DstData (0x%X)  SrcPacket (0x%X)  SrcOffset (0x%X)  Length (%d)\n", DstData, SrcPacket, SrcOffset, Length));
+
+    *Checksum = 0;
+
+    NdisGetFirstBufferFromPacket(SrcPacket, &SrcBuffer, (PVOID)&SrcData, &SrcSize, &Total);
+    if (SkipToOffset(SrcBuffer, SrcOffset, &SrcData, &SrcSize) == -1)
+        return 0;
+
+    BytesCopied = 0;
+    for (;;) {
+        BytesToCopy = MIN(SrcSize, Length);
+
+        /* Buffers in the chain may end on an odd byte */
+        Sum = ChecksumCombine(Sum,
+                              ChecksumCopy(DstData, SrcData, BytesToCopy, 0),
+                              BytesCopied);
+        BytesCopied += BytesToCopy;
+        DstData      = (PCHAR)((ULONG_PTR)DstData + BytesToCopy);
+
+        Length -= BytesToCopy;
+        if (Length == 0)
+            break;
+
+        SrcSize -= BytesToCopy;
+        if (SrcSize == 0) {
+            NdisGetNextBuffer(SrcBuffer, &SrcBuffer);
+            if (!SrcBuffer)
+                break;
+
+            NdisQueryBuffer(SrcBuffer, (PVOID)&SrcData, &SrcSize);
+        }
+    }
+
+    *Checksum = Sum;
+
+    return BytesCopied;
+}
+
+
 UINT CopyPacketToBufferChain(
     PNDIS_BUFFER DstBuffer,
     UINT DstOffset,
@@ -24,6 +24,20 @@ TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
             Set = *(BOOLEAN*)Buffer;
             return TCPSetNoDelay(Connection, Set);
         }
+        case TCP_SOCKET_WINDOW:
+        case TCP_SOCKET_SEND_BUFFER:
+        {
+            ULONG Size;
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            Size = *(ULONG*)Buffer;
+            if (Size == 0)
+                return TDI_INVALID_PARAMETER;
+            if (ID->toi_id == TCP_SOCKET_WINDOW)
+                return TCPSetBuffers(Connection, Size, 0);
+            else
+                return TCPSetBuffers(Connection, 0, Size);
+        }
         default:
             DbgPrint("TCPIP: Unknown connection info ID: %u.\n", ID->toi_id);
     }
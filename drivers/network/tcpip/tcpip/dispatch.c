@@ -1546,6 +1546,16 @@ NTSTATUS DispTdiSetInformationEx(
     Request.RequestNotifyObject = NULL;
     Request.RequestContext      = NULL;
 
+    /* Connection options sent on a connection file (e.g. by AFD) apply to
+       that connection, there is no need to look up its address entity */
+    if ((ULONG_PTR)IrpSp->FileObject->FsContext2 == TDI_CONNECTION_FILE &&
+        Info->ID.toi_class == INFO_CLASS_PROTOCOL &&
+        Info->ID.toi_type == INFO_TYPE_CONNECTION)
+    {
+        return SetConnectionInfo(&Info->ID, Request.Handle.ConnectionContext,
+                                 &Info->Buffer, Info->BufferSize);
+    }
+
     Status = InfoTdiSetInformationEx(&Request, &Info->ID,
             &Info->Buffer, Info->BufferSize);
 
@@ -529,12 +529,14 @@ HalpInitializePICs(IN BOOLEAN EnableInterrupts)
     HalpVectorToIndex[DISPATCH_VECTOR] = APIC_RESERVED_VECTOR;
     HalpVectorToIndex[APIC_CLOCK_VECTOR] = 8;
     HalpVectorToIndex[APIC_SPURIOUS_VECTOR] = APIC_RESERVED_VECTOR;
+    HalpVectorToIndex[APIC_IPI_VECTOR] = APIC_RESERVED_VECTOR;
 
     /* Set interrupt handlers in the IDT */
     KeRegisterInterruptHandler(APIC_CLOCK_VECTOR, HalpClockInterrupt);
 #ifndef _M_AMD64
     KeRegisterInterruptHandler(APC_VECTOR, HalpApcInterrupt);
     KeRegisterInterruptHandler(DISPATCH_VECTOR, HalpDispatchInterrupt);
+    KeRegisterInterruptHandler(APIC_IPI_VECTOR, HalpIpiInterrupt);
 #endif
 
     /* Register the vectors for APC and dispatch interrupts */
@@ -550,6 +552,30 @@ HalpInitializePICs(IN BOOLEAN EnableInterrupts)
 /* SOFTWARE INTERRUPT TRAPS ***************************************************/
 
 #ifndef _M_AMD64
+VOID
+DECLSPEC_NORETURN
+FASTCALL
+HalpIpiInterruptHandler(IN PKTRAP_FRAME TrapFrame)
+{
+    KIRQL OldIrql;
+
+    /* Enter trap */
+    KiEnterInterruptTrap(TrapFrame);
+
+    /* Start the interrupt */
+    if (!HalBeginSystemInterrupt(IPI_LEVEL, APIC_IPI_VECTOR, &OldIrql))
+    {
+        /* "Spurious" interrupt, exit the interrupt */
+        KiEoiHelper(TrapFrame);
+    }
+
+    /* Let the kernel handle the requests the other processor posted */
+    KiIpiServiceRoutine(TrapFrame, NULL);
+
+    /* End the interrupt and exit the trap */
+    KiEndInterrupt(OldIrql, TrapFrame);
+}
+
 VOID
 DECLSPEC_NORETURN
 FASTCALL
@@ -337,3 +337,4 @@ NTAPI
 HalpInitApicInfo(IN PLOADER_PARAMETER_BLOCK KeLoaderBlock);
 
 VOID __cdecl ApicSpuriousService(VOID);
+VOID __cdecl HalpIpiInterrupt(VOID);
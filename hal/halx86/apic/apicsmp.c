@@ -10,9 +10,14 @@
 
 #include <hal.h>
 #include "apicp.h"
+#include <smp.h>
 #define NDEBUG
 #include <debug.h>
 
+/* GLOBALS ********************************************************************/
+
+extern PPROCESSOR_IDENTITY HalpProcessorIdentity;
+
 /* INTERNAL FUNCTIONS *********************************************************/
 
 /*!
@@ -84,13 +89,28 @@ ApicRequestGlobalInterrupt(
 
 /* SMP SUPPORT FUNCTIONS ******************************************************/
 
-// Should be called by SMP version of HalRequestIpi
 VOID
 NTAPI
 HalpRequestIpi(KAFFINITY TargetProcessors)
 {
-    UNIMPLEMENTED;
-    __debugbreak();
+    ULONG Processor;
+
+    /* Without a processor table there is nobody else to interrupt */
+    if (HalpProcessorIdentity == NULL)
+        return;
+
+    /* Send a fixed IPI to the local APIC of every target */
+    for (Processor = 0; Processor < MAXIMUM_PROCESSORS; Processor++)
+    {
+        if (TargetProcessors & ((KAFFINITY)1 << Processor))
+        {
+            ApicRequestGlobalInterrupt(HalpProcessorIdentity[Processor].LapicId,
+                                       APIC_IPI_VECTOR,
+                                       APIC_MT_Fixed,
+                                       APIC_TGM_Edge,
+                                       APIC_DSH_Destination);
+        }
+    }
 }
 
 // APIC specific SMP code here
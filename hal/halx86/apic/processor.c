@@ -8,6 +8,7 @@
 /* INCLUDES ******************************************************************/
 
 #include <hal.h>
+#include <smp.h>
 #define NDEBUG
 #include <debug.h>
 
@@ -69,8 +70,7 @@ VOID
 NTAPI
 HalRequestIpi(KAFFINITY TargetProcessors)
 {
-    UNIMPLEMENTED;
-    __debugbreak();
+    HalpRequestIpi(TargetProcessors);
 }
 
 /* EOF */
@@ -426,6 +426,7 @@ x86BiosCall(
                       x86BOP,
                       x86IntAck,
                       NULL,  // FpuCallback,
+                      NULL,  // MemMapCallback
                       NULL); // Tlb
 
     /* Copy the registers */
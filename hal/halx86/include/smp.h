@@ -41,3 +41,8 @@ HalpSetupProcessorsTable(
 
 VOID
 HalpPrintApicTables(VOID);
+
+VOID
+NTAPI
+HalpRequestIpi(
+    _In_ KAFFINITY TargetProcessors);
@@ -0,0 +1,240 @@
+/*
+ * PROJECT:     ReactOS API tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Tests for GetQueuedCompletionStatusEx
+ */
+
+#include "precomp.h"
+#include <ndk/psfuncs.h>
+
+#define BATCH_SIZE      64
+#define PACKET_COUNT    200000
+
+typedef
+BOOL
+WINAPI
+FN_GetQueuedCompletionStatusEx(
+    _In_ HANDLE CompletionPort,
+    _Out_writes_to_(ulCount, *ulNumEntriesRemoved) LPOVERLAPPED_ENTRY lpCompletionPortEntries,
+    _In_ ULONG ulCount,
+    _Out_ PULONG ulNumEntriesRemoved,
+    _In_ DWORD dwMilliseconds,
+    _In_ BOOL fAlertable);
+
+static FN_GetQueuedCompletionStatusEx *pfnGetQueuedCompletionStatusEx;
+
+static
+DWORD
+WINAPI
+ProducerThread(
+    _In_ PVOID Parameter)
+{
+    HANDLE Port = Parameter;
+    ULONG i;
+
+    for (i = 0; i < PACKET_COUNT; i++)
+    {
+        if (!PostQueuedCompletionStatus(Port, i, i + 1, (LPOVERLAPPED)(ULONG_PTR)i))
+            return 1;
+    }
+
+    return 0;
+}
+
+static
+VOID
+TestBasic(VOID)
+{
+    OVERLAPPED_ENTRY Entries[BATCH_SIZE];
+    ULONG Removed, i, Total;
+    HANDLE Port;
+    BOOL Ret;
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+    if (!Port)
+        return;
+
+    /* Nothing queued */
+    Removed = 0xdeadbeef;
+    SetLastError(0xdeadbeef);
+    Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, BATCH_SIZE, &Removed, 0, FALSE);
+    ok(!Ret, "GetQueuedCompletionStatusEx returned %d\n", Ret);
+    ok(GetLastError() == WAIT_TIMEOUT, "Error %lu\n", GetLastError());
+    ok(Removed == 0, "Removed %lu\n", Removed);
+
+    SetLastError(0xdeadbeef);
+    Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, 0, &Removed, 0, FALSE);
+    ok(!Ret, "GetQueuedCompletionStatusEx returned %d\n", Ret);
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "Error %lu\n", GetLastError());
+
+    /* More packets than fit in one call come back in order over several */
+    for (i = 0; i < BATCH_SIZE + 10; i++)
+    {
+        Ret = PostQueuedCompletionStatus(Port, i * 2, i + 1, (LPOVERLAPPED)(ULONG_PTR)(i + 0x100));
+        ok(Ret, "PostQueuedCompletionStatus failed with %lu\n", GetLastError());
+    }
+
+    Total = 0;
+    while (Total < BATCH_SIZE + 10)
+    {
+        Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, BATCH_SIZE, &Removed, 0, FALSE);
+        ok(Ret, "GetQueuedCompletionStatusEx failed with %lu\n", GetLastError());
+        if (!Ret)
+            break;
+        ok(Removed >= 1 && Removed <= BATCH_SIZE, "Removed %lu\n", Removed);
+
+        for (i = 0; i < Removed; i++, Total++)
+        {
+            ok(Entries[i].lpCompletionKey == Total + 1, "Key %Iu for packet %lu\n",
+               Entries[i].lpCompletionKey, Total);
+            ok(Entries[i].lpOverlapped == (LPOVERLAPPED)(ULONG_PTR)(Total + 0x100),
+               "Overlapped %p for packet %lu\n", Entries[i].lpOverlapped, Total);
+            ok(Entries[i].dwNumberOfBytesTransferred == Total * 2, "Bytes %lu for packet %lu\n",
+               Entries[i].dwNumberOfBytesTransferred, Total);
+        }
+    }
+    ok(Total == BATCH_SIZE + 10, "Got %lu packets\n", Total);
+
+    Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, BATCH_SIZE, &Removed, 10, FALSE);
+    ok(!Ret, "GetQueuedCompletionStatusEx returned %d\n", Ret);
+    ok(GetLastError() == WAIT_TIMEOUT, "Error %lu\n", GetLastError());
+
+    CloseHandle(Port);
+}
+
+static
+VOID
+CALLBACK
+ApcRoutine(
+    _In_ ULONG_PTR Parameter)
+{
+    (*(PULONG)Parameter)++;
+}
+
+static
+VOID
+TestAlertable(VOID)
+{
+    OVERLAPPED_ENTRY Entries[4];
+    ULONG Removed, ApcCount = 0;
+    NTSTATUS Status;
+    HANDLE Port;
+    BOOL Ret;
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+    if (!Port)
+        return;
+
+    /* A user APC queued before the call ends the alertable wait right away */
+    Ret = QueueUserAPC(ApcRoutine, GetCurrentThread(), (ULONG_PTR)&ApcCount);
+    ok(Ret, "QueueUserAPC failed with %lu\n", GetLastError());
+    Removed = 0xdeadbeef;
+    SetLastError(0xdeadbeef);
+    Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, 4, &Removed, 5000, TRUE);
+    ok(!Ret, "GetQueuedCompletionStatusEx returned %d\n", Ret);
+    ok(GetLastError() == WAIT_IO_COMPLETION, "Error %lu\n", GetLastError());
+    ok(Removed == 0, "Removed %lu\n", Removed);
+    ok(ApcCount == 1, "The APC ran %lu times\n", ApcCount);
+
+    /* So does a pending alert */
+    Status = NtAlertThread(GetCurrentThread());
+    ok(Status == STATUS_SUCCESS, "NtAlertThread returned 0x%lx\n", Status);
+    Removed = 0xdeadbeef;
+    SetLastError(0xdeadbeef);
+    Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, 4, &Removed, 5000, TRUE);
+    ok(!Ret, "GetQueuedCompletionStatusEx returned %d\n", Ret);
+    ok(GetLastError() == WAIT_IO_COMPLETION, "Error %lu\n", GetLastError());
+    ok(Removed == 0, "Removed %lu\n", Removed);
+
+    /* The alert was consumed, and a queued packet still comes through */
+    Ret = PostQueuedCompletionStatus(Port, 1, 2, (LPOVERLAPPED)(ULONG_PTR)3);
+    ok(Ret, "PostQueuedCompletionStatus failed with %lu\n", GetLastError());
+    Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, 4, &Removed, 0, TRUE);
+    ok(Ret, "GetQueuedCompletionStatusEx failed with %lu\n", GetLastError());
+    ok(Removed == 1, "Removed %lu\n", Removed);
+
+    CloseHandle(Port);
+}
+
+static
+VOID
+TestThroughput(
+    _In_ BOOL Batched)
+{
+    OVERLAPPED_ENTRY Entries[BATCH_SIZE];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Received = 0, Calls = 0, Removed;
+    ULONG_PTR Key;
+    LPOVERLAPPED Overlapped;
+    DWORD Bytes;
+    HANDLE Port, Thread;
+    ULONGLONG Elapsed;
+    BOOL Ret;
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+    if (!Port)
+        return;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    Thread = CreateThread(NULL, 0, ProducerThread, Port, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+    {
+        CloseHandle(Port);
+        return;
+    }
+
+    while (Received < PACKET_COUNT)
+    {
+        if (Batched)
+        {
+            Ret = pfnGetQueuedCompletionStatusEx(Port, Entries, BATCH_SIZE, &Removed, 5000, FALSE);
+        }
+        else
+        {
+            Ret = GetQueuedCompletionStatus(Port, &Bytes, &Key, &Overlapped, 5000);
+            Removed = 1;
+        }
+        if (!Ret)
+            break;
+
+        Received += Removed;
+        Calls++;
+    }
+
+    QueryPerformanceCounter(&End);
+
+    ok(Received == PACKET_COUNT, "Received %lu packets, error %lu\n", Received, GetLastError());
+    ok(WaitForSingleObject(Thread, 30000) == WAIT_OBJECT_0, "Producer did not finish\n");
+    CloseHandle(Thread);
+    CloseHandle(Port);
+
+    Elapsed = (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+    trace("%s: %lu completions in %lu calls, %I64u us (%I64u completions/s)\n",
+          Batched ? "GetQueuedCompletionStatusEx" : "GetQueuedCompletionStatus",
+          Received, Calls, Elapsed,
+          Elapsed ? (ULONGLONG)Received * 1000000 / Elapsed : 0);
+}
+
+START_TEST(GetQueuedCompletionStatusEx)
+{
+    HMODULE hKernel32;
+
+    hKernel32 = GetModuleHandleW(L"kernel32.dll");
+    pfnGetQueuedCompletionStatusEx = (FN_GetQueuedCompletionStatusEx*)GetProcAddress(hKernel32, "GetQueuedCompletionStatusEx");
+    if (!pfnGetQueuedCompletionStatusEx)
+    {
+        skip("GetQueuedCompletionStatusEx is not available\n");
+        return;
+    }
+
+    TestBasic();
+    TestAlertable();
+    TestThroughput(FALSE);
+    TestThroughput(TRUE);
+}
@@ -0,0 +1,136 @@
+/*
+ * PROJECT:     ReactOS API tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Tests for SetFileCompletionNotificationModes
+ */
+
+#include "precomp.h"
+
+#ifndef FILE_SKIP_COMPLETION_PORT_ON_SUCCESS
+#define FILE_SKIP_COMPLETION_PORT_ON_SUCCESS 0x1
+#define FILE_SKIP_SET_EVENT_ON_HANDLE        0x2
+#endif
+
+#define PIPE_NAME L"\\\\.\\pipe\\SetFileCompletionNotificationModes"
+
+typedef
+BOOL
+WINAPI
+FN_SetFileCompletionNotificationModes(
+    _In_ HANDLE FileHandle,
+    _In_ UCHAR Flags);
+
+static FN_SetFileCompletionNotificationModes *pfnSetFileCompletionNotificationModes;
+
+static
+BOOL
+ReadInline(
+    _In_ HANDLE Client,
+    _In_ HANDLE Server,
+    _Inout_ LPOVERLAPPED Overlapped)
+{
+    char Buffer[8];
+    DWORD Bytes;
+    BOOL Ret;
+
+    /* The data is already in the pipe, so the read completes without pending */
+    Ret = WriteFile(Client, "skip", 4, &Bytes, NULL);
+    ok(Ret, "WriteFile failed with %lu\n", GetLastError());
+
+    ZeroMemory(Overlapped, sizeof(*Overlapped));
+    Ret = ReadFile(Server, Buffer, sizeof(Buffer), NULL, Overlapped);
+    ok(Ret, "ReadFile failed with %lu\n", GetLastError());
+    return Ret;
+}
+
+START_TEST(SetFileCompletionNotificationModes)
+{
+    OVERLAPPED Overlapped, *pOverlapped;
+    HANDLE Server, Client, Port;
+    char Buffer[8];
+    ULONG_PTR Key;
+    DWORD Bytes;
+    BOOL Ret;
+
+    pfnSetFileCompletionNotificationModes = (FN_SetFileCompletionNotificationModes*)
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetFileCompletionNotificationModes");
+    if (!pfnSetFileCompletionNotificationModes)
+    {
+        skip("SetFileCompletionNotificationModes is not available\n");
+        return;
+    }
+
+    Server = CreateNamedPipeW(PIPE_NAME,
+                              PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+                              PIPE_TYPE_BYTE | PIPE_WAIT,
+                              1, 4096, 4096, 0, NULL);
+    ok(Server != INVALID_HANDLE_VALUE, "CreateNamedPipeW failed with %lu\n", GetLastError());
+    if (Server == INVALID_HANDLE_VALUE)
+        return;
+
+    Client = CreateFileW(PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                         OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    ok(Client != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (Client == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(Server);
+        return;
+    }
+
+    Port = CreateIoCompletionPort(Server, NULL, 1, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+    if (!Port)
+    {
+        CloseHandle(Client);
+        CloseHandle(Server);
+        return;
+    }
+
+    SetLastError(0xdeadbeef);
+    Ret = pfnSetFileCompletionNotificationModes(Server, 0x80);
+    ok(!Ret, "SetFileCompletionNotificationModes returned %d\n", Ret);
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "Error %lu\n", GetLastError());
+
+    /* By default, even an inline completion queues a packet */
+    if (ReadInline(Client, Server, &Overlapped))
+    {
+        Ret = GetQueuedCompletionStatus(Port, &Bytes, &Key, &pOverlapped, 0);
+        ok(Ret, "GetQueuedCompletionStatus failed with %lu\n", GetLastError());
+        ok(pOverlapped == &Overlapped, "Overlapped %p\n", pOverlapped);
+        ok(Bytes == 4, "Bytes %lu\n", Bytes);
+    }
+
+    Ret = pfnSetFileCompletionNotificationModes(Server,
+                                                FILE_SKIP_COMPLETION_PORT_ON_SUCCESS |
+                                                FILE_SKIP_SET_EVENT_ON_HANDLE);
+    ok(Ret, "SetFileCompletionNotificationModes failed with %lu\n", GetLastError());
+
+    /* Now the caller already has the result and nothing is queued or signaled */
+    if (ReadInline(Client, Server, &Overlapped))
+    {
+        SetLastError(0xdeadbeef);
+        Ret = GetQueuedCompletionStatus(Port, &Bytes, &Key, &pOverlapped, 0);
+        ok(!Ret, "GetQueuedCompletionStatus returned %d\n", Ret);
+        ok(GetLastError() == WAIT_TIMEOUT, "Error %lu\n", GetLastError());
+        ok(WaitForSingleObject(Server, 0) == WAIT_TIMEOUT, "The file handle was signaled\n");
+    }
+
+    /* A request that went pending still completes through the port */
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Ret = ReadFile(Server, Buffer, sizeof(Buffer), NULL, &Overlapped);
+    ok(!Ret, "ReadFile returned %d\n", Ret);
+    ok(GetLastError() == ERROR_IO_PENDING, "Error %lu\n", GetLastError());
+
+    Ret = WriteFile(Client, "pend", 4, &Bytes, NULL);
+    ok(Ret, "WriteFile failed with %lu\n", GetLastError());
+
+    Ret = GetQueuedCompletionStatus(Port, &Bytes, &Key, &pOverlapped, 5000);
+    ok(Ret, "GetQueuedCompletionStatus failed with %lu\n", GetLastError());
+    ok(Key == 1, "Key %Iu\n", Key);
+    ok(pOverlapped == &Overlapped, "Overlapped %p\n", pOverlapped);
+    ok(Bytes == 4, "Bytes %lu\n", Bytes);
+
+    CloseHandle(Port);
+    CloseHandle(Client);
+    CloseHandle(Server);
+}
@@ -0,0 +1,155 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test that CPU-bound threads are spread over all processors
+ */
+
+#include "precomp.h"
+
+#include <ndk/kefuncs.h>
+
+#define MAX_THREADS     64
+#define TARGET_MS       500
+
+typedef struct _WORKER
+{
+    HANDLE StartEvent;
+    ULONG Iterations;
+    ULONG_PTR ProcessorSet;
+    volatile ULONG Result;
+} WORKER, *PWORKER;
+
+static
+ULONG
+Spin(
+    _In_ ULONG Iterations,
+    _Inout_ PULONG_PTR ProcessorSet)
+{
+    ULONG Value = 1, i;
+
+    for (i = 0; i < Iterations; i++)
+    {
+        Value = Value * 1664525 + 1013904223;
+
+        /* Sample where we run every now and then */
+        if (!(i & 0xFFFFF))
+            *ProcessorSet |= (ULONG_PTR)1 << (NtGetCurrentProcessorNumber() % (sizeof(ULONG_PTR) * 8));
+    }
+
+    return Value;
+}
+
+static
+DWORD
+WINAPI
+WorkerThread(
+    _In_ PVOID Parameter)
+{
+    PWORKER Worker = Parameter;
+
+    WaitForSingleObject(Worker->StartEvent, INFINITE);
+    Worker->Result = Spin(Worker->Iterations, &Worker->ProcessorSet);
+    return 0;
+}
+
+static
+ULONG
+RunWorkers(
+    _In_ ULONG ThreadCount,
+    _In_ ULONG Iterations,
+    _Out_ PULONG ProcessorsUsed)
+{
+    HANDLE Threads[MAX_THREADS];
+    WORKER Workers[MAX_THREADS];
+    HANDLE StartEvent;
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG_PTR ProcessorSet = 0;
+    ULONG i, Started = 0;
+
+    *ProcessorsUsed = 0;
+    StartEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(StartEvent != NULL, "CreateEvent failed with %lu\n", GetLastError());
+    if (!StartEvent)
+        return 0;
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        Workers[i].StartEvent = StartEvent;
+        Workers[i].Iterations = Iterations;
+        Workers[i].ProcessorSet = 0;
+        Threads[i] = CreateThread(NULL, 0, WorkerThread, &Workers[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Threads[i])
+            break;
+        Started++;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    SetEvent(StartEvent);
+    WaitForMultipleObjects(Started, Threads, TRUE, INFINITE);
+    QueryPerformanceCounter(&End);
+
+    for (i = 0; i < Started; i++)
+    {
+        ProcessorSet |= Workers[i].ProcessorSet;
+        CloseHandle(Threads[i]);
+    }
+    CloseHandle(StartEvent);
+
+    for (; ProcessorSet; ProcessorSet &= ProcessorSet - 1)
+        (*ProcessorsUsed)++;
+
+    return (ULONG)((End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart);
+}
+
+START_TEST(ThreadScaling)
+{
+    SYSTEM_INFO SystemInfo;
+    ULONG Processors, ThreadCount, Iterations, ProcessorsUsed;
+    ULONG SingleMs, Ms;
+
+    GetSystemInfo(&SystemInfo);
+    Processors = min(SystemInfo.dwNumberOfProcessors, MAX_THREADS / 2);
+
+    /* Calibrate the work so that one thread spins for about TARGET_MS */
+    Iterations = 0x1000000;
+    for (;;)
+    {
+        SingleMs = RunWorkers(1, Iterations, &ProcessorsUsed);
+        if (SingleMs >= TARGET_MS / 4 || Iterations >= 0x40000000)
+            break;
+        Iterations *= 2;
+    }
+    if (SingleMs)
+        Iterations = (ULONG)min((ULONGLONG)Iterations * TARGET_MS / SingleMs, 0xFFFFFFFF);
+    SingleMs = RunWorkers(1, Iterations, &ProcessorsUsed);
+    trace("1 thread: %lu ms\n", SingleMs);
+
+    /* With every thread getting its own processor, the wall time stays flat */
+    for (ThreadCount = 2; ThreadCount <= 2 * Processors; ThreadCount *= 2)
+    {
+        Ms = RunWorkers(ThreadCount, Iterations, &ProcessorsUsed);
+        trace("%lu threads on %lu processors: %lu ms, speedup %lu.%02lu, %lu processors used\n",
+              ThreadCount, Processors, Ms,
+              Ms ? SingleMs * ThreadCount / Ms : 0,
+              Ms ? (SingleMs * ThreadCount * 100 / Ms) % 100 : 0,
+              ProcessorsUsed);
+
+        if (Processors > 1)
+        {
+            ok(ProcessorsUsed > 1, "%lu threads only ran on %lu processor\n",
+               ThreadCount, ProcessorsUsed);
+        }
+
+        /* Allow for noise, but two busy processors must beat one */
+        if (Processors > 1 && ThreadCount <= Processors)
+        {
+            ok(Ms < SingleMs * ThreadCount * 3 / 4,
+               "%lu threads took %lu ms, one took %lu ms\n", ThreadCount, Ms, SingleMs);
+        }
+    }
+
+    if (Processors == 1)
+        skip("Only one processor, run with more to test scaling\n");
+}
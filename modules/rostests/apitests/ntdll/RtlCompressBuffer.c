@@ -0,0 +1,197 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Round-trip and throughput test for LZNT1 RtlCompressBuffer
+ */
+
+#include "precomp.h"
+
+#define TEST_BUFFER_SIZE    (256 * 1024)
+#define TEST_ROUNDS         8
+
+typedef enum _DATA_PATTERN
+{
+    PatternZeros,
+    PatternText,
+    PatternRandom,
+    PatternMixed,
+    PatternMax
+} DATA_PATTERN;
+
+static const char *PatternNames[PatternMax] = { "zeros", "text", "random", "mixed" };
+
+static
+void
+FillPattern(PUCHAR Buffer, ULONG Size, DATA_PATTERN Pattern)
+{
+    static const char Words[] = "the quick brown fox jumps over the lazy dog while ReactOS compresses ";
+    ULONG i, Seed = 0x12345678;
+
+    for (i = 0; i < Size; i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+
+        switch (Pattern)
+        {
+            case PatternZeros:
+                Buffer[i] = 0;
+                break;
+            case PatternText:
+                Buffer[i] = Words[(i + (i / 997)) % (sizeof(Words) - 1)];
+                break;
+            case PatternRandom:
+                Buffer[i] = (UCHAR)(Seed >> 16);
+                break;
+            default:
+                /* Alternate compressible and incompressible 1 KB runs */
+                Buffer[i] = ((i / 1024) & 1) ? (UCHAR)(Seed >> 16) : Words[i % (sizeof(Words) - 1)];
+                break;
+        }
+    }
+}
+
+static
+void
+TestRoundTrip(USHORT Engine, DATA_PATTERN Pattern, ULONG Size,
+              PUCHAR Source, PUCHAR Compressed, PUCHAR Decompressed)
+{
+    LARGE_INTEGER Frequency, Start, Middle, End;
+    ULONG WorkSpaceSize, FragmentSize, CompressedSize, FinalSize, Round;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+
+    Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1 | Engine, &WorkSpaceSize, &FragmentSize);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(FragmentSize, 0x1000);
+
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, WorkSpaceSize);
+    ok(WorkSpace != NULL, "Failed to allocate %lu bytes of workspace\n", WorkSpaceSize);
+    if (!WorkSpace) return;
+
+    FillPattern(Source, Size, Pattern);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (Round = 0; Round < TEST_ROUNDS; Round++)
+    {
+        CompressedSize = 0xdeadbeef;
+        Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1 | Engine,
+                                   Source, Size,
+                                   Compressed, Size + Size / 0x1000 * 2 + 2,
+                                   0x1000, &CompressedSize, WorkSpace);
+    }
+
+    QueryPerformanceCounter(&Middle);
+
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status)) goto Cleanup;
+
+    for (Round = 0; Round < TEST_ROUNDS; Round++)
+    {
+        RtlFillMemory(Decompressed, Size, 0xCC);
+        FinalSize = 0xdeadbeef;
+        Status = RtlDecompressBuffer(COMPRESSION_FORMAT_LZNT1,
+                                     Decompressed, Size,
+                                     Compressed, CompressedSize,
+                                     &FinalSize);
+    }
+
+    QueryPerformanceCounter(&End);
+
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(FinalSize, Size);
+    ok(RtlCompareMemory(Source, Decompressed, Size) == Size,
+       "Engine 0x%x, %s data doesn't survive the round trip\n", Engine, PatternNames[Pattern]);
+
+    /* Only incompressible data may stay as big as it was */
+    if (Pattern == PatternZeros || Pattern == PatternText)
+    {
+        ok(CompressedSize < Size / 4, "Engine 0x%x, %s data only compressed to %lu bytes\n",
+           Engine, PatternNames[Pattern], CompressedSize);
+    }
+    ok(CompressedSize <= Size + (Size + 0xFFF) / 0x1000 * 2, "Compressed data grew to %lu bytes\n", CompressedSize);
+
+    trace("Engine 0x%x, %s: %lu -> %lu bytes (%lu%%), compress %lu KB/s, decompress %lu KB/s\n",
+          Engine, PatternNames[Pattern], Size, CompressedSize,
+          (ULONG)((ULONGLONG)CompressedSize * 100 / Size),
+          (ULONG)((ULONGLONG)Size * TEST_ROUNDS * Frequency.QuadPart / 1024 / max(Middle.QuadPart - Start.QuadPart, 1)),
+          (ULONG)((ULONGLONG)Size * TEST_ROUNDS * Frequency.QuadPart / 1024 / max(End.QuadPart - Middle.QuadPart, 1)));
+
+Cleanup:
+    RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+}
+
+static
+void
+TestSmallBuffers(void)
+{
+    static UCHAR Source[] = "WineWineWineWineWineWine";
+    UCHAR Compressed[64], Decompressed[64];
+    ULONG WorkSpaceSize, FragmentSize, FinalSize;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+
+    Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1, &WorkSpaceSize, &FragmentSize);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, WorkSpaceSize);
+    ok(WorkSpace != NULL, "Failed to allocate %lu bytes of workspace\n", WorkSpaceSize);
+    if (!WorkSpace) return;
+
+    /* Repetitive data ends up in a compressed chunk */
+    Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1, Source, sizeof(Source),
+                               Compressed, sizeof(Compressed), 0x1000, &FinalSize, WorkSpace);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok((*(PUSHORT)Compressed & 0xF000) == 0xB000, "Chunk header is 0x%04x\n", *(PUSHORT)Compressed);
+    ok(FinalSize < sizeof(Source), "Compressed size is %lu\n", FinalSize);
+
+    Status = RtlDecompressBuffer(COMPRESSION_FORMAT_LZNT1, Decompressed, sizeof(Decompressed),
+                                 Compressed, FinalSize, &FinalSize);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(FinalSize, sizeof(Source));
+    ok(!memcmp(Source, Decompressed, sizeof(Source)), "Data doesn't survive the round trip\n");
+
+    /* The output buffer is still checked */
+    Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1, Source, sizeof(Source),
+                               Compressed, 4, 0x1000, &FinalSize, WorkSpace);
+    ok_ntstatus(Status, STATUS_BUFFER_TOO_SMALL);
+
+    /* Unknown engines are refused */
+    Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1 | 0x0F00, Source, sizeof(Source),
+                               Compressed, sizeof(Compressed), 0x1000, &FinalSize, WorkSpace);
+    ok_ntstatus(Status, STATUS_NOT_SUPPORTED);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+}
+
+START_TEST(RtlCompressBuffer)
+{
+    PUCHAR Source, Compressed, Decompressed;
+    DATA_PATTERN Pattern;
+
+    TestSmallBuffers();
+
+    Source = RtlAllocateHeap(RtlGetProcessHeap(), 0, TEST_BUFFER_SIZE);
+    Compressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, TEST_BUFFER_SIZE * 2);
+    Decompressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, TEST_BUFFER_SIZE);
+    if (!Source || !Compressed || !Decompressed)
+    {
+        skip("Failed to allocate test buffers\n");
+        goto Cleanup;
+    }
+
+    for (Pattern = PatternZeros; Pattern < PatternMax; Pattern++)
+    {
+        /* Odd size so that the last chunk is a partial one */
+        TestRoundTrip(COMPRESSION_ENGINE_STANDARD, Pattern, TEST_BUFFER_SIZE - 123,
+                      Source, Compressed, Decompressed);
+        TestRoundTrip(COMPRESSION_ENGINE_MAXIMUM, Pattern, TEST_BUFFER_SIZE - 123,
+                      Source, Compressed, Decompressed);
+    }
+
+Cleanup:
+    if (Source) RtlFreeHeap(RtlGetProcessHeap(), 0, Source);
+    if (Compressed) RtlFreeHeap(RtlGetProcessHeap(), 0, Compressed);
+    if (Decompressed) RtlFreeHeap(RtlGetProcessHeap(), 0, Decompressed);
+}
@@ -0,0 +1,300 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test and stress benchmark for the low fragmentation heap
+ */
+
+#include "precomp.h"
+
+#define STRESS_THREADS      4
+#define STRESS_ITERATIONS   200000
+#define STRESS_SLOTS        1024
+#define STRESS_MAX_SIZE     1024
+
+typedef struct _STRESS_CONTEXT
+{
+    HANDLE Heap;
+    ULONG Seed;
+    ULONG Failures;
+} STRESS_CONTEXT, *PSTRESS_CONTEXT;
+
+static
+ULONG
+QueryFrontEndHeapType(HANDLE Heap)
+{
+    ULONG FrontEndType = 0xFFFFFFFF;
+    SIZE_T ReturnLength = 0;
+    NTSTATUS Status;
+
+    Status = RtlQueryHeapInformation(Heap,
+                                     HeapCompatibilityInformation,
+                                     &FrontEndType,
+                                     sizeof(FrontEndType),
+                                     &ReturnLength);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_size_t(ReturnLength, sizeof(ULONG));
+    return FrontEndType;
+}
+
+static
+NTSTATUS
+EnableLowFragHeap(HANDLE Heap)
+{
+    ULONG FrontEndType = 2;
+
+    return RtlSetHeapInformation(Heap,
+                                 HeapCompatibilityInformation,
+                                 &FrontEndType,
+                                 sizeof(FrontEndType));
+}
+
+static
+void
+Test_Activation(void)
+{
+    HANDLE Heap;
+    ULONG FrontEndType = 1;
+    NTSTATUS Status;
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    ok_long(QueryFrontEndHeapType(Heap), 0);
+
+    /* Only the LFH magic value is accepted */
+    Status = RtlSetHeapInformation(Heap, HeapCompatibilityInformation, &FrontEndType, sizeof(FrontEndType));
+    ok_ntstatus(Status, STATUS_UNSUCCESSFUL);
+    Status = RtlSetHeapInformation(Heap, HeapCompatibilityInformation, &FrontEndType, sizeof(USHORT));
+    ok_ntstatus(Status, STATUS_BUFFER_TOO_SMALL);
+
+    ok_ntstatus(EnableLowFragHeap(Heap), STATUS_SUCCESS);
+    ok_long(QueryFrontEndHeapType(Heap), 2);
+
+    /* Enabling it twice is fine */
+    ok_ntstatus(EnableLowFragHeap(Heap), STATUS_SUCCESS);
+    ok_long(QueryFrontEndHeapType(Heap), 2);
+
+    RtlDestroyHeap(Heap);
+
+    /* Unserialized heaps can't use it */
+    Heap = RtlCreateHeap(HEAP_GROWABLE | HEAP_NO_SERIALIZE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    ok_ntstatus(EnableLowFragHeap(Heap), STATUS_UNSUCCESSFUL);
+    ok_long(QueryFrontEndHeapType(Heap), 0);
+
+    RtlDestroyHeap(Heap);
+}
+
+static
+void
+Test_Blocks(void)
+{
+    static PUCHAR Blocks[512];
+    HANDLE Heap;
+    PUCHAR NewBlock;
+    SIZE_T Size, i, j;
+    BOOLEAN Intact;
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    ok_ntstatus(EnableLowFragHeap(Heap), STATUS_SUCCESS);
+
+    /* Cover every bucket and a few back end sizes */
+    for (i = 0; i < RTL_NUMBER_OF(Blocks); i++)
+    {
+        Size = (i * 37) % (20 * 1024);
+        Blocks[i] = RtlAllocateHeap(Heap, HEAP_ZERO_MEMORY, Size);
+        ok(Blocks[i] != NULL, "Allocation of %Iu bytes failed\n", Size);
+        if (!Blocks[i]) continue;
+
+        ok(((ULONG_PTR)Blocks[i] & (sizeof(PVOID) * 2 - 1)) == 0, "Block %p is misaligned\n", Blocks[i]);
+        ok_size_t(RtlSizeHeap(Heap, 0, Blocks[i]), Size);
+        ok(RtlValidateHeap(Heap, 0, Blocks[i]), "Block %p doesn't validate\n", Blocks[i]);
+
+        for (j = 0; j < Size; j++)
+        {
+            if (Blocks[i][j]) break;
+        }
+        ok(j == Size, "Block %p of %Iu bytes isn't zeroed at %Iu\n", Blocks[i], Size, j);
+
+        RtlFillMemory(Blocks[i], Size, (UCHAR)i);
+    }
+
+    /* Grow, shrink and move blocks around, checking the contents survive */
+    for (i = 0; i < RTL_NUMBER_OF(Blocks); i++)
+    {
+        if (!Blocks[i]) continue;
+
+        Size = RtlSizeHeap(Heap, 0, Blocks[i]);
+        NewBlock = RtlReAllocateHeap(Heap, HEAP_ZERO_MEMORY, Blocks[i], Size + 100);
+        ok(NewBlock != NULL, "Reallocation of %p failed\n", Blocks[i]);
+        if (!NewBlock) continue;
+        Blocks[i] = NewBlock;
+
+        ok_size_t(RtlSizeHeap(Heap, 0, NewBlock), Size + 100);
+
+        Intact = TRUE;
+        for (j = 0; j < Size; j++)
+            Intact = Intact && (NewBlock[j] == (UCHAR)i);
+        for (j = Size; j < Size + 100; j++)
+            Intact = Intact && (NewBlock[j] == 0);
+        ok(Intact, "Block %p lost its contents\n", NewBlock);
+
+        NewBlock = RtlReAllocateHeap(Heap, 0, NewBlock, Size / 2);
+        ok(NewBlock != NULL, "Reallocation of %p failed\n", Blocks[i]);
+        if (!NewBlock) continue;
+        Blocks[i] = NewBlock;
+
+        ok_size_t(RtlSizeHeap(Heap, 0, NewBlock), Size / 2);
+    }
+
+    ok(RtlValidateHeap(Heap, 0, NULL), "Heap doesn't validate\n");
+
+    for (i = 0; i < RTL_NUMBER_OF(Blocks); i++)
+    {
+        if (!Blocks[i]) continue;
+        ok(RtlFreeHeap(Heap, 0, Blocks[i]), "Freeing %p failed\n", Blocks[i]);
+    }
+
+    /* Double frees are caught */
+    NewBlock = RtlAllocateHeap(Heap, 0, 24);
+    ok(NewBlock != NULL, "Allocation failed\n");
+    if (NewBlock)
+    {
+        ok(RtlFreeHeap(Heap, 0, NewBlock), "Freeing %p failed\n", NewBlock);
+        ok(!RtlFreeHeap(Heap, 0, NewBlock), "Freeing %p twice succeeded\n", NewBlock);
+    }
+
+    RtlDestroyHeap(Heap);
+}
+
+static
+ULONG
+NextRandom(PULONG Seed)
+{
+    *Seed = *Seed * 1103515245 + 12345;
+    return *Seed >> 8;
+}
+
+static
+DWORD
+WINAPI
+StressThread(LPVOID Parameter)
+{
+    PSTRESS_CONTEXT Context = Parameter;
+    PVOID Slots[STRESS_SLOTS] = { NULL };
+    ULONG i, Slot;
+
+    for (i = 0; i < STRESS_ITERATIONS; i++)
+    {
+        Slot = NextRandom(&Context->Seed) % STRESS_SLOTS;
+
+        if (Slots[Slot])
+        {
+            RtlFreeHeap(Context->Heap, 0, Slots[Slot]);
+            Slots[Slot] = NULL;
+        }
+        else
+        {
+            Slots[Slot] = RtlAllocateHeap(Context->Heap,
+                                          0,
+                                          NextRandom(&Context->Seed) % STRESS_MAX_SIZE + 1);
+            if (!Slots[Slot]) Context->Failures++;
+        }
+    }
+
+    for (Slot = 0; Slot < STRESS_SLOTS; Slot++)
+    {
+        if (Slots[Slot]) RtlFreeHeap(Context->Heap, 0, Slots[Slot]);
+    }
+
+    return 0;
+}
+
+static
+SIZE_T
+QueryCommittedSize(HANDLE Heap)
+{
+    MEMORY_BASIC_INFORMATION MemoryInfo;
+    PUCHAR Address = Heap;
+    SIZE_T Committed = 0;
+
+    /* Walk the heap's initial reservation, that's where most blocks live */
+    while (VirtualQuery(Address, &MemoryInfo, sizeof(MemoryInfo)) &&
+           (MemoryInfo.AllocationBase == Heap))
+    {
+        if (MemoryInfo.State == MEM_COMMIT)
+            Committed += MemoryInfo.RegionSize;
+        Address += MemoryInfo.RegionSize;
+    }
+
+    return Committed;
+}
+
+static
+void
+RunStress(BOOLEAN UseLowFragHeap)
+{
+    STRESS_CONTEXT Contexts[STRESS_THREADS];
+    HANDLE Threads[STRESS_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    HANDLE Heap;
+    ULONG i, Failures = 0;
+    double Seconds;
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    if (UseLowFragHeap)
+        ok_ntstatus(EnableLowFragHeap(Heap), STATUS_SUCCESS);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < STRESS_THREADS; i++)
+    {
+        Contexts[i].Heap = Heap;
+        Contexts[i].Seed = i + 1;
+        Contexts[i].Failures = 0;
+        Threads[i] = CreateThread(NULL, 0, StressThread, &Contexts[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    for (i = 0; i < STRESS_THREADS; i++)
+    {
+        if (!Threads[i]) continue;
+        WaitForSingleObject(Threads[i], INFINITE);
+        CloseHandle(Threads[i]);
+        Failures += Contexts[i].Failures;
+    }
+
+    QueryPerformanceCounter(&End);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+
+    ok_long(Failures, 0);
+    ok(RtlValidateHeap(Heap, 0, NULL), "Heap doesn't validate\n");
+
+    trace("%s: %lu threads, %.0f operations/s, %Iu KB committed after the run\n",
+          UseLowFragHeap ? "LFH" : "Back end",
+          STRESS_THREADS,
+          STRESS_THREADS * STRESS_ITERATIONS / (Seconds ? Seconds : 1),
+          QueryCommittedSize(Heap) / 1024);
+
+    RtlDestroyHeap(Heap);
+}
+
+START_TEST(RtlLowFragHeap)
+{
+    Test_Activation();
+    Test_Blocks();
+
+    /* Throughput and fragmentation, back end versus front end */
+    RunStress(FALSE);
+    RunStress(TRUE);
+}
@@ -0,0 +1,311 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test for RtlWaitOnAddress and lock contention benchmark
+ */
+
+#include "precomp.h"
+
+#define CONTENTION_THREADS      4
+#define CONTENTION_ITERATIONS   100000UL
+#define PINGPONG_ROUNDS         10000UL
+
+static NTSTATUS (NTAPI *pRtlWaitOnAddress)(const volatile VOID *, PVOID, SIZE_T, PLARGE_INTEGER);
+static VOID (NTAPI *pRtlWakeAddressSingle)(PVOID);
+static VOID (NTAPI *pRtlWakeAddressAll)(PVOID);
+static VOID (NTAPI *pRtlInitializeSRWLock)(PRTL_SRWLOCK);
+static VOID (NTAPI *pRtlAcquireSRWLockExclusive)(PRTL_SRWLOCK);
+static VOID (NTAPI *pRtlReleaseSRWLockExclusive)(PRTL_SRWLOCK);
+static VOID (NTAPI *pRtlInitializeConditionVariable)(PRTL_CONDITION_VARIABLE);
+static VOID (NTAPI *pRtlWakeConditionVariable)(PRTL_CONDITION_VARIABLE);
+static NTSTATUS (NTAPI *pRtlSleepConditionVariableCS)(PRTL_CONDITION_VARIABLE, PRTL_CRITICAL_SECTION, const LARGE_INTEGER *);
+
+typedef enum _LOCK_KIND
+{
+    LockCriticalSection,
+    LockSRW,
+    LockAddress,
+    LockMax
+} LOCK_KIND;
+
+static const char *LockNames[LockMax] = { "critical section", "SRW lock", "address wait" };
+
+static RTL_CRITICAL_SECTION TestCriticalSection;
+static RTL_SRWLOCK TestSRWLock;
+static volatile LONG TestAddressLock;
+static volatile LONG TestCounter;
+static volatile LONG WakeValue;
+
+static RTL_CONDITION_VARIABLE PingPongCondition;
+static volatile ULONG PingPongTurn;
+
+static
+void
+AcquireTestLock(LOCK_KIND Kind)
+{
+    LONG Locked = 1;
+
+    switch (Kind)
+    {
+        case LockCriticalSection:
+            RtlEnterCriticalSection(&TestCriticalSection);
+            break;
+        case LockSRW:
+            pRtlAcquireSRWLockExclusive(&TestSRWLock);
+            break;
+        default:
+            /* Minimal futex style lock */
+            while (InterlockedExchange(&TestAddressLock, 1) != 0)
+                pRtlWaitOnAddress(&TestAddressLock, &Locked, sizeof(Locked), NULL);
+            break;
+    }
+}
+
+static
+void
+ReleaseTestLock(LOCK_KIND Kind)
+{
+    switch (Kind)
+    {
+        case LockCriticalSection:
+            RtlLeaveCriticalSection(&TestCriticalSection);
+            break;
+        case LockSRW:
+            pRtlReleaseSRWLockExclusive(&TestSRWLock);
+            break;
+        default:
+            InterlockedExchange(&TestAddressLock, 0);
+            pRtlWakeAddressSingle((PVOID)&TestAddressLock);
+            break;
+    }
+}
+
+static
+DWORD
+WINAPI
+ContentionThread(LPVOID Parameter)
+{
+    LOCK_KIND Kind = (LOCK_KIND)(ULONG_PTR)Parameter;
+    ULONG i;
+
+    for (i = 0; i < CONTENTION_ITERATIONS; i++)
+    {
+        AcquireTestLock(Kind);
+        TestCounter++;
+        ReleaseTestLock(Kind);
+    }
+
+    return 0;
+}
+
+static
+void
+TestContention(LOCK_KIND Kind)
+{
+    HANDLE Threads[CONTENTION_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG i;
+
+    TestCounter = 0;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < CONTENTION_THREADS; i++)
+    {
+        Threads[i] = CreateThread(NULL, 0, ContentionThread, (LPVOID)(ULONG_PTR)Kind, 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Threads[i])
+        {
+            skip("Not all threads could be created\n");
+            while (i--)
+            {
+                WaitForSingleObject(Threads[i], INFINITE);
+                CloseHandle(Threads[i]);
+            }
+            return;
+        }
+    }
+
+    ok_long(WaitForMultipleObjects(CONTENTION_THREADS, Threads, TRUE, 60000), WAIT_OBJECT_0);
+    QueryPerformanceCounter(&End);
+
+    for (i = 0; i < CONTENTION_THREADS; i++)
+        CloseHandle(Threads[i]);
+
+    ok_long(TestCounter, CONTENTION_THREADS * CONTENTION_ITERATIONS);
+
+    trace("%s: %lu threads, %lu acquisitions/s\n",
+          LockNames[Kind], (ULONG)CONTENTION_THREADS,
+          (ULONG)((ULONGLONG)CONTENTION_THREADS * CONTENTION_ITERATIONS * Frequency.QuadPart /
+                  max(End.QuadPart - Start.QuadPart, 1)));
+}
+
+static
+DWORD
+WINAPI
+PingPongThread(LPVOID Parameter)
+{
+    ULONG Self = (ULONG)(ULONG_PTR)Parameter;
+    ULONG i;
+
+    RtlEnterCriticalSection(&TestCriticalSection);
+    for (i = 0; i < PINGPONG_ROUNDS; i++)
+    {
+        while (PingPongTurn != Self)
+            pRtlSleepConditionVariableCS(&PingPongCondition, &TestCriticalSection, NULL);
+
+        PingPongTurn = !Self;
+        pRtlWakeConditionVariable(&PingPongCondition);
+    }
+    RtlLeaveCriticalSection(&TestCriticalSection);
+
+    return 0;
+}
+
+static
+void
+TestConditionVariable(void)
+{
+    LARGE_INTEGER Frequency, Start, End, Timeout;
+    HANDLE Threads[2];
+    NTSTATUS Status;
+
+    pRtlInitializeConditionVariable(&PingPongCondition);
+
+    /* Nobody wakes us, so this has to time out */
+    Timeout.QuadPart = -10 * 1000 * 10;
+    RtlEnterCriticalSection(&TestCriticalSection);
+    Status = pRtlSleepConditionVariableCS(&PingPongCondition, &TestCriticalSection, &Timeout);
+    RtlLeaveCriticalSection(&TestCriticalSection);
+    ok_ntstatus(Status, STATUS_TIMEOUT);
+
+    PingPongTurn = 0;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    Threads[0] = CreateThread(NULL, 0, PingPongThread, (LPVOID)0, 0, NULL);
+    Threads[1] = CreateThread(NULL, 0, PingPongThread, (LPVOID)1, 0, NULL);
+    if (!Threads[0] || !Threads[1])
+    {
+        skip("Failed to create threads\n");
+        return;
+    }
+
+    /* Lost wakeups would make this hang */
+    ok_long(WaitForMultipleObjects(2, Threads, TRUE, 60000), WAIT_OBJECT_0);
+    QueryPerformanceCounter(&End);
+
+    CloseHandle(Threads[0]);
+    CloseHandle(Threads[1]);
+
+    trace("condition variable: %lu round trips/s\n",
+          (ULONG)((ULONGLONG)PINGPONG_ROUNDS * Frequency.QuadPart / max(End.QuadPart - Start.QuadPart, 1)));
+}
+
+static
+DWORD
+WINAPI
+WakerThread(LPVOID Parameter)
+{
+    Sleep(50);
+    InterlockedExchange(&WakeValue, 1);
+    pRtlWakeAddressAll((PVOID)&WakeValue);
+    return 0;
+}
+
+static
+void
+TestWaitOnAddress(void)
+{
+    LARGE_INTEGER Timeout;
+    LONG Compare = 0;
+    LONGLONG Compare64 = 0;
+    HANDLE Thread;
+    NTSTATUS Status;
+
+    WakeValue = 0;
+
+    /* Invalid sizes are refused */
+    Status = pRtlWaitOnAddress(&WakeValue, &Compare, 3, NULL);
+    ok_ntstatus(Status, STATUS_INVALID_PARAMETER);
+
+    /* The value differs already, no wait */
+    Compare = 1;
+    Status = pRtlWaitOnAddress(&WakeValue, &Compare, sizeof(Compare), NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+
+    /* The value matches and nobody wakes us */
+    Compare = 0;
+    Timeout.QuadPart = -10 * 1000 * 10;
+    Status = pRtlWaitOnAddress(&WakeValue, &Compare, sizeof(Compare), &Timeout);
+    ok_ntstatus(Status, STATUS_TIMEOUT);
+    Status = pRtlWaitOnAddress(&Compare64, &Compare64, sizeof(Compare64), &Timeout);
+    ok_ntstatus(Status, STATUS_TIMEOUT);
+
+    /* Waking an address nobody waits on is fine */
+    pRtlWakeAddressSingle(&Compare);
+
+    Thread = CreateThread(NULL, 0, WakerThread, NULL, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        return;
+
+    while (WakeValue == 0)
+    {
+        Status = pRtlWaitOnAddress(&WakeValue, &Compare, sizeof(Compare), NULL);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+    }
+
+    ok_long(WaitForSingleObject(Thread, 5000), WAIT_OBJECT_0);
+    CloseHandle(Thread);
+}
+
+START_TEST(RtlWaitOnAddress)
+{
+    HMODULE hNtdll = GetModuleHandleW(L"ntdll.dll");
+
+#define LOAD_FUNC(Name) p##Name = (PVOID)GetProcAddress(hNtdll, #Name)
+    LOAD_FUNC(RtlWaitOnAddress);
+    LOAD_FUNC(RtlWakeAddressSingle);
+    LOAD_FUNC(RtlWakeAddressAll);
+    LOAD_FUNC(RtlInitializeSRWLock);
+    LOAD_FUNC(RtlAcquireSRWLockExclusive);
+    LOAD_FUNC(RtlReleaseSRWLockExclusive);
+    LOAD_FUNC(RtlInitializeConditionVariable);
+    LOAD_FUNC(RtlWakeConditionVariable);
+    LOAD_FUNC(RtlSleepConditionVariableCS);
+#undef LOAD_FUNC
+
+    RtlInitializeCriticalSection(&TestCriticalSection);
+
+    TestContention(LockCriticalSection);
+
+    if (pRtlInitializeSRWLock && pRtlAcquireSRWLockExclusive && pRtlReleaseSRWLockExclusive)
+    {
+        pRtlInitializeSRWLock(&TestSRWLock);
+        TestContention(LockSRW);
+    }
+    else
+    {
+        skip("SRW locks are not available\n");
+    }
+
+    if (pRtlInitializeConditionVariable && pRtlWakeConditionVariable && pRtlSleepConditionVariableCS)
+        TestConditionVariable();
+    else
+        skip("Condition variables are not available\n");
+
+    if (pRtlWaitOnAddress && pRtlWakeAddressSingle && pRtlWakeAddressAll)
+    {
+        TestWaitOnAddress();
+        TestContention(LockAddress);
+    }
+    else
+    {
+        skip("RtlWaitOnAddress is not available\n");
+    }
+
+    RtlDeleteCriticalSection(&TestCriticalSection);
+}
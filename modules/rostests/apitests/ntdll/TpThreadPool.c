@@ -0,0 +1,359 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test and throughput benchmark for the Tp* thread pool
+ */
+
+#include "precomp.h"
+
+#define WORK_ITEMS          20000UL
+#define TIMER_PERIOD        20
+
+static NTSTATUS (NTAPI *pTpAllocPool)(PTP_POOL *, PVOID);
+static VOID (NTAPI *pTpReleasePool)(PTP_POOL);
+static VOID (NTAPI *pTpSetPoolMaxThreads)(PTP_POOL, ULONG);
+static NTSTATUS (NTAPI *pTpAllocCleanupGroup)(PTP_CLEANUP_GROUP *);
+static VOID (NTAPI *pTpReleaseCleanupGroup)(PTP_CLEANUP_GROUP);
+static VOID (NTAPI *pTpReleaseCleanupGroupMembers)(PTP_CLEANUP_GROUP, BOOL, PVOID);
+static NTSTATUS (NTAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static NTSTATUS (NTAPI *pTpAllocWork)(PTP_WORK *, PTP_WORK_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (NTAPI *pTpPostWork)(PTP_WORK);
+static VOID (NTAPI *pTpWaitForWork)(PTP_WORK, BOOL);
+static VOID (NTAPI *pTpReleaseWork)(PTP_WORK);
+static NTSTATUS (NTAPI *pTpAllocTimer)(PTP_TIMER *, PTP_TIMER_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (NTAPI *pTpSetTimer)(PTP_TIMER, PLARGE_INTEGER, ULONG, ULONG);
+static BOOL (NTAPI *pTpIsTimerSet)(PTP_TIMER);
+static VOID (NTAPI *pTpWaitForTimer)(PTP_TIMER, BOOL);
+static VOID (NTAPI *pTpReleaseTimer)(PTP_TIMER);
+static NTSTATUS (NTAPI *pTpAllocWait)(PTP_WAIT *, PTP_WAIT_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (NTAPI *pTpSetWait)(PTP_WAIT, HANDLE, PLARGE_INTEGER);
+static VOID (NTAPI *pTpWaitForWait)(PTP_WAIT, BOOL);
+static VOID (NTAPI *pTpReleaseWait)(PTP_WAIT);
+static VOID (NTAPI *pTpCallbackReleaseSemaphoreOnCompletion)(PTP_CALLBACK_INSTANCE, HANDLE, ULONG);
+
+static LONG WorkCount;
+static LONG CancelCount;
+
+static
+BOOLEAN
+InitFunctionPointers(void)
+{
+    HMODULE hNtdll = GetModuleHandleW(L"ntdll.dll");
+
+#define LOAD_FUNC(Name) p##Name = (PVOID)GetProcAddress(hNtdll, #Name)
+    LOAD_FUNC(TpAllocPool);
+    LOAD_FUNC(TpReleasePool);
+    LOAD_FUNC(TpSetPoolMaxThreads);
+    LOAD_FUNC(TpAllocCleanupGroup);
+    LOAD_FUNC(TpReleaseCleanupGroup);
+    LOAD_FUNC(TpReleaseCleanupGroupMembers);
+    LOAD_FUNC(TpSimpleTryPost);
+    LOAD_FUNC(TpAllocWork);
+    LOAD_FUNC(TpPostWork);
+    LOAD_FUNC(TpWaitForWork);
+    LOAD_FUNC(TpReleaseWork);
+    LOAD_FUNC(TpAllocTimer);
+    LOAD_FUNC(TpSetTimer);
+    LOAD_FUNC(TpIsTimerSet);
+    LOAD_FUNC(TpWaitForTimer);
+    LOAD_FUNC(TpReleaseTimer);
+    LOAD_FUNC(TpAllocWait);
+    LOAD_FUNC(TpSetWait);
+    LOAD_FUNC(TpWaitForWait);
+    LOAD_FUNC(TpReleaseWait);
+    LOAD_FUNC(TpCallbackReleaseSemaphoreOnCompletion);
+#undef LOAD_FUNC
+
+    return pTpAllocPool && pTpReleasePool && pTpSetPoolMaxThreads &&
+           pTpAllocCleanupGroup && pTpReleaseCleanupGroup && pTpReleaseCleanupGroupMembers &&
+           pTpSimpleTryPost && pTpAllocWork && pTpPostWork && pTpWaitForWork && pTpReleaseWork &&
+           pTpAllocTimer && pTpSetTimer && pTpIsTimerSet && pTpWaitForTimer && pTpReleaseTimer &&
+           pTpAllocWait && pTpSetWait && pTpWaitForWait && pTpReleaseWait &&
+           pTpCallbackReleaseSemaphoreOnCompletion;
+}
+
+static
+VOID
+NTAPI
+SimpleCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context)
+{
+    pTpCallbackReleaseSemaphoreOnCompletion(Instance, Context, 1);
+}
+
+static
+VOID
+NTAPI
+WorkCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WORK Work)
+{
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+SlowWorkCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WORK Work)
+{
+    Sleep(100);
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+CancelCallback(PVOID ObjectContext, PVOID CleanupContext)
+{
+    ok(CleanupContext == (PVOID)0xdeadbeef, "CleanupContext is %p\n", CleanupContext);
+    InterlockedIncrement(&CancelCount);
+}
+
+static
+VOID
+NTAPI
+TimerCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer)
+{
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+WaitCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WAIT Wait, TP_WAIT_RESULT WaitResult)
+{
+    *(TP_WAIT_RESULT *)Context = WaitResult;
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+void
+Test_Simple(void)
+{
+    TP_CALLBACK_ENVIRON Environment;
+    HANDLE Semaphore;
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Semaphore = CreateSemaphoreW(NULL, 0, 1, NULL);
+    ok(Semaphore != NULL, "CreateSemaphoreW failed with %lu\n", GetLastError());
+    if (!Semaphore) return;
+
+    /* Default pool */
+    Status = pTpSimpleTryPost(SimpleCallback, Semaphore, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(WaitForSingleObject(Semaphore, 1000), WAIT_OBJECT_0);
+
+    Status = pTpAllocPool(&Pool, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (NT_SUCCESS(Status))
+    {
+        RtlZeroMemory(&Environment, sizeof(Environment));
+        Environment.Version = 1;
+        Environment.Pool = Pool;
+        Status = pTpSimpleTryPost(SimpleCallback, Semaphore, &Environment);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+        ok_long(WaitForSingleObject(Semaphore, 1000), WAIT_OBJECT_0);
+
+        /* Unknown environment versions are refused */
+        Environment.Version = 9999;
+        Status = pTpSimpleTryPost(SimpleCallback, Semaphore, &Environment);
+        ok_ntstatus(Status, STATUS_INVALID_PARAMETER);
+
+        pTpReleasePool(Pool);
+    }
+
+    CloseHandle(Semaphore);
+}
+
+static
+void
+Test_Work(void)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    PTP_WORK Work;
+    NTSTATUS Status;
+    ULONG i;
+
+    Status = pTpAllocWork(&Work, WorkCallback, NULL, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status)) return;
+
+    WorkCount = 0;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < WORK_ITEMS; i++)
+        pTpPostWork(Work);
+    pTpWaitForWork(Work, FALSE);
+
+    QueryPerformanceCounter(&End);
+
+    /* Every post runs exactly once */
+    ok_long(WorkCount, WORK_ITEMS);
+
+    trace("%lu work callbacks, %I64u callbacks/s\n", WORK_ITEMS,
+          WORK_ITEMS * Frequency.QuadPart / max(End.QuadPart - Start.QuadPart, 1));
+
+    pTpReleaseWork(Work);
+}
+
+static
+void
+Test_CleanupGroup(void)
+{
+    TP_CALLBACK_ENVIRON Environment;
+    PTP_CLEANUP_GROUP CleanupGroup;
+    PTP_WORK Work;
+    PTP_POOL Pool;
+    NTSTATUS Status;
+    ULONG i;
+
+    Status = pTpAllocPool(&Pool, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status)) return;
+
+    /* One worker, so that callbacks pile up */
+    pTpSetPoolMaxThreads(Pool, 1);
+
+    Status = pTpAllocCleanupGroup(&CleanupGroup);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+    {
+        pTpReleasePool(Pool);
+        return;
+    }
+
+    RtlZeroMemory(&Environment, sizeof(Environment));
+    Environment.Version = 1;
+    Environment.Pool = Pool;
+    Environment.CleanupGroup = CleanupGroup;
+    Environment.CleanupGroupCancelCallback = CancelCallback;
+
+    Status = pTpAllocWork(&Work, SlowWorkCallback, NULL, &Environment);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (NT_SUCCESS(Status))
+    {
+        WorkCount = 0;
+        CancelCount = 0;
+        for (i = 0; i < 10; i++)
+            pTpPostWork(Work);
+        Sleep(50);
+
+        /* The running callback completes, the pending ones don't run */
+        pTpReleaseCleanupGroupMembers(CleanupGroup, TRUE, (PVOID)0xdeadbeef);
+        ok_long(WorkCount, 1);
+        ok_long(CancelCount, 1);
+    }
+
+    pTpReleaseCleanupGroup(CleanupGroup);
+    pTpReleasePool(Pool);
+}
+
+static
+void
+Test_Timer(void)
+{
+    LARGE_INTEGER DueTime;
+    PTP_TIMER Timer;
+    NTSTATUS Status;
+
+    Status = pTpAllocTimer(&Timer, TimerCallback, NULL, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status)) return;
+
+    ok(!pTpIsTimerSet(Timer), "Timer is set\n");
+
+    /* One shot */
+    WorkCount = 0;
+    DueTime.QuadPart = -10 * 10000;
+    pTpSetTimer(Timer, &DueTime, 0, 0);
+    ok(pTpIsTimerSet(Timer), "Timer isn't set\n");
+    Sleep(200);
+    pTpWaitForTimer(Timer, FALSE);
+    ok_long(WorkCount, 1);
+    ok(pTpIsTimerSet(Timer), "Timer isn't set anymore\n");
+
+    /* Periodic, with a window */
+    WorkCount = 0;
+    DueTime.QuadPart = 0;
+    pTpSetTimer(Timer, &DueTime, TIMER_PERIOD, TIMER_PERIOD / 2);
+    Sleep(10 * TIMER_PERIOD + TIMER_PERIOD / 2);
+    pTpSetTimer(Timer, NULL, 0, 0);
+    pTpWaitForTimer(Timer, TRUE);
+    ok(!pTpIsTimerSet(Timer), "Timer is still set\n");
+    ok(WorkCount >= 5 && WorkCount <= 12, "Periodic timer fired %ld times\n", WorkCount);
+
+    pTpReleaseTimer(Timer);
+}
+
+static
+void
+Test_Wait(void)
+{
+    TP_WAIT_RESULT WaitResult = 0xdeadbeef;
+    LARGE_INTEGER Timeout;
+    HANDLE Semaphore;
+    PTP_WAIT Wait;
+    NTSTATUS Status;
+
+    Semaphore = CreateSemaphoreW(NULL, 0, 1, NULL);
+    ok(Semaphore != NULL, "CreateSemaphoreW failed with %lu\n", GetLastError());
+    if (!Semaphore) return;
+
+    Status = pTpAllocWait(&Wait, WaitCallback, &WaitResult, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+    {
+        CloseHandle(Semaphore);
+        return;
+    }
+
+    /* Signaled */
+    WorkCount = 0;
+    pTpSetWait(Wait, Semaphore, NULL);
+    ReleaseSemaphore(Semaphore, 1, NULL);
+    Sleep(100);
+    pTpWaitForWait(Wait, FALSE);
+    ok_long(WorkCount, 1);
+    ok_long(WaitResult, WAIT_OBJECT_0);
+    ok_long(WaitForSingleObject(Semaphore, 0), WAIT_TIMEOUT);
+
+    /* Timed out */
+    WorkCount = 0;
+    Timeout.QuadPart = -50 * 10000;
+    pTpSetWait(Wait, Semaphore, &Timeout);
+    Sleep(200);
+    pTpWaitForWait(Wait, FALSE);
+    ok_long(WorkCount, 1);
+    ok_long(WaitResult, WAIT_TIMEOUT);
+
+    /* Waits are one-shot */
+    ReleaseSemaphore(Semaphore, 1, NULL);
+    Sleep(100);
+    ok_long(WorkCount, 1);
+    ok_long(WaitForSingleObject(Semaphore, 0), WAIT_OBJECT_0);
+
+    /* Disarmed */
+    WorkCount = 0;
+    pTpSetWait(Wait, Semaphore, NULL);
+    pTpSetWait(Wait, NULL, NULL);
+    ReleaseSemaphore(Semaphore, 1, NULL);
+    Sleep(100);
+    ok_long(WorkCount, 0);
+
+    pTpReleaseWait(Wait);
+    CloseHandle(Semaphore);
+}
+
+START_TEST(TpThreadPool)
+{
+    if (!InitFunctionPointers())
+    {
+        win_skip("Thread pool functions not available\n");
+        return;
+    }
+
+    Test_Simple();
+    Test_Work();
+    Test_CleanupGroup();
+    Test_Timer();
+    Test_Wait();
+}
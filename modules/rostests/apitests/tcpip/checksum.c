@@ -0,0 +1,201 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Unit Tests for the tcpip checksum routines
+ */
+
+#include <apitest.h>
+
+#define UNIT_TEST
+#include "../../../../drivers/network/tcpip/ip/network/checksum.c"
+
+#define BUFFER_SIZE     2048
+#define BENCHMARK_SIZE  1500
+#define BENCHMARK_LOOPS 100000
+
+typedef ULONG (*PCOMPUTE_ROUTINE)(PVOID, UINT, ULONG);
+typedef ULONG (*PCOPY_ROUTINE)(PVOID, PVOID, UINT, ULONG);
+
+static const struct
+{
+    PCSTR Name;
+    PCOMPUTE_ROUTINE Compute;
+    PCOPY_ROUTINE Copy;
+} Routines[] =
+{
+    { "Generic", ChecksumComputeGeneric, ChecksumCopyGeneric },
+#if defined(_M_AMD64)
+    { "Sse2", ChecksumComputeSse2, ChecksumCopySse2 },
+#endif
+};
+
+static UCHAR Source[BUFFER_SIZE + 16];
+static UCHAR Destination[BUFFER_SIZE + 16];
+
+/* RFC 1071, one 16-bit word at a time in memory order */
+static
+USHORT
+ReferenceChecksum(
+    _In_ const UCHAR *Data,
+    _In_ UINT Count,
+    _In_ ULONG Seed)
+{
+    ULONG Sum = Seed;
+    UINT i;
+
+    for (i = 0; i + 1 < Count; i += 2)
+        Sum += *(const USHORT *)&Data[i];
+
+    if (Count & 1)
+        Sum += Data[Count - 1];
+
+    while (Sum >> 16)
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+
+    return (USHORT)Sum;
+}
+
+static
+VOID
+FillBuffer(
+    _In_ ULONG Seed)
+{
+    UINT i;
+
+    /* Mostly 0xFF bytes push the carries as far as they go */
+    for (i = 0; i < sizeof(Source); i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Source[i] = (Seed & 0x30000) ? 0xFF : (UCHAR)(Seed >> 16);
+    }
+}
+
+static
+VOID
+TestRoutines(VOID)
+{
+    ULONG Seed, Sum, Expected;
+    UINT r, Length, Alignment, Failures;
+
+    for (r = 0; r < _countof(Routines); r++)
+    {
+        Failures = 0;
+
+        for (Seed = 0; Seed < 4; Seed++)
+        {
+            FillBuffer(Seed);
+
+            for (Alignment = 0; Alignment < 16; Alignment++)
+            {
+                for (Length = 0; Length <= 300; Length++)
+                {
+                    Expected = ReferenceChecksum(Source + Alignment, Length, Seed * 0x1234);
+
+                    Sum = ChecksumFold(Routines[r].Compute(Source + Alignment, Length, Seed * 0x1234));
+                    if (Sum != Expected && Failures++ < 10)
+                    {
+                        ok(0, "%s compute: length %u, alignment %u: 0x%lx, expected 0x%lx\n",
+                           Routines[r].Name, Length, Alignment, Sum, Expected);
+                    }
+
+                    memset(Destination, 0xCC, sizeof(Destination));
+                    Sum = ChecksumFold(Routines[r].Copy(Destination + (15 - Alignment),
+                                                        Source + Alignment,
+                                                        Length,
+                                                        Seed * 0x1234));
+                    if (Sum != Expected && Failures++ < 10)
+                    {
+                        ok(0, "%s copy: length %u, alignment %u: 0x%lx, expected 0x%lx\n",
+                           Routines[r].Name, Length, Alignment, Sum, Expected);
+                    }
+                    if (memcmp(Destination + (15 - Alignment), Source + Alignment, Length) ||
+                        Destination[15 - Alignment + Length] != 0xCC)
+                    {
+                        if (Failures++ < 10)
+                        {
+                            ok(0, "%s copy: length %u, alignment %u: data mismatch\n",
+                               Routines[r].Name, Length, Alignment);
+                        }
+                    }
+                }
+            }
+        }
+
+        ok(Failures == 0, "%s: %u failures\n", Routines[r].Name, Failures);
+    }
+}
+
+static
+VOID
+TestCombine(VOID)
+{
+    ULONG Sum, Expected;
+    UINT Length, Split;
+
+    FillBuffer(42);
+
+    /* Summing in pieces must match summing in one go, odd offsets included */
+    for (Length = 1; Length <= 64; Length++)
+    {
+        Expected = ReferenceChecksum(Source, Length, 0);
+
+        for (Split = 0; Split <= Length; Split++)
+        {
+            Sum = ChecksumComputeGeneric(Source, Split, 0);
+            Sum = ChecksumCombine(Sum,
+                                  ChecksumComputeGeneric(Source + Split, Length - Split, 0),
+                                  Split);
+            Sum = ChecksumFold(Sum);
+            ok(Sum == Expected, "Length %u, split %u: 0x%lx, expected 0x%lx\n",
+               Length, Split, Sum, Expected);
+        }
+    }
+}
+
+static
+VOID
+Benchmark(VOID)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    volatile ULONG Sink = 0;
+    UINT r, i;
+
+    if (!QueryPerformanceFrequency(&Frequency) || !Frequency.QuadPart)
+        return;
+
+    FillBuffer(7);
+
+    for (r = 0; r < _countof(Routines); r++)
+    {
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < BENCHMARK_LOOPS; i++)
+            Sink += Routines[r].Compute(Source, BENCHMARK_SIZE, 0);
+        QueryPerformanceCounter(&End);
+        trace("%s compute: %I64d us for %u x %u bytes\n", Routines[r].Name,
+              (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart,
+              BENCHMARK_LOOPS, BENCHMARK_SIZE);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < BENCHMARK_LOOPS; i++)
+            Sink += Routines[r].Copy(Destination, Source, BENCHMARK_SIZE, 0);
+        QueryPerformanceCounter(&End);
+        trace("%s copy: %I64d us for %u x %u bytes\n", Routines[r].Name,
+              (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart,
+              BENCHMARK_LOOPS, BENCHMARK_SIZE);
+    }
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCHMARK_LOOPS; i++)
+        Sink += ReferenceChecksum(Source, BENCHMARK_SIZE, 0);
+    QueryPerformanceCounter(&End);
+    trace("Reference: %I64d us for %u x %u bytes\n",
+          (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart,
+          BENCHMARK_LOOPS, BENCHMARK_SIZE);
+}
+
+START_TEST(checksum)
+{
+    TestRoutines();
+    TestCombine();
+    Benchmark();
+}
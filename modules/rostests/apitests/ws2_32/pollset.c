@@ -0,0 +1,155 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test for the readiness set extension functions
+ */
+
+#include "ws2_32.h"
+#include <winsock/wspollset.h>
+
+static LPFN_WSAPOLLSETCREATE pWSAPollSetCreate;
+static LPFN_WSAPOLLSETCONTROL pWSAPollSetControl;
+static LPFN_WSAPOLLSETWAIT pWSAPollSetWait;
+
+static
+BOOL
+GetExtensionFunction(
+    _In_ SOCKET Socket,
+    _In_ GUID Guid,
+    _Out_ PVOID *Function)
+{
+    DWORD Returned;
+
+    *Function = NULL;
+    return WSAIoctl(Socket, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                    &Guid, sizeof(Guid), Function, sizeof(*Function),
+                    &Returned, NULL, NULL) == 0 && *Function;
+}
+
+START_TEST(pollset)
+{
+    GUID CreateGuid = WSAID_POLLSETCREATE;
+    GUID ControlGuid = WSAID_POLLSETCONTROL;
+    GUID WaitGuid = WSAID_POLLSETWAIT;
+    SOCKET ListenSocket, ClientSocket, ServerSocket;
+    struct sockaddr_in Address;
+    WSAPOLLSET_EVENT Events[4];
+    int AddressLength;
+    WSADATA WsaData;
+    HANDLE PollSet;
+    char Buffer[16];
+    int Ret;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+    {
+        skip("WSAStartup failed\n");
+        return;
+    }
+
+    ListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ClientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(ListenSocket != INVALID_SOCKET, "socket failed\n");
+    ok(ClientSocket != INVALID_SOCKET, "socket failed\n");
+    if (ListenSocket == INVALID_SOCKET || ClientSocket == INVALID_SOCKET)
+    {
+        skip("No socket\n");
+        goto Cleanup;
+    }
+
+    if (!GetExtensionFunction(ListenSocket, CreateGuid, (PVOID *)&pWSAPollSetCreate) ||
+        !GetExtensionFunction(ListenSocket, ControlGuid, (PVOID *)&pWSAPollSetControl) ||
+        !GetExtensionFunction(ListenSocket, WaitGuid, (PVOID *)&pWSAPollSetWait))
+    {
+        skip("Readiness sets are not supported\n");
+        goto Cleanup;
+    }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Ret = bind(ListenSocket, (struct sockaddr *)&Address, sizeof(Address));
+    ok(Ret == 0, "bind failed with %d\n", WSAGetLastError());
+    AddressLength = sizeof(Address);
+    Ret = getsockname(ListenSocket, (struct sockaddr *)&Address, &AddressLength);
+    ok(Ret == 0, "getsockname failed with %d\n", WSAGetLastError());
+    Ret = listen(ListenSocket, 1);
+    ok(Ret == 0, "listen failed with %d\n", WSAGetLastError());
+
+    PollSet = pWSAPollSetCreate();
+    ok(PollSet != NULL, "WSAPollSetCreate failed with %d\n", WSAGetLastError());
+    if (!PollSet)
+        goto Cleanup;
+
+    /* A pending connection makes the listening socket ready */
+    Ret = pWSAPollSetControl(PollSet, WSA_POLLSET_ADD, ListenSocket, FD_ACCEPT, 1);
+    ok(Ret == 0, "WSAPollSetControl failed with %d\n", WSAGetLastError());
+    Ret = pWSAPollSetControl(PollSet, WSA_POLLSET_ADD, ListenSocket, FD_ACCEPT, 1);
+    ok(Ret == SOCKET_ERROR, "Adding twice returned %d\n", Ret);
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 0);
+    ok(Ret == 0, "WSAPollSetWait returned %d\n", Ret);
+
+    Ret = connect(ClientSocket, (struct sockaddr *)&Address, sizeof(Address));
+    ok(Ret == 0, "connect failed with %d\n", WSAGetLastError());
+
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 5000);
+    ok(Ret == 1, "WSAPollSetWait returned %d\n", Ret);
+    if (Ret == 1)
+    {
+        ok(Events[0].Socket == ListenSocket, "Socket %Ix\n", Events[0].Socket);
+        ok(Events[0].Context == 1, "Context %Iu\n", Events[0].Context);
+        ok(Events[0].NetworkEvents & FD_ACCEPT, "NetworkEvents %lx\n", Events[0].NetworkEvents);
+    }
+
+    ServerSocket = accept(ListenSocket, NULL, NULL);
+    ok(ServerSocket != INVALID_SOCKET, "accept failed with %d\n", WSAGetLastError());
+    if (ServerSocket == INVALID_SOCKET)
+    {
+        CloseHandle(PollSet);
+        goto Cleanup;
+    }
+
+    Ret = pWSAPollSetControl(PollSet, WSA_POLLSET_REMOVE, ListenSocket, 0, 0);
+    ok(Ret == 0, "WSAPollSetControl failed with %d\n", WSAGetLastError());
+    Ret = pWSAPollSetControl(PollSet, WSA_POLLSET_MODIFY, ListenSocket, FD_ACCEPT, 1);
+    ok(Ret == SOCKET_ERROR, "Modifying a removed socket returned %d\n", Ret);
+
+    /* Readiness is level triggered: the socket stays ready until it is drained */
+    Ret = pWSAPollSetControl(PollSet, WSA_POLLSET_ADD, ServerSocket, FD_READ | FD_CLOSE, 2);
+    ok(Ret == 0, "WSAPollSetControl failed with %d\n", WSAGetLastError());
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 0);
+    ok(Ret == 0, "WSAPollSetWait returned %d\n", Ret);
+
+    Ret = send(ClientSocket, "pollset", 7, 0);
+    ok(Ret == 7, "send returned %d\n", Ret);
+
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 5000);
+    ok(Ret == 1, "WSAPollSetWait returned %d\n", Ret);
+    if (Ret == 1)
+    {
+        ok(Events[0].Socket == ServerSocket, "Socket %Ix\n", Events[0].Socket);
+        ok(Events[0].Context == 2, "Context %Iu\n", Events[0].Context);
+        ok(Events[0].NetworkEvents & FD_READ, "NetworkEvents %lx\n", Events[0].NetworkEvents);
+    }
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 0);
+    ok(Ret == 1, "WSAPollSetWait returned %d\n", Ret);
+
+    Ret = recv(ServerSocket, Buffer, sizeof(Buffer), 0);
+    ok(Ret == 7, "recv returned %d\n", Ret);
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 0);
+    ok(Ret == 0, "WSAPollSetWait returned %d\n", Ret);
+
+    /* Closing a registered socket drops it from the set */
+    closesocket(ServerSocket);
+    Ret = pWSAPollSetWait(PollSet, Events, 4, 100);
+    ok(Ret == 0, "WSAPollSetWait returned %d\n", Ret);
+
+    ok(CloseHandle(PollSet), "CloseHandle failed with %lu\n", GetLastError());
+
+Cleanup:
+    if (ClientSocket != INVALID_SOCKET)
+        closesocket(ClientSocket);
+    if (ListenSocket != INVALID_SOCKET)
+        closesocket(ListenSocket);
+
+    WSACleanup();
+}
@@ -0,0 +1,193 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Loopback TCP throughput test with large socket buffers
+ */
+
+#include "ws2_32.h"
+
+#define TRANSFER_SIZE   (8 * 1024 * 1024)
+#define CHUNK_SIZE      (64 * 1024)
+#define WAIT_TIMEOUT_   60000
+
+typedef struct _SENDER_CONTEXT
+{
+    SOCKET Socket;
+    int BufferSize;
+    int Sent;
+} SENDER_CONTEXT, *PSENDER_CONTEXT;
+
+static
+UCHAR
+PatternByte(
+    _In_ ULONG Offset)
+{
+    return (UCHAR)((Offset * 7) ^ (Offset >> 12));
+}
+
+static
+DWORD
+WINAPI
+SenderThread(
+    _In_ PVOID Parameter)
+{
+    PSENDER_CONTEXT Context = Parameter;
+    PUCHAR Chunk;
+    ULONG Offset, i;
+    int Length, Ret;
+
+    Chunk = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Chunk)
+        return 1;
+
+    if (Context->BufferSize)
+    {
+        setsockopt(Context->Socket, SOL_SOCKET, SO_SNDBUF,
+                   (const char *)&Context->BufferSize, sizeof(Context->BufferSize));
+    }
+
+    for (Offset = 0; Offset < TRANSFER_SIZE; Offset += Length)
+    {
+        Length = min(CHUNK_SIZE, TRANSFER_SIZE - Offset);
+        for (i = 0; i < (ULONG)Length; i++)
+            Chunk[i] = PatternByte(Offset + i);
+
+        Ret = send(Context->Socket, (const char *)Chunk, Length, 0);
+        if (Ret != Length)
+            break;
+        Context->Sent += Ret;
+    }
+
+    shutdown(Context->Socket, SD_SEND);
+    HeapFree(GetProcessHeap(), 0, Chunk);
+    return 0;
+}
+
+static
+VOID
+TestThroughput(
+    _In_ int BufferSize)
+{
+    SOCKET ListenSocket, ClientSocket, ServerSocket;
+    struct sockaddr_in Address;
+    int AddressLength;
+    SENDER_CONTEXT Context;
+    HANDLE Thread;
+    PUCHAR Buffer;
+    ULONG Received = 0, Mismatches = 0, i;
+    DWORD Start, Elapsed;
+    int Ret;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        return;
+    }
+
+    ListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ClientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(ListenSocket != INVALID_SOCKET, "socket failed\n");
+    ok(ClientSocket != INVALID_SOCKET, "socket failed\n");
+    if (ListenSocket == INVALID_SOCKET || ClientSocket == INVALID_SOCKET)
+    {
+        skip("No socket\n");
+        goto Cleanup;
+    }
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = 0;
+    Ret = bind(ListenSocket, (struct sockaddr *)&Address, sizeof(Address));
+    ok(Ret == 0, "bind failed with %d\n", WSAGetLastError());
+    AddressLength = sizeof(Address);
+    Ret = getsockname(ListenSocket, (struct sockaddr *)&Address, &AddressLength);
+    ok(Ret == 0, "getsockname failed with %d\n", WSAGetLastError());
+    Ret = listen(ListenSocket, 1);
+    ok(Ret == 0, "listen failed with %d\n", WSAGetLastError());
+
+    Ret = connect(ClientSocket, (struct sockaddr *)&Address, sizeof(Address));
+    ok(Ret == 0, "connect failed with %d\n", WSAGetLastError());
+    ServerSocket = accept(ListenSocket, NULL, NULL);
+    ok(ServerSocket != INVALID_SOCKET, "accept failed with %d\n", WSAGetLastError());
+    if (Ret != 0 || ServerSocket == INVALID_SOCKET)
+    {
+        skip("No connection\n");
+        goto Cleanup;
+    }
+
+    if (BufferSize)
+    {
+        Ret = setsockopt(ServerSocket, SOL_SOCKET, SO_RCVBUF,
+                         (const char *)&BufferSize, sizeof(BufferSize));
+        ok(Ret == 0, "setsockopt(SO_RCVBUF) failed with %d\n", WSAGetLastError());
+    }
+
+    Context.Socket = ClientSocket;
+    Context.BufferSize = BufferSize;
+    Context.Sent = 0;
+
+    Start = GetTickCount();
+    Thread = CreateThread(NULL, 0, SenderThread, &Context, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+    {
+        closesocket(ServerSocket);
+        goto Cleanup;
+    }
+
+    for (;;)
+    {
+        Ret = recv(ServerSocket, (char *)Buffer, CHUNK_SIZE, 0);
+        if (Ret <= 0)
+            break;
+
+        for (i = 0; i < (ULONG)Ret; i++)
+        {
+            if (Buffer[i] != PatternByte(Received + i))
+                Mismatches++;
+        }
+        Received += Ret;
+    }
+    Elapsed = GetTickCount() - Start;
+
+    ok(Ret == 0, "recv failed with %d\n", WSAGetLastError());
+    ok(WaitForSingleObject(Thread, WAIT_TIMEOUT_) == WAIT_OBJECT_0, "Sender did not finish\n");
+    CloseHandle(Thread);
+
+    ok(Context.Sent == TRANSFER_SIZE, "Sent %d bytes\n", Context.Sent);
+    ok(Received == TRANSFER_SIZE, "Received %lu bytes\n", Received);
+    ok(Mismatches == 0, "%lu bytes were corrupted\n", Mismatches);
+
+    trace("Buffer size %d: %lu bytes in %lu ms (%lu KB/s)\n",
+          BufferSize, Received, Elapsed,
+          Elapsed ? (Received / 1024) * 1000 / Elapsed : 0);
+
+    closesocket(ServerSocket);
+
+Cleanup:
+    if (ClientSocket != INVALID_SOCKET)
+        closesocket(ClientSocket);
+    if (ListenSocket != INVALID_SOCKET)
+        closesocket(ListenSocket);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+}
+
+START_TEST(throughput)
+{
+    WSADATA WsaData;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+    {
+        skip("WSAStartup failed\n");
+        return;
+    }
+
+    /* Transport defaults, then windows that need window scaling */
+    TestThroughput(0);
+    TestThroughput(256 * 1024);
+    TestThroughput(512 * 1024);
+
+    WSACleanup();
+}
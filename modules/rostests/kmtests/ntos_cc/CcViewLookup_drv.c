@@ -0,0 +1,371 @@
+/*
+ * PROJECT:     ReactOS kernel-mode tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test driver for the cache view lookup, with latency measurement
+ */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define IOCTL_START_TEST  1
+#define IOCTL_FINISH_TEST 2
+
+#define LOOKUP_ITERATIONS 10000
+
+typedef struct _TEST_FCB
+{
+    FSRTL_ADVANCED_FCB_HEADER Header;
+    SECTION_OBJECT_POINTERS SectionObjectPointers;
+    FAST_MUTEX HeaderMutex;
+} TEST_FCB, *PTEST_FCB;
+
+static ULONG TestTestId = -1;
+static PFILE_OBJECT TestFileObject;
+static PDEVICE_OBJECT TestDeviceObject;
+static KMT_IRP_HANDLER TestIrpHandler;
+static KMT_MESSAGE_HANDLER TestMessageHandler;
+
+/* File size in MB for each test */
+static const ULONG TestFileSizes[] = { 1, 16, 64, 256 };
+
+NTSTATUS
+TestEntry(
+    _In_ PDRIVER_OBJECT DriverObject,
+    _In_ PCUNICODE_STRING RegistryPath,
+    _Out_ PCWSTR *DeviceName,
+    _Inout_ INT *Flags)
+{
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(RegistryPath);
+
+    *DeviceName = L"CcViewLookup";
+    *Flags = TESTENTRY_NO_EXCLUSIVE_DEVICE |
+             TESTENTRY_BUFFERED_IO_DEVICE |
+             TESTENTRY_NO_READONLY_DEVICE;
+
+    KmtRegisterIrpHandler(IRP_MJ_READ, NULL, TestIrpHandler);
+    KmtRegisterMessageHandler(0, NULL, TestMessageHandler);
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+TestUnload(
+    _In_ PDRIVER_OBJECT DriverObject)
+{
+    PAGED_CODE();
+}
+
+BOOLEAN
+NTAPI
+AcquireForLazyWrite(
+    _In_ PVOID Context,
+    _In_ BOOLEAN Wait)
+{
+    return TRUE;
+}
+
+VOID
+NTAPI
+ReleaseFromLazyWrite(
+    _In_ PVOID Context)
+{
+    return;
+}
+
+BOOLEAN
+NTAPI
+AcquireForReadAhead(
+    _In_ PVOID Context,
+    _In_ BOOLEAN Wait)
+{
+    return TRUE;
+}
+
+VOID
+NTAPI
+ReleaseFromReadAhead(
+    _In_ PVOID Context)
+{
+    return;
+}
+
+static CACHE_MANAGER_CALLBACKS Callbacks = {
+    AcquireForLazyWrite,
+    ReleaseFromLazyWrite,
+    AcquireForReadAhead,
+    ReleaseFromReadAhead,
+};
+
+static
+PVOID
+MapAndLockUserBuffer(
+    _In_ _Out_ PIRP Irp,
+    _In_ ULONG BufferLength)
+{
+    PMDL Mdl;
+
+    if (Irp->MdlAddress == NULL)
+    {
+        Mdl = IoAllocateMdl(Irp->UserBuffer, BufferLength, FALSE, FALSE, Irp);
+        if (Mdl == NULL)
+        {
+            return NULL;
+        }
+
+        _SEH2_TRY
+        {
+            MmProbeAndLockPages(Mdl, Irp->RequestorMode, IoWriteAccess);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            IoFreeMdl(Mdl);
+            Irp->MdlAddress = NULL;
+            _SEH2_YIELD(return NULL);
+        }
+        _SEH2_END;
+    }
+
+    return MmGetSystemAddressForMdlSafe(Irp->MdlAddress, NormalPagePriority);
+}
+
+static
+BOOLEAN
+MapAndCheckView(
+    _In_ ULONG View)
+{
+    LARGE_INTEGER Offset;
+    PULONG Buffer;
+    PVOID Bcb;
+    BOOLEAN Ret = FALSE;
+
+    Offset.QuadPart = (LONGLONG)View * VACB_MAPPING_GRANULARITY;
+
+    KmtStartSeh();
+    Ret = CcMapData(TestFileObject, &Offset, PAGE_SIZE, MAP_WAIT, &Bcb, (PVOID *)&Buffer);
+    KmtEndSeh(STATUS_SUCCESS);
+
+    if (Ret)
+    {
+        /* Each page starts with its offset in the file */
+        ok_eq_ulong(Buffer[0], Offset.LowPart);
+        CcUnpinData(Bcb);
+    }
+
+    return Ret;
+}
+
+static
+VOID
+PerformTest(
+    ULONG TestId,
+    PDEVICE_OBJECT DeviceObject)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    CC_FILE_SIZES FileSizes;
+    ULONG Views, View, i, Seed;
+    PTEST_FCB Fcb;
+
+    ok_eq_pointer(TestFileObject, NULL);
+    ok_eq_pointer(TestDeviceObject, NULL);
+    ok_eq_ulong(TestTestId, -1);
+
+    TestDeviceObject = DeviceObject;
+    TestTestId = TestId;
+
+    if (skip(TestId < RTL_NUMBER_OF(TestFileSizes), "Invalid test %lu\n", TestId))
+        return;
+
+    TestFileObject = IoCreateStreamFileObject(NULL, DeviceObject);
+    if (skip(TestFileObject != NULL, "Failed to allocate FO\n"))
+        return;
+
+    Fcb = ExAllocatePool(NonPagedPool, sizeof(TEST_FCB));
+    if (skip(Fcb != NULL, "ExAllocatePool failed\n"))
+        return;
+
+    RtlZeroMemory(Fcb, sizeof(TEST_FCB));
+    ExInitializeFastMutex(&Fcb->HeaderMutex);
+    FsRtlSetupAdvancedHeader(&Fcb->Header, &Fcb->HeaderMutex);
+
+    TestFileObject->FsContext = Fcb;
+    TestFileObject->SectionObjectPointer = &Fcb->SectionObjectPointers;
+
+    FileSizes.AllocationSize.QuadPart = (LONGLONG)TestFileSizes[TestId] * 1024 * 1024;
+    FileSizes.FileSize = FileSizes.AllocationSize;
+    FileSizes.ValidDataLength = FileSizes.AllocationSize;
+
+    KmtStartSeh();
+    CcInitializeCacheMap(TestFileObject, &FileSizes, FALSE, &Callbacks, NULL);
+    KmtEndSeh(STATUS_SUCCESS);
+
+    if (skip(CcIsFileCached(TestFileObject) == TRUE, "CcInitializeCacheMap failed\n"))
+        return;
+
+    Views = (ULONG)(FileSizes.FileSize.QuadPart / VACB_MAPPING_GRANULARITY);
+
+    /* Get a view of the whole file in the cache */
+    for (View = 0; View < Views; View++)
+    {
+        if (!MapAndCheckView(View))
+        {
+            ok(FALSE, "CcMapData failed for view %lu\n", View);
+            return;
+        }
+    }
+
+    /* Now that all the views exist, every map is a lookup */
+    Seed = TestId + 1;
+    KeQueryPerformanceCounter(&Frequency);
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; i < LOOKUP_ITERATIONS; i++)
+    {
+        View = RtlRandomEx(&Seed) % Views;
+        if (!MapAndCheckView(View))
+        {
+            ok(FALSE, "CcMapData failed for view %lu\n", View);
+            return;
+        }
+    }
+    End = KeQueryPerformanceCounter(NULL);
+
+    trace("%lu MB file, %lu views: %I64u ns per lookup\n",
+          TestFileSizes[TestId], Views,
+          (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / LOOKUP_ITERATIONS);
+}
+
+
+static
+VOID
+CleanupTest(
+    ULONG TestId,
+    PDEVICE_OBJECT DeviceObject)
+{
+    LARGE_INTEGER Zero = RTL_CONSTANT_LARGE_INTEGER(0LL);
+    CACHE_UNINITIALIZE_EVENT CacheUninitEvent;
+
+    ok_eq_pointer(TestDeviceObject, DeviceObject);
+    ok_eq_ulong(TestTestId, TestId);
+
+    if (!skip(TestFileObject != NULL, "No test FO\n"))
+    {
+        if (CcIsFileCached(TestFileObject))
+        {
+            KeInitializeEvent(&CacheUninitEvent.Event, NotificationEvent, FALSE);
+            CcUninitializeCacheMap(TestFileObject, &Zero, &CacheUninitEvent);
+            KeWaitForSingleObject(&CacheUninitEvent.Event, Executive, KernelMode, FALSE, NULL);
+        }
+
+        if (TestFileObject->FsContext != NULL)
+        {
+            ExFreePool(TestFileObject->FsContext);
+            TestFileObject->FsContext = NULL;
+            TestFileObject->SectionObjectPointer = NULL;
+        }
+
+        ObDereferenceObject(TestFileObject);
+    }
+
+    TestFileObject = NULL;
+    TestDeviceObject = NULL;
+    TestTestId = -1;
+}
+
+
+static
+NTSTATUS
+TestMessageHandler(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ ULONG ControlCode,
+    _In_opt_ PVOID Buffer,
+    _In_ SIZE_T InLength,
+    _Inout_ PSIZE_T OutLength)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    FsRtlEnterFileSystem();
+
+    switch (ControlCode)
+    {
+        case IOCTL_START_TEST:
+            ok_eq_ulong((ULONG)InLength, sizeof(ULONG));
+            PerformTest(*(PULONG)Buffer, DeviceObject);
+            break;
+
+        case IOCTL_FINISH_TEST:
+            ok_eq_ulong((ULONG)InLength, sizeof(ULONG));
+            CleanupTest(*(PULONG)Buffer, DeviceObject);
+            break;
+
+        default:
+            Status = STATUS_NOT_IMPLEMENTED;
+            break;
+    }
+
+    FsRtlExitFileSystem();
+
+    return Status;
+}
+
+static
+NTSTATUS
+TestIrpHandler(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ PIRP Irp,
+    _In_ PIO_STACK_LOCATION IoStack)
+{
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    DPRINT("IRP %x/%x\n", IoStack->MajorFunction, IoStack->MinorFunction);
+    ASSERT(IoStack->MajorFunction == IRP_MJ_READ);
+
+    FsRtlEnterFileSystem();
+
+    Status = STATUS_NOT_SUPPORTED;
+    Irp->IoStatus.Information = 0;
+
+    if (IoStack->MajorFunction == IRP_MJ_READ)
+    {
+        ULONG Length, Page;
+        PVOID Buffer;
+        LARGE_INTEGER Offset;
+
+        Offset = IoStack->Parameters.Read.ByteOffset;
+        Length = IoStack->Parameters.Read.Length;
+
+        ok_eq_pointer(DeviceObject, TestDeviceObject);
+        ok_eq_pointer(IoStack->FileObject, TestFileObject);
+        ok(Offset.QuadPart % PAGE_SIZE == 0, "Offset is not aligned: %I64i\n", Offset.QuadPart);
+        ok(Length % PAGE_SIZE == 0, "Length is not aligned: %lu\n", Length);
+
+        Buffer = MapAndLockUserBuffer(Irp, Length);
+        ok(Buffer != NULL, "Null pointer!\n");
+        if (Buffer != NULL)
+        {
+            RtlFillMemory(Buffer, Length, 0xBA);
+            for (Page = 0; Page < Length; Page += PAGE_SIZE)
+            {
+                *(PULONG)((ULONG_PTR)Buffer + Page) = Offset.LowPart + Page;
+            }
+
+            Status = STATUS_SUCCESS;
+            Irp->IoStatus.Information = Length;
+        }
+        else
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    Irp->IoStatus.Status = Status;
+    IoCompleteRequest(Irp, IO_NO_INCREMENT);
+
+    FsRtlExitFileSystem();
+
+    return Status;
+}
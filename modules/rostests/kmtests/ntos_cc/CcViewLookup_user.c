@@ -0,0 +1,33 @@
+/*
+ * PROJECT:     ReactOS kernel-mode tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Kernel-Mode Test Suite cache view lookup test user-mode part
+ */
+
+#include <kmt_test.h>
+
+#define IOCTL_START_TEST  1
+#define IOCTL_FINISH_TEST 2
+
+START_TEST(CcViewLookup)
+{
+    DWORD Ret;
+    ULONG TestId;
+
+    Ret = KmtLoadAndOpenDriver(L"CcViewLookup", FALSE);
+    ok_eq_int(Ret, ERROR_SUCCESS);
+    if (Ret)
+        return;
+
+    /* One test per file size: 1, 16, 64 and 256 MB */
+    for (TestId = 0; TestId < 4; ++TestId)
+    {
+        Ret = KmtSendUlongToDriver(IOCTL_START_TEST, TestId);
+        ok(Ret == ERROR_SUCCESS, "KmtSendUlongToDriver failed: %lx\n", Ret);
+        Ret = KmtSendUlongToDriver(IOCTL_FINISH_TEST, TestId);
+        ok(Ret == ERROR_SUCCESS, "KmtSendUlongToDriver failed: %lx\n", Ret);
+    }
+
+    KmtCloseDriver();
+    KmtUnloadDriver();
+}
@@ -0,0 +1,109 @@
+/*
+ * PROJECT:     ReactOS kernel-mode tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Kernel-Mode Test Suite generic call DPC test
+ */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define LATENCY_ITERATIONS 1000
+
+typedef struct _GENERIC_CALL_CONTEXT
+{
+    volatile LONG Calls[MAXIMUM_PROCESSORS];
+    volatile LONG Arrived;
+    volatile LONG Winners;
+    volatile LONG EarlyLeavers;
+    volatile LONG BadIrql;
+} GENERIC_CALL_CONTEXT, *PGENERIC_CALL_CONTEXT;
+
+static KDEFERRED_ROUTINE GenericCallRoutine;
+static KDEFERRED_ROUTINE EmptyCallRoutine;
+
+static
+VOID
+NTAPI
+GenericCallRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PGENERIC_CALL_CONTEXT Context = DeferredContext;
+    ULONG Processor = KeGetCurrentProcessorNumber();
+
+    UNREFERENCED_PARAMETER(Dpc);
+
+    if (KeGetCurrentIrql() != DISPATCH_LEVEL)
+        InterlockedIncrement(&Context->BadIrql);
+
+    if (Processor < MAXIMUM_PROCESSORS)
+        InterlockedIncrement(&Context->Calls[Processor]);
+
+    /* Nobody may leave the barrier before everybody arrived */
+    InterlockedIncrement(&Context->Arrived);
+    if (KeSignalCallDpcSynchronize(SystemArgument2))
+        InterlockedIncrement(&Context->Winners);
+    if (Context->Arrived != KeNumberProcessors)
+        InterlockedIncrement(&Context->EarlyLeavers);
+
+    /* The barrier must be usable again right away */
+    KeSignalCallDpcSynchronize(SystemArgument2);
+    KeSignalCallDpcDone(SystemArgument1);
+}
+
+static
+VOID
+NTAPI
+EmptyCallRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(DeferredContext);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    KeSignalCallDpcDone(SystemArgument1);
+}
+
+START_TEST(KeGenericCallDpc)
+{
+    PGENERIC_CALL_CONTEXT Context;
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Processors = KeNumberProcessors;
+    ULONG i;
+
+    Context = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Context), 'TmK');
+    if (skip(Context != NULL, "Out of memory\n"))
+        return;
+
+    RtlZeroMemory(Context, sizeof(*Context));
+    KeGenericCallDpc(GenericCallRoutine, Context);
+
+    /* Every processor ran the routine exactly once */
+    for (i = 0; i < min(Processors, MAXIMUM_PROCESSORS); i++)
+        ok(Context->Calls[i] == 1, "Processor %lu ran the routine %ld times\n", i, Context->Calls[i]);
+    ok_eq_long(Context->Arrived, (LONG)Processors);
+    ok_eq_long(Context->Winners, 1L);
+    ok_eq_long(Context->EarlyLeavers, 0L);
+    ok_eq_long(Context->BadIrql, 0L);
+    ok_irql(PASSIVE_LEVEL);
+
+    ExFreePoolWithTag(Context, 'TmK');
+
+    /* Fan-out latency */
+    KeQueryPerformanceCounter(&Frequency);
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; i < LATENCY_ITERATIONS; i++)
+        KeGenericCallDpc(EmptyCallRoutine, NULL);
+    End = KeQueryPerformanceCounter(NULL);
+
+    trace("%lu processors: %I64u ns per generic call\n",
+          Processors,
+          (End.QuadPart - Start.QuadPart) * 1000000000ULL / Frequency.QuadPart / LATENCY_ITERATIONS);
+}
@@ -0,0 +1,216 @@
+/*
+ * PROJECT:     ReactOS kernel-mode tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test for RtlCompressChunks / RtlDecompressChunks
+ */
+
+#include <kmt_test.h>
+#include <ndk/rtlfuncs.h>
+
+#define TEST_CHUNK_SHIFT    12
+#define TEST_CHUNK_SIZE     (1 << TEST_CHUNK_SHIFT)
+#define TEST_UNIT_SIZE      (64 * 1024)
+#define TEST_CHUNKS         (TEST_UNIT_SIZE / TEST_CHUNK_SIZE)
+#define TEST_ROUNDS         64
+#define TEST_TAG            'CCmK'
+
+typedef struct _TEST_DATA_INFO
+{
+    COMPRESSED_DATA_INFO Info;
+    ULONG MoreChunkSizes[TEST_CHUNKS - 1];
+} TEST_DATA_INFO;
+
+static
+VOID
+FillUnit(
+    _Out_ PUCHAR Buffer)
+{
+    static const CHAR Words[] = "compression units are made of independent chunks ";
+    ULONG Chunk, i, Seed = 0x2468ACE;
+
+    for (Chunk = 0; Chunk < TEST_CHUNKS; Chunk++)
+    {
+        for (i = 0; i < TEST_CHUNK_SIZE; i++)
+        {
+            Seed = Seed * 1103515245 + 12345;
+
+            /* Mix of text, zero and random chunks */
+            switch (Chunk % 4)
+            {
+                case 0:
+                case 1:
+                    Buffer[Chunk * TEST_CHUNK_SIZE + i] = Words[(i + Chunk) % (sizeof(Words) - 1)];
+                    break;
+                case 2:
+                    Buffer[Chunk * TEST_CHUNK_SIZE + i] = 0;
+                    break;
+                default:
+                    Buffer[Chunk * TEST_CHUNK_SIZE + i] = (UCHAR)(Seed >> 16);
+                    break;
+            }
+        }
+    }
+}
+
+static
+VOID
+TestDecompress(
+    _In_ PUCHAR Source,
+    _In_ PUCHAR Compressed,
+    _In_ ULONG CompressedSize,
+    _In_ TEST_DATA_INFO *DataInfo,
+    _Out_ PUCHAR Decompressed,
+    _In_ BOOLEAN Parallel)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    NTSTATUS Status = STATUS_UNSUCCESSFUL;
+    ULONG Round;
+
+    DataInfo->Info.Reserved = Parallel ? COMPRESSED_DATA_INFO_PARALLEL : 0;
+
+    Start = KeQueryPerformanceCounter(&Frequency);
+    for (Round = 0; Round < TEST_ROUNDS; Round++)
+    {
+        RtlFillMemory(Decompressed, TEST_UNIT_SIZE, 0x55);
+        Status = RtlDecompressChunks(Decompressed, TEST_UNIT_SIZE,
+                                     Compressed, CompressedSize,
+                                     NULL, 0,
+                                     &DataInfo->Info);
+    }
+    End = KeQueryPerformanceCounter(NULL);
+
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok(RtlCompareMemory(Source, Decompressed, TEST_UNIT_SIZE) == TEST_UNIT_SIZE,
+       "Unit doesn't survive the round trip (parallel %u)\n", Parallel);
+
+    trace("%s decompression: %I64u units/s\n",
+          Parallel ? "Parallel" : "Serial",
+          TEST_ROUNDS * Frequency.QuadPart / max(End.QuadPart - Start.QuadPart, 1));
+}
+
+static
+VOID
+TestTail(
+    _In_ PUCHAR Source,
+    _Inout_ PUCHAR Compressed,
+    _In_ ULONG CompressedSize,
+    _In_ TEST_DATA_INFO *DataInfo,
+    _Out_ PUCHAR Decompressed,
+    _In_ BOOLEAN Parallel)
+{
+    PUCHAR Tail;
+    ULONG Chunk, HeadSize = 0;
+    NTSTATUS Status;
+
+    /* Move everything past the middle chunk to a separate tail buffer. The
+       tail then starts inside what a parallel decompression gives one worker */
+    for (Chunk = 0; Chunk <= TEST_CHUNKS / 2; Chunk++)
+        HeadSize += DataInfo->Info.CompressedChunkSizes[Chunk];
+
+    Tail = ExAllocatePoolWithTag(NonPagedPool, CompressedSize - HeadSize, TEST_TAG);
+    if (skip(Tail != NULL, "Out of memory\n"))
+        return;
+
+    RtlCopyMemory(Tail, Compressed + HeadSize, CompressedSize - HeadSize);
+
+    /* Whatever follows the head in the buffer must not be used */
+    RtlFillMemory(Compressed + HeadSize, CompressedSize - HeadSize, 0xCC);
+
+    DataInfo->Info.Reserved = Parallel ? COMPRESSED_DATA_INFO_PARALLEL : 0;
+    RtlFillMemory(Decompressed, TEST_UNIT_SIZE, 0x55);
+    Status = RtlDecompressChunks(Decompressed, TEST_UNIT_SIZE,
+                                 Compressed, HeadSize,
+                                 Tail, CompressedSize - HeadSize,
+                                 &DataInfo->Info);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok(RtlCompareMemory(Source, Decompressed, TEST_UNIT_SIZE) == TEST_UNIT_SIZE,
+       "Unit with a tail doesn't survive the round trip (parallel %u)\n", Parallel);
+
+    /* Put the buffer back together for the next test */
+    RtlCopyMemory(Compressed + HeadSize, Tail, CompressedSize - HeadSize);
+    ExFreePoolWithTag(Tail, TEST_TAG);
+}
+
+START_TEST(RtlCompressChunks)
+{
+    PUCHAR Source, Compressed, Decompressed;
+    PVOID WorkSpace = NULL;
+    TEST_DATA_INFO DataInfo;
+    ULONG WorkSpaceSize, FragmentSize, Chunk, CompressedSize;
+    NTSTATUS Status;
+
+    Source = ExAllocatePoolWithTag(NonPagedPool, TEST_UNIT_SIZE, TEST_TAG);
+    Compressed = ExAllocatePoolWithTag(NonPagedPool, TEST_UNIT_SIZE, TEST_TAG);
+    Decompressed = ExAllocatePoolWithTag(NonPagedPool, TEST_UNIT_SIZE, TEST_TAG);
+    if (!skip(Source && Compressed && Decompressed, "Out of memory\n"))
+    {
+        Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1, &WorkSpaceSize, &FragmentSize);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+        WorkSpace = ExAllocatePoolWithTag(NonPagedPool, WorkSpaceSize, TEST_TAG);
+    }
+
+    if (!skip(WorkSpace != NULL, "Out of memory\n"))
+    {
+        FillUnit(Source);
+
+        RtlZeroMemory(&DataInfo, sizeof(DataInfo));
+        DataInfo.Info.CompressionFormatAndEngine = COMPRESSION_FORMAT_LZNT1;
+        DataInfo.Info.ChunkShift = TEST_CHUNK_SHIFT;
+
+        /* The chunk size array has to be large enough */
+        Status = RtlCompressChunks(Source, TEST_UNIT_SIZE, Compressed, TEST_UNIT_SIZE,
+                                   &DataInfo.Info, sizeof(COMPRESSED_DATA_INFO), WorkSpace);
+        ok_eq_hex(Status, STATUS_BUFFER_TOO_SMALL);
+
+        Status = RtlCompressChunks(Source, TEST_UNIT_SIZE, Compressed, TEST_UNIT_SIZE,
+                                   &DataInfo.Info, sizeof(DataInfo), WorkSpace);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+        ok_eq_uint(DataInfo.Info.NumberOfChunks, TEST_CHUNKS);
+
+        CompressedSize = 0;
+        for (Chunk = 0; Chunk < DataInfo.Info.NumberOfChunks; Chunk++)
+        {
+            switch (Chunk % 4)
+            {
+                case 2:
+                    ok(DataInfo.Info.CompressedChunkSizes[Chunk] == 0,
+                       "Zero chunk %lu takes %lu bytes\n", Chunk, DataInfo.Info.CompressedChunkSizes[Chunk]);
+                    break;
+                case 3:
+                    ok(DataInfo.Info.CompressedChunkSizes[Chunk] == TEST_CHUNK_SIZE,
+                       "Random chunk %lu takes %lu bytes\n", Chunk, DataInfo.Info.CompressedChunkSizes[Chunk]);
+                    break;
+                default:
+                    ok(DataInfo.Info.CompressedChunkSizes[Chunk] < TEST_CHUNK_SIZE / 4,
+                       "Text chunk %lu takes %lu bytes\n", Chunk, DataInfo.Info.CompressedChunkSizes[Chunk]);
+                    break;
+            }
+            CompressedSize += DataInfo.Info.CompressedChunkSizes[Chunk];
+        }
+
+        /* A truncated compressed buffer is caught */
+        Status = RtlDecompressChunks(Decompressed, TEST_UNIT_SIZE,
+                                     Compressed, CompressedSize - 1,
+                                     NULL, 0,
+                                     &DataInfo.Info);
+        ok_eq_hex(Status, STATUS_BAD_COMPRESSION_BUFFER);
+
+        TestDecompress(Source, Compressed, CompressedSize, &DataInfo, Decompressed, FALSE);
+        TestDecompress(Source, Compressed, CompressedSize, &DataInfo, Decompressed, TRUE);
+
+        /* The chunks that don't fit in the buffer are taken from the tail */
+        TestTail(Source, Compressed, CompressedSize, &DataInfo, Decompressed, FALSE);
+        TestTail(Source, Compressed, CompressedSize, &DataInfo, Decompressed, TRUE);
+
+        /* Too small an output buffer makes the caller store the unit uncompressed */
+        Status = RtlCompressChunks(Source, TEST_UNIT_SIZE, Compressed, CompressedSize - 1,
+                                   &DataInfo.Info, sizeof(DataInfo), WorkSpace);
+        ok_eq_hex(Status, STATUS_BUFFER_TOO_SMALL);
+
+        ExFreePoolWithTag(WorkSpace, TEST_TAG);
+    }
+
+    if (Decompressed) ExFreePoolWithTag(Decompressed, TEST_TAG);
+    if (Compressed) ExFreePoolWithTag(Compressed, TEST_TAG);
+    if (Source) ExFreePoolWithTag(Source, TEST_TAG);
+}
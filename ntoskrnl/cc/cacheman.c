@@ -20,6 +20,14 @@ MM_SYSTEMSIZE CcCapturedSystemSize;
 
 static ULONG BugCheckFileId = 0x4 << 16;
 
+/* Counters:
+ * - Number of read ahead I/Os issued
+ * - Reads which found their data already read ahead, and the ones which didn't
+ */
+ULONG CcReadAheadIos = 0;
+ULONG CcReadAheadHits = 0;
+ULONG CcReadAheadMisses = 0;
+
 /* FUNCTIONS *****************************************************************/
 
 CODE_SEG("INIT")
@@ -149,8 +157,285 @@ CcRemapBcb (
     return 0;
 }
 
+static
+PROS_READ_AHEAD_STREAM
+CcpFindReadAheadStream(
+    IN PROS_PRIVATE_CACHE_MAP PrivateMap,
+    IN LONGLONG FileOffset,
+    IN LONGLONG BeyondLastByte)
+{
+    PROS_READ_AHEAD_STREAM Stream, Closest = NULL, Free = NULL, Oldest = NULL;
+    LONGLONG Delta, ClosestDelta = READ_AHEAD_MAX_STRIDE;
+    ULONG i;
+
+    for (i = 0; i < READ_AHEAD_STREAMS; i++)
+    {
+        Stream = &PrivateMap->Streams[i];
+        if (Stream->LastUse == 0)
+        {
+            if (Free == NULL)
+                Free = Stream;
+            continue;
+        }
+
+        /* Data we read ahead for it, or the continuation of its last read */
+        if ((FileOffset >= Stream->ReadAheadOffset && BeyondLastByte <= Stream->ReadAheadEnd) ||
+            (FileOffset >= Stream->FileOffset && FileOffset <= Stream->BeyondLastByte))
+        {
+            return Stream;
+        }
+
+        /* Or exactly where its stride says the next read goes */
+        Delta = FileOffset - Stream->FileOffset;
+        if (Stream->Confidence != 0 && Stream->Stride != 0 && Delta == Stream->Stride)
+            return Stream;
+
+        /* A stream that has yet to settle on a stride may still take this
+         * read as its next one, but only if there's no room for a new
+         * stream, so that interleaved readers keep to their own streams
+         */
+        if (Stream->Confidence < 2)
+        {
+            if (Delta < 0)
+                Delta = -Delta;
+            if (Delta < ClosestDelta)
+            {
+                ClosestDelta = Delta;
+                Closest = Stream;
+            }
+        }
+
+        if (Oldest == NULL || Stream->LastUse < Oldest->LastUse)
+            Oldest = Stream;
+    }
+
+    if (Free != NULL)
+        return Free;
+
+    if (Closest != NULL)
+        return Closest;
+
+    /* A new stream, recycle the least recently used one */
+    RtlZeroMemory(Oldest, sizeof(*Oldest));
+    return Oldest;
+}
+
+static
+VOID
+CcpUpdateReadAheadStream(
+    IN PROS_PRIVATE_CACHE_MAP PrivateMap,
+    IN PROS_READ_AHEAD_STREAM Stream,
+    IN LONGLONG FileOffset,
+    IN ULONG Length)
+{
+    LONGLONG BeyondLastByte = FileOffset + Length;
+    READ_AHEAD_PATTERN Pattern;
+    LONGLONG Delta;
+
+    if (Stream->LastUse != 0)
+    {
+        /* Did we guess right? Open the window when the reads catch up with
+         * what was read ahead, and close it down when we read for nothing
+         */
+        if (FileOffset >= Stream->ReadAheadOffset && BeyondLastByte <= Stream->ReadAheadEnd)
+        {
+            PrivateMap->ReadAheadHits++;
+            CcReadAheadHits++;
+
+            if (Stream->Pattern == ReadAheadReverse ?
+                FileOffset - Stream->ReadAheadOffset < Stream->ReadAheadEnd - BeyondLastByte :
+                Stream->ReadAheadEnd - BeyondLastByte < FileOffset - Stream->ReadAheadOffset)
+            {
+                Stream->Window = min(Stream->Window * 2, READ_AHEAD_MAX_WINDOW);
+            }
+        }
+        else if (Stream->ReadAheadEnd != Stream->ReadAheadOffset)
+        {
+            PrivateMap->ReadAheadMisses++;
+            CcReadAheadMisses++;
+
+            if (FileOffset <= Stream->ReadAheadEnd && BeyondLastByte >= Stream->ReadAheadOffset)
+            {
+                /* Right guess, but the reads overran what was read ahead */
+                Stream->Window = min(Stream->Window * 2, READ_AHEAD_MAX_WINDOW);
+            }
+            else
+            {
+                /* Wrong guess, read ahead less until the stream settles */
+                Stream->Window = min(max(Stream->Window / 2, Length), READ_AHEAD_MAX_WINDOW);
+                Stream->ReadAheadOffset = Stream->ReadAheadEnd = 0;
+            }
+        }
+
+        /* Classify this read against the previous one */
+        Delta = FileOffset - Stream->FileOffset;
+        if (FileOffset >= Stream->FileOffset && FileOffset <= Stream->BeyondLastByte)
+            Pattern = ReadAheadForward;
+        else if (Delta < 0 && BeyondLastByte >= Stream->FileOffset - (LONGLONG)Length)
+            Pattern = ReadAheadReverse;
+        else
+            Pattern = ReadAheadStrided;
+
+        if (Pattern == Stream->Pattern && (Pattern != ReadAheadStrided || Delta == Stream->Stride))
+        {
+            Stream->Confidence++;
+        }
+        else
+        {
+            Stream->Pattern = Pattern;
+            Stream->Confidence = 1;
+        }
+        Stream->Stride = Delta;
+    }
+    else
+    {
+        /* The handle says it's sequential, take its word for it */
+        Stream->Pattern = BooleanFlagOn(PrivateMap->PrivateCacheMap.FileObject->Flags, FO_SEQUENTIAL_ONLY) ?
+                          ReadAheadForward : ReadAheadUnknown;
+        Stream->Confidence = (Stream->Pattern != ReadAheadUnknown);
+        Stream->Stride = 0;
+        Stream->Window = min(Length, READ_AHEAD_MAX_WINDOW / 2) * 2;
+    }
+
+    Stream->FileOffset = FileOffset;
+    Stream->BeyondLastByte = BeyondLastByte;
+    Stream->LastUse = ++PrivateMap->StreamClock;
+}
+
+static
+VOID
+CcpQueueReadAhead(
+    IN PPRIVATE_CACHE_MAP PrivateMap,
+    IN LONGLONG FileOffset,
+    IN ULONG Length)
+{
+    ULONG Entry;
+
+    /* Two ranges may wait for the read ahead worker, so that interleaved
+     * streams don't keep replacing each other. If both are taken, the
+     * oldest one goes.
+     */
+    if (PrivateMap->ReadAheadLength[1] == 0)
+    {
+        Entry = 1;
+    }
+    else
+    {
+        if (PrivateMap->ReadAheadLength[0] != 0)
+        {
+            PrivateMap->ReadAheadOffset[1] = PrivateMap->ReadAheadOffset[0];
+            PrivateMap->ReadAheadLength[1] = PrivateMap->ReadAheadLength[0];
+        }
+        Entry = 0;
+    }
+
+    PrivateMap->ReadAheadOffset[Entry].QuadPart = FileOffset;
+    PrivateMap->ReadAheadLength[Entry] = Length;
+}
+
+/* Queues what to read ahead for the stream, returns FALSE if nothing */
+static
+BOOLEAN
+CcpComputeReadAhead(
+    IN PROS_PRIVATE_CACHE_MAP PrivateMap,
+    IN PROS_READ_AHEAD_STREAM Stream,
+    IN ULONG Length)
+{
+    BOOLEAN ReadAhead = (Stream->ReadAheadEnd != Stream->ReadAheadOffset);
+    LONGLONG Start, End, Stride, Next;
+
+    switch (Stream->Pattern)
+    {
+        case ReadAheadForward:
+            /* Don't bother while more than half of the window is still ahead */
+            if (ReadAhead && Stream->ReadAheadEnd - Stream->BeyondLastByte >= Stream->Window / 2)
+                return FALSE;
+
+            Start = ReadAhead ? max(Stream->BeyondLastByte, Stream->ReadAheadEnd) : Stream->BeyondLastByte;
+            End = Stream->BeyondLastByte + Stream->Window;
+            break;
+
+        case ReadAheadReverse:
+            /* Going down the file takes one more read to be sure of */
+            if (Stream->Confidence < 2)
+                return FALSE;
+            if (ReadAhead && Stream->FileOffset - Stream->ReadAheadOffset >= Stream->Window / 2)
+                return FALSE;
+
+            Start = max(Stream->FileOffset - (LONGLONG)Stream->Window, 0);
+            End = ReadAhead ? min(Stream->FileOffset, Stream->ReadAheadOffset) : Stream->FileOffset;
+            break;
+
+        case ReadAheadStrided:
+            Stride = Stream->Stride;
+            if (Stream->Confidence < 2 || Stride > READ_AHEAD_MAX_STRIDE || Stride < -READ_AHEAD_MAX_STRIDE)
+                return FALSE;
+
+            if ((Stride > 0 ? Stride : -Stride) > 2 * (LONGLONG)Length)
+            {
+                /* Records are far apart, only read the next two of them */
+                Next = Stream->FileOffset + Stride;
+                if (Next < 0)
+                    return FALSE;
+
+                CcpQueueReadAhead(&PrivateMap->PrivateCacheMap, Next, Length);
+                Start = End = Next;
+                if (Next + Stride >= 0)
+                {
+                    CcpQueueReadAhead(&PrivateMap->PrivateCacheMap, Next + Stride, Length);
+                    Start = min(Next, Next + Stride);
+                    End = max(Next, Next + Stride);
+                }
+
+                Stream->ReadAheadOffset = Start;
+                Stream->ReadAheadEnd = End + Length;
+                return TRUE;
+            }
+
+            /* Records are close to each other, read the whole span */
+            if (Stride > 0)
+            {
+                if (ReadAhead && Stream->ReadAheadEnd - Stream->BeyondLastByte >= Stream->Window / 2)
+                    return FALSE;
+
+                Start = ReadAhead ? max(Stream->BeyondLastByte, Stream->ReadAheadEnd) : Stream->BeyondLastByte;
+                End = Stream->BeyondLastByte + Stream->Window;
+            }
+            else
+            {
+                if (ReadAhead && Stream->FileOffset - Stream->ReadAheadOffset >= Stream->Window / 2)
+                    return FALSE;
+
+                Start = max(Stream->FileOffset - (LONGLONG)Stream->Window, 0);
+                End = ReadAhead ? min(Stream->FileOffset, Stream->ReadAheadOffset) : Stream->FileOffset;
+            }
+            break;
+
+        default:
+            return FALSE;
+    }
+
+    if (End <= Start)
+        return FALSE;
+
+    CcpQueueReadAhead(&PrivateMap->PrivateCacheMap, Start, (ULONG)(End - Start));
+
+    if (ReadAhead)
+    {
+        Stream->ReadAheadOffset = min(Stream->ReadAheadOffset, Start);
+        Stream->ReadAheadEnd = max(Stream->ReadAheadEnd, End);
+    }
+    else
+    {
+        Stream->ReadAheadOffset = Start;
+        Stream->ReadAheadEnd = End;
+    }
+
+    return TRUE;
+}
+
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
@@ -161,73 +446,55 @@ CcScheduleReadAhead (
 	)
 {
     KIRQL OldIrql;
-    LARGE_INTEGER NewOffset;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
-    PPRIVATE_CACHE_MAP PrivateCacheMap;
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
+    PROS_READ_AHEAD_STREAM Stream;
 
     SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
     PrivateCacheMap = FileObject->PrivateCacheMap;
 
     /* If file isn't cached, or if read ahead is disabled, this is no op */
     if (SharedCacheMap == NULL || PrivateCacheMap == NULL ||
-        BooleanFlagOn(SharedCacheMap->Flags, READAHEAD_DISABLED))
+        BooleanFlagOn(SharedCacheMap->Flags, READAHEAD_DISABLED) || Length == 0)
     {
         return;
     }
 
     /* Round read length with read ahead mask */
-    Length = ROUND_UP(Length, PrivateCacheMap->ReadAheadMask + 1);
-    /* Compute the offset we'll reach */
-    NewOffset.QuadPart = FileOffset->QuadPart + Length;
+    Length = ROUND_UP(Length, PrivateCacheMap->PrivateCacheMap.ReadAheadMask + 1);
 
     /* Lock read ahead spin lock */
-    KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
-    /* Easy case: the file is sequentially read */
-    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY))
+    KeAcquireSpinLock(&PrivateCacheMap->PrivateCacheMap.ReadAheadSpinLock, &OldIrql);
+
+    /* Find out which of the streams read from this handle this read belongs to,
+     * and how it moves through the file
+     */
+    Stream = CcpFindReadAheadStream(PrivateCacheMap, FileOffset->QuadPart, FileOffset->QuadPart + Length);
+    CcpUpdateReadAheadStream(PrivateCacheMap, Stream, FileOffset->QuadPart, Length);
+
+    /* Keep the read history of the handle up to date */
+    PrivateCacheMap->PrivateCacheMap.FileOffset1 = PrivateCacheMap->PrivateCacheMap.FileOffset2;
+    PrivateCacheMap->PrivateCacheMap.BeyondLastByte1 = PrivateCacheMap->PrivateCacheMap.BeyondLastByte2;
+    PrivateCacheMap->PrivateCacheMap.FileOffset2.QuadPart = FileOffset->QuadPart;
+    PrivateCacheMap->PrivateCacheMap.BeyondLastByte2.QuadPart = FileOffset->QuadPart + Length;
+
+    /* Nothing to predict (yet) or we're already ahead enough */
+    if (!CcpComputeReadAhead(PrivateCacheMap, Stream, Length))
     {
-        /* If we went backward, this is no go! */
-        if (NewOffset.QuadPart < PrivateCacheMap->ReadAheadOffset[1].QuadPart)
-        {
-            KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            return;
-        }
-
-        /* FIXME: hackish, but will do the job for now */
-        PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-        PrivateCacheMap->ReadAheadLength[1] = Length;
-    }
-    /* Other cases: try to find some logic in that mess... */
-    else
-    {
-        /* Let's check if we always read the same way (like going down in the file)
-         * and pretend it's enough for now
-         */
-        if (PrivateCacheMap->FileOffset2.QuadPart >= PrivateCacheMap->FileOffset1.QuadPart &&
-            FileOffset->QuadPart >= PrivateCacheMap->FileOffset2.QuadPart)
-        {
-            /* FIXME: hackish, but will do the job for now */
-            PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-            PrivateCacheMap->ReadAheadLength[1] = Length;
-        }
-        else
-        {
-            /* FIXME: handle the other cases */
-            KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            UNIMPLEMENTED_ONCE;
-            return;
-        }
+        KeReleaseSpinLock(&PrivateCacheMap->PrivateCacheMap.ReadAheadSpinLock, OldIrql);
+        return;
     }
 
     /* If read ahead isn't active yet */
-    if (!PrivateCacheMap->Flags.ReadAheadActive)
+    if (!PrivateCacheMap->PrivateCacheMap.Flags.ReadAheadActive)
     {
         PWORK_QUEUE_ENTRY WorkItem;
 
         /* It's active now!
          * Be careful with the mask, you don't want to mess with node code
          */
-        InterlockedOr((volatile long *)&PrivateCacheMap->UlongFlags, PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
-        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        InterlockedOr((volatile long *)&PrivateCacheMap->PrivateCacheMap.UlongFlags, PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
+        KeReleaseSpinLock(&PrivateCacheMap->PrivateCacheMap.ReadAheadSpinLock, OldIrql);
 
         /* Get a work item */
         WorkItem = ExAllocateFromNPagedLookasideList(&CcTwilightLookasideList);
@@ -247,12 +514,12 @@ CcScheduleReadAhead (
         }
 
         /* Fail path: lock again, and revert read ahead active */
-        KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
-        InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
+        KeAcquireSpinLock(&PrivateCacheMap->PrivateCacheMap.ReadAheadSpinLock, &OldIrql);
+        InterlockedAnd((volatile long *)&PrivateCacheMap->PrivateCacheMap.UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
     }
 
-    /* Done (fail) */
-    KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+    /* Done (either the running read ahead picks up the new range, or fail) */
+    KeReleaseSpinLock(&PrivateCacheMap->PrivateCacheMap.ReadAheadSpinLock, OldIrql);
 }
 
 /*
@@ -39,9 +39,11 @@ ULONG CcFastReadResourceMiss;
 /* Counters:
  * - Amount of pages flushed to the disk
  * - Number of flush operations
+ * - Number of writes CcCanIWrite refused or deferred
  */
 ULONG CcDataPages = 0;
 ULONG CcDataFlushes = 0;
+ULONG CcThrottledWrites = 0;
 
 /* FUNCTIONS *****************************************************************/
 
@@ -126,70 +128,30 @@ CcPostDeferredWrites(VOID)
     }
 }
 
-VOID
-CcPerformReadAhead(
-    IN PFILE_OBJECT FileObject)
+static
+BOOLEAN
+CcpReadAheadRange(
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN LONGLONG CurrentOffset,
+    IN ULONG Length)
 {
     NTSTATUS Status;
-    LONGLONG CurrentOffset;
-    KIRQL OldIrql;
-    PROS_SHARED_CACHE_MAP SharedCacheMap;
     PROS_VACB Vacb;
     ULONG PartialLength;
-    ULONG Length;
-    PPRIVATE_CACHE_MAP PrivateCacheMap;
-    BOOLEAN Locked;
     BOOLEAN Success;
 
-    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
-
-    /* Critical:
-     * PrivateCacheMap might disappear in-between if the handle
-     * to the file is closed (private is attached to the handle not to
-     * the file), so we need to lock the master lock while we deal with
-     * it. It won't disappear without attempting to lock such lock.
-     */
-    OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    PrivateCacheMap = FileObject->PrivateCacheMap;
-    /* If the handle was closed since the read ahead was scheduled, just quit */
-    if (PrivateCacheMap == NULL)
-    {
-        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
-        ObDereferenceObject(FileObject);
-        return;
-    }
-    /* Otherwise, extract read offset and length and release private map */
-    else
-    {
-        KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
-        CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
-        Length = PrivateCacheMap->ReadAheadLength[1];
-        KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
-    }
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
-
-    /* Time to go! */
-    DPRINT("Doing ReadAhead for %p\n", FileObject);
-    /* Lock the file, first */
-    if (!SharedCacheMap->Callbacks->AcquireForReadAhead(SharedCacheMap->LazyWriteContext, FALSE))
-    {
-        Locked = FALSE;
-        goto Clear;
-    }
-
-    /* Remember it's locked */
-    Locked = TRUE;
-
     /* Don't read past the end of the file */
     if (CurrentOffset >= SharedCacheMap->FileSize.QuadPart)
     {
-        goto Clear;
+        return TRUE;
     }
     if (CurrentOffset + Length > SharedCacheMap->FileSize.QuadPart)
     {
         Length = SharedCacheMap->FileSize.QuadPart - CurrentOffset;
     }
 
+    ++CcReadAheadIos;
+
     /* Next of the algorithm will lock like CcCopyData with the slight
      * difference that we don't copy data back to an user-backed buffer
      * We just bring data into Cc
@@ -204,7 +166,7 @@ CcPerformReadAhead(
         if (!NT_SUCCESS(Status))
         {
             DPRINT1("Failed to request VACB: %lx!\n", Status);
-            goto Clear;
+            return FALSE;
         }
 
         _SEH2_TRY
@@ -222,7 +184,7 @@ CcPerformReadAhead(
         {
             CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE);
             DPRINT1("Failed to read data: %lx!\n", Status);
-            goto Clear;
+            return FALSE;
         }
 
         CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE);
@@ -241,7 +203,7 @@ CcPerformReadAhead(
         if (!NT_SUCCESS(Status))
         {
             DPRINT1("Failed to request VACB: %lx!\n", Status);
-            goto Clear;
+            return FALSE;
         }
 
         _SEH2_TRY
@@ -258,7 +220,7 @@ CcPerformReadAhead(
         {
             CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE);
             DPRINT1("Failed to read data: %lx!\n", Status);
-            goto Clear;
+            return FALSE;
         }
 
         CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE);
@@ -267,6 +229,82 @@ CcPerformReadAhead(
         CurrentOffset += PartialLength;
     }
 
+    return TRUE;
+}
+
+VOID
+CcPerformReadAhead(
+    IN PFILE_OBJECT FileObject)
+{
+    LONGLONG CurrentOffset;
+    KIRQL OldIrql;
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    ULONG Length;
+    ULONG Entry;
+    PPRIVATE_CACHE_MAP PrivateCacheMap;
+    BOOLEAN Locked = FALSE;
+
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+
+    /* Keep going as long as reads queue new ranges for us */
+    while (TRUE)
+    {
+        /* Critical:
+         * PrivateCacheMap might disappear in-between if the handle
+         * to the file is closed (private is attached to the handle not to
+         * the file), so we need to lock the master lock while we deal with
+         * it. It won't disappear without attempting to lock such lock.
+         */
+        OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+        PrivateCacheMap = FileObject->PrivateCacheMap;
+        /* If the handle was closed since the read ahead was scheduled, just quit */
+        if (PrivateCacheMap == NULL)
+        {
+            KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+            goto Done;
+        }
+
+        /* Otherwise, take the oldest range queued and release private map.
+         * If there is none left, we're done and no longer active, so that
+         * the next read queues us again.
+         */
+        KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+        Entry = (PrivateCacheMap->ReadAheadLength[1] != 0) ? 1 : 0;
+        CurrentOffset = PrivateCacheMap->ReadAheadOffset[Entry].QuadPart;
+        Length = PrivateCacheMap->ReadAheadLength[Entry];
+        PrivateCacheMap->ReadAheadLength[Entry] = 0;
+        if (Length == 0)
+        {
+            InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
+        }
+        KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+
+        if (Length == 0)
+        {
+            goto Done;
+        }
+
+        /* Time to go! */
+        DPRINT("Doing ReadAhead for %p\n", FileObject);
+        /* Lock the file, first */
+        if (!Locked)
+        {
+            if (!SharedCacheMap->Callbacks->AcquireForReadAhead(SharedCacheMap->LazyWriteContext, FALSE))
+            {
+                goto Clear;
+            }
+
+            /* Remember it's locked */
+            Locked = TRUE;
+        }
+
+        if (!CcpReadAheadRange(SharedCacheMap, CurrentOffset, Length))
+        {
+            goto Clear;
+        }
+    }
+
 Clear:
     /* See previous comment about private cache map */
     OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
@@ -280,6 +318,7 @@ Clear:
     }
     KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
 
+Done:
     /* If file was locked, release it */
     if (Locked)
     {
@@ -392,6 +431,12 @@ CcCanIWrite (
         return TRUE;
     }
 
+    /* Count each write only once, not on every retry */
+    if (TryContext == FirstTry)
+    {
+        InterlockedIncrement((PLONG)&CcThrottledWrites);
+    }
+
     /* If we can wait, we'll start the wait loop for waiting till we can
      * write for real
      */
@@ -559,28 +604,11 @@ CcCopyRead (
     IoStatus->Status = STATUS_SUCCESS;
     IoStatus->Information = ReadLength;
 
-#if 0
-    /* If that was a successful sync read operation, let's handle read ahead */
-    if (Length == 0 && Wait)
+    /* Let read ahead follow the way the file is being read */
+    if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS))
     {
-        PPRIVATE_CACHE_MAP PrivateCacheMap = FileObject->PrivateCacheMap;
-
-        /* If file isn't random access and next read may get us cross VACB boundary,
-         * schedule next read
-         */
-        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS) &&
-            (CurrentOffset - 1) / VACB_MAPPING_GRANULARITY != (CurrentOffset + ReadLength - 1) / VACB_MAPPING_GRANULARITY)
-        {
-            CcScheduleReadAhead(FileObject, FileOffset, ReadLength);
-        }
-
-        /* And update read history in private cache map */
-        PrivateCacheMap->FileOffset1.QuadPart = PrivateCacheMap->FileOffset2.QuadPart;
-        PrivateCacheMap->BeyondLastByte1.QuadPart = PrivateCacheMap->BeyondLastByte2.QuadPart;
-        PrivateCacheMap->FileOffset2.QuadPart = FileOffset->QuadPart;
-        PrivateCacheMap->BeyondLastByte2.QuadPart = FileOffset->QuadPart + ReadLength;
+        CcScheduleReadAhead(FileObject, FileOffset, ReadLength);
     }
-#endif
 
     return TRUE;
 }
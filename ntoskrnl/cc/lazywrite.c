@@ -13,12 +13,31 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Maximum number of write behind operations in flight for a single device */
+#define CC_MAX_WRITE_BEHIND_PER_DEVICE 2
+/* Number of devices we can track write behind operations for */
+#define CC_MAX_WRITE_BEHIND_DEVICES 16
+
+typedef struct _CC_WRITE_BEHIND_DEVICE
+{
+    PDEVICE_OBJECT DeviceObject;
+    ULONG ActiveWrites;
+} CC_WRITE_BEHIND_DEVICE, *PCC_WRITE_BEHIND_DEVICE;
+
 /* Counters:
  * - Amount of pages flushed by lazy writer
- * - Number of times lazy writer ran
+ * - Number of writes issued by lazy writer
+ * - Amount of pages flushed by lazy writer since its previous scan
+ * - Number of files whose write behind was postponed because their device was busy
  */
 ULONG CcLazyWritePages = 0;
 ULONG CcLazyWriteIos = 0;
+ULONG CcLazyWriteRate = 0;
+ULONG CcLazyWriteThrottled = 0;
+
+/* Write behind operations in flight per device, protected by the master lock */
+static CC_WRITE_BEHIND_DEVICE CcWriteBehindDevices[CC_MAX_WRITE_BEHIND_DEVICES];
+static ULONG CcLazyWritePagesAtLastScan = 0;
 
 /* Internal vars (MS):
  * - Lazy writer status structure
@@ -113,24 +132,79 @@ CcScanDpc(
     CcPostWorkQueue(WorkItem, &CcRegularWorkQueue);
 }
 
+static
+PCC_WRITE_BEHIND_DEVICE
+CcpGetWriteBehindDevice(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ BOOLEAN Allocate)
+{
+    PCC_WRITE_BEHIND_DEVICE FreeEntry = NULL;
+    ULONG i;
+
+    for (i = 0; i < CC_MAX_WRITE_BEHIND_DEVICES; i++)
+    {
+        if (CcWriteBehindDevices[i].ActiveWrites == 0)
+        {
+            if (FreeEntry == NULL)
+                FreeEntry = &CcWriteBehindDevices[i];
+        }
+        else if (CcWriteBehindDevices[i].DeviceObject == DeviceObject)
+        {
+            return &CcWriteBehindDevices[i];
+        }
+    }
+
+    if (!Allocate || FreeEntry == NULL)
+        return NULL;
+
+    FreeEntry->DeviceObject = DeviceObject;
+    return FreeEntry;
+}
+
 VOID
-CcWriteBehind(VOID)
+CcWriteBehind(
+    _In_ PROS_SHARED_CACHE_MAP SharedCacheMap,
+    _In_ ULONG Target)
 {
-    ULONG Target, Count;
+    PCC_WRITE_BEHIND_DEVICE Device;
+    NTSTATUS Status;
+    ULONG Count = 0, Runs = 0;
+    KIRQL OldIrql;
 
-    Target = CcTotalDirtyPages / 8;
-    if (Target != 0)
+    /* The scan already marked the map as being lazy written and referenced it for us */
+    if (SharedCacheMap->Callbacks->AcquireForLazyWrite(SharedCacheMap->LazyWriteContext, FALSE))
     {
         /* Flush! */
-        DPRINT("Lazy writer starting (%d)\n", Target);
-        CcRosFlushDirtyPages(Target, &Count, FALSE, TRUE);
+        DPRINT("Lazy writer starting (%p, %lu)\n", SharedCacheMap, Target);
+        Status = CcRosFlushDirtyRuns(SharedCacheMap, Target, &Count, &Runs);
+        if (!NT_SUCCESS(Status) && (Status != STATUS_END_OF_FILE) &&
+            (Status != STATUS_MEDIA_WRITE_PROTECTED))
+        {
+            DPRINT1("CC: Failed to write behind %p: 0x%08lx\n", SharedCacheMap, Status);
+        }
 
-        /* And update stats */
-        CcLazyWritePages += Count;
-        ++CcLazyWriteIos;
-        DPRINT("Lazy writer done (%d)\n", Count);
+        SharedCacheMap->Callbacks->ReleaseFromLazyWrite(SharedCacheMap->LazyWriteContext);
+        DPRINT("Lazy writer done (%lu pages, %lu runs)\n", Count, Runs);
     }
 
+    OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+
+    /* And update stats */
+    CcLazyWritePages += Count;
+    CcLazyWriteIos += Runs;
+
+    Device = CcpGetWriteBehindDevice(IoGetRelatedDeviceObject(SharedCacheMap->FileObject), FALSE);
+    ASSERT(Device != NULL);
+    if (Device != NULL)
+        Device->ActiveWrites--;
+
+    SharedCacheMap->Flags &= ~SHARED_CACHE_MAP_IN_LAZYWRITE;
+
+    if (--SharedCacheMap->OpenCount == 0)
+        CcRosDeleteFileCache(SharedCacheMap->FileObject, SharedCacheMap, &OldIrql);
+
+    KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+
     /* Make sure we're not throttling writes after this */
     while (MmAvailablePages < MmThrottleTop)
     {
@@ -142,6 +216,75 @@ CcWriteBehind(VOID)
     }
 }
 
+static
+VOID
+CcpQueueWriteBehind(
+    _In_ ULONG Target,
+    _Inout_ PLIST_ENTRY ToPost)
+{
+    PLIST_ENTRY ListEntry;
+    PWORK_QUEUE_ENTRY WorkItem;
+    ULONG Queued = 0;
+    KIRQL OldIrql;
+
+    OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+
+    /* Pick the files to write behind, one work item per file so that
+     * they get written in parallel by the worker threads. Each of them
+     * is flushed in offset order by CcRosFlushDirtyRuns. */
+    for (ListEntry = DirtyVacbListHead.Flink;
+         (ListEntry != &DirtyVacbListHead) && (Target > 0) && (Queued < CcNumberWorkerThreads);
+         ListEntry = ListEntry->Flink)
+    {
+        PROS_VACB Vacb = CONTAINING_RECORD(ListEntry, ROS_VACB, DirtyVacbListEntry);
+        PROS_SHARED_CACHE_MAP SharedCacheMap = Vacb->SharedCacheMap;
+        PCC_WRITE_BEHIND_DEVICE Device;
+        ULONG FileTarget;
+
+        /* Don't handle temporary files */
+        if (BooleanFlagOn(SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE))
+            continue;
+
+        /* Don't attempt to lazy write the files that asked not to */
+        if (BooleanFlagOn(SharedCacheMap->Flags, WRITEBEHIND_DISABLED))
+            continue;
+
+        /* Do not lazy-write the same file concurrently. Fastfat ASSERTS on that.
+         * This also skips the files we already queued during this scan. */
+        if (BooleanFlagOn(SharedCacheMap->Flags, SHARED_CACHE_MAP_IN_LAZYWRITE))
+            continue;
+
+        /* Don't flood a device with writes, leave this file for the next scan */
+        Device = CcpGetWriteBehindDevice(IoGetRelatedDeviceObject(SharedCacheMap->FileObject), TRUE);
+        if (Device == NULL || Device->ActiveWrites >= CC_MAX_WRITE_BEHIND_PER_DEVICE)
+        {
+            CcLazyWriteThrottled++;
+            continue;
+        }
+
+        WorkItem = ExAllocateFromNPagedLookasideList(&CcTwilightLookasideList);
+        if (WorkItem == NULL)
+            break;
+
+        FileTarget = min(SharedCacheMap->DirtyPages, Target);
+        Target -= FileTarget;
+
+        Device->ActiveWrites++;
+        SharedCacheMap->Flags |= SHARED_CACHE_MAP_IN_LAZYWRITE;
+
+        /* Keep a ref on the shared cache map, CcWriteBehind drops it */
+        SharedCacheMap->OpenCount++;
+
+        WorkItem->Function = WriteBehind;
+        WorkItem->Parameters.Write.SharedCacheMap = (PVOID)SharedCacheMap;
+        WorkItem->Parameters.Write.Target = FileTarget;
+        InsertTailList(ToPost, &WorkItem->WorkQueueLinks);
+        Queued++;
+    }
+
+    KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+}
+
 VOID
 CcLazyWriteScan(VOID)
 {
@@ -164,20 +307,37 @@ CcLazyWriteScan(VOID)
         }
         LazyWriter.OtherWork = FALSE;
     }
+
+    /* Flush rate since the previous scan */
+    CcLazyWriteRate = CcLazyWritePages - CcLazyWritePagesAtLastScan;
+    CcLazyWritePagesAtLastScan = CcLazyWritePages;
     KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
 
-    /* Our target is one-eighth of the dirty pages */
+    /* Our target is one-eighth of the dirty pages. If writers are already
+     * waiting in CcCanIWrite, go for half of them to get them going again. */
     Target = CcTotalDirtyPages / 8;
+    if (!IsListEmpty(&CcDeferredWrites))
+    {
+        Target = CcTotalDirtyPages / 2;
+    }
+
     if (Target != 0)
     {
-        /* There is stuff to flush, schedule a write-behind operation */
+        /* There is stuff to flush, schedule write-behind operations.
+         * Post them before the items that were due for end of run. */
+        LIST_ENTRY PostTick;
 
-        /* Allocate a work item */
-        WorkItem = ExAllocateFromNPagedLookasideList(&CcTwilightLookasideList);
-        if (WorkItem != NULL)
+        InitializeListHead(&PostTick);
+        while (!IsListEmpty(&ToPost))
+        {
+            InsertTailList(&PostTick, RemoveHeadList(&ToPost));
+        }
+
+        CcpQueueWriteBehind(Target, &ToPost);
+
+        while (!IsListEmpty(&PostTick))
         {
-            WorkItem->Function = WriteBehind;
-            CcPostWorkQueue(WorkItem, &CcRegularWorkQueue);
+            InsertTailList(&ToPost, RemoveHeadList(&PostTick));
         }
     }
 
@@ -318,7 +478,8 @@ CcWorkerThread(
 
             case WriteBehind:
                 PsGetCurrentThread()->MemoryMaker = 1;
-                CcWriteBehind();
+                CcWriteBehind((PROS_SHARED_CACHE_MAP)WorkItem->Parameters.Write.SharedCacheMap,
+                              WorkItem->Parameters.Write.Target);
                 PsGetCurrentThread()->MemoryMaker = 0;
                 WritePerformed = TRUE;
                 break;
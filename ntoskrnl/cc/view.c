@@ -36,6 +36,9 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Maximum number of adjacent dirty VACBs written back with a single flush */
+#define CC_MAX_FLUSH_RUN_VACBS 16
+
 /* GLOBALS *******************************************************************/
 
 LIST_ENTRY DirtyVacbListHead;
@@ -109,6 +112,289 @@ ULONG CcRosVacbGetRefCount_(PROS_VACB vacb, PCSTR file, INT line)
 
 /* FUNCTIONS *****************************************************************/
 
+static
+PROS_VACB_LEVEL
+CcRosAllocateVacbLevel(VOID)
+{
+    PROS_VACB_LEVEL Level;
+
+    Level = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Level), TAG_VACB_LEVEL);
+    if (Level != NULL)
+    {
+        RtlZeroMemory(Level, sizeof(*Level));
+    }
+
+    return Level;
+}
+
+static
+VOID
+CcRosFreeVacbLevels(
+    PROS_VACB_LEVEL Level,
+    ULONG Depth)
+{
+    ULONG i;
+
+    if (Depth > 1)
+    {
+        for (i = 0; i < VACB_LEVEL_ENTRIES; i++)
+        {
+            if (Level->Entries[i] != NULL)
+                CcRosFreeVacbLevels(Level->Entries[i], Depth - 1);
+        }
+    }
+
+    ExFreePoolWithTag(Level, TAG_VACB_LEVEL);
+}
+
+/* Must be called with the cache map lock held */
+static
+PROS_VACB
+CcRosFindVacbInArray(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+{
+    ULONGLONG View = (ULONGLONG)FileOffset >> VACB_OFFSET_SHIFT;
+    PROS_VACB_LEVEL Level = SharedCacheMap->VacbLevels;
+    ULONG Depth = SharedCacheMap->VacbDepth;
+
+    if (Level == NULL || (View >> (Depth * VACB_LEVEL_SHIFT)) != 0)
+        return NULL;
+
+    while (--Depth > 0)
+    {
+        Level = Level->Entries[(View >> (Depth * VACB_LEVEL_SHIFT)) & (VACB_LEVEL_ENTRIES - 1)];
+        if (Level == NULL)
+            return NULL;
+    }
+
+    return Level->Entries[View & (VACB_LEVEL_ENTRIES - 1)];
+}
+
+static
+PROS_VACB
+CcRosFindLastVacb(
+    PROS_VACB_LEVEL Level,
+    ULONG Depth,
+    ULONG Limit)
+{
+    PROS_VACB Vacb;
+    ULONG i;
+
+    /* Highest VACB found in the entries below Limit */
+    for (i = Limit; i-- > 0; )
+    {
+        if (Level->Entries[i] == NULL)
+            continue;
+
+        if (Depth == 1)
+            return Level->Entries[i];
+
+        Vacb = CcRosFindLastVacb(Level->Entries[i], Depth - 1, VACB_LEVEL_ENTRIES);
+        if (Vacb != NULL)
+            return Vacb;
+    }
+
+    return NULL;
+}
+
+static
+PROS_VACB
+CcRosFindPreviousVacbInLevel(
+    PROS_VACB_LEVEL Level,
+    ULONG Depth,
+    ULONGLONG View)
+{
+    ULONG Slot = (ULONG)(View >> ((Depth - 1) * VACB_LEVEL_SHIFT)) & (VACB_LEVEL_ENTRIES - 1);
+    PROS_VACB Vacb;
+
+    if (Depth > 1 && Level->Entries[Slot] != NULL)
+    {
+        Vacb = CcRosFindPreviousVacbInLevel(Level->Entries[Slot], Depth - 1, View);
+        if (Vacb != NULL)
+            return Vacb;
+    }
+
+    return CcRosFindLastVacb(Level, Depth, Slot);
+}
+
+/* Must be called with the cache map lock held.
+ * Returns the VACB mapping the highest offset below FileOffset, if any. */
+static
+PROS_VACB
+CcRosFindPreviousVacbInArray(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+{
+    ULONGLONG View = (ULONGLONG)FileOffset >> VACB_OFFSET_SHIFT;
+    ULONG Depth = SharedCacheMap->VacbDepth;
+
+    if (SharedCacheMap->VacbLevels == NULL)
+        return NULL;
+
+    if ((View >> (Depth * VACB_LEVEL_SHIFT)) != 0)
+        return CcRosFindLastVacb(SharedCacheMap->VacbLevels, Depth, VACB_LEVEL_ENTRIES);
+
+    return CcRosFindPreviousVacbInLevel(SharedCacheMap->VacbLevels, Depth, View);
+}
+
+static
+PROS_VACB
+CcRosFindFirstVacb(
+    PROS_VACB_LEVEL Level,
+    ULONG Depth,
+    ULONG Start)
+{
+    PROS_VACB Vacb;
+    ULONG i;
+
+    /* Lowest VACB found in the entries from Start on */
+    for (i = Start; i < VACB_LEVEL_ENTRIES; i++)
+    {
+        if (Level->Entries[i] == NULL)
+            continue;
+
+        if (Depth == 1)
+            return Level->Entries[i];
+
+        Vacb = CcRosFindFirstVacb(Level->Entries[i], Depth - 1, 0);
+        if (Vacb != NULL)
+            return Vacb;
+    }
+
+    return NULL;
+}
+
+static
+PROS_VACB
+CcRosFindNextVacbInLevel(
+    PROS_VACB_LEVEL Level,
+    ULONG Depth,
+    ULONGLONG View)
+{
+    ULONG Slot = (ULONG)(View >> ((Depth - 1) * VACB_LEVEL_SHIFT)) & (VACB_LEVEL_ENTRIES - 1);
+    PROS_VACB Vacb;
+
+    if (Depth > 1 && Level->Entries[Slot] != NULL)
+    {
+        Vacb = CcRosFindNextVacbInLevel(Level->Entries[Slot], Depth - 1, View);
+        if (Vacb != NULL)
+            return Vacb;
+
+        Slot++;
+    }
+
+    return CcRosFindFirstVacb(Level, Depth, Slot);
+}
+
+/* Must be called with the cache map lock held.
+ * Returns the VACB mapping the lowest offset at or above FileOffset, if any. */
+static
+PROS_VACB
+CcRosFindNextVacbInArray(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+{
+    ULONGLONG View = (ULONGLONG)FileOffset >> VACB_OFFSET_SHIFT;
+    ULONG Depth = SharedCacheMap->VacbDepth;
+
+    if (SharedCacheMap->VacbLevels == NULL || (View >> (Depth * VACB_LEVEL_SHIFT)) != 0)
+        return NULL;
+
+    return CcRosFindNextVacbInLevel(SharedCacheMap->VacbLevels, Depth, View);
+}
+
+/* Must be called with the cache map lock held */
+static
+NTSTATUS
+CcRosInsertVacbInArray(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PROS_VACB Vacb)
+{
+    ULONGLONG View = (ULONGLONG)Vacb->FileOffset.QuadPart >> VACB_OFFSET_SHIFT;
+    PROS_VACB_LEVEL Level, *Slot;
+    ULONG Depth;
+
+    /* Add levels on top until the array reaches the view */
+    while (SharedCacheMap->VacbLevels == NULL ||
+           (View >> (SharedCacheMap->VacbDepth * VACB_LEVEL_SHIFT)) != 0)
+    {
+        ASSERT(SharedCacheMap->VacbDepth < VACB_LEVEL_MAX);
+
+        Level = CcRosAllocateVacbLevel();
+        if (Level == NULL)
+            return STATUS_INSUFFICIENT_RESOURCES;
+
+        if (SharedCacheMap->VacbLevels != NULL)
+        {
+            Level->Entries[0] = SharedCacheMap->VacbLevels;
+            Level->ValidEntries = 1;
+        }
+
+        SharedCacheMap->VacbLevels = Level;
+        SharedCacheMap->VacbDepth++;
+    }
+
+    Level = SharedCacheMap->VacbLevels;
+    for (Depth = SharedCacheMap->VacbDepth - 1; Depth > 0; Depth--)
+    {
+        Slot = (PROS_VACB_LEVEL *)&Level->Entries[(View >> (Depth * VACB_LEVEL_SHIFT)) & (VACB_LEVEL_ENTRIES - 1)];
+        if (*Slot == NULL)
+        {
+            *Slot = CcRosAllocateVacbLevel();
+            if (*Slot == NULL)
+                return STATUS_INSUFFICIENT_RESOURCES;
+            Level->ValidEntries++;
+        }
+        Level = *Slot;
+    }
+
+    ASSERT(Level->Entries[View & (VACB_LEVEL_ENTRIES - 1)] == NULL);
+    Level->Entries[View & (VACB_LEVEL_ENTRIES - 1)] = Vacb;
+    Level->ValidEntries++;
+
+    return STATUS_SUCCESS;
+}
+
+/* Must be called with the cache map lock held */
+VOID
+CcRosRemoveVacbFromArray(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PROS_VACB Vacb)
+{
+    ULONGLONG View = (ULONGLONG)Vacb->FileOffset.QuadPart >> VACB_OFFSET_SHIFT;
+    PROS_VACB_LEVEL Path[VACB_LEVEL_MAX];
+    PROS_VACB_LEVEL Level = SharedCacheMap->VacbLevels;
+    ULONG Depth;
+
+    ASSERT(CcRosFindVacbInArray(SharedCacheMap, Vacb->FileOffset.QuadPart) == Vacb);
+
+    for (Depth = SharedCacheMap->VacbDepth - 1; Depth > 0; Depth--)
+    {
+        Path[Depth] = Level;
+        Level = Level->Entries[(View >> (Depth * VACB_LEVEL_SHIFT)) & (VACB_LEVEL_ENTRIES - 1)];
+    }
+
+    Level->Entries[View & (VACB_LEVEL_ENTRIES - 1)] = NULL;
+    Level->ValidEntries--;
+
+    /* Release the levels we left empty on the way up */
+    for (Depth = 1; Depth < SharedCacheMap->VacbDepth && Level->ValidEntries == 0; Depth++)
+    {
+        ExFreePoolWithTag(Level, TAG_VACB_LEVEL);
+        Level = Path[Depth];
+        Level->Entries[(View >> (Depth * VACB_LEVEL_SHIFT)) & (VACB_LEVEL_ENTRIES - 1)] = NULL;
+        Level->ValidEntries--;
+    }
+
+    if (Level == SharedCacheMap->VacbLevels && Level->ValidEntries == 0)
+    {
+        ExFreePoolWithTag(Level, TAG_VACB_LEVEL);
+        SharedCacheMap->VacbLevels = NULL;
+        SharedCacheMap->VacbDepth = 0;
+    }
+}
+
 VOID
 CcRosTraceCacheMap (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
@@ -200,7 +486,139 @@ quit:
     return Status;
 }
 
-static
+/*
+ * Writes back the dirty VACBs of a shared cache map in file offset order.
+ * Adjacent dirty VACBs are merged into a single flush, which lets Mm issue
+ * large contiguous writes instead of one write per view.
+ * The caller owns a reference on the map and has acquired the file for lazy write.
+ */
+NTSTATUS
+CcRosFlushDirtyRuns(
+    _In_ PROS_SHARED_CACHE_MAP SharedCacheMap,
+    _In_ ULONG Target,
+    _Out_ PULONG Count,
+    _Out_opt_ PULONG Runs)
+{
+    PROS_VACB RunVacbs[CC_MAX_FLUSH_RUN_VACBS];
+    LONGLONG RunStart = 0, RunEnd = 0;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PLIST_ENTRY current_entry;
+    PROS_VACB current;
+    ULONG RunLength, RunPages, i;
+    KIRQL OldIrql;
+
+    *Count = 0;
+    if (Runs)
+        *Runs = 0;
+
+    while (Target > 0)
+    {
+        IO_STATUS_BLOCK Iosb;
+        LARGE_INTEGER FlushOffset;
+        BOOLEAN HaveLock = FALSE;
+
+        OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+        KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+
+        /* Resume right after the previous run through the VACB array. The
+         * views are sorted by offset, so from there the list leads to the
+         * next dirty one and to the dirty ones directly following it */
+        RunLength = 0;
+        for (current = CcRosFindNextVacbInArray(SharedCacheMap, RunEnd);
+             current != NULL;
+             current = (current_entry != &SharedCacheMap->CacheMapVacbListHead) ?
+                       CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry) : NULL)
+        {
+            current_entry = current->CacheMapVacbListEntry.Flink;
+            ASSERT(current->FileOffset.QuadPart >= RunEnd);
+
+            if (!current->Dirty)
+            {
+                if (RunLength != 0)
+                    break;
+                continue;
+            }
+
+            if (RunLength == 0)
+                RunStart = current->FileOffset.QuadPart;
+            else if (current->FileOffset.QuadPart != RunEnd)
+                break;
+
+            /* Keep the VACB around while it is being written */
+            CcRosVacbIncRefCount(current);
+            CcRosUnmarkDirtyVacb(current, FALSE);
+
+            RunVacbs[RunLength++] = current;
+            RunEnd = current->FileOffset.QuadPart + VACB_MAPPING_GRANULARITY;
+
+            if ((RunLength == CC_MAX_FLUSH_RUN_VACBS) ||
+                (RunLength * (VACB_MAPPING_GRANULARITY / PAGE_SIZE) >= Target))
+            {
+                break;
+            }
+        }
+
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+
+        if (RunLength == 0)
+            break;
+
+        /* Lock for flush, if we are not already the top-level */
+        if (IoGetTopLevelIrp() != (PIRP)FSRTL_CACHE_TOP_LEVEL_IRP)
+        {
+            Status = FsRtlAcquireFileForCcFlushEx(SharedCacheMap->FileObject);
+            HaveLock = NT_SUCCESS(Status);
+        }
+
+        Iosb.Information = 0;
+        if (NT_SUCCESS(Status))
+        {
+            FlushOffset.QuadPart = RunStart;
+            Status = MmFlushSegment(SharedCacheMap->FileObject->SectionObjectPointer,
+                                    &FlushOffset,
+                                    (ULONG)(RunEnd - RunStart),
+                                    &Iosb);
+        }
+
+        if (HaveLock)
+        {
+            FsRtlReleaseFileForCcFlush(SharedCacheMap->FileObject);
+        }
+
+        if (NT_SUCCESS(Status))
+        {
+            /* Update VDL */
+            if (SharedCacheMap->ValidDataLength.QuadPart < RunEnd)
+            {
+                SharedCacheMap->ValidDataLength.QuadPart = RunEnd;
+            }
+
+            if (Runs)
+                (*Runs)++;
+        }
+
+        for (i = 0; i < RunLength; i++)
+        {
+            if (!NT_SUCCESS(Status))
+                CcRosMarkDirtyVacb(RunVacbs[i]);
+
+            CcRosVacbDecRefCount(RunVacbs[i]);
+        }
+
+        (*Count) += Iosb.Information / PAGE_SIZE;
+
+        if (!NT_SUCCESS(Status))
+            break;
+
+        /* The target is in dirty pages as accounted by the VACBs */
+        RunPages = RunLength * (VACB_MAPPING_GRANULARITY / PAGE_SIZE);
+        Target = (Target > RunPages) ? Target - RunPages : 0;
+    }
+
+    return Status;
+}
+
 NTSTATUS
 CcRosDeleteFileCache (
     PFILE_OBJECT FileObject,
@@ -236,6 +654,14 @@ CcRosDeleteFileCache (
         current_entry = current_entry->Flink;
     }
 
+    /* The VACBs are only reachable from the list now */
+    if (SharedCacheMap->VacbLevels != NULL)
+    {
+        CcRosFreeVacbLevels(SharedCacheMap->VacbLevels, SharedCacheMap->VacbDepth);
+        SharedCacheMap->VacbLevels = NULL;
+        SharedCacheMap->VacbDepth = 0;
+    }
+
     /* Make sure there is no trace anymore of this map */
     FileObject->SectionObjectPointer->SharedCacheMap = NULL;
     RemoveEntryList(&SharedCacheMap->SharedCacheMapLinks);
@@ -331,6 +757,7 @@ CcRosFlushDirtyPages (
         PROS_SHARED_CACHE_MAP SharedCacheMap;
         PROS_VACB current;
         BOOLEAN Locked;
+        ULONG PagesFreed;
 
         if (current_entry == &DirtyVacbListHead)
         {
@@ -345,21 +772,17 @@ CcRosFlushDirtyPages (
                                     DirtyVacbListEntry);
         current_entry = current_entry->Flink;
 
-        CcRosVacbIncRefCount(current);
-
         SharedCacheMap = current->SharedCacheMap;
 
         /* When performing lazy write, don't handle temporary files */
         if (CalledFromLazy && BooleanFlagOn(SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE))
         {
-            CcRosVacbDecRefCount(current);
             continue;
         }
 
         /* Don't attempt to lazy write the files that asked not to */
         if (CalledFromLazy && BooleanFlagOn(SharedCacheMap->Flags, WRITEBEHIND_DISABLED))
         {
-            CcRosVacbDecRefCount(current);
             continue;
         }
 
@@ -368,7 +791,6 @@ CcRosFlushDirtyPages (
         /* Do not lazy-write the same file concurrently. Fastfat ASSERTS on that */
         if (SharedCacheMap->Flags & SHARED_CACHE_MAP_IN_LAZYWRITE)
         {
-            CcRosVacbDecRefCount(current);
             continue;
         }
 
@@ -384,7 +806,6 @@ CcRosFlushDirtyPages (
         {
             DPRINT("Not locked!");
             ASSERT(!Wait);
-            CcRosVacbDecRefCount(current);
             OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
             SharedCacheMap->Flags &= ~SHARED_CACHE_MAP_IN_LAZYWRITE;
 
@@ -394,16 +815,11 @@ CcRosFlushDirtyPages (
             continue;
         }
 
-        IO_STATUS_BLOCK Iosb;
-        Status = CcRosFlushVacb(current, &Iosb);
+        /* Write back the dirty views of this file in offset order, not just this one */
+        Status = CcRosFlushDirtyRuns(SharedCacheMap, Wait ? MAXULONG : Target, &PagesFreed, NULL);
 
         SharedCacheMap->Callbacks->ReleaseFromLazyWrite(SharedCacheMap->LazyWriteContext);
 
-        /* We release the VACB before acquiring the lock again, because
-         * CcRosVacbDecRefCount might free the VACB, as CcRosFlushVacb dropped a
-         * Refcount. Freeing must be done outside of the lock.
-         * The refcount is decremented atomically. So this is OK. */
-        CcRosVacbDecRefCount(current);
         OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
 
         SharedCacheMap->Flags &= ~SHARED_CACHE_MAP_IN_LAZYWRITE;
@@ -416,26 +832,21 @@ CcRosFlushDirtyPages (
         {
             DPRINT1("CC: Failed to flush VACB.\n");
         }
-        else
-        {
-            ULONG PagesFreed;
 
-            /* How many pages did we free? */
-            PagesFreed = Iosb.Information / PAGE_SIZE;
-            (*Count) += PagesFreed;
+        /* How many pages did we free? */
+        (*Count) += PagesFreed;
 
-            if (!Wait)
+        if (!Wait)
+        {
+            /* Make sure we don't overflow target! */
+            if (Target < PagesFreed)
             {
-                /* Make sure we don't overflow target! */
-                if (Target < PagesFreed)
-                {
-                    /* If we would have, jump to zero directly */
-                    Target = 0;
-                }
-                else
-                {
-                    Target -= PagesFreed;
-                }
+                /* If we would have, jump to zero directly */
+                Target = 0;
+            }
+            else
+            {
+                Target -= PagesFreed;
             }
         }
 
@@ -516,6 +927,7 @@ retry:
             ASSERT(!current->MappedCount);
             ASSERT(Refs == 1);
 
+            CcRosRemoveVacbFromArray(current->SharedCacheMap, current);
             RemoveEntryList(&current->CacheMapVacbListEntry);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
@@ -604,7 +1016,6 @@ CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
     PROS_VACB current;
     KIRQL oldIrql;
 
@@ -613,33 +1024,19 @@ CcRosLookupVacb (
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+    /* The VACBs of the map can only go away with its lock held, so it is
+     * enough to reference the one we find. No need for the master lock. */
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    current = CcRosFindVacbInArray(SharedCacheMap, FileOffset);
+    if (current != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        CcRosVacbIncRefCount(current);
     }
 
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
-    return NULL;
+    return current;
 }
 
 VOID
@@ -745,6 +1142,7 @@ CcRosFreeOneUnusedVacb(
             ASSERT(Refs == 1);
 
             /* Reset it, this is the one we want to free */
+            CcRosRemoveVacbFromArray(current->SharedCacheMap, current);
             RemoveEntryList(&current->CacheMapVacbListEntry);
             InitializeListHead(&current->CacheMapVacbListEntry);
             RemoveEntryList(&current->VacbLruListEntry);
@@ -781,7 +1179,6 @@ CcRosCreateVacb (
 {
     PROS_VACB current;
     PROS_VACB previous;
-    PLIST_ENTRY current_entry;
     NTSTATUS Status;
     KIRQL oldIrql;
     ULONG Refs;
@@ -842,50 +1239,49 @@ CcRosCreateVacb (
      * our newly created VACB and return the existing one.
      */
     KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    current = CcRosFindVacbInArray(SharedCacheMap, FileOffset);
+    if (current != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 #if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
+        if (SharedCacheMap->Trace)
+        {
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
+        }
 #endif
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 
-            Refs = CcRosVacbDecRefCount(*Vacb);
-            ASSERT(Refs == 0);
+        Refs = CcRosVacbDecRefCount(*Vacb);
+        ASSERT(Refs == 0);
 
-            *Vacb = current;
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
-        {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        *Vacb = current;
+        return STATUS_SUCCESS;
     }
+
     /* There was no existing VACB. */
     current = *Vacb;
+    Status = CcRosInsertVacbInArray(SharedCacheMap, current);
+    if (!NT_SUCCESS(Status))
+    {
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+
+        Refs = CcRosVacbDecRefCount(current);
+        ASSERT(Refs == 0);
+
+        *Vacb = NULL;
+        return Status;
+    }
+
+    /* Keep the list sorted by offset, purging relies on it */
+    previous = CcRosFindPreviousVacbInArray(SharedCacheMap, current->FileOffset.QuadPart);
     if (previous)
     {
+        ASSERT(previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
         InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
     }
     else
@@ -1231,7 +1627,7 @@ CcRosReleaseFileCache (
             KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 
             /* And free it. */
-            if (PrivateMap != &SharedCacheMap->PrivateCacheMap)
+            if (PrivateMap != &SharedCacheMap->PrivateCacheMap.PrivateCacheMap)
             {
                 ExFreePoolWithTag(PrivateMap, TAG_PRIVATE_CACHE_MAP);
             }
@@ -1334,13 +1730,13 @@ CcRosInitializeFileCache (
         PPRIVATE_CACHE_MAP PrivateMap;
 
         /* Allocate the private cache map for this handle */
-        if (SharedCacheMap->PrivateCacheMap.NodeTypeCode != 0)
+        if (SharedCacheMap->PrivateCacheMap.PrivateCacheMap.NodeTypeCode != 0)
         {
-            PrivateMap = ExAllocatePoolWithTag(NonPagedPool, sizeof(PRIVATE_CACHE_MAP), TAG_PRIVATE_CACHE_MAP);
+            PrivateMap = ExAllocatePoolWithTag(NonPagedPool, sizeof(ROS_PRIVATE_CACHE_MAP), TAG_PRIVATE_CACHE_MAP);
         }
         else
         {
-            PrivateMap = &SharedCacheMap->PrivateCacheMap;
+            PrivateMap = &SharedCacheMap->PrivateCacheMap.PrivateCacheMap;
         }
 
         if (PrivateMap == NULL)
@@ -1360,7 +1756,7 @@ CcRosInitializeFileCache (
         }
 
         /* Initialize it */
-        RtlZeroMemory(PrivateMap, sizeof(PRIVATE_CACHE_MAP));
+        RtlZeroMemory(PrivateMap, sizeof(ROS_PRIVATE_CACHE_MAP));
         PrivateMap->NodeTypeCode = NODE_TYPE_PRIVATE_MAP;
         PrivateMap->ReadAheadMask = PAGE_SIZE - 1;
         PrivateMap->FileObject = FileObject;
@@ -1538,6 +1934,8 @@ ExpKdbgExtFileCache(ULONG Argc, PCHAR Argv[])
         KdbpPrint("%p\t%d\t%d\t%wZ%S\n", SharedCacheMap, Mapped, Dirty, FileName, Extra);
     }
 
+    KdbpPrint("Read ahead:\t%lu I/Os, %lu hits, %lu misses\n", CcReadAheadIos, CcReadAheadHits, CcReadAheadMisses);
+
     return TRUE;
 }
 
@@ -1556,6 +1954,10 @@ ExpKdbgExtDefWrites(ULONG Argc, PCHAR Argv[])
               (MmThrottleBottom * PAGE_SIZE) / 1024);
     KdbpPrint("MmModifiedPageListHead.Total:\t%lu (%lu Kb)\n", MmModifiedPageListHead.Total,
               (MmModifiedPageListHead.Total * PAGE_SIZE) / 1024);
+    KdbpPrint("Lazy writer:\t\t%lu pages in %lu writes, %lu pages last scan\n",
+              CcLazyWritePages, CcLazyWriteIos, CcLazyWriteRate);
+    KdbpPrint("Throttled:\t\t%lu write behinds, %lu writes\n",
+              CcLazyWriteThrottled, CcThrottledWrites);
 
     if (CcTotalDirtyPages >= CcDirtyPageThreshold)
     {
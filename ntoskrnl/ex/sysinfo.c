@@ -701,6 +701,8 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->IoReadOperationCount = IoReadOperationCount;
     Spi->IoWriteOperationCount = IoWriteOperationCount;
     Spi->IoOtherOperationCount = IoOtherOperationCount;
+    Spi->DirtyPagesWriteCount = 0;
+    Spi->DirtyWriteIoCount = 0;
     for (i = 0; i < KeNumberProcessors; i ++)
     {
         Prcb = KiProcessorBlock[i];
@@ -712,6 +714,8 @@ QSI_DEF(SystemPerformanceInformation)
             Spi->IoReadOperationCount += Prcb->IoReadOperationCount;
             Spi->IoWriteOperationCount += Prcb->IoWriteOperationCount;
             Spi->IoOtherOperationCount += Prcb->IoOtherOperationCount;
+            Spi->DirtyPagesWriteCount += Prcb->MmDirtyPagesWriteCount;
+            Spi->DirtyWriteIoCount += Prcb->MmDirtyWriteIoCount;
         }
     }
 
@@ -735,8 +739,6 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->PageReadIoCount = 0; /* FIXME */
     Spi->CacheReadCount = 0; /* FIXME */
     Spi->CacheIoCount = 0; /* FIXME */
-    Spi->DirtyPagesWriteCount = 0; /* FIXME */
-    Spi->DirtyWriteIoCount = 0; /* FIXME */
     Spi->MappedPagesWriteCount = 0; /* FIXME */
     Spi->MappedWriteIoCount = 0; /* FIXME */
 
@@ -796,7 +798,7 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->CcMdlReadWait = 0; /* FIXME */
     Spi->CcMdlReadNoWaitMiss = 0; /* FIXME */
     Spi->CcMdlReadWaitMiss = 0; /* FIXME */
-    Spi->CcReadAheadIos = 0; /* FIXME */
+    Spi->CcReadAheadIos = CcReadAheadIos;
     Spi->CcLazyWriteIos = CcLazyWriteIos;
     Spi->CcLazyWritePages = CcLazyWritePages;
     Spi->CcDataFlushes = CcDataFlushes;
@@ -58,6 +58,9 @@ extern LARGE_INTEGER CcIdleDelay;
 //
 extern ULONG CcLazyWritePages;
 extern ULONG CcLazyWriteIos;
+extern ULONG CcLazyWriteRate;
+extern ULONG CcLazyWriteThrottled;
+extern ULONG CcThrottledWrites;
 extern ULONG CcMapDataWait;
 extern ULONG CcMapDataNoWait;
 extern ULONG CcPinReadWait;
@@ -65,6 +68,9 @@ extern ULONG CcPinReadNoWait;
 extern ULONG CcPinMappedDataCount;
 extern ULONG CcDataPages;
 extern ULONG CcDataFlushes;
+extern ULONG CcReadAheadIos;
+extern ULONG CcReadAheadHits;
+extern ULONG CcReadAheadMisses;
 
 typedef struct _PF_SCENARIO_ID
 {
@@ -167,6 +173,61 @@ typedef struct _PFSN_PREFETCHER_GLOBALS
     LONG ActivePrefetches;
 } PFSN_PREFETCHER_GLOBALS, *PPFSN_PREFETCHER_GLOBALS;
 
+/* One level of the VACB array of a shared cache map. The leaves point to
+ * the VACBs, indexed by file offset / VACB_MAPPING_GRANULARITY, and the
+ * array only gets as deep as the highest view mapped so far requires. */
+#define VACB_LEVEL_SHIFT 7
+#define VACB_LEVEL_ENTRIES (1 << VACB_LEVEL_SHIFT)
+#define VACB_LEVEL_MAX ((63 - VACB_OFFSET_SHIFT + VACB_LEVEL_SHIFT - 1) / VACB_LEVEL_SHIFT)
+
+typedef struct _ROS_VACB_LEVEL
+{
+    PVOID Entries[VACB_LEVEL_ENTRIES];
+    ULONG ValidEntries;
+} ROS_VACB_LEVEL, *PROS_VACB_LEVEL;
+
+/* Read ahead tracks this many interleaved access streams per handle */
+#define READ_AHEAD_STREAMS 4
+/* Largest read ahead window, and largest stride still followed */
+#define READ_AHEAD_MAX_WINDOW (2 * VACB_MAPPING_GRANULARITY)
+#define READ_AHEAD_MAX_STRIDE (16 * VACB_MAPPING_GRANULARITY)
+
+typedef enum _READ_AHEAD_PATTERN
+{
+    ReadAheadUnknown = 0,
+    ReadAheadForward,
+    ReadAheadReverse,
+    ReadAheadStrided,
+} READ_AHEAD_PATTERN;
+
+typedef struct _ROS_READ_AHEAD_STREAM
+{
+    /* Last read of the stream */
+    LONGLONG FileOffset;
+    LONGLONG BeyondLastByte;
+    /* Distance between the starts of the last two reads */
+    LONGLONG Stride;
+    /* What was read ahead for the stream so far */
+    LONGLONG ReadAheadOffset;
+    LONGLONG ReadAheadEnd;
+    READ_AHEAD_PATTERN Pattern;
+    /* Number of reads in a row that matched the pattern */
+    ULONG Confidence;
+    ULONG Window;
+    ULONG LastUse;
+} ROS_READ_AHEAD_STREAM, *PROS_READ_AHEAD_STREAM;
+
+typedef struct _ROS_PRIVATE_CACHE_MAP
+{
+    PRIVATE_CACHE_MAP PrivateCacheMap;
+
+    /* ROS specific, protected by the read ahead spin lock */
+    ROS_READ_AHEAD_STREAM Streams[READ_AHEAD_STREAMS];
+    ULONG StreamClock;
+    ULONG ReadAheadHits;
+    ULONG ReadAheadMisses;
+} ROS_PRIVATE_CACHE_MAP, *PROS_PRIVATE_CACHE_MAP;
+
 typedef struct _ROS_SHARED_CACHE_MAP
 {
     CSHORT NodeTypeCode;
@@ -187,10 +248,12 @@ typedef struct _ROS_SHARED_CACHE_MAP
     LIST_ENTRY PrivateList;
     ULONG DirtyPageThreshold;
     KSPIN_LOCK BcbSpinLock;
-    PRIVATE_CACHE_MAP PrivateCacheMap;
+    ROS_PRIVATE_CACHE_MAP PrivateCacheMap;
 
     /* ROS specific */
     LIST_ENTRY CacheMapVacbListHead;
+    PROS_VACB_LEVEL VacbLevels;
+    ULONG VacbDepth;
     BOOLEAN PinAccess;
     KSPIN_LOCK CacheMapLock;
 #if DBG
@@ -260,6 +323,7 @@ typedef struct _WORK_QUEUE_ENTRY
         struct
         {
             SHARED_CACHE_MAP *SharedCacheMap;
+            unsigned long Target;
         } Write;
         struct
         {
@@ -350,6 +414,11 @@ CcRosLookupVacb(
     LONGLONG FileOffset
 );
 
+VOID
+CcRosRemoveVacbFromArray(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PROS_VACB Vacb);
+
 VOID
 NTAPI
 CcInitCacheZeroPage(VOID);
@@ -371,6 +440,21 @@ CcRosFlushDirtyPages(
     BOOLEAN CalledFromLazy
 );
 
+NTSTATUS
+CcRosDeleteFileCache(
+    PFILE_OBJECT FileObject,
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PKIRQL OldIrql
+);
+
+NTSTATUS
+CcRosFlushDirtyRuns(
+    _In_ PROS_SHARED_CACHE_MAP SharedCacheMap,
+    _In_ ULONG Target,
+    _Out_ PULONG Count,
+    _Out_opt_ PULONG Runs
+);
+
 VOID
 CcRosDereferenceCache(PFILE_OBJECT FileObject);
 
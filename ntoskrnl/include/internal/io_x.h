@@ -76,6 +76,19 @@ IopUnQueueIrpFromThread(IN PIRP Irp)
     InitializeListHead(&Irp->ThreadListEntry);
 }
 
+FORCEINLINE
+BOOLEAN
+IopSkipCompletionPort(IN PFILE_OBJECT FileObject, IN NTSTATUS Status)
+{
+    /*
+     * With FILE_SKIP_COMPLETION_PORT_ON_SUCCESS, a request that succeeded
+     * without going pending already handed its result to the caller, so
+     * no completion packet is queued for it.
+     */
+    return ((FileObject->Flags & FO_SKIP_COMPLETION_PORT) &&
+            NT_SUCCESS(Status));
+}
+
 static
 __inline
 VOID
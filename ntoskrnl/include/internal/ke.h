@@ -156,7 +156,7 @@ extern VOID __cdecl KiInterruptTemplate(VOID);
 
 /* MACROS *************************************************************************/
 
-#define AFFINITY_MASK(Id) KiMask32Array[Id]
+#define AFFINITY_MASK(Id) ((KAFFINITY)1 << (Id))
 #define PRIORITY_MASK(Id) KiMask32Array[Id]
 
 /* Tells us if the Timer or Event is a Syncronization or Notification Object */
@@ -716,6 +716,18 @@ VOID
 FASTCALL
 KiActivateWaiterQueue(IN PKQUEUE Queue);
 
+NTSTATUS
+NTAPI
+KeRemoveQueueEx(
+    IN PKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN BOOLEAN Alertable,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    OUT PLIST_ENTRY *EntryArray,
+    IN ULONG Count,
+    OUT PULONG EntriesRemoved
+);
+
 ULONG
 NTAPI
 KeQueryRuntimeProcess(IN PKPROCESS Process,
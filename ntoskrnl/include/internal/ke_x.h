@@ -1240,7 +1240,7 @@ KxSetTimerForThreadWait(IN PKTIMER Timer,
     }                                                                       \
                                                                             \
     /* Set wait settings */                                                 \
-    Thread->Alertable = FALSE;                                              \
+    Thread->Alertable = Alertable;                                          \
     Thread->WaitMode = WaitMode;                                            \
     Thread->WaitReason = WrQueue;                                           \
                                                                             \
@@ -1362,9 +1362,14 @@ KxQueueReadyThread(IN PKTHREAD Thread,
     ASSERT(Thread->State == Running);
     ASSERT(Thread->NextProcessor == Prcb->Number);
 
-    /* Check if this thread is allowed to run in this CPU */
+    /*
+     * Check if this thread is allowed to run in this CPU, and that no other
+     * CPU it may run on is idle. Otherwise let KiDeferredReadyThread hand it
+     * to the idle one instead of leaving it behind on our ready lists.
+     */
 #ifdef CONFIG_SMP
-    if ((Thread->Affinity) & (Prcb->SetMember))
+    if (((Thread->Affinity) & (Prcb->SetMember)) &&
+        !((Thread->Affinity) & KiIdleSummary))
 #else
     if (TRUE)
 #endif
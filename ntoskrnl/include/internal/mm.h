@@ -507,11 +507,31 @@ typedef struct _MMPAGING_FILE
     UNICODE_STRING PageFileName;
     PRTL_BITMAP Bitmap;
     HANDLE FileHandle;
+    ULONG AllocationHint;
 }
 MMPAGING_FILE, *PMMPAGING_FILE;
 
 extern PMMPAGING_FILE MmPagingFile[MAX_PAGING_FILES];
 
+/* Number of dirty pages the balancer writes to the paging file in one I/O */
+#define MI_PAGE_OUT_CLUSTER_SIZE 16
+
+typedef struct _MM_PAGE_OUT_CLUSTER
+{
+    ULONG Count;
+    ULONG Reserved;
+    BOOLEAN Pending;
+    NTSTATUS Status;
+    KEVENT Event;
+    IO_STATUS_BLOCK Iosb;
+    PEPROCESS Process[MI_PAGE_OUT_CLUSTER_SIZE];
+    PVOID Address[MI_PAGE_OUT_CLUSTER_SIZE];
+    PMEMORY_AREA MemoryArea[MI_PAGE_OUT_CLUSTER_SIZE];
+    SWAPENTRY SwapEntry[MI_PAGE_OUT_CLUSTER_SIZE];
+    MDL Mdl;
+    PFN_NUMBER Page[MI_PAGE_OUT_CLUSTER_SIZE];
+} MM_PAGE_OUT_CLUSTER, *PMM_PAGE_OUT_CLUSTER;
+
 typedef VOID
 (*PMM_ALTER_REGION_FUNC)(
     PMMSUPPORT AddressSpace,
@@ -704,6 +724,13 @@ SWAPENTRY
 NTAPI
 MmAllocSwapPage(VOID);
 
+ULONG
+NTAPI
+MmAllocSwapCluster(
+    _In_ ULONG Count,
+    _Out_writes_to_(Count, return) SWAPENTRY *Entries
+);
+
 VOID
 NTAPI
 MmFreeSwapPage(SWAPENTRY Entry);
@@ -731,6 +758,15 @@ MmWriteToSwapPage(
     PFN_NUMBER Page
 );
 
+NTSTATUS
+NTAPI
+MmWriteToSwapPages(
+    _In_ SWAPENTRY SwapEntry,
+    _In_ PMDL Mdl,
+    _In_ PKEVENT Event,
+    _Out_ PIO_STATUS_BLOCK Iosb
+);
+
 VOID
 NTAPI
 MmShowOutOfSpaceMessagePagingFile(VOID);
@@ -983,6 +1019,17 @@ NTSTATUS
 NTAPI
 MmPageOutPhysicalAddress(PFN_NUMBER Page);
 
+NTSTATUS
+NTAPI
+MiPageOutPhysicalAddress(
+    _In_ PFN_NUMBER Page,
+    _In_ BOOLEAN Cluster
+);
+
+VOID
+NTAPI
+MiFlushPageOutClusters(VOID);
+
 PMM_SECTION_SEGMENT
 NTAPI
 MmGetSectionAssociation(PFN_NUMBER Page,
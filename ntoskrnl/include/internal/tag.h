@@ -13,6 +13,7 @@
 /* Cache Manager Tags */
 #define TAG_CC                      '  cC'
 #define TAG_VACB                    'aVcC'
+#define TAG_VACB_LEVEL              'lVcC'
 #define TAG_SHARED_CACHE_MAP        'cScC'
 #define TAG_PRIVATE_CACHE_MAP       'cPcC'
 #define TAG_BCB                     'cBcC'
@@ -145,6 +146,7 @@
 #define TAG_USTR    'RTSU'
 #define TAG_ASTR    'RTSA'
 #define TAG_OSTR    'RTSO'
+#define TAG_RTLP_PARALLEL   'PltR' /* RtlpRunInParallel jobs */
 
 /* Security Manager Tags */
 #define TAG_SE                  '  eS'
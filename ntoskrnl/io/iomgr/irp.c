@@ -399,8 +399,15 @@ IopCompleteRequest(IN PKAPC Apc,
         }
         else if (FileObject)
         {
-            /* Signal the file object and set the status */
-            KeSetEvent(&FileObject->Event, 0, FALSE);
+            /*
+             * Signal the file object and set the status, unless the caller
+             * of an asynchronous file asked us not to bother
+             */
+            if ((FileObject->Flags & FO_SYNCHRONOUS_IO) ||
+                !(FileObject->Flags & FO_SKIP_SET_EVENT))
+            {
+                KeSetEvent(&FileObject->Event, 0, FALSE);
+            }
             FileObject->FinalStatus = Irp->IoStatus.Status;
 
             /*
@@ -460,7 +467,9 @@ IopCompleteRequest(IN PKAPC Apc,
             KeInsertQueueApc(&Irp->Tail.Apc, Irp->UserIosb, NULL, 2);
         }
         else if ((Port) &&
-                 (Irp->Overlay.AsynchronousParameters.UserApcContext))
+                 (Irp->Overlay.AsynchronousParameters.UserApcContext) &&
+                 ((Irp->PendingReturned) ||
+                  !(IopSkipCompletionPort(FileObject, Irp->IoStatus.Status))))
         {
             /* We have an I/O Completion setup... create the special Overlay */
             Irp->Tail.CompletionKey = Key;
@@ -68,6 +68,9 @@ KiDpcInterruptHandler(VOID)
         OldThread = Prcb->CurrentThread;
         NewThread = Prcb->NextThread;
 
+        /* Another processor may pick up the old thread once it is queued */
+        KiSetThreadSwapBusy(OldThread);
+
         /* Set new thread data */
         Prcb->NextThread = NULL;
         Prcb->CurrentThread = NewThread;
@@ -193,12 +196,25 @@ KiIdleLoop(VOID)
             KiRetireDpcList(Prcb);
         }
 
+#ifdef CONFIG_SMP
+        /* Pick up work that was queued on busy processors before we went idle */
+        if (Prcb->IdleSchedule)
+        {
+            _enable();
+            KiIdleSchedule(Prcb);
+            _disable();
+        }
+#endif
+
         /* Check if a new thread is scheduled for execution */
         if (Prcb->NextThread)
         {
             /* Enable interrupts */
             _enable();
 
+            /* Other processors may replace the next thread, lock the PRCB */
+            KiAcquirePrcbLock(Prcb);
+
             /* Capture current thread data */
             OldThread = Prcb->CurrentThread;
             NewThread = Prcb->NextThread;
@@ -210,6 +226,12 @@ KiIdleLoop(VOID)
             /* The thread is now running */
             NewThread->State = Running;
 
+#ifdef CONFIG_SMP
+            /* We are no longer idle */
+            InterlockedAnd64((PLONG64)&KiIdleSummary, ~Prcb->SetMember);
+#endif
+            KiReleasePrcbLock(Prcb);
+
             /* Do the swap at SYNCH_LEVEL */
             KfRaiseIrql(SYNCH_LEVEL);
 
@@ -984,9 +984,12 @@ NTAPI
 KeGenericCallDpc(IN PKDEFERRED_ROUTINE Routine,
                  IN PVOID Context)
 {
-    ULONG Barrier = KeNumberProcessors;
+    volatile LONG Barrier = KeNumberProcessors;
     KIRQL OldIrql;
     DEFERRED_REVERSE_BARRIER ReverseBarrier;
+    PKPRCB Prcb, CurrentPrcb;
+    KAFFINITY IdleSet;
+    ULONG i;
     ASSERT(KeGetCurrentIrql () < DISPATCH_LEVEL);
 
     //
@@ -997,12 +1000,48 @@ KeGenericCallDpc(IN PKDEFERRED_ROUTINE Routine,
     ReverseBarrier.TotalProcessors = Barrier;
 
     //
-    // But we don't need the barrier on UP, since we can simply call the routine
-    // directly while at DISPATCH_LEVEL and not worry about anything else
+    // The call DPCs are shared, so only one generic call can be in flight
+    //
+    ExAcquireFastMutex(&KiGenericCallDpcMutex);
+
+    //
+    // Raise to DISPATCH_LEVEL first so that we stay on this processor
     //
     KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
-    Routine(&KeGetCurrentPrcb()->CallDpc, Context, &Barrier, &ReverseBarrier);
+    CurrentPrcb = KeGetCurrentPrcb();
+
+    //
+    // Queue the routine to every other processor. The call DPCs are already
+    // targeted and of high importance, so busy processors get an IPI
+    //
+    IdleSet = 0;
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        Prcb = KiProcessorBlock[i];
+        if (Prcb == CurrentPrcb) continue;
+
+        Prcb->CallDpc.DeferredRoutine = Routine;
+        Prcb->CallDpc.DeferredContext = Context;
+        KeInsertQueueDpc(&Prcb->CallDpc, (PVOID)&Barrier, &ReverseBarrier);
+
+        //
+        // Idle processors don't get an IPI for a queued DPC, they find it
+        // on their next pass through the idle loop. That only comes after
+        // their next interrupt, since they halt, so wake them up right away
+        //
+        if (KiIdleSummary & AFFINITY_MASK(i)) IdleSet |= AFFINITY_MASK(i);
+    }
+    if (IdleSet) KiIpiSend(IdleSet, IPI_DPC);
+
+    //
+    // Run our own share, then wait for everyone else to be done with the
+    // barriers, which live on our stack
+    //
+    Routine(&CurrentPrcb->CallDpc, Context, (PVOID)&Barrier, &ReverseBarrier);
+    while (Barrier) YieldProcessor();
+
     KeLowerIrql(OldIrql);
+    ExReleaseFastMutex(&KiGenericCallDpcMutex);
 }
 
 /*
@@ -1025,11 +1064,33 @@ BOOLEAN
 NTAPI
 KeSignalCallDpcSynchronize(IN PVOID SystemArgument2)
 {
+    PDEFERRED_REVERSE_BARRIER ReverseBarrier = SystemArgument2;
+    volatile LONG *Barrier = (volatile LONG *)&ReverseBarrier->Barrier;
+    LONG Sense, Count;
+
+    //
+    // The top bit of the barrier flips every time all processors went
+    // through it, so that the same barrier can be used again right away.
+    // It cannot flip before we decrement, since we are one of the processors
+    // it is waiting for
+    //
+    Sense = *Barrier & 0x80000000;
+    Count = InterlockedDecrement((PLONG)Barrier);
+    if (!(Count & 0x7FFFFFFF))
+    {
+        //
+        // We came in last: rearm the barrier, release the others and win
+        //
+        InterlockedExchange((PLONG)Barrier,
+                            (Sense ^ 0x80000000) | ReverseBarrier->TotalProcessors);
+        return TRUE;
+    }
+
     //
-    // There is nothing to do on UP systems -- the processor calling this wins
+    // Wait for the last processor to flip the barrier
     //
-    UNREFERENCED_PARAMETER(SystemArgument2);
-    return TRUE;
+    while ((*Barrier & 0x80000000) == Sense) YieldProcessor();
+    return FALSE;
 }
 
 /* EOF */
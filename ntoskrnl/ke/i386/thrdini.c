@@ -283,12 +283,25 @@ KiIdleLoop(VOID)
             KiRetireDpcList(Prcb);
         }
 
+#ifdef CONFIG_SMP
+        /* Pick up work that was queued on busy processors before we went idle */
+        if (Prcb->IdleSchedule)
+        {
+            _enable();
+            KiIdleSchedule(Prcb);
+            _disable();
+        }
+#endif
+
         /* Check if a new thread is scheduled for execution */
         if (Prcb->NextThread)
         {
             /* Enable interrupts */
             _enable();
 
+            /* Other processors may replace the next thread, lock the PRCB */
+            KiAcquirePrcbLock(Prcb);
+
             /* Capture current thread data */
             OldThread = Prcb->CurrentThread;
             NewThread = Prcb->NextThread;
@@ -300,6 +313,12 @@ KiIdleLoop(VOID)
             /* The thread is now running */
             NewThread->State = Running;
 
+#ifdef CONFIG_SMP
+            /* We are no longer idle */
+            InterlockedAnd((PLONG)&KiIdleSummary, ~Prcb->SetMember);
+#endif
+            KiReleasePrcbLock(Prcb);
+
             /* Switch away from the idle thread */
             KiSwapContext(APC_LEVEL, OldThread);
         }
@@ -366,6 +385,11 @@ KiSwapContextExit(IN PKTHREAD OldThread,
     /* Increase thread context switches */
     NewThread->ContextSwitches++;
 
+#ifdef CONFIG_SMP
+    /* We are off the old thread's stack, other processors may run it now */
+    OldThread->SwapBusy = FALSE;
+#endif
+
     /* Load data from switch frame */
     Pcr->NtTib.ExceptionList = SwitchFrame->ExceptionList;
 
@@ -427,12 +451,32 @@ KiSwapContextEntry(IN PKSWITCHFRAME SwitchFrame,
     /* Get the old thread and set its kernel stack */
     OldThread->KernelStack = SwitchFrame;
 
+#ifdef CONFIG_SMP
+    /* Wait until the processor that ran the new thread last is off its stack */
+    while (NewThread->SwapBusy) YieldProcessor();
+#else
     /* Set swapbusy to false for the new thread */
     NewThread->SwapBusy = FALSE;
+#endif
 
     /* ISRs can change FPU state, so disable interrupts while checking */
     _disable();
 
+#ifdef CONFIG_SMP
+    /* The old thread may resume on another processor, so its FPU state
+       cannot be left behind in this one */
+    if (OldThread->NpxState == NPX_STATE_LOADED)
+    {
+        Cr0 = __readcr0();
+        if (Cr0 & (CR0_MP | CR0_EM | CR0_TS))
+            __writecr0(Cr0 & ~(CR0_MP | CR0_EM | CR0_TS));
+
+        Ke386SaveFpuState(KiGetThreadNpxArea(OldThread));
+        OldThread->NpxState = NPX_STATE_NOT_LOADED;
+        Pcr->PrcbData.NpxThread = NULL;
+    }
+#endif
+
     /* Get current and new CR0 and check if they've changed */
     Cr0 = __readcr0();
     NewCr0 = NewThread->NpxState |
@@ -485,10 +529,16 @@ KiDispatchInterrupt(VOID)
     }
     else if (Prcb->NextThread)
     {
+        /* Acquire the PRCB lock */
+        KiAcquirePrcbLock(Prcb);
+
         /* Capture current thread data */
         OldThread = Prcb->CurrentThread;
         NewThread = Prcb->NextThread;
 
+        /* Another processor may pick up the old thread once it is queued */
+        KiSetThreadSwapBusy(OldThread);
+
         /* Set new thread data */
         Prcb->NextThread = NULL;
         Prcb->CurrentThread = NewThread;
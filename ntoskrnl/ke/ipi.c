@@ -34,8 +34,24 @@ FASTCALL
 KiIpiSend(IN KAFFINITY TargetProcessors,
           IN ULONG IpiRequest)
 {
-    /* FIXME: TODO */
-    ASSERTMSG("Not yet implemented\n", FALSE);
+#ifdef CONFIG_SMP
+    LONG i;
+    PKPRCB Prcb;
+    KAFFINITY Current;
+
+    for (i = 0, Current = 1; i < KeNumberProcessors; i++, Current <<= 1)
+    {
+        if (TargetProcessors & Current)
+        {
+            /* Post the request, KiIpiServiceRoutine picks it up on the target */
+            Prcb = KiProcessorBlock[i];
+            InterlockedBitTestAndSet((PLONG)&Prcb->IpiFrozen, IpiRequest);
+        }
+    }
+
+    /* Interrupt all the targets at once */
+    HalRequestIpi(TargetProcessors);
+#endif
 }
 
 VOID
@@ -230,13 +230,11 @@ KeReadStateQueue(IN PKQUEUE Queue)
     return Queue->Header.SignalState;
 }
 
-/*
- * @implemented
- */
+static
 PLIST_ENTRY
-NTAPI
-KeRemoveQueue(IN PKQUEUE Queue,
+KiRemoveQueue(IN PKQUEUE Queue,
               IN KPROCESSOR_MODE WaitMode,
+              IN BOOLEAN Alertable,
               IN PLARGE_INTEGER Timeout OPTIONAL)
 {
     PLIST_ENTRY QueueEntry;
@@ -344,12 +342,12 @@ KeRemoveQueue(IN PKQUEUE Queue,
             }
             else
             {
-                /* Fail if there's a User APC Pending */
-                if ((WaitMode != KernelMode) &&
-                    (Thread->ApcState.UserApcPending))
+                /* Fail if there's a User APC Pending or we were alerted */
+                Status = KiCheckAlertability(Thread, Alertable, WaitMode);
+                if (Status != STATUS_WAIT_0)
                 {
                     /* Return the status and increase the pending threads */
-                    QueueEntry = (PLIST_ENTRY)STATUS_USER_APC;
+                    QueueEntry = (PLIST_ENTRY)Status;
                     Queue->CurrentCount++;
                     break;
                 }
@@ -430,6 +428,87 @@ KeRemoveQueue(IN PKQUEUE Queue,
     return QueueEntry;
 }
 
+/*
+ * Removes up to Count entries, waiting only for the first one. If the wait
+ * ends without an entry (timeout, alert, user APC), no entries are returned
+ * and the wait status is the result.
+ */
+NTSTATUS
+NTAPI
+KeRemoveQueueEx(IN PKQUEUE Queue,
+                IN KPROCESSOR_MODE WaitMode,
+                IN BOOLEAN Alertable,
+                IN PLARGE_INTEGER Timeout OPTIONAL,
+                OUT PLIST_ENTRY *EntryArray,
+                IN ULONG Count,
+                OUT PULONG EntriesRemoved)
+{
+    PLIST_ENTRY QueueEntry;
+    NTSTATUS Status;
+    ULONG Removed = 1;
+    KIRQL OldIrql;
+    ASSERT_QUEUE(Queue);
+    ASSERT(Count != 0);
+
+    /* Wait for the first entry, this also makes us an active thread of the queue */
+    QueueEntry = KiRemoveQueue(Queue, WaitMode, Alertable, Timeout);
+    Status = (NTSTATUS)(ULONG_PTR)QueueEntry;
+    if ((Status == STATUS_TIMEOUT) ||
+        (Status == STATUS_USER_APC) ||
+        (Status == STATUS_ALERTED) ||
+        (Status == STATUS_ABANDONED))
+    {
+        *EntriesRemoved = 0;
+        return Status;
+    }
+    EntryArray[0] = QueueEntry;
+
+    /*
+     * Take whatever else is queued already. We stay the one active thread
+     * for all of them, so the concurrency count does not change.
+     */
+    OldIrql = KiAcquireDispatcherLock();
+    while (Removed < Count)
+    {
+        QueueEntry = Queue->EntryListHead.Flink;
+        if (QueueEntry == &Queue->EntryListHead) break;
+
+        /* Check if the entry is valid. If not, bugcheck */
+        if (!(QueueEntry->Flink) || !(QueueEntry->Blink))
+        {
+            /* Invalid item */
+            KeBugCheckEx(INVALID_WORK_QUEUE_ITEM,
+                         (ULONG_PTR)QueueEntry,
+                         (ULONG_PTR)Queue,
+                         (ULONG_PTR)NULL,
+                         (ULONG_PTR)((PWORK_QUEUE_ITEM)QueueEntry)->
+                                     WorkerRoutine);
+        }
+
+        /* Remove the Entry */
+        Queue->Header.SignalState--;
+        RemoveEntryList(QueueEntry);
+        QueueEntry->Flink = NULL;
+        EntryArray[Removed++] = QueueEntry;
+    }
+    KiReleaseDispatcherLock(OldIrql);
+
+    *EntriesRemoved = Removed;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+PLIST_ENTRY
+NTAPI
+KeRemoveQueue(IN PKQUEUE Queue,
+              IN KPROCESSOR_MODE WaitMode,
+              IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    return KiRemoveQueue(Queue, WaitMode, FALSE, Timeout);
+}
+
 /*
  * @implemented
  */
@@ -15,9 +15,17 @@
 #ifdef _WIN64
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr64((PLONG64)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd64((PLONG64)Destination, SetMember);
+# define BitScanForwardAffinity(Index, Mask) \
+    BitScanForward64(Index, Mask)
 #else
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr((PLONG)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd((PLONG)Destination, SetMember);
+# define BitScanForwardAffinity(Index, Mask) \
+    BitScanForward(Index, Mask)
 #endif
 
 /* GLOBALS *******************************************************************/
@@ -27,13 +35,230 @@ ULONG_PTR KiIdleSMTSummary;
 
 /* FUNCTIONS *****************************************************************/
 
+#ifdef CONFIG_SMP
+
+//
+// Acquires the locks of two PRCBs in processor order, so that two processors
+// locking each other's PRCB cannot deadlock.
+//
+FORCEINLINE
+VOID
+KiAcquireTwoPrcbLocks(IN PKPRCB FirstPrcb,
+                      IN PKPRCB SecondPrcb)
+{
+    if (FirstPrcb == SecondPrcb)
+    {
+        KiAcquirePrcbLock(FirstPrcb);
+    }
+    else if (FirstPrcb->Number < SecondPrcb->Number)
+    {
+        KiAcquirePrcbLock(FirstPrcb);
+        KiAcquirePrcbLock(SecondPrcb);
+    }
+    else
+    {
+        KiAcquirePrcbLock(SecondPrcb);
+        KiAcquirePrcbLock(FirstPrcb);
+    }
+}
+
+FORCEINLINE
+VOID
+KiReleaseTwoPrcbLocks(IN PKPRCB FirstPrcb,
+                      IN PKPRCB SecondPrcb)
+{
+    KiReleasePrcbLock(FirstPrcb);
+    if (FirstPrcb != SecondPrcb) KiReleasePrcbLock(SecondPrcb);
+}
+
+//
+// Picks the processor an idle set should hand the thread to: the ideal
+// processor first, then the one the thread last ran on, whose caches may
+// still be warm, then the current one.
+//
+static
+ULONG
+KiSelectIdleProcessor(IN PKTHREAD Thread,
+                      IN KAFFINITY IdleSet)
+{
+    ULONG Processor;
+
+    ASSERT(IdleSet != 0);
+
+    Processor = Thread->IdealProcessor;
+    if (IdleSet & AFFINITY_MASK(Processor)) return Processor;
+
+    Processor = Thread->NextProcessor;
+    if (IdleSet & AFFINITY_MASK(Processor)) return Processor;
+
+    Processor = KeGetCurrentProcessorNumber();
+    if (IdleSet & AFFINITY_MASK(Processor)) return Processor;
+
+    BitScanForwardAffinity(&Processor, IdleSet);
+    return Processor;
+}
+
+//
+// Returns the priority of the thread a processor runs or is about to run.
+//
+static
+KPRIORITY
+KiGetProcessorPriority(IN PKPRCB Prcb)
+{
+    PKTHREAD Thread;
+    KPRIORITY Priority;
+
+    KiAcquirePrcbLock(Prcb);
+    Thread = Prcb->NextThread ? Prcb->NextThread : Prcb->CurrentThread;
+    Priority = Thread->Priority;
+    KiReleasePrcbLock(Prcb);
+
+    return Priority;
+}
+
+//
+// Picks the processor a thread should go to when none of its processors is
+// idle: the ideal or last processor, unless only another one is running
+// something the thread can preempt.
+//
+static
+ULONG
+KiSelectCandidateProcessor(IN PKTHREAD Thread,
+                           IN KAFFINITY Affinity)
+{
+    ULONG Processor, Number;
+    KAFFINITY Set;
+    KPRIORITY Priority, LowestPriority;
+
+    /* Start with the ideal processor, then the last one */
+    Processor = Thread->IdealProcessor;
+    if (!(Affinity & AFFINITY_MASK(Processor)))
+    {
+        Processor = Thread->NextProcessor;
+        if (!(Affinity & AFFINITY_MASK(Processor)))
+        {
+            BitScanForwardAffinity(&Processor, Affinity);
+        }
+    }
+
+    /* Stay there if the thread can preempt it */
+    LowestPriority = KiGetProcessorPriority(KiProcessorBlock[Processor]);
+    if (LowestPriority < Thread->Priority) return Processor;
+
+    /* Otherwise look for the processor running the least important thread */
+    Set = Affinity & ~AFFINITY_MASK(Processor);
+    while (Set)
+    {
+        BitScanForwardAffinity(&Number, Set);
+        Set &= ~AFFINITY_MASK(Number);
+
+        Priority = KiGetProcessorPriority(KiProcessorBlock[Number]);
+        if ((Priority < LowestPriority) && (Priority < Thread->Priority))
+        {
+            LowestPriority = Priority;
+            Processor = Number;
+        }
+    }
+
+    return Processor;
+}
+
+//
+// Removes the highest priority thread that may run on the target processor
+// from the ready lists of the source processor. Both PRCB locks must be held.
+//
+static
+PKTHREAD
+KiStealReadyThread(IN PKPRCB SourcePrcb,
+                   IN PKPRCB TargetPrcb)
+{
+    ULONG PrioritySet;
+    LONG Priority;
+    PLIST_ENTRY ListHead, ListEntry;
+    PKTHREAD Thread;
+
+    PrioritySet = SourcePrcb->ReadySummary;
+    while (PrioritySet)
+    {
+        BitScanReverse((PULONG)&Priority, PrioritySet);
+        PrioritySet &= ~PRIORITY_MASK(Priority);
+
+        /* Find the first thread at this priority allowed on the target */
+        ListHead = &SourcePrcb->DispatcherReadyListHead[Priority];
+        for (ListEntry = ListHead->Flink;
+             ListEntry != ListHead;
+             ListEntry = ListEntry->Flink)
+        {
+            Thread = CONTAINING_RECORD(ListEntry, KTHREAD, WaitListEntry);
+            ASSERT(Thread->State == Ready);
+            ASSERT(Thread->NextProcessor == SourcePrcb->Number);
+
+            if (Thread->Affinity & TargetPrcb->SetMember)
+            {
+                /* Take it off the source processor */
+                if (RemoveEntryList(&Thread->WaitListEntry))
+                {
+                    SourcePrcb->ReadySummary ^= PRIORITY_MASK(Priority);
+                }
+
+                return Thread;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+#endif /* CONFIG_SMP */
+
 PKTHREAD
 FASTCALL
 KiIdleSchedule(IN PKPRCB Prcb)
 {
-    /* FIXME: TODO */
-    ASSERTMSG("SMP: Not yet implemented\n", FALSE);
-    return NULL;
+    PKTHREAD Thread = NULL;
+#ifdef CONFIG_SMP
+    ULONG Number;
+    PKPRCB SourcePrcb;
+
+    /* Called from the idle loop, once each time the processor goes idle */
+    ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
+    Prcb->IdleSchedule = FALSE;
+
+    /* Look for work on our own ready lists first, then on the others' */
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number++)
+    {
+        SourcePrcb = KiProcessorBlock[(Prcb->Number + Number) % KeNumberProcessors];
+
+        /* Don't lock processors with nothing ready */
+        if (!SourcePrcb->ReadySummary) continue;
+
+        KiAcquireTwoPrcbLocks(Prcb, SourcePrcb);
+
+        /* Someone may have given us a thread in the meantime */
+        if (Prcb->NextThread)
+        {
+            KiReleaseTwoPrcbLocks(Prcb, SourcePrcb);
+            break;
+        }
+
+        Thread = KiStealReadyThread(SourcePrcb, Prcb);
+        if (Thread)
+        {
+            /* Run it here, we are no longer idle */
+            Thread->NextProcessor = Prcb->Number;
+            Thread->State = Standby;
+            Prcb->NextThread = Thread;
+            InterlockedAndSetMember(&KiIdleSummary, ~Prcb->SetMember);
+        }
+
+        KiReleaseTwoPrcbLocks(Prcb, SourcePrcb);
+        if (Thread) break;
+    }
+#else
+    UNREFERENCED_PARAMETER(Prcb);
+#endif
+
+    return Thread;
 }
 
 VOID
@@ -83,6 +308,9 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     ULONG Processor = 0;
     KPRIORITY OldPriority;
     PKTHREAD NextThread;
+#ifdef CONFIG_SMP
+    KAFFINITY Affinity, IdleSet;
+#endif
 
     /* Sanity checks */
     ASSERT(Thread->State == DeferredReady);
@@ -228,6 +456,49 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     OldPriority = Thread->Priority;
     Thread->Preempted = FALSE;
 
+#ifdef CONFIG_SMP
+    /* Only the processors in the thread's affinity can run it */
+    Affinity = Thread->Affinity & KeActiveProcessors;
+    ASSERT(Affinity != 0);
+
+    /* Check if any of them is idle */
+    IdleSet = KiIdleSummary & Affinity;
+    while (IdleSet)
+    {
+        /* Pick one and lock its PRCB */
+        Processor = KiSelectIdleProcessor(Thread, IdleSet);
+        Prcb = KiProcessorBlock[Processor];
+        KiAcquirePrcbLock(Prcb);
+
+        /* Make sure it is still idle */
+        if ((KiIdleSummary & Prcb->SetMember) && !(Prcb->NextThread))
+        {
+            /* Clear its idle bit and set this thread as the next one */
+            InterlockedAndSetMember(&KiIdleSummary, ~Prcb->SetMember);
+            Thread->NextProcessor = (UCHAR)Processor;
+            Thread->State = Standby;
+            Prcb->NextThread = Thread;
+
+            /* Unlock the PRCB and wake the processor up if it isn't us */
+            KiReleasePrcbLock(Prcb);
+            if (KeGetCurrentProcessorNumber() != Processor)
+            {
+                KiIpiSend(AFFINITY_MASK(Processor), IPI_DPC);
+            }
+            return;
+        }
+
+        /* Somebody beat us to it, try the next one */
+        KiReleasePrcbLock(Prcb);
+        IdleSet &= ~AFFINITY_MASK(Processor);
+        IdleSet &= KiIdleSummary;
+    }
+
+    /* None is idle, find the processor to preempt or queue on and lock it */
+    Processor = KiSelectCandidateProcessor(Thread, Affinity);
+    Prcb = KiProcessorBlock[Processor];
+    KiAcquirePrcbLock(Prcb);
+#else
     /* Queue the thread on CPU 0 and get the PRCB and lock it */
     Thread->NextProcessor = 0;
     Prcb = KiProcessorBlock[0];
@@ -245,6 +516,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         KiReleasePrcbLock(Prcb);
         return;
     }
+#endif
 
     /* Set the CPU number */
     Thread->NextProcessor = (UCHAR)Processor;
@@ -278,7 +550,8 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     {
         /* Set the next thread as the current thread */
         NextThread = Prcb->CurrentThread;
-        if (OldPriority > NextThread->Priority)
+        if ((OldPriority > NextThread->Priority) ||
+            (NextThread == Prcb->IdleThread))
         {
             /* Preempt it if it's already running */
             if (NextThread->State == Running) NextThread->Preempted = TRUE;
@@ -287,6 +560,14 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
             Thread->State = Standby;
             Prcb->NextThread = Thread;
 
+#ifdef CONFIG_SMP
+            /* The processor may have gone idle after we looked */
+            if (NextThread == Prcb->IdleThread)
+            {
+                InterlockedAndSetMember(&KiIdleSummary, ~Prcb->SetMember);
+            }
+#endif
+
             /* Release the lock */
             KiReleasePrcbLock(Prcb);
 
@@ -341,7 +622,6 @@ KiSelectNextThread(IN PKPRCB Prcb)
         Prcb->IdleSchedule = TRUE;
 
         /* FIXME: SMT support */
-        ASSERTMSG("SMP: Not yet implemented\n", FALSE);
     }
 
     /* Sanity checks and return the thread */
@@ -385,8 +665,9 @@ KiSwapThread(IN PKTHREAD CurrentThread,
         }
         else
         {
-            /* Set the idle summary */
+            /* Set the idle summary and look for work elsewhere once idle */
             InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+            Prcb->IdleSchedule = TRUE;
 
             /* Schedule the idle thread */
             NextThread = Prcb->IdleThread;
@@ -150,7 +150,7 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
     {
         if (Priority)
         {
-            Status = MmPageOutPhysicalAddress(CurrentPage);
+            Status = MiPageOutPhysicalAddress(CurrentPage, TRUE);
             if (NT_SUCCESS(Status))
             {
                 DPRINT("Succeeded\n");
@@ -248,7 +248,7 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
             {
                 /* Nobody accessed this page since the last time we check. Time to clean up */
 
-                Status = MmPageOutPhysicalAddress(CurrentPage);
+                Status = MiPageOutPhysicalAddress(CurrentPage, TRUE);
                 if (NT_SUCCESS(Status))
                 {
                     if (CurrentPage == FirstPage)
@@ -271,6 +271,7 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
         else if (CurrentPage == FirstPage)
         {
             DPRINT1("We are back at the start, abort!\n");
+            MiFlushPageOutClusters();
             return STATUS_SUCCESS;
         }
     }
@@ -282,6 +283,9 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
         MiReleasePfnLock(OldIrql);
     }
 
+    /* Write out what is left of the dirty pages and free them */
+    MiFlushPageOutClusters();
+
     return STATUS_SUCCESS;
 }
 
@@ -144,18 +144,18 @@ MmShowOutOfSpaceMessagePagingFile(VOID)
 
 NTSTATUS
 NTAPI
-MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+MmWriteToSwapPages(
+    _In_ SWAPENTRY SwapEntry,
+    _In_ PMDL Mdl,
+    _In_ PKEVENT Event,
+    _Out_ PIO_STATUS_BLOCK Iosb)
 {
     ULONG i;
     ULONG_PTR offset;
     LARGE_INTEGER file_offset;
-    IO_STATUS_BLOCK Iosb;
-    NTSTATUS Status;
-    KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(PFN_NUMBER)];
-    PMDL Mdl = (PMDL)MdlBase;
+    PKPRCB Prcb;
 
-    DPRINT("MmWriteToSwapPage\n");
+    DPRINT("MmWriteToSwapPages\n");
 
     if (SwapEntry == 0)
     {
@@ -173,18 +173,39 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
+    /* The pages of the MDL go to consecutive slots, one I/O for all of them */
+    Prcb = KeGetCurrentPrcb();
+    InterlockedIncrement(&Prcb->MmDirtyWriteIoCount);
+    InterlockedExchangeAdd(&Prcb->MmDirtyPagesWriteCount, Mdl->ByteCount >> PAGE_SHIFT);
+
+    file_offset.QuadPart = offset * PAGE_SIZE;
+
+    KeClearEvent(Event);
+    return IoSynchronousPageWrite(MmPagingFile[i]->FileObject,
+                                  Mdl,
+                                  &file_offset,
+                                  Event,
+                                  Iosb);
+}
+
+NTSTATUS
+NTAPI
+MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+{
+    IO_STATUS_BLOCK Iosb;
+    NTSTATUS Status;
+    KEVENT Event;
+    UCHAR MdlBase[sizeof(MDL) + sizeof(PFN_NUMBER)];
+    PMDL Mdl = (PMDL)MdlBase;
+
+    DPRINT("MmWriteToSwapPage\n");
+
     MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
     MmBuildMdlFromPages(Mdl, &Page);
     Mdl->MdlFlags |= MDL_PAGES_LOCKED;
 
-    file_offset.QuadPart = offset * PAGE_SIZE;
-
     KeInitializeEvent(&Event, NotificationEvent, FALSE);
-    Status = IoSynchronousPageWrite(MmPagingFile[i]->FileObject,
-                                    Mdl,
-                                    &file_offset,
-                                    &Event,
-                                    &Iosb);
+    Status = MmWriteToSwapPages(SwapEntry, Mdl, &Event, &Iosb);
     if (Status == STATUS_PENDING)
     {
         KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
@@ -305,7 +326,7 @@ MmFreeSwapPage(SWAPENTRY Entry)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    RtlClearBit(PagingFile->Bitmap, off >> 5);
+    RtlClearBit(PagingFile->Bitmap, (ULONG)off);
 
     PagingFile->FreeSpace++;
     PagingFile->CurrentUsage--;
@@ -317,48 +338,79 @@ MmFreeSwapPage(SWAPENTRY Entry)
     KeReleaseGuardedMutex(&MmPageFileCreationLock);
 }
 
-SWAPENTRY
+ULONG
 NTAPI
-MmAllocSwapPage(VOID)
+MmAllocSwapCluster(
+    _In_ ULONG Count,
+    _Out_writes_to_(Count, return) SWAPENTRY *Entries)
 {
-    ULONG i;
+    ULONG i, j;
     ULONG off;
-    SWAPENTRY entry;
+    ULONG Run;
+    PMMPAGING_FILE PagingFile;
+
+    ASSERT(Count != 0);
 
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
 
     if (MiFreeSwapPages == 0)
     {
         KeReleaseGuardedMutex(&MmPageFileCreationLock);
-        return(0);
+        return 0;
     }
 
-    for (i = 0; i < MAX_PAGING_FILES; i++)
+    /*
+     * Take the longest run we can get, halving the request on fragmented
+     * files. Each file hands out slots from where the last run ended so
+     * that pages written together stay together.
+     */
+    for (Run = min(Count, MiFreeSwapPages); Run != 0; Run >>= 1)
     {
-        if (MmPagingFile[i] != NULL &&
-                MmPagingFile[i]->FreeSpace >= 1)
+        for (i = 0; i < MAX_PAGING_FILES; i++)
         {
-            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1, 0);
+            PagingFile = MmPagingFile[i];
+            if (PagingFile == NULL || PagingFile->FreeSpace < Run)
+                continue;
+
+            off = RtlFindClearBitsAndSet(PagingFile->Bitmap, Run, PagingFile->AllocationHint);
             if (off == 0xFFFFFFFF)
-            {
-                KeBugCheck(MEMORY_MANAGEMENT);
-                KeReleaseGuardedMutex(&MmPageFileCreationLock);
-                return(STATUS_UNSUCCESSFUL);
-            }
-            MiUsedSwapPages++;
-            MiFreeSwapPages--;
-            UpdateTotalCommittedPages(1);
+                continue;
+
+            PagingFile->AllocationHint = off + Run;
+            PagingFile->FreeSpace -= Run;
+            PagingFile->CurrentUsage += Run;
+
+            MiUsedSwapPages += Run;
+            MiFreeSwapPages -= Run;
+            UpdateTotalCommittedPages(Run);
 
             KeReleaseGuardedMutex(&MmPageFileCreationLock);
 
-            entry = ENTRY_FROM_FILE_OFFSET(i, off + 1);
-            return(entry);
+            for (j = 0; j < Run; j++)
+            {
+                Entries[j] = ENTRY_FROM_FILE_OFFSET(i, off + j + 1);
+            }
+            return Run;
         }
     }
 
     KeReleaseGuardedMutex(&MmPageFileCreationLock);
     KeBugCheck(MEMORY_MANAGEMENT);
-    return(0);
+    return 0;
+}
+
+SWAPENTRY
+NTAPI
+MmAllocSwapPage(VOID)
+{
+    SWAPENTRY entry;
+
+    if (MmAllocSwapCluster(1, &entry) == 0)
+    {
+        return(0);
+    }
+
+    return(entry);
 }
 
 NTSTATUS
@@ -792,6 +844,14 @@ EarlyQuit:
                         (ULONG)(PagingFile->MaximumSize));
     RtlClearAllBits(PagingFile->Bitmap);
 
+    /* Slots past the current size are not backed by the file yet */
+    if (PagingFile->MaximumSize > PagingFile->FreeSpace)
+    {
+        RtlSetBits(PagingFile->Bitmap,
+                   (ULONG)PagingFile->FreeSpace,
+                   (ULONG)(PagingFile->MaximumSize - PagingFile->FreeSpace));
+    }
+
     /* Insert the new paging file information into the list */
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
     /* Ensure the corresponding slot is empty yet */
@@ -20,6 +20,17 @@
 
 static NPAGED_LOOKASIDE_LIST RmapLookasideList;
 
+/*
+ * Only the balancer pages out in clusters. One cluster is written while
+ * the other one is being filled.
+ */
+static MM_PAGE_OUT_CLUSTER MiPageOutClusters[2];
+static ULONG MiPageOutClusterIndex;
+
+/* The pages of the cluster are the PFN array of its MDL */
+C_ASSERT(FIELD_OFFSET(MM_PAGE_OUT_CLUSTER, Page) ==
+         FIELD_OFFSET(MM_PAGE_OUT_CLUSTER, Mdl) + sizeof(MDL));
+
 /* FUNCTIONS ****************************************************************/
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
@@ -44,11 +55,239 @@ MmInitializeRmapList(VOID)
                                      sizeof(MM_RMAP_ENTRY),
                                      TAG_RMAP,
                                      50);
+
+    KeInitializeEvent(&MiPageOutClusters[0].Event, NotificationEvent, FALSE);
+    KeInitializeEvent(&MiPageOutClusters[1].Event, NotificationEvent, FALSE);
+}
+
+static
+VOID
+MiRestorePageOut(
+    _In_ PEPROCESS Process,
+    _In_ PVOID Address,
+    _In_ PFN_NUMBER Page,
+    _In_ PMEMORY_AREA MemoryArea)
+{
+    PMM_REGION Region = MmFindRegion((PVOID)MA_GetStartingAddress(MemoryArea),
+            &MemoryArea->SectionData.RegionListHead,
+            Address, NULL);
+
+    /* Let this page in the Process VM */
+    MmCreateVirtualMapping(Process, Address, Region->Protect, Page);
+    MmInsertRmap(Page, Process, Address);
+    MmSetDirtyPage(Process, Address);
+}
+
+/*
+ * Called once the page was written to the page file, with the wait entry
+ * still in the process and the references taken by the page-out.
+ */
+static
+NTSTATUS
+MiFinishPageOut(
+    _In_ PEPROCESS Process,
+    _In_ PVOID Address,
+    _In_ PFN_NUMBER Page,
+    _In_ PMEMORY_AREA MemoryArea,
+    _In_ SWAPENTRY SwapEntry,
+    _In_ NTSTATUS Status)
+{
+    PMMSUPPORT AddressSpace = &Process->Vm;
+    SWAPENTRY Dummy;
+#if DBG
+    KIRQL OldIrql;
+#endif
+
+    MmLockAddressSpace(AddressSpace);
+    if (Process != PsInitialSystemProcess)
+        KeAttachProcess(&Process->Pcb);
+
+    MmDeletePageFileMapping(Process, Address, &Dummy);
+    ASSERT(Dummy == MM_WAIT_ENTRY);
+
+    /* This Swap Entry is either in the process now or useless to us */
+    MmSetSavedSwapEntryPage(Page, 0);
+
+    if (!NT_SUCCESS(Status))
+    {
+        /* We failed at saving the content of this page. Keep it in */
+        MmFreeSwapPage(SwapEntry);
+        MiRestorePageOut(Process, Address, Page, MemoryArea);
+
+        MmUnlockAddressSpace(AddressSpace);
+        if (Process != PsInitialSystemProcess)
+            KeDetachProcess();
+        ExReleaseRundownProtection(&Process->RundownProtect);
+        ObDereferenceObject(Process);
+
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* Keep this in the process VM */
+    MmCreatePageFileMapping(Process, Address, SwapEntry);
+
+    /* We can finally let this page go */
+    MmUnlockAddressSpace(AddressSpace);
+    if (Process != PsInitialSystemProcess)
+        KeDetachProcess();
+#if DBG
+    OldIrql = MiAcquirePfnLock();
+    ASSERT(MmGetRmapListHeadPage(Page) == NULL);
+    MiReleasePfnLock(OldIrql);
+#endif
+    MmReleasePageMemoryConsumer(MC_USER, Page);
+
+    ExReleaseRundownProtection(&Process->RundownProtect);
+    ObDereferenceObject(Process);
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+MiStartPageOutCluster(
+    _Inout_ PMM_PAGE_OUT_CLUSTER Cluster)
+{
+    ULONG i;
+
+    ASSERT(Cluster->Count != 0);
+    ASSERT(!Cluster->Pending);
+
+    /* Give back the slots that we did not get pages for */
+    for (i = Cluster->Count; i < Cluster->Reserved; i++)
+    {
+        MmFreeSwapPage(Cluster->SwapEntry[i]);
+    }
+    Cluster->Reserved = Cluster->Count;
+
+    /* The slots are contiguous, so all the pages go out in one write */
+    MmInitializeMdl(&Cluster->Mdl, NULL, Cluster->Count * PAGE_SIZE);
+    Cluster->Mdl.MdlFlags |= MDL_PAGES_LOCKED;
+
+    Cluster->Status = MmWriteToSwapPages(Cluster->SwapEntry[0],
+                                         &Cluster->Mdl,
+                                         &Cluster->Event,
+                                         &Cluster->Iosb);
+    Cluster->Pending = (Cluster->Status == STATUS_PENDING);
+}
+
+static
+VOID
+MiCompletePageOutCluster(
+    _Inout_ PMM_PAGE_OUT_CLUSTER Cluster)
+{
+    ULONG i;
+
+    if (Cluster->Count == 0)
+        return;
+
+    if (Cluster->Pending)
+    {
+        KeWaitForSingleObject(&Cluster->Event, Executive, KernelMode, FALSE, NULL);
+        Cluster->Status = Cluster->Iosb.Status;
+        Cluster->Pending = FALSE;
+    }
+
+    if (Cluster->Mdl.MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+    {
+        MmUnmapLockedPages(Cluster->Mdl.MappedSystemVa, &Cluster->Mdl);
+    }
+
+    for (i = 0; i < Cluster->Count; i++)
+    {
+        MiFinishPageOut(Cluster->Process[i],
+                        Cluster->Address[i],
+                        Cluster->Page[i],
+                        Cluster->MemoryArea[i],
+                        Cluster->SwapEntry[i],
+                        Cluster->Status);
+    }
+
+    Cluster->Count = 0;
+    Cluster->Reserved = 0;
+}
+
+static
+VOID
+MiSwitchPageOutCluster(VOID)
+{
+    /* Start writing the current cluster and get the other one ready */
+    MiStartPageOutCluster(&MiPageOutClusters[MiPageOutClusterIndex]);
+    MiPageOutClusterIndex ^= 1;
+    MiCompletePageOutCluster(&MiPageOutClusters[MiPageOutClusterIndex]);
+}
+
+static
+SWAPENTRY
+MiReservePageOutSlot(VOID)
+{
+    PMM_PAGE_OUT_CLUSTER Cluster = &MiPageOutClusters[MiPageOutClusterIndex];
+
+    /* Take a run of slots for the whole cluster at once */
+    if (Cluster->Reserved == 0)
+    {
+        Cluster->Reserved = MmAllocSwapCluster(MI_PAGE_OUT_CLUSTER_SIZE, Cluster->SwapEntry);
+        if (Cluster->Reserved == 0)
+            return 0;
+    }
+
+    ASSERT(Cluster->Count < Cluster->Reserved);
+    return Cluster->SwapEntry[Cluster->Count];
+}
+
+static
+VOID
+MiQueuePageOut(
+    _In_ PEPROCESS Process,
+    _In_ PVOID Address,
+    _In_ PFN_NUMBER Page,
+    _In_ PMEMORY_AREA MemoryArea,
+    _In_ SWAPENTRY SwapEntry)
+{
+    PMM_PAGE_OUT_CLUSTER Cluster = &MiPageOutClusters[MiPageOutClusterIndex];
+    ULONG i = Cluster->Count;
+
+    ASSERT(Cluster->SwapEntry[i] == SwapEntry);
+
+    Cluster->Process[i] = Process;
+    Cluster->Address[i] = Address;
+    Cluster->MemoryArea[i] = MemoryArea;
+    Cluster->Page[i] = Page;
+    Cluster->Count++;
+
+    if (Cluster->Count == Cluster->Reserved)
+        MiSwitchPageOutCluster();
+}
+
+VOID
+NTAPI
+MiFlushPageOutClusters(VOID)
+{
+    PMM_PAGE_OUT_CLUSTER Cluster = &MiPageOutClusters[MiPageOutClusterIndex];
+    ULONG i;
+
+    if (Cluster->Count != 0)
+    {
+        MiStartPageOutCluster(Cluster);
+    }
+    else
+    {
+        for (i = 0; i < Cluster->Reserved; i++)
+        {
+            MmFreeSwapPage(Cluster->SwapEntry[i]);
+        }
+        Cluster->Reserved = 0;
+    }
+
+    MiCompletePageOutCluster(&MiPageOutClusters[0]);
+    MiCompletePageOutCluster(&MiPageOutClusters[1]);
 }
 
 NTSTATUS
 NTAPI
-MmPageOutPhysicalAddress(PFN_NUMBER Page)
+MiPageOutPhysicalAddress(
+    _In_ PFN_NUMBER Page,
+    _In_ BOOLEAN Cluster)
 {
     PMM_RMAP_ENTRY entry;
     PMEMORY_AREA MemoryArea;
@@ -183,20 +422,28 @@ GetEntry:
             /* Check if we should write it back to the page file */
             SwapEntry = MmGetSavedSwapEntryPage(Page);
 
-            if ((SwapEntry == 0) && Dirty)
+            if (Dirty)
             {
-                /* We don't have a Swap entry, yet the page is dirty. Get one */
-                SwapEntry = MmAllocSwapPage();
-                if (!SwapEntry)
+                if (Cluster)
                 {
-                    PMM_REGION Region = MmFindRegion((PVOID)MA_GetStartingAddress(MemoryArea),
-                            &MemoryArea->SectionData.RegionListHead,
-                            Address, NULL);
+                    /* The old copy is stale anyway, write it next to the rest of the cluster */
+                    if (SwapEntry)
+                    {
+                        MmSetSavedSwapEntryPage(Page, 0);
+                        MmFreeSwapPage(SwapEntry);
+                    }
+                    SwapEntry = MiReservePageOutSlot();
+                }
+                else if (SwapEntry == 0)
+                {
+                    /* We don't have a Swap entry, yet the page is dirty. Get one */
+                    SwapEntry = MmAllocSwapPage();
+                }
 
+                if (!SwapEntry)
+                {
                     /* We can't, so let this page in the Process VM */
-                    MmCreateVirtualMapping(Process, Address, Region->Protect, Page);
-                    MmInsertRmap(Page, Process, Address);
-                    MmSetDirtyPage(Process, Address);
+                    MiRestorePageOut(Process, Address, Page, MemoryArea);
 
                     MmUnlockAddressSpace(AddressSpace);
                     if (Process != PsInitialSystemProcess)
@@ -206,46 +453,22 @@ GetEntry:
 
                     return STATUS_UNSUCCESSFUL;
                 }
-            }
-
-            if (Dirty)
-            {
-                SWAPENTRY Dummy;
 
                 /* Put a wait entry into the process and unlock */
                 MmCreatePageFileMapping(Process, Address, MM_WAIT_ENTRY);
+                if (Process != PsInitialSystemProcess)
+                    KeDetachProcess();
                 MmUnlockAddressSpace(AddressSpace);
 
-                Status = MmWriteToSwapPage(SwapEntry, Page);
-
-                MmLockAddressSpace(AddressSpace);
-                MmDeletePageFileMapping(Process, Address, &Dummy);
-                ASSERT(Dummy == MM_WAIT_ENTRY);
-
-                if (!NT_SUCCESS(Status))
+                if (Cluster)
                 {
-                    /* We failed at saving the content of this page. Keep it in */
-                    PMM_REGION Region = MmFindRegion((PVOID)MA_GetStartingAddress(MemoryArea),
-                            &MemoryArea->SectionData.RegionListHead,
-                            Address, NULL);
-
-                    /* This Swap Entry is useless to us */
-                    MmSetSavedSwapEntryPage(Page, 0);
-                    MmFreeSwapPage(SwapEntry);
-
-                    /* We can't, so let this page in the Process VM */
-                    MmCreateVirtualMapping(Process, Address, Region->Protect, Page);
-                    MmInsertRmap(Page, Process, Address);
-                    MmSetDirtyPage(Process, Address);
-
-                    MmUnlockAddressSpace(AddressSpace);
-                    if (Process != PsInitialSystemProcess)
-                        KeDetachProcess();
-                    ExReleaseRundownProtection(&Process->RundownProtect);
-                    ObDereferenceObject(Process);
-
-                    return STATUS_UNSUCCESSFUL;
+                    /* The page goes away when its cluster has been written */
+                    MiQueuePageOut(Process, Address, Page, MemoryArea, SwapEntry);
+                    return STATUS_SUCCESS;
                 }
+
+                Status = MmWriteToSwapPage(SwapEntry, Page);
+                return MiFinishPageOut(Process, Address, Page, MemoryArea, SwapEntry, Status);
             }
 
             if (SwapEntry)
@@ -322,6 +545,13 @@ WriteSegment:
     return STATUS_UNSUCCESSFUL;
 }
 
+NTSTATUS
+NTAPI
+MmPageOutPhysicalAddress(PFN_NUMBER Page)
+{
+    return MiPageOutPhysicalAddress(Page, FALSE);
+}
+
 VOID
 NTAPI
 MmInsertRmap(PFN_NUMBER Page, PEPROCESS Process,
@@ -63,6 +63,9 @@ extern MMSESSION MmSession;
 
 static LARGE_INTEGER TinyTime = {{-1L, -1L}};
 
+/* Maximum number of contiguous dirty pages MmFlushSegment writes with one I/O */
+#define MM_FLUSH_CLUSTER_PAGES 16
+
 #ifndef NEWCC
 KEVENT MmWaitPageEvent;
 
@@ -234,32 +237,36 @@ static GENERIC_MAPPING MmpSectionMapping =
 
 
 
+static
 NTSTATUS
-NTAPI
-MiWritePage(PMM_SECTION_SEGMENT Segment,
-            LONGLONG SegOffset,
-            PFN_NUMBER Page)
+MiWritePages(PMM_SECTION_SEGMENT Segment,
+             LONGLONG SegOffset,
+             PPFN_NUMBER Pages,
+             ULONG PageCount)
 /*
- * FUNCTION: write a page for a section backed memory area.
+ * FUNCTION: write a run of pages for a section backed memory area with a single I/O.
  * PARAMETERS:
- *       MemoryArea - Memory area to write the page for.
- *       Offset - Offset of the page to write.
- *       Page - Page which contains the data to write.
+ *       Segment - Segment to write the pages for.
+ *       SegOffset - Offset of the first page to write.
+ *       Pages - Pages which contain the data to write, in file order.
+ *       PageCount - Number of pages in the run.
  */
 {
     NTSTATUS Status;
     IO_STATUS_BLOCK IoStatus;
     KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(PFN_NUMBER)];
+    UCHAR MdlBase[sizeof(MDL) + MM_FLUSH_CLUSTER_PAGES * sizeof(PFN_NUMBER)];
     PMDL Mdl = (PMDL)MdlBase;
     PFILE_OBJECT FileObject = Segment->FileObject;
     LARGE_INTEGER FileOffset;
 
+    ASSERT(PageCount != 0 && PageCount <= MM_FLUSH_CLUSTER_PAGES);
+
     FileOffset.QuadPart = Segment->Image.FileOffset + SegOffset;
 
     RtlZeroMemory(MdlBase, sizeof(MdlBase));
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
+    MmInitializeMdl(Mdl, NULL, PageCount * PAGE_SIZE);
+    MmBuildMdlFromPages(Mdl, Pages);
     Mdl->MdlFlags |= MDL_PAGES_LOCKED;
 
     KeInitializeEvent(&Event, NotificationEvent, FALSE);
@@ -277,6 +284,21 @@ MiWritePage(PMM_SECTION_SEGMENT Segment,
     return Status;
 }
 
+NTSTATUS
+NTAPI
+MiWritePage(PMM_SECTION_SEGMENT Segment,
+            LONGLONG SegOffset,
+            PFN_NUMBER Page)
+/*
+ * FUNCTION: write a page for a section backed memory area.
+ * PARAMETERS:
+ *       MemoryArea - Memory area to write the page for.
+ *       Offset - Offset of the page to write.
+ *       Page - Page which contains the data to write.
+ */
+{
+    return MiWritePages(Segment, SegOffset, &Page, 1);
+}
 
 /*
  References:
@@ -4932,7 +4954,7 @@ MmFlushSegment(
     _Out_opt_ PIO_STATUS_BLOCK Iosb)
 {
     LARGE_INTEGER FlushStart, FlushEnd;
-    NTSTATUS Status;
+    NTSTATUS Status, WriteStatus;
 
     if (Offset)
     {
@@ -4984,28 +5006,85 @@ MmFlushSegment(
     FlushStart.QuadPart >>= PAGE_SHIFT;
     FlushStart.QuadPart <<= PAGE_SHIFT;
 
+    Status = STATUS_SUCCESS;
     while (FlushStart.QuadPart < FlushEnd.QuadPart)
     {
-        ULONG_PTR Entry = MmGetPageEntrySectionSegment(Segment, &FlushStart);
+        PFN_NUMBER Pages[MM_FLUSH_CLUSTER_PAGES];
+        LARGE_INTEGER ClusterStart = FlushStart;
+        ULONG PageCount = 0;
+        ULONG_PTR Entry;
+        ULONG i;
 
-        if (IS_DIRTY_SSE(Entry))
+        /* Gather a run of contiguous dirty pages. Mark them as write in progress and clean,
+         * like MmCheckDirtySegment does, so that they stay around while we write them. */
+        while ((PageCount < MM_FLUSH_CLUSTER_PAGES) && (FlushStart.QuadPart < FlushEnd.QuadPart))
         {
-            MmCheckDirtySegment(Segment, &FlushStart, FALSE, FALSE);
+            Entry = MmGetPageEntrySectionSegment(Segment, &FlushStart);
+            if (!IS_DIRTY_SSE(Entry))
+                break;
 
-            if (Iosb)
-                Iosb->Information += PAGE_SIZE;
+            Pages[PageCount++] = PFN_FROM_SSE(Entry);
+
+            Entry = MAKE_SSE(PAGE_FROM_SSE(Entry), SHARE_COUNT_FROM_SSE(Entry) + 1);
+            Entry = WRITE_SSE(Entry);
+            MmSetPageEntrySectionSegment(Segment, &FlushStart, Entry);
+
+            FlushStart.QuadPart += PAGE_SIZE;
+        }
+
+        if (PageCount == 0)
+        {
+            FlushStart.QuadPart += PAGE_SIZE;
+            continue;
         }
 
-        FlushStart.QuadPart += PAGE_SIZE;
+        MmUnlockSectionSegment(Segment);
+
+        DPRINT("Writing %lu pages at offset %I64d for file %wZ\n",
+               PageCount, ClusterStart.QuadPart, &Segment->FileObject->FileName);
+        WriteStatus = MiWritePages(Segment, ClusterStart.QuadPart, Pages, PageCount);
+
+        MmLockSectionSegment(Segment);
+
+        for (i = 0; i < PageCount; i++)
+        {
+            LARGE_INTEGER PageOffset;
+            BOOLEAN DirtyAgain;
+
+            PageOffset.QuadPart = ClusterStart.QuadPart + i * PAGE_SIZE;
+            Entry = MmGetPageEntrySectionSegment(Segment, &PageOffset);
+            ASSERT(PFN_FROM_SSE(Entry) == Pages[i]);
+
+            /* Keep the page dirty if the write failed or someone dirtified it meanwhile */
+            DirtyAgain = !NT_SUCCESS(WriteStatus) || IS_DIRTY_SSE(Entry);
+
+            /* Drop the reference we got, deleting the write altogether. */
+            Entry = MAKE_SSE(Pages[i] << PAGE_SHIFT, SHARE_COUNT_FROM_SSE(Entry) - 1);
+            if (DirtyAgain)
+            {
+                Entry = DIRTY_SSE(Entry);
+            }
+            MmSetPageEntrySectionSegment(Segment, &PageOffset, Entry);
+        }
+
+        if (!NT_SUCCESS(WriteStatus))
+        {
+            DPRINT1("MiWritePages FAILED: Status 0x%08x!\n", WriteStatus);
+            Status = WriteStatus;
+        }
+        else if (Iosb)
+        {
+            Iosb->Information += PageCount * PAGE_SIZE;
+        }
     }
 
     MmUnlockSectionSegment(Segment);
     MmDereferenceSegment(Segment);
 
     if (Iosb)
-        Iosb->Status = STATUS_SUCCESS;
+        Iosb->Status = Status;
 
-    return STATUS_SUCCESS;
+    return Status;
 }
 
 _Requires_exclusive_lock_held_(Segment->Lock)
@@ -21,6 +21,18 @@ typedef struct _RTL_RANGE_ENTRY
     RTL_RANGE Range;
 } RTL_RANGE_ENTRY, *PRTL_RANGE_ENTRY;
 
+typedef struct _RTLP_PARALLEL_JOB
+{
+    PRTLP_PARALLEL_ROUTINE Routine;
+    PVOID Context;
+    ULONG Count;
+    volatile LONG NextIndex;
+    volatile LONG Remaining;
+    volatile LONG ReferenceCount;
+    KEVENT DoneEvent;
+    WORK_QUEUE_ITEM WorkItems[ANYSIZE_ARRAY];
+} RTLP_PARALLEL_JOB, *PRTLP_PARALLEL_JOB;
+
 PAGED_LOOKASIDE_LIST RtlpRangeListEntryLookasideList;
 SIZE_T RtlpAllocDeallocQueryBufferSize = 128;
 
@@ -101,6 +113,88 @@ RtlpGetMode(VOID)
    return KernelMode;
 }
 
+static
+VOID
+RtlpRunParallelJob(IN PRTLP_PARALLEL_JOB Job)
+{
+    LONG Index;
+
+    /* Grab indices until there are none left */
+    while ((Index = InterlockedIncrement(&Job->NextIndex) - 1) < (LONG)Job->Count)
+    {
+        Job->Routine(Job->Context, Index);
+
+        if (!InterlockedDecrement(&Job->Remaining))
+            KeSetEvent(&Job->DoneEvent, IO_NO_INCREMENT, FALSE);
+    }
+}
+
+static
+VOID
+RtlpDereferenceParallelJob(IN PRTLP_PARALLEL_JOB Job)
+{
+    if (!InterlockedDecrement(&Job->ReferenceCount))
+        ExFreePoolWithTag(Job, TAG_RTLP_PARALLEL);
+}
+
+static
+VOID
+NTAPI
+RtlpParallelWorker(IN PVOID Parameter)
+{
+    RtlpRunParallelJob(Parameter);
+    RtlpDereferenceParallelJob(Parameter);
+}
+
+VOID
+NTAPI
+RtlpRunInParallel(IN PRTLP_PARALLEL_ROUTINE Routine,
+                  IN PVOID Context,
+                  IN ULONG Count)
+{
+    PRTLP_PARALLEL_JOB Job = NULL;
+    ULONG Helpers, Index;
+
+    Helpers = min(Count, (ULONG)KeNumberProcessors) - 1;
+    if (Helpers && (KeGetCurrentIrql() == PASSIVE_LEVEL))
+    {
+        Job = ExAllocatePoolWithTag(NonPagedPool,
+                                    FIELD_OFFSET(RTLP_PARALLEL_JOB, WorkItems[Helpers]),
+                                    TAG_RTLP_PARALLEL);
+    }
+
+    /* Without helpers, or if they can't be had, do everything here */
+    if (!Job)
+    {
+        for (Index = 0; Index < Count; Index++)
+            Routine(Context, Index);
+        return;
+    }
+
+    Job->Routine = Routine;
+    Job->Context = Context;
+    Job->Count = Count;
+    Job->NextIndex = 0;
+    Job->Remaining = Count;
+    Job->ReferenceCount = Helpers + 1;
+    KeInitializeEvent(&Job->DoneEvent, NotificationEvent, FALSE);
+
+    for (Index = 0; Index < Helpers; Index++)
+    {
+        ExInitializeWorkItem(&Job->WorkItems[Index], RtlpParallelWorker, Job);
+        ExQueueWorkItem(&Job->WorkItems[Index], DelayedWorkQueue);
+    }
+
+    /*
+     * Work along with the helpers. We only wait for indices a helper has
+     * already picked up, so a starved work queue can't hold us up: helpers
+     * that start late find nothing to do and just drop their reference.
+     */
+    RtlpRunParallelJob(Job);
+    KeWaitForSingleObject(&Job->DoneEvent, Executive, KernelMode, FALSE, NULL);
+    RtlpDereferenceParallelJob(Job);
+}
+
 PVOID
 NTAPI
 RtlpAllocateMemory(ULONG Bytes,
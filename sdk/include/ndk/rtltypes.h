@@ -588,6 +588,20 @@ typedef NTSTATUS
     _In_ NTSTATUS ExitStatus
 );
 
+//
+// Thread Pool I/O Completion Callback
+//
+#if defined(NTOS_MODE_USER) && (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+typedef VOID
+(NTAPI *PTP_IO_CALLBACK)(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID Context,
+    _In_ PVOID ApcContext,
+    _In_ PIO_STATUS_BLOCK IoStatusBlock,
+    _In_ PTP_IO Io
+);
+#endif
+
 //
 // Declare empty structure definitions so that they may be referenced by
 // routines before they are defined
@@ -1453,6 +1467,20 @@ typedef struct _HEAP_LOCK
     };
 } HEAP_LOCK, *PHEAP_LOCK;
 
+//
+// COMPRESSED_DATA_INFO Reserved flags (ReactOS extension)
+//
+#define COMPRESSED_DATA_INFO_PARALLEL   0x01
+
+//
+// RTL Private Parallel Work Routine
+//
+typedef VOID
+(NTAPI *PRTLP_PARALLEL_ROUTINE)(
+    _In_ PVOID Context,
+    _In_ ULONG Index
+);
+
 //
 // RTL Range List Structures
 //
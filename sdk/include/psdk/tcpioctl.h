@@ -101,7 +101,9 @@
 #define AO_OPTION_PROTECT           38
 
 /* TCP connection options */
-#define TCP_SOCKET_NODELAY 1
+#define TCP_SOCKET_NODELAY     1
+#define TCP_SOCKET_WINDOW      2
+#define TCP_SOCKET_SEND_BUFFER 3
 
 typedef struct IFEntry
 {
@@ -149,6 +149,32 @@ typedef struct _AFD_TDI_HANDLE_DATA
     HANDLE TdiConnectionHandle;
 } AFD_TDI_HANDLE_DATA, *PAFD_TDI_HANDLE_DATA;
 
+/* Persistent readiness sets. The set is a control channel handle on which
+ * sockets are registered once; only sockets whose state changed are queued,
+ * and IOCTL_AFD_POLL_SET_WAIT harvests them in batches. */
+#define AFD_POLL_SET_ADD                0
+#define AFD_POLL_SET_MODIFY             1
+#define AFD_POLL_SET_REMOVE             2
+
+typedef struct _AFD_POLL_SET_UPDATE_INFO {
+    SOCKET				Handle;
+    ULONG				Operation;
+    ULONG				Events;
+    ULONG_PTR				Context;
+} AFD_POLL_SET_UPDATE_INFO, *PAFD_POLL_SET_UPDATE_INFO;
+
+typedef struct _AFD_POLL_SET_EVENT {
+    SOCKET				Handle;
+    ULONG				Events;
+    ULONG_PTR				Context;
+} AFD_POLL_SET_EVENT, *PAFD_POLL_SET_EVENT;
+
+typedef struct _AFD_POLL_SET_WAIT_INFO {
+    LARGE_INTEGER			Timeout;
+    ULONG				EventCount;
+    AFD_POLL_SET_EVENT			Events[1];
+} AFD_POLL_SET_WAIT_INFO, *PAFD_POLL_SET_WAIT_INFO;
+
 /* AFD Packet Endpoint Flags */
 #define AFD_ENDPOINT_CONNECTIONLESS	0x1
 #define AFD_ENDPOINT_MESSAGE_ORIENTED	0x10
@@ -262,6 +288,10 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_GET_PENDING_CONNECT_DATA	41
 #define AFD_VALIDATE_GROUP		42
 
+/* ReactOS extensions */
+#define AFD_POLL_SET_UPDATE		64
+#define AFD_POLL_SET_WAIT		65
+
 /* AFD IOCTLs */
 
 #define IOCTL_AFD_BIND \
@@ -336,6 +366,10 @@ typedef struct _AFD_TDI_HANDLE_DATA
   _AFD_CONTROL_CODE(AFD_ENUM_NETWORK_EVENTS, METHOD_NEITHER)
 #define IOCTL_AFD_VALIDATE_GROUP \
   _AFD_CONTROL_CODE(AFD_VALIDATE_GROUP, METHOD_NEITHER)
+#define IOCTL_AFD_POLL_SET_UPDATE \
+  _AFD_CONTROL_CODE(AFD_POLL_SET_UPDATE, METHOD_BUFFERED)
+#define IOCTL_AFD_POLL_SET_WAIT \
+  _AFD_CONTROL_CODE(AFD_POLL_SET_WAIT, METHOD_BUFFERED)
 
 typedef struct _AFD_SOCKET_INFORMATION {
     BOOL CommandChannel;
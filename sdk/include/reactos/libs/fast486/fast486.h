@@ -106,6 +106,10 @@
 
 #define FAST486_PAGE_SIZE 4096
 #define FAST486_CACHE_SIZE 32
+#define FAST486_HOST_TLB_ENTRIES 256
+#define FAST486_BLOCK_CACHE_SIZE 256
+#define FAST486_BLOCK_MAX_OPS 32
+#define FAST486_BLOCK_MAX_LENGTH 128
 
 /*
  * These are condiciones sine quibus non that should be respected, because
@@ -116,6 +120,13 @@
 C_ASSERT((FAST486_CACHE_SIZE >= sizeof(ULONG))
          && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE));
 
+/* The host TLB and the block cache are direct-mapped */
+C_ASSERT((FAST486_HOST_TLB_ENTRIES & (FAST486_HOST_TLB_ENTRIES - 1)) == 0);
+C_ASSERT((FAST486_BLOCK_CACHE_SIZE & (FAST486_BLOCK_CACHE_SIZE - 1)) == 0);
+
+/* Micro-op offsets and counts are stored in bytes */
+C_ASSERT((FAST486_BLOCK_MAX_OPS <= 0xFF) && (FAST486_BLOCK_MAX_LENGTH <= 0xFF));
+
 struct _FAST486_STATE;
 typedef struct _FAST486_STATE FAST486_STATE, *PFAST486_STATE;
 
@@ -244,6 +255,21 @@ VOID
     PFAST486_STATE State
 );
 
+/*
+ * Returns a host pointer to the start of the physical page containing
+ * the given address, or NULL if that page is not plain RAM (e.g. it is
+ * hooked or unmapped) and must keep going through the memory callbacks.
+ * When Write is TRUE, the page must be both readable and writable directly.
+ */
+typedef
+PVOID
+(FASTCALL *FAST486_MEM_MAP_PROC)
+(
+    PFAST486_STATE State,
+    ULONG Address,
+    BOOLEAN Write
+);
+
 typedef union _FAST486_REG
 {
     union
@@ -511,6 +537,44 @@ typedef union _FAST486_FPU_CONTROL_REG
     };
 } FAST486_FPU_CONTROL_REG, *PFAST486_FPU_CONTROL_REG;
 
+typedef struct _FAST486_HOST_TLB_ENTRY
+{
+    ULONG LinearPage;
+    BOOLEAN Usermode;
+    PUCHAR ReadPage;
+    PUCHAR WritePage;
+} FAST486_HOST_TLB_ENTRY, *PFAST486_HOST_TLB_ENTRY;
+
+typedef struct _FAST486_MICRO_OP
+{
+    UCHAR Type;
+    UCHAR Offset;
+    UCHAR Length;
+    UCHAR Operation;
+    UCHAR Register;
+    UCHAR SecondRegister;
+    ULONG Immediate;
+} FAST486_MICRO_OP, *PFAST486_MICRO_OP;
+
+typedef struct _FAST486_BLOCK
+{
+    ULONG Address;
+    BOOLEAN Size;
+    UCHAR Count;
+    UCHAR Length;
+    UCHAR Code[FAST486_BLOCK_MAX_LENGTH];
+    FAST486_MICRO_OP Ops[FAST486_BLOCK_MAX_OPS];
+} FAST486_BLOCK, *PFAST486_BLOCK;
+
+/*
+ * Storage for the pre-decoded blocks, allocated by the host because the
+ * library can't allocate memory by itself (see also the TLB).
+ */
+typedef struct _FAST486_BLOCK_CACHE
+{
+    FAST486_BLOCK Blocks[FAST486_BLOCK_CACHE_SIZE];
+} FAST486_BLOCK_CACHE, *PFAST486_BLOCK_CACHE;
+
 struct _FAST486_STATE
 {
     FAST486_MEM_READ_PROC MemReadCallback;
@@ -520,6 +584,7 @@ struct _FAST486_STATE
     FAST486_BOP_PROC BopCallback;
     FAST486_INT_ACK_PROC IntAckCallback;
     FAST486_FPU_PROC FpuCallback;
+    FAST486_MEM_MAP_PROC MemMapCallback;
     FAST486_REG GeneralRegs[FAST486_NUM_GEN_REGS];
     FAST486_SEG_REG SegmentRegs[FAST486_NUM_SEG_REGS];
     FAST486_REG InstPtr, SavedInstPtr;
@@ -539,6 +604,11 @@ struct _FAST486_STATE
     BOOLEAN DoNotInterrupt;
     PULONG Tlb;
     BOOLEAN TlbEmpty;
+    BOOLEAN HostTlbEmpty;
+    FAST486_HOST_TLB_ENTRY HostTlb[FAST486_HOST_TLB_ENTRIES];
+    PFAST486_BLOCK_CACHE BlockCache;
+    PFAST486_BLOCK CurrentBlock;
+    ULONG CurrentOp;
 #ifndef FAST486_NO_PREFETCH
     BOOLEAN PrefetchValid;
     ULONG PrefetchAddress;
@@ -568,6 +638,7 @@ Fast486Initialize(PFAST486_STATE         State,
                   FAST486_BOP_PROC       BopCallback,
                   FAST486_INT_ACK_PROC   IntAckCallback,
                   FAST486_FPU_PROC       FpuCallback,
+                  FAST486_MEM_MAP_PROC   MemMapCallback,
                   PULONG                 Tlb);
 
 VOID
@@ -619,6 +690,14 @@ VOID
 NTAPI
 Fast486Rewind(PFAST486_STATE State);
 
+VOID
+NTAPI
+Fast486InvalidateMemoryMap(PFAST486_STATE State);
+
+VOID
+NTAPI
+Fast486SetBlockCache(PFAST486_STATE State, PFAST486_BLOCK_CACHE BlockCache);
+
 #endif // _FAST486_H_
 
 /* EOF */
@@ -0,0 +1,55 @@
+/*
+ * COPYRIGHT:   See COPYING in the top level directory
+ * PROJECT:     ReactOS Ancillary Function Driver DLL
+ * FILE:        include/reactos/winsock/wspollset.h
+ * PURPOSE:     Readiness set extension functions
+ */
+#ifndef __WSPOLLSET_H
+#define __WSPOLLSET_H
+
+/*
+ * A readiness set is registered with sockets once and then waited on
+ * repeatedly; only sockets whose state changed are returned. The functions
+ * are queried with SIO_GET_EXTENSION_FUNCTION_POINTER on any socket of the
+ * provider and the set is closed with CloseHandle.
+ */
+#define WSAID_POLLSETCREATE \
+  {0x57db6a88,0xd673,0x4acb,{0x84,0x1f,0xa5,0xab,0xa9,0x43,0x3e,0x0d}}
+#define WSAID_POLLSETCONTROL \
+  {0x537fc1f5,0x10e7,0x4c03,{0xbf,0x76,0x38,0x1d,0x8f,0x98,0xcd,0x06}}
+#define WSAID_POLLSETWAIT \
+  {0xe9861869,0xfe42,0x4ba7,{0x87,0xaf,0xac,0x6b,0x76,0xd0,0x4f,0xad}}
+
+/* Operations of LPFN_WSAPOLLSETCONTROL */
+#define WSA_POLLSET_ADD     0
+#define WSA_POLLSET_MODIFY  1
+#define WSA_POLLSET_REMOVE  2
+
+typedef struct _WSAPOLLSET_EVENT {
+    SOCKET      Socket;
+    LONG        NetworkEvents;  /* FD_* */
+    ULONG_PTR   Context;
+} WSAPOLLSET_EVENT, *PWSAPOLLSET_EVENT, FAR *LPWSAPOLLSET_EVENT;
+
+typedef
+HANDLE
+(PASCAL FAR *LPFN_WSAPOLLSETCREATE)(VOID);
+
+typedef
+INT
+(PASCAL FAR *LPFN_WSAPOLLSETCONTROL)(
+    IN HANDLE hPollSet,
+    IN INT iOperation,
+    IN SOCKET s,
+    IN LONG lNetworkEvents,
+    IN ULONG_PTR Context);
+
+typedef
+INT
+(PASCAL FAR *LPFN_WSAPOLLSETWAIT)(
+    IN HANDLE hPollSet,
+    OUT LPWSAPOLLSET_EVENT lpEvents,
+    IN INT iMaxEvents,
+    IN INT iTimeout);
+
+#endif
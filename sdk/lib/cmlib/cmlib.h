@@ -117,6 +117,12 @@
         IN ULONG StartingIndex,
         IN ULONG NumberToSet);
 
+    VOID NTAPI
+    RtlClearBits(
+        IN PRTL_BITMAP BitMapHeader,
+        IN ULONG StartingIndex,
+        IN ULONG NumberToClear);
+
     VOID NTAPI
     RtlClearAllBits(
         IN PRTL_BITMAP BitMapHeader);
@@ -416,6 +422,10 @@ HvFreeCell(
    PHHIVE RegistryHive,
    HCELL_INDEX CellOffset);
 
+VOID CMAPI
+HvCompactFreeCells(
+   PHHIVE RegistryHive);
+
 BOOLEAN CMAPI
 HvMarkCellDirty(
    PHHIVE RegistryHive,
@@ -479,6 +489,14 @@ ULONG CMAPI
 HvpHiveHeaderChecksum(
    PHBASE_BLOCK HiveHeader);
 
+ULONG CMAPI
+HvpLogEntryChecksum(
+   PHV_LOG_ENTRY LogEntry);
+
+BOOLEAN CMAPI
+HvpGrowLogVector(
+   PHHIVE RegistryHive);
+
 
 /* Old-style Public "Cmlib" functions */
 
@@ -81,15 +81,6 @@ HvpGetCellData(
     return (PCELL_DATA)(HvpGetCellHeader(Hive, CellIndex) + 1);
 }
 
-static __inline LONG CMAPI
-HvpGetCellFullSize(
-    PHHIVE RegistryHive,
-    PVOID Cell)
-{
-    UNREFERENCED_PARAMETER(RegistryHive);
-    return ((PHCELL)Cell - 1)->Size;
-}
-
 LONG CMAPI
 HvGetCellSize(IN PHHIVE Hive,
               IN PVOID Address)
@@ -198,27 +189,59 @@ HvpComputeFreeListIndex(
     return Index;
 }
 
+/*
+ * Free cells are kept on doubly linked lists, one per size class. The
+ * first 16 classes hold a single cell size each, the remaining ones a
+ * power of two range of sizes. FreeSummary has a bit set for each class
+ * that is not empty, so a search can skip straight to the first class
+ * that may hold a large enough cell.
+ */
+typedef struct _HCELL_FREE_LINKS
+{
+    HCELL_INDEX Next;
+    HCELL_INDEX Prev;
+} HCELL_FREE_LINKS, *PHCELL_FREE_LINKS;
+
+#define HCELL_MIN_FREE_SIZE     (sizeof(HCELL) + sizeof(HCELL_FREE_LINKS))
+#define HCELL_EXACT_FREE_LISTS  16
+
+static __inline PHCELL_FREE_LINKS CMAPI
+HvpGetFreeLinks(
+    PHHIVE RegistryHive,
+    HCELL_INDEX CellIndex)
+{
+    return (PHCELL_FREE_LINKS)(HvpGetCellHeader(RegistryHive, CellIndex) + 1);
+}
+
 static NTSTATUS CMAPI
 HvpAddFree(
     PHHIVE RegistryHive,
     PHCELL FreeBlock,
     HCELL_INDEX FreeIndex)
 {
-    PHCELL_INDEX FreeBlockData;
-    HSTORAGE_TYPE Storage;
+    PHCELL_FREE_LINKS FreeLinks;
+    PDUAL Dual;
     ULONG Index;
 
     ASSERT(RegistryHive != NULL);
     ASSERT(FreeBlock != NULL);
 
-    Storage = HvGetCellType(FreeIndex);
+    /* Cells too small for the links can only be reused once they merge
+       with a freed neighbour, so don't keep track of them */
+    if ((ULONG)FreeBlock->Size < HCELL_MIN_FREE_SIZE)
+        return STATUS_SUCCESS;
+
+    Dual = &RegistryHive->Storage[HvGetCellType(FreeIndex)];
     Index = HvpComputeFreeListIndex((ULONG)FreeBlock->Size);
 
-    FreeBlockData = (PHCELL_INDEX)(FreeBlock + 1);
-    *FreeBlockData = RegistryHive->Storage[Storage].FreeDisplay[Index];
-    RegistryHive->Storage[Storage].FreeDisplay[Index] = FreeIndex;
+    FreeLinks = (PHCELL_FREE_LINKS)(FreeBlock + 1);
+    FreeLinks->Next = Dual->FreeDisplay[Index];
+    FreeLinks->Prev = HCELL_NIL;
+    if (FreeLinks->Next != HCELL_NIL)
+        HvpGetFreeLinks(RegistryHive, FreeLinks->Next)->Prev = FreeIndex;
 
-    /* FIXME: Eventually get rid of free bins. */
+    Dual->FreeDisplay[Index] = FreeIndex;
+    Dual->FreeSummary |= (1 << Index);
 
     return STATUS_SUCCESS;
 }
@@ -229,47 +252,34 @@ HvpRemoveFree(
     PHCELL CellBlock,
     HCELL_INDEX CellIndex)
 {
-    PHCELL_INDEX FreeCellData;
-    PHCELL_INDEX pFreeCellOffset;
-    HSTORAGE_TYPE Storage;
-    ULONG Index, FreeListIndex;
+    PHCELL_FREE_LINKS FreeLinks;
+    PDUAL Dual;
+    ULONG Index;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
 
-    Storage = HvGetCellType(CellIndex);
+    if ((ULONG)CellBlock->Size < HCELL_MIN_FREE_SIZE)
+        return;
+
+    Dual = &RegistryHive->Storage[HvGetCellType(CellIndex)];
     Index = HvpComputeFreeListIndex((ULONG)CellBlock->Size);
 
-    pFreeCellOffset = &RegistryHive->Storage[Storage].FreeDisplay[Index];
-    while (*pFreeCellOffset != HCELL_NIL)
+    FreeLinks = (PHCELL_FREE_LINKS)(CellBlock + 1);
+    if (FreeLinks->Prev != HCELL_NIL)
     {
-        FreeCellData = (PHCELL_INDEX)HvGetCell(RegistryHive, *pFreeCellOffset);
-        if (*pFreeCellOffset == CellIndex)
-        {
-            *pFreeCellOffset = *FreeCellData;
-            return;
-        }
-        pFreeCellOffset = FreeCellData;
+        HvpGetFreeLinks(RegistryHive, FreeLinks->Prev)->Next = FreeLinks->Next;
     }
-
-    /* Something bad happened, print a useful trace info and bugcheck */
-    CMLTRACE(CMLIB_HCELL_DEBUG, "-- beginning of HvpRemoveFree trace --\n");
-    CMLTRACE(CMLIB_HCELL_DEBUG, "block we are about to free: %08x\n", CellIndex);
-    CMLTRACE(CMLIB_HCELL_DEBUG, "chosen free list index: %u\n", Index);
-    for (FreeListIndex = 0; FreeListIndex < 24; FreeListIndex++)
+    else
     {
-        CMLTRACE(CMLIB_HCELL_DEBUG, "free list [%u]: ", FreeListIndex);
-        pFreeCellOffset = &RegistryHive->Storage[Storage].FreeDisplay[FreeListIndex];
-        while (*pFreeCellOffset != HCELL_NIL)
-        {
-            CMLTRACE(CMLIB_HCELL_DEBUG, "%08x ", *pFreeCellOffset);
-            FreeCellData = (PHCELL_INDEX)HvGetCell(RegistryHive, *pFreeCellOffset);
-            pFreeCellOffset = FreeCellData;
-        }
-        CMLTRACE(CMLIB_HCELL_DEBUG, "\n");
+        /* We must be the head of our list, or the lists are corrupted */
+        ASSERT(Dual->FreeDisplay[Index] == CellIndex);
+        Dual->FreeDisplay[Index] = FreeLinks->Next;
+        if (FreeLinks->Next == HCELL_NIL)
+            Dual->FreeSummary &= ~(1 << Index);
     }
-    CMLTRACE(CMLIB_HCELL_DEBUG, "-- end of HvpRemoveFree trace --\n");
 
-    ASSERT(FALSE);
+    if (FreeLinks->Next != HCELL_NIL)
+        HvpGetFreeLinks(RegistryHive, FreeLinks->Next)->Prev = FreeLinks->Prev;
 }
 
 static HCELL_INDEX CMAPI
@@ -278,76 +288,157 @@ HvpFindFree(
     ULONG Size,
     HSTORAGE_TYPE Storage)
 {
-    PHCELL_INDEX FreeCellData;
-    HCELL_INDEX FreeCellOffset;
-    PHCELL_INDEX pFreeCellOffset;
-    ULONG Index;
+    PDUAL Dual = &RegistryHive->Storage[Storage];
+    PHCELL FreeCell;
+    HCELL_INDEX CellIndex, BestIndex;
+    ULONG Index, Summary, BestSize;
+
+    Index = HvpComputeFreeListIndex(Size);
+    Summary = Dual->FreeSummary & ~((1 << Index) - 1);
 
-    for (Index = HvpComputeFreeListIndex(Size); Index < 24; Index++)
+    while (Summary != 0)
     {
-        pFreeCellOffset = &RegistryHive->Storage[Storage].FreeDisplay[Index];
-        while (*pFreeCellOffset != HCELL_NIL)
+        while (!(Summary & (1 << Index)))
+            Index++;
+
+        /* Pick the smallest cell of the class that fits. All cells of an
+           exact class have the same size, so the head will do there, and
+           so will any cell that is too close to the size to be split. */
+        BestIndex = HCELL_NIL;
+        BestSize = MAXULONG;
+        for (CellIndex = Dual->FreeDisplay[Index];
+             CellIndex != HCELL_NIL;
+             CellIndex = ((PHCELL_FREE_LINKS)(FreeCell + 1))->Next)
         {
-            FreeCellData = (PHCELL_INDEX)HvGetCell(RegistryHive, *pFreeCellOffset);
-            if ((ULONG)HvpGetCellFullSize(RegistryHive, FreeCellData) >= Size)
+            FreeCell = HvpGetCellHeader(RegistryHive, CellIndex);
+            if ((ULONG)FreeCell->Size >= Size && (ULONG)FreeCell->Size < BestSize)
             {
-                FreeCellOffset = *pFreeCellOffset;
-                *pFreeCellOffset = *FreeCellData;
-                return FreeCellOffset;
+                BestIndex = CellIndex;
+                BestSize = (ULONG)FreeCell->Size;
+                if (BestSize <= Size + 16 || Index < HCELL_EXACT_FREE_LISTS)
+                    break;
             }
-            pFreeCellOffset = FreeCellData;
         }
+
+        if (BestIndex != HCELL_NIL)
+        {
+            HvpRemoveFree(RegistryHive,
+                          HvpGetCellHeader(RegistryHive, BestIndex),
+                          BestIndex);
+            return BestIndex;
+        }
+
+        /* Every cell of the next non-empty class is large enough */
+        Summary &= ~(1 << Index);
     }
 
     return HCELL_NIL;
 }
 
+/*
+ * Gives the part of the free cell beyond Size back to the free lists,
+ * merged with a free cell that may follow it.
+ */
+static VOID CMAPI
+HvpSplitFreeCell(
+    PHHIVE RegistryHive,
+    PHCELL FreeCell,
+    HCELL_INDEX CellIndex,
+    ULONG Size)
+{
+    PHCELL NewCell, Neighbor;
+    HCELL_INDEX NewCellIndex;
+    PHBIN Bin;
+
+    /* The free block that is created has to be at least
+       sizeof(HCELL) + sizeof(HCELL_FREE_LINKS) big, so that free
+       cell list code can work. Moreover we round cell sizes
+       to 16 bytes, so creating a smaller block would result in
+       a cell that would never be allocated. */
+    if ((ULONG)FreeCell->Size <= Size + 16)
+        return;
+
+    NewCell = (PHCELL)((ULONG_PTR)FreeCell + Size);
+    NewCell->Size = FreeCell->Size - Size;
+    NewCellIndex = CellIndex + Size;
+    FreeCell->Size = Size;
+
+    Bin = (PHBIN)RegistryHive->Storage[HvGetCellType(CellIndex)].BlockList[HvGetCellBlock(CellIndex)].BinAddress;
+    if ((NewCellIndex & ~HCELL_TYPE_MASK) + NewCell->Size < Bin->FileOffset + Bin->Size)
+    {
+        Neighbor = (PHCELL)((ULONG_PTR)NewCell + NewCell->Size);
+        if (Neighbor->Size > 0)
+        {
+            HvpRemoveFree(RegistryHive, Neighbor, NewCellIndex + NewCell->Size);
+            NewCell->Size += Neighbor->Size;
+        }
+    }
+
+    HvpAddFree(RegistryHive, NewCell, NewCellIndex);
+    if (HvGetCellType(CellIndex) == Stable)
+        HvMarkCellDirty(RegistryHive, NewCellIndex, FALSE);
+}
+
+static VOID CMAPI
+HvpResetFreeCellLists(
+    PHHIVE Hive)
+{
+    ULONG Index;
+
+    for (Index = 0; Index < 24; Index++)
+    {
+        Hive->Storage[Stable].FreeDisplay[Index] = HCELL_NIL;
+        Hive->Storage[Volatile].FreeDisplay[Index] = HCELL_NIL;
+    }
+
+    Hive->Storage[Stable].FreeSummary = 0;
+    Hive->Storage[Volatile].FreeSummary = 0;
+}
+
 NTSTATUS CMAPI
 HvpCreateHiveFreeCellList(
     PHHIVE Hive)
 {
-    HCELL_INDEX BlockOffset;
     PHCELL FreeBlock;
     ULONG BlockIndex;
     ULONG FreeOffset;
     PHBIN Bin;
     NTSTATUS Status;
-    ULONG Index;
+    ULONG Storage;
 
     /* Initialize the free cell list */
-    for (Index = 0; Index < 24; Index++)
-    {
-        Hive->Storage[Stable].FreeDisplay[Index] = HCELL_NIL;
-        Hive->Storage[Volatile].FreeDisplay[Index] = HCELL_NIL;
-    }
+    HvpResetFreeCellLists(Hive);
 
-    BlockOffset = 0;
-    BlockIndex = 0;
-    while (BlockIndex < Hive->Storage[Stable].Length)
+    for (Storage = Stable; Storage < Hive->StorageTypeCount; Storage++)
     {
-        Bin = (PHBIN)Hive->Storage[Stable].BlockList[BlockIndex].BinAddress;
-
-        /* Search free blocks and add to list */
-        FreeOffset = sizeof(HBIN);
-        while (FreeOffset < Bin->Size)
+        BlockIndex = 0;
+        while (BlockIndex < Hive->Storage[Storage].Length)
         {
-            FreeBlock = (PHCELL)((ULONG_PTR)Bin + FreeOffset);
-            if (FreeBlock->Size > 0)
-            {
-                Status = HvpAddFree(Hive, FreeBlock, Bin->FileOffset + FreeOffset);
-                if (!NT_SUCCESS(Status))
-                    return Status;
+            Bin = (PHBIN)Hive->Storage[Storage].BlockList[BlockIndex].BinAddress;
 
-                FreeOffset += FreeBlock->Size;
-            }
-            else
+            /* Search free blocks and add to list */
+            FreeOffset = sizeof(HBIN);
+            while (FreeOffset < Bin->Size)
             {
-                FreeOffset -= FreeBlock->Size;
+                FreeBlock = (PHCELL)((ULONG_PTR)Bin + FreeOffset);
+                if (FreeBlock->Size > 0)
+                {
+                    Status = HvpAddFree(Hive, FreeBlock,
+                                       (Bin->FileOffset + FreeOffset) |
+                                       (Storage << HCELL_TYPE_SHIFT));
+                    if (!NT_SUCCESS(Status))
+                        return Status;
+
+                    FreeOffset += FreeBlock->Size;
+                }
+                else
+                {
+                    FreeOffset -= FreeBlock->Size;
+                }
             }
-        }
 
-        BlockIndex += Bin->Size / HBLOCK_SIZE;
-        BlockOffset += Bin->Size;
+            BlockIndex += Bin->Size / HBLOCK_SIZE;
+        }
     }
 
     return STATUS_SUCCESS;
@@ -362,7 +453,6 @@ HvAllocateCell(
 {
     PHCELL FreeCell;
     HCELL_INDEX FreeCellOffset;
-    PHCELL NewCell;
     PHBIN Bin;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
@@ -389,21 +479,7 @@ HvAllocateCell(
     FreeCell = HvpGetCellHeader(RegistryHive, FreeCellOffset);
 
     /* Split the block in two parts */
-
-    /* The free block that is created has to be at least
-       sizeof(HCELL) + sizeof(HCELL_INDEX) big, so that free
-       cell list code can work. Moreover we round cell sizes
-       to 16 bytes, so creating a smaller block would result in
-       a cell that would never be allocated. */
-    if ((ULONG)FreeCell->Size > Size + 16)
-    {
-        NewCell = (PHCELL)((ULONG_PTR)FreeCell + Size);
-        NewCell->Size = FreeCell->Size - Size;
-        FreeCell->Size = Size;
-        HvpAddFree(RegistryHive, NewCell, FreeCellOffset + Size);
-        if (Storage == Stable)
-            HvMarkCellDirty(RegistryHive, FreeCellOffset + Size, FALSE);
-    }
+    HvpSplitFreeCell(RegistryHive, FreeCell, FreeCellOffset, Size);
 
     if (Storage == Stable)
         HvMarkCellDirty(RegistryHive, FreeCellOffset, FALSE);
@@ -428,6 +504,11 @@ HvReallocateCell(
     LONG OldCellSize;
     HCELL_INDEX NewCellIndex;
     HSTORAGE_TYPE Storage;
+    PHCELL CellHeader;
+    PHCELL Neighbor;
+    ULONG CellSize;
+    ULONG NeighborSize;
+    PHBIN Bin;
 
     ASSERT(CellIndex != HCELL_NIL);
 
@@ -440,27 +521,52 @@ HvReallocateCell(
     OldCellSize = HvGetCellSize(RegistryHive, OldCell);
     ASSERT(OldCellSize > 0);
 
-    /*
-     * If new data size is larger than the current, destroy current
-     * data block and allocate a new one.
-     *
-     * FIXME: Merge with adjacent free cell if possible.
-     * FIXME: Implement shrinking.
-     */
-    if (Size > (ULONG)OldCellSize)
+    CellHeader = (PHCELL)OldCell - 1;
+    CellSize = (ULONG)-CellHeader->Size;
+
+    /* Round to 16 bytes multiple, like HvAllocateCell does. */
+    Size = ROUND_UP(Size + sizeof(HCELL), 16);
+
+    if (Size > CellSize)
     {
-        NewCellIndex = HvAllocateCell(RegistryHive, Size, Storage, HCELL_NIL);
-        if (NewCellIndex == HCELL_NIL)
-            return HCELL_NIL;
+        /* Try to grow in place by taking over the free cell behind us */
+        Bin = (PHBIN)RegistryHive->Storage[Storage].BlockList[HvGetCellBlock(CellIndex)].BinAddress;
+        Neighbor = (PHCELL)((ULONG_PTR)CellHeader + CellSize);
+        if ((CellIndex & ~HCELL_TYPE_MASK) + CellSize < Bin->FileOffset + Bin->Size &&
+            Neighbor->Size > 0 &&
+            CellSize + (ULONG)Neighbor->Size >= Size)
+        {
+            NeighborSize = (ULONG)Neighbor->Size;
+            HvpRemoveFree(RegistryHive, Neighbor, CellIndex + CellSize);
+            RtlZeroMemory(Neighbor, NeighborSize);
+            if (Storage == Stable)
+                HvMarkCellDirty(RegistryHive, CellIndex + CellSize, FALSE);
+            CellSize += NeighborSize;
+        }
+        else
+        {
+            /* Destroy the current data block and allocate a new one */
+            NewCellIndex = HvAllocateCell(RegistryHive, Size - sizeof(HCELL), Storage, HCELL_NIL);
+            if (NewCellIndex == HCELL_NIL)
+                return HCELL_NIL;
 
-        NewCell = HvGetCell(RegistryHive, NewCellIndex);
-        RtlCopyMemory(NewCell, OldCell, (SIZE_T)OldCellSize);
+            NewCell = HvGetCell(RegistryHive, NewCellIndex);
+            RtlCopyMemory(NewCell, OldCell, (SIZE_T)OldCellSize);
 
-        HvFreeCell(RegistryHive, CellIndex);
+            HvFreeCell(RegistryHive, CellIndex);
 
-        return NewCellIndex;
+            return NewCellIndex;
+        }
     }
 
+    /* Give back whatever we don't need any longer */
+    CellHeader->Size = CellSize;
+    HvpSplitFreeCell(RegistryHive, CellHeader, CellIndex, Size);
+    CellHeader->Size = -CellHeader->Size;
+
+    if (Storage == Stable && (ULONG)-CellHeader->Size != (ULONG)OldCellSize + sizeof(HCELL))
+        HvMarkCellDirty(RegistryHive, CellIndex, FALSE);
+
     return CellIndex;
 }
 
@@ -547,6 +653,91 @@ HvFreeCell(
 }
 
 
+/**
+ * @name HvCompactFreeCells
+ *
+ * Merges all runs of adjacent free cells, releases the wholly free bins
+ * at the end of the stable storage and rebuilds the free cell lists.
+ * Cells never move, so cell indexes held by the caller stay valid.
+ */
+VOID CMAPI
+HvCompactFreeCells(
+    PHHIVE RegistryHive)
+{
+    PDUAL Dual;
+    PHBIN Bin;
+    PHCELL Cell;
+    PHCELL Neighbor;
+    ULONG Storage;
+    ULONG BlockIndex;
+    ULONG BlockCount;
+    ULONG Offset;
+    BOOLEAN Merged;
+
+    ASSERT(RegistryHive->ReadOnly == FALSE);
+    ASSERT(RegistryHive->Flat == FALSE);
+
+    for (Storage = Stable; Storage < RegistryHive->StorageTypeCount; Storage++)
+    {
+        Dual = &RegistryHive->Storage[Storage];
+
+        for (BlockIndex = 0; BlockIndex < Dual->Length; BlockIndex += Bin->Size / HBLOCK_SIZE)
+        {
+            Bin = (PHBIN)Dual->BlockList[BlockIndex].BinAddress;
+
+            for (Offset = sizeof(HBIN); Offset < Bin->Size;
+                 Offset += (Cell->Size > 0) ? Cell->Size : -Cell->Size)
+            {
+                Cell = (PHCELL)((ULONG_PTR)Bin + Offset);
+                if (Cell->Size < 0)
+                    continue;
+
+                /* Swallow every free cell that directly follows this one */
+                Merged = FALSE;
+                while (Offset + Cell->Size < Bin->Size)
+                {
+                    Neighbor = (PHCELL)((ULONG_PTR)Cell + Cell->Size);
+                    if (Neighbor->Size < 0)
+                        break;
+
+                    Cell->Size += Neighbor->Size;
+                    Merged = TRUE;
+                }
+
+                if (Merged && Storage == Stable)
+                    HvMarkCellDirty(RegistryHive, Bin->FileOffset + Offset, FALSE);
+            }
+        }
+    }
+
+    /* Drop the trailing bins that hold nothing but a free cell now. The
+       first bin is always kept, it holds the root key. */
+    Dual = &RegistryHive->Storage[Stable];
+    while (Dual->Length > 0)
+    {
+        Bin = (PHBIN)Dual->BlockList[Dual->Length - 1].BinAddress;
+        Cell = (PHCELL)(Bin + 1);
+        BlockCount = Bin->Size / HBLOCK_SIZE;
+
+        if (Bin->FileOffset == 0 || Cell->Size != (LONG)(Bin->Size - sizeof(HBIN)))
+            break;
+
+        Dual->Length -= BlockCount;
+        for (BlockIndex = Dual->Length; BlockIndex < Dual->Length + BlockCount; BlockIndex++)
+        {
+            Dual->BlockList[BlockIndex].BinAddress = (ULONG_PTR)NULL;
+            Dual->BlockList[BlockIndex].BlockAddress = (ULONG_PTR)NULL;
+        }
+
+        RtlClearBits(&RegistryHive->DirtyVector, Dual->Length, BlockCount);
+        RegistryHive->BaseBlock->Length -= Bin->Size;
+        RegistryHive->Free(Bin, 0);
+    }
+
+    HvpCreateHiveFreeCellList(RegistryHive);
+}
+
+
 #define CELL_REF_INCREMENT  10
 
 BOOLEAN
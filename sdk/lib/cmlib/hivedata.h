@@ -26,6 +26,7 @@
 #define HIVE_HAS_BEEN_FREED             8
 #define HIVE_UNKNOWN                    0x10
 #define HIVE_IS_UNLOADING               0x20
+#define HIVE_DELTA_LOG                  0x40    // ReactOS: defer primary writes, see HvSyncHive
 
 //
 // Hive types
@@ -43,6 +44,7 @@
 #define HSECTOR_COUNT                   8
 
 #define HV_LOG_HEADER_SIZE              FIELD_OFFSET(HBASE_BLOCK, Reserved2)
+#define HV_LOG_RECONCILE_SIZE           0x100000
 
 //
 // Hive structure identifiers
@@ -50,6 +52,7 @@
 #define HV_HHIVE_SIGNATURE              0xbee0bee0
 #define HV_HBLOCK_SIGNATURE             0x66676572  // "regf"
 #define HV_HBIN_SIGNATURE               0x6e696268  // "hbin"
+#define HV_LOG_ENTRY_SIGNATURE          0x454c7648  // "HvLE"
 
 //
 // Hive versions
@@ -184,6 +187,43 @@ typedef struct _HBIN
     ULONG Spare;
 } HBIN, *PHBIN;
 
+/*
+ * The log file starts with a copy of the base block whose sequence numbers
+ * give the primary sequence the log applies to, followed by one entry per
+ * HvSyncHive. Each entry is sector aligned and holds the runs of dirty
+ * blocks it carries, then the blocks themselves back to back.
+ */
+typedef struct _HV_LOG_ENTRY
+{
+    /* Log entry identifier "HvLE" (0x454c7648) */
+    ULONG Signature;
+
+    /* Size of the entry including the block data, multiple of HSECTOR_SIZE */
+    ULONG Size;
+
+    /* Entries carry consecutive numbers, starting at the log sequence */
+    ULONG Sequence;
+
+    /* Sequence of the log header the entry was appended under */
+    ULONG BaseSequence;
+
+    /* Length of the hive bins once the entry is applied */
+    ULONG HiveLength;
+
+    /* Number of HV_LOG_DIRTY_RUN following this header */
+    ULONG RunCount;
+
+    /* Checksum of the whole entry, computed with this field zeroed */
+    ULONG CheckSum;
+} HV_LOG_ENTRY, *PHV_LOG_ENTRY;
+
+typedef struct _HV_LOG_DIRTY_RUN
+{
+    /* Offset from the first bin and length, in bytes */
+    ULONG Offset;
+    ULONG Length;
+} HV_LOG_DIRTY_RUN, *PHV_LOG_DIRTY_RUN;
+
 typedef struct _HCELL
 {
     /* <0 if used, >0 if free */
@@ -328,6 +368,10 @@ typedef struct _HHIVE
     ULONG RefreshCount;
     ULONG StorageTypeCount;
     ULONG Version;
+    /* ReactOS-specific: blocks logged but not yet written to the primary */
+    RTL_BITMAP LogVector;
+    ULONG LogBaseSequence;
+    ULONG LogSequence;
     DUAL Storage[HTYPE_COUNT];
 } HHIVE, *PHHIVE;
 
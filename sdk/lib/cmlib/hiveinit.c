@@ -203,6 +203,9 @@ HvpCreateHive(
         RegistryHive->Storage[Volatile].FreeDisplay[Index] = HCELL_NIL;
     }
 
+    RegistryHive->Storage[Stable].FreeSummary = 0;
+    RegistryHive->Storage[Volatile].FreeSummary = 0;
+
     HvpInitFileName(BaseBlock, FileName);
 
     return STATUS_SUCCESS;
@@ -403,7 +406,20 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     if (!Result) return NotHive;
 
     /* Do validation */
-    if (!HvpVerifyHiveHeader(BaseBlock)) return NotHive;
+    if (!HvpVerifyHiveHeader(BaseBlock))
+    {
+        /* A write to the primary was cut short, the log may have the data */
+        if (BaseBlock->Signature == HV_HBLOCK_SIGNATURE &&
+            BaseBlock->Sequence1 != BaseBlock->Sequence2 &&
+            HvpHiveHeaderChecksum(BaseBlock) == BaseBlock->CheckSum)
+        {
+            *HiveBaseBlock = BaseBlock;
+            *TimeStamp = BaseBlock->TimeStamp;
+            return RecoverData;
+        }
+
+        return NotHive;
+    }
 
     /* Return information */
     *HiveBaseBlock = BaseBlock;
@@ -411,17 +427,210 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     return HiveSuccess;
 }
 
+/**
+ * @name HvpReadLogEntry
+ *
+ * Internal helper to read and validate the log entry at the given offset.
+ * Returns NULL at the end of the log, that is as soon as the entry read
+ * isn't the one with the expected sequence number or is damaged. Entries
+ * left over from an earlier log are told apart by their base sequence,
+ * since their own numbers may well line up with the current log.
+ */
+static PHV_LOG_ENTRY CMAPI
+HvpReadLogEntry(
+    IN PHHIVE Hive,
+    IN ULONG Offset,
+    IN ULONG BaseSequence,
+    IN ULONG Sequence)
+{
+    HV_LOG_ENTRY Header;
+    PHV_LOG_ENTRY LogEntry;
+    PHV_LOG_DIRTY_RUN Runs;
+    ULONG DataOffset, DataLength;
+    ULONG ReadOffset = Offset;
+    ULONG i;
+
+    if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &ReadOffset, &Header, sizeof(Header)))
+        return NULL;
+
+    if (Header.Signature != HV_LOG_ENTRY_SIGNATURE ||
+        Header.Sequence != Sequence ||
+        Header.BaseSequence != BaseSequence ||
+        (Header.HiveLength % HBLOCK_SIZE) != 0 ||
+        Header.RunCount > Header.HiveLength / HBLOCK_SIZE ||
+        (Header.Size % HSECTOR_SIZE) != 0)
+    {
+        return NULL;
+    }
+
+    DataOffset = ROUND_UP(sizeof(HV_LOG_ENTRY) + Header.RunCount * sizeof(HV_LOG_DIRTY_RUN),
+                          HSECTOR_SIZE);
+    if (Header.Size < DataOffset || Header.Size - DataOffset > Header.HiveLength)
+        return NULL;
+
+    LogEntry = Hive->Allocate(Header.Size, FALSE, TAG_CM);
+    if (LogEntry == NULL)
+        return NULL;
+
+    ReadOffset = Offset;
+    if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &ReadOffset, LogEntry, Header.Size) ||
+        LogEntry->Size != Header.Size ||
+        LogEntry->RunCount != Header.RunCount ||
+        LogEntry->HiveLength != Header.HiveLength ||
+        LogEntry->Sequence != Sequence ||
+        LogEntry->BaseSequence != BaseSequence ||
+        HvpLogEntryChecksum(LogEntry) != LogEntry->CheckSum)
+    {
+        Hive->Free(LogEntry, 0);
+        return NULL;
+    }
+
+    /* The runs must stay within the hive and account for all the data */
+    Runs = (PHV_LOG_DIRTY_RUN)(LogEntry + 1);
+    DataLength = 0;
+    for (i = 0; i < LogEntry->RunCount; i++)
+    {
+        if ((Runs[i].Offset % HBLOCK_SIZE) != 0 ||
+            (Runs[i].Length % HBLOCK_SIZE) != 0 ||
+            Runs[i].Length == 0 ||
+            Runs[i].Offset > LogEntry->HiveLength ||
+            Runs[i].Length > LogEntry->HiveLength - Runs[i].Offset)
+        {
+            break;
+        }
+        DataLength += Runs[i].Length;
+    }
+
+    if (i != LogEntry->RunCount || DataLength != LogEntry->Size - DataOffset)
+    {
+        Hive->Free(LogEntry, 0);
+        return NULL;
+    }
+
+    return LogEntry;
+}
+
+/**
+ * @name HvpScanLog
+ *
+ * Internal helper to find out how many log entries apply on top of the
+ * primary sequence given. Also returns the hive length the log starts
+ * from, the one the last entry leaves behind and where the log ends.
+ */
+static ULONG CMAPI
+HvpScanLog(
+    IN PHHIVE Hive,
+    IN ULONG Sequence,
+    OUT PULONG BaseLength,
+    OUT PULONG HiveLength,
+    OUT PULONG LogSize)
+{
+    PHBASE_BLOCK LogHeader;
+    PHV_LOG_ENTRY LogEntry;
+    ULONG Offset = 0;
+    ULONG Count = 0;
+    BOOLEAN Result;
+
+    LogHeader = HvpAllocBaseBlockAligned(Hive, FALSE, TAG_CM);
+    if (!LogHeader) return 0;
+
+    Result = Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, LogHeader, sizeof(HBASE_BLOCK));
+    if (!Result ||
+        LogHeader->Signature != HV_HBLOCK_SIGNATURE ||
+        LogHeader->Type != HFILE_TYPE_LOG ||
+        LogHeader->Sequence1 != Sequence ||
+        LogHeader->Sequence2 != Sequence ||
+        (LogHeader->Length % HBLOCK_SIZE) != 0 ||
+        HvpHiveHeaderChecksum(LogHeader) != LogHeader->CheckSum)
+    {
+        /* No log, or one that was already written back */
+        Hive->Free(LogHeader, Hive->BaseBlockAlloc);
+        return 0;
+    }
+
+    *BaseLength = *HiveLength = LogHeader->Length;
+    Hive->Free(LogHeader, Hive->BaseBlockAlloc);
+
+    Offset = HBLOCK_SIZE;
+    while ((LogEntry = HvpReadLogEntry(Hive, Offset, Sequence, Sequence + Count)) != NULL)
+    {
+        *HiveLength = LogEntry->HiveLength;
+        Offset += LogEntry->Size;
+        Count++;
+        Hive->Free(LogEntry, 0);
+    }
+
+    *LogSize = Offset;
+    return Count;
+}
+
+/**
+ * @name HvpReplayLog
+ *
+ * Internal helper to apply the first Count log entries on a copy of the
+ * hive and record the blocks they touched in the given bitmap.
+ */
+static BOOLEAN CMAPI
+HvpReplayLog(
+    IN PHHIVE Hive,
+    IN PVOID HiveData,
+    IN ULONG Sequence,
+    IN ULONG Count,
+    IN PRTL_BITMAP Replayed)
+{
+    PHV_LOG_ENTRY LogEntry;
+    PHV_LOG_DIRTY_RUN Runs;
+    PUCHAR Data;
+    ULONG Offset = HBLOCK_SIZE;
+    ULONG i, j;
+
+    for (i = 0; i < Count; i++)
+    {
+        /* The entry was fine a moment ago */
+        LogEntry = HvpReadLogEntry(Hive, Offset, Sequence, Sequence + i);
+        if (!LogEntry) return FALSE;
+
+        Runs = (PHV_LOG_DIRTY_RUN)(LogEntry + 1);
+        Data = (PUCHAR)LogEntry + LogEntry->Size;
+        for (j = 0; j < LogEntry->RunCount; j++)
+            Data -= Runs[j].Length;
+
+        for (j = 0; j < LogEntry->RunCount; j++)
+        {
+            RtlCopyMemory((PUCHAR)HiveData + HBLOCK_SIZE + Runs[j].Offset,
+                          Data,
+                          Runs[j].Length);
+            RtlSetBits(Replayed,
+                       Runs[j].Offset / HBLOCK_SIZE,
+                       Runs[j].Length / HBLOCK_SIZE);
+            Data += Runs[j].Length;
+        }
+
+        Offset += LogEntry->Size;
+        Hive->Free(LogEntry, 0);
+    }
+
+    return TRUE;
+}
+
 NTSTATUS CMAPI
 HvLoadHive(IN PHHIVE Hive,
            IN PCUNICODE_STRING FileName OPTIONAL)
 {
     NTSTATUS Status;
     PHBASE_BLOCK BaseBlock = NULL;
+    PHBASE_BLOCK HiveHeader;
     ULONG Result;
     LARGE_INTEGER TimeStamp;
     ULONG Offset = 0;
     PVOID HiveData;
-    ULONG FileSize;
+    ULONG FileSize, DataSize;
+    ULONG Sequence;
+    ULONG LogEntries = 0;
+    ULONG BaseLength, HiveLength, LogSize;
+    RTL_BITMAP Replayed;
+    PULONG ReplayedBuffer = NULL;
+    ULONG ReplayedSize = 0;
 
     /* Get the hive header */
     Result = HvpGetHiveHeader(Hive, &BaseBlock, &TimeStamp);
@@ -440,7 +649,6 @@ HvLoadHive(IN PHHIVE Hive,
             return STATUS_NOT_REGISTRY_FILE;
 
         /* Has recovery data */
-        case RecoverData:
         case RecoverHeader:
 
             /* Fail */
@@ -454,9 +662,24 @@ HvLoadHive(IN PHHIVE Hive,
     Hive->BaseBlock = BaseBlock;
     Hive->Version = BaseBlock->Minor;
 
+    /* The last complete write of the primary is the one the log builds on */
+    Sequence = BaseBlock->Sequence2;
+    BaseLength = HiveLength = BaseBlock->Length;
+    if (Hive->Log)
+        LogEntries = HvpScanLog(Hive, Sequence, &BaseLength, &HiveLength, &LogSize);
+
+    if (Result == RecoverData && LogEntries == 0)
+    {
+        /* Nothing to repair the primary with */
+        DPRINT1("Hive primary is incomplete and there is no log for it\n");
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        return STATUS_REGISTRY_CORRUPT;
+    }
+
     /* Allocate a buffer large enough to hold the hive */
-    FileSize = HBLOCK_SIZE + BaseBlock->Length; // == sizeof(HBASE_BLOCK) + BaseBlock->Length;
-    HiveData = Hive->Allocate(FileSize, TRUE, TAG_CM);
+    FileSize = HBLOCK_SIZE + BaseLength; // == sizeof(HBASE_BLOCK) + BaseLength;
+    DataSize = HBLOCK_SIZE + ((BaseLength > HiveLength) ? BaseLength : HiveLength);
+    HiveData = Hive->Allocate(DataSize, TRUE, TAG_CM);
     if (!HiveData)
     {
         Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
@@ -471,11 +694,42 @@ HvLoadHive(IN PHHIVE Hive,
                             FileSize);
     if (!Result)
     {
-        Hive->Free(HiveData, FileSize);
+        Hive->Free(HiveData, DataSize);
         Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
         return STATUS_NOT_REGISTRY_FILE;
     }
 
+    if (LogEntries)
+    {
+        DPRINT1("Replaying %lu log entries\n", LogEntries);
+
+        /* Keep track of the blocks the primary doesn't have */
+        ReplayedSize = ROUND_UP((DataSize - HBLOCK_SIZE) / HBLOCK_SIZE, sizeof(ULONG) * 8) / 8;
+        ReplayedBuffer = Hive->Allocate(ReplayedSize, TRUE, TAG_CM);
+        if (!ReplayedBuffer)
+        {
+            Hive->Free(HiveData, DataSize);
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        RtlInitializeBitMap(&Replayed, ReplayedBuffer, ReplayedSize * 8);
+        RtlClearAllBits(&Replayed);
+
+        if (!HvpReplayLog(Hive, HiveData, Sequence, LogEntries, &Replayed))
+        {
+            Hive->Free(ReplayedBuffer, ReplayedSize);
+            Hive->Free(HiveData, DataSize);
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+            return STATUS_REGISTRY_CORRUPT;
+        }
+
+        /* The header now describes the replayed hive */
+        HiveHeader = (PHBASE_BLOCK)HiveData;
+        HiveHeader->Length = HiveLength;
+        HiveHeader->Sequence1 = HiveHeader->Sequence2 = Sequence;
+        HiveHeader->CheckSum = HvpHiveHeaderChecksum(HiveHeader);
+    }
+
     // This is a HACK!
     /* Free our base block... it's usless in this implementation */
     Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
@@ -483,7 +737,29 @@ HvLoadHive(IN PHHIVE Hive,
     /* Initialize the hive directly from memory */
     Status = HvpInitializeMemoryHive(Hive, HiveData, FileName);
     if (!NT_SUCCESS(Status))
-        Hive->Free(HiveData, FileSize);
+        Hive->Free(HiveData, DataSize);
+
+    if (NT_SUCCESS(Status) && LogEntries)
+    {
+        /* Carry on with the log, the primary still has to catch up with it */
+        if (HvpGrowLogVector(Hive))
+        {
+            RtlCopyMemory(Hive->LogVector.Buffer,
+                          ReplayedBuffer,
+                          min(ReplayedSize, Hive->LogVector.SizeOfBitMap / 8));
+            Hive->LogSize = LogSize;
+            Hive->LogBaseSequence = Sequence;
+            Hive->LogSequence = Sequence + LogEntries;
+        }
+        else
+        {
+            /* Write it all back at the next sync instead */
+            RtlSetBits(&Hive->DirtyVector, 0, Hive->Storage[Stable].Length);
+        }
+    }
+
+    if (ReplayedBuffer)
+        Hive->Free(ReplayedBuffer, ReplayedSize);
 
     return Status;
 }
@@ -636,6 +912,12 @@ HvFree(
             RegistryHive->Free(RegistryHive->DirtyVector.Buffer, 0);
         }
 
+        /* Release log bitmap */
+        if (RegistryHive->LogVector.Buffer)
+        {
+            RegistryHive->Free(RegistryHive->LogVector.Buffer, 0);
+        }
+
         HvpFreeHiveBins(RegistryHive);
 
         /* Free the BaseBlock */
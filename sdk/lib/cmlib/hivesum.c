@@ -30,3 +30,29 @@ HvpHiveHeaderChecksum(
 
     return Sum;
 }
+
+/**
+ * @name HvpLogEntryChecksum
+ *
+ * Compute checksum of a log entry, block data included, and return it.
+ */
+
+ULONG CMAPI
+HvpLogEntryChecksum(
+    PHV_LOG_ENTRY LogEntry)
+{
+    PULONG Buffer = (PULONG)LogEntry;
+    ULONG Sum1 = 0, Sum2 = 0;
+    ULONG Value;
+    ULONG i;
+
+    /* Fletcher style, so that blocks logged in the wrong place get caught too */
+    for (i = 0; i < LogEntry->Size / sizeof(ULONG); i++)
+    {
+        Value = (i == FIELD_OFFSET(HV_LOG_ENTRY, CheckSum) / sizeof(ULONG)) ? 0 : Buffer[i];
+        Sum1 += Value;
+        Sum2 += Sum1;
+    }
+
+    return Sum1 ^ ((Sum2 << 16) | (Sum2 >> 16));
+}
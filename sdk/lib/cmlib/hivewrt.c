@@ -9,26 +9,70 @@
 #define NDEBUG
 #include <debug.h>
 
-static BOOLEAN CMAPI
-HvpWriteLog(
+static BOOLEAN
+HvpIsBlockSet(
+    PRTL_BITMAP Vector,
+    ULONG BlockIndex)
+{
+    return BlockIndex < Vector->SizeOfBitMap && RtlCheckBit(Vector, BlockIndex);
+}
+
+/**
+ * @name HvpGrowLogVector
+ *
+ * Make the log bitmap cover every block the dirty bitmap covers.
+ */
+BOOLEAN CMAPI
+HvpGrowLogVector(
     PHHIVE RegistryHive)
 {
-    ULONG FileOffset;
-    UINT32 BufferSize;
-    UINT32 BitmapSize;
-    PUCHAR Buffer;
-    PUCHAR Ptr;
-    ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
-    BOOLEAN Success;
-    static ULONG PrintCount = 0;
+    ULONG BitmapSize;
+    PULONG BitmapBuffer;
+
+    if (RegistryHive->LogVector.SizeOfBitMap >= RegistryHive->DirtyVector.SizeOfBitMap)
+        return TRUE;
+
+    BitmapSize = RegistryHive->DirtyVector.SizeOfBitMap / 8;
+    BitmapBuffer = RegistryHive->Allocate(BitmapSize, TRUE, TAG_CM);
+    if (BitmapBuffer == NULL)
+        return FALSE;
 
-    if (PrintCount++ == 0)
+    RtlZeroMemory(BitmapBuffer, BitmapSize);
+    if (RegistryHive->LogVector.Buffer)
     {
-        UNIMPLEMENTED;
+        RtlCopyMemory(BitmapBuffer,
+                      RegistryHive->LogVector.Buffer,
+                      RegistryHive->LogVector.SizeOfBitMap / 8);
+        RegistryHive->Free(RegistryHive->LogVector.Buffer, 0);
     }
+
+    RtlInitializeBitMap(&RegistryHive->LogVector, BitmapBuffer, BitmapSize * 8);
     return TRUE;
+}
+
+/**
+ * @name HvpWriteLog
+ *
+ * Append the dirty blocks to the log as a single entry, made of runs of
+ * consecutive blocks. The entry, and the log header when the log starts
+ * over, go out in one write followed by one flush, so a whole burst of
+ * updates costs one ordered write no matter how many cells it touched.
+ */
+static BOOLEAN CMAPI
+HvpWriteLog(
+    PHHIVE RegistryHive)
+{
+    PHV_LOG_ENTRY LogEntry;
+    PHV_LOG_DIRTY_RUN Runs, Run = NULL;
+    PHBASE_BLOCK LogHeader;
+    ULONG FileOffset;
+    ULONG BufferSize, HeaderSize, EntrySize;
+    ULONG BlockCount, RunCount;
+    ULONG BlockIndex, Length;
+    PUCHAR Buffer, Ptr;
+    PULONG Source, Target;
+    ULONG i;
+    BOOLEAN Success;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
     ASSERT(RegistryHive->BaseBlock->Length ==
@@ -36,17 +80,28 @@ HvpWriteLog(
 
     DPRINT("HvpWriteLog called\n");
 
-    if (RegistryHive->BaseBlock->Sequence1 !=
-        RegistryHive->BaseBlock->Sequence2)
-    {
+    if (!HvpGrowLogVector(RegistryHive))
         return FALSE;
+
+    /* Count the runs of dirty blocks */
+    Length = RegistryHive->Storage[Stable].Length;
+    BlockCount = RunCount = 0;
+    for (BlockIndex = 0; BlockIndex < Length; BlockIndex++)
+    {
+        if (!HvpIsBlockSet(&RegistryHive->DirtyVector, BlockIndex))
+            continue;
+
+        if (BlockIndex == 0 || !HvpIsBlockSet(&RegistryHive->DirtyVector, BlockIndex - 1))
+            RunCount++;
+        BlockCount++;
     }
 
-    BitmapSize = RegistryHive->DirtyVector.SizeOfBitMap;
-    BufferSize = HV_LOG_HEADER_SIZE + sizeof(ULONG) + BitmapSize;
-    BufferSize = ROUND_UP(BufferSize, HBLOCK_SIZE);
+    EntrySize = ROUND_UP(sizeof(HV_LOG_ENTRY) + RunCount * sizeof(HV_LOG_DIRTY_RUN), HSECTOR_SIZE);
+    EntrySize += BlockCount * HBLOCK_SIZE;
 
-    DPRINT("Bitmap size %u  buffer size: %u\n", BitmapSize, BufferSize);
+    /* A fresh log starts with its header */
+    HeaderSize = (RegistryHive->LogSize == 0) ? HBLOCK_SIZE : 0;
+    BufferSize = HeaderSize + EntrySize;
 
     Buffer = RegistryHive->Allocate(BufferSize, TRUE, TAG_CM);
     if (Buffer == NULL)
@@ -54,104 +109,101 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Update first update counter and CheckSum */
-    RegistryHive->BaseBlock->Type = HFILE_TYPE_LOG;
-    RegistryHive->BaseBlock->Sequence1++;
-    RegistryHive->BaseBlock->CheckSum =
-        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
-
-    /* Copy hive header */
-    RtlCopyMemory(Buffer, RegistryHive->BaseBlock, HV_LOG_HEADER_SIZE);
-    Ptr = Buffer + HV_LOG_HEADER_SIZE;
-    RtlCopyMemory(Ptr, "DIRT", 4);
-    Ptr += 4;
-    RtlCopyMemory(Ptr, RegistryHive->DirtyVector.Buffer, BitmapSize);
-
-    /* Write hive block and block bitmap */
-    FileOffset = 0;
-    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, Buffer, BufferSize);
-    RegistryHive->Free(Buffer, 0);
+    /* Don't leak pool contents through the sector padding */
+    RtlZeroMemory(Buffer, BufferSize - BlockCount * HBLOCK_SIZE);
 
-    if (!Success)
+    if (HeaderSize)
     {
-        return FALSE;
+        /* The log applies on top of the primary as it is right now */
+        RegistryHive->LogBaseSequence = RegistryHive->BaseBlock->Sequence2;
+        RegistryHive->LogSequence = RegistryHive->LogBaseSequence;
+
+        LogHeader = (PHBASE_BLOCK)Buffer;
+        RtlCopyMemory(LogHeader, RegistryHive->BaseBlock, sizeof(HBASE_BLOCK));
+        LogHeader->Type = HFILE_TYPE_LOG;
+        LogHeader->Sequence1 = LogHeader->Sequence2 = RegistryHive->LogSequence;
+        LogHeader->CheckSum = HvpHiveHeaderChecksum(LogHeader);
     }
 
-    /* Write dirty blocks */
-    FileOffset = BufferSize;
-    BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    LogEntry = (PHV_LOG_ENTRY)(Buffer + HeaderSize);
+    LogEntry->Signature = HV_LOG_ENTRY_SIGNATURE;
+    LogEntry->Size = EntrySize;
+    LogEntry->Sequence = RegistryHive->LogSequence;
+    LogEntry->BaseSequence = RegistryHive->LogBaseSequence;
+    LogEntry->HiveLength = RegistryHive->BaseBlock->Length;
+    LogEntry->RunCount = RunCount;
+
+    /* Describe the runs and gather their blocks behind them */
+    Runs = (PHV_LOG_DIRTY_RUN)(LogEntry + 1);
+    RunCount = 0;
+    Ptr = (PUCHAR)LogEntry + EntrySize - BlockCount * HBLOCK_SIZE;
+    for (BlockIndex = 0; BlockIndex < Length; BlockIndex++)
     {
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~0U || BlockIndex < LastIndex)
-        {
-            break;
-        }
-
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
+        if (!HvpIsBlockSet(&RegistryHive->DirtyVector, BlockIndex))
+            continue;
 
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
+        if (BlockIndex == 0 || !HvpIsBlockSet(&RegistryHive->DirtyVector, BlockIndex - 1))
         {
-            return FALSE;
+            Run = &Runs[RunCount++];
+            Run->Offset = BlockIndex * HBLOCK_SIZE;
+            Run->Length = 0;
         }
+        Run->Length += HBLOCK_SIZE;
 
-        BlockIndex++;
-        FileOffset += HBLOCK_SIZE;
+        RtlCopyMemory(Ptr,
+                      (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress,
+                      HBLOCK_SIZE);
+        Ptr += HBLOCK_SIZE;
     }
 
-    Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
-    if (!Success)
-    {
-        DPRINT("FileSetSize failed\n");
-        return FALSE;
-    }
+    LogEntry->CheckSum = HvpLogEntryChecksum(LogEntry);
 
-    /* Flush the log file */
-    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
-    if (!Success)
-    {
-        DPRINT("FileFlush failed\n");
-    }
-
-    /* Update second update counter and CheckSum */
-    RegistryHive->BaseBlock->Sequence2++;
-    RegistryHive->BaseBlock->CheckSum =
-        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
-
-    /* Write hive header again with updated sequence counter. */
-    FileOffset = 0;
+    FileOffset = HeaderSize ? 0 : RegistryHive->LogSize;
     Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, RegistryHive->BaseBlock,
-                                      HV_LOG_HEADER_SIZE);
+                                      &FileOffset, Buffer, BufferSize);
+    RegistryHive->Free(Buffer, 0);
+
     if (!Success)
     {
         return FALSE;
     }
 
-    /* Flush the log file */
+    /* The entry must be on disk before the primary gets any of its blocks */
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
     if (!Success)
     {
         DPRINT("FileFlush failed\n");
+        return FALSE;
     }
 
+    RegistryHive->LogSize = (HeaderSize ? 0 : RegistryHive->LogSize) + BufferSize;
+    RegistryHive->LogSequence++;
+
+    /* Remember what the primary still lacks */
+    Source = RegistryHive->DirtyVector.Buffer;
+    Target = RegistryHive->LogVector.Buffer;
+    for (i = 0; i < RegistryHive->DirtyVector.SizeOfBitMap / 32; i++)
+        Target[i] |= Source[i];
+
     return TRUE;
 }
 
+/**
+ * @name HvpWriteHive
+ *
+ * Write the blocks set in the given bitmap, or all of them, to the primary
+ * file. Consecutive blocks of the same bin go out in a single write.
+ */
 static BOOLEAN CMAPI
 HvpWriteHive(
     PHHIVE RegistryHive,
-    BOOLEAN OnlyDirty)
+    PRTL_BITMAP Vector OPTIONAL)
 {
     ULONG FileOffset;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    ULONG RunLength;
+    ULONG_PTR BlockPtr;
+    PHMAP_ENTRY BlockList;
     BOOLEAN Success;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
@@ -182,31 +234,38 @@ HvpWriteHive(
         return FALSE;
     }
 
+    BlockList = RegistryHive->Storage[Stable].BlockList;
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
-        if (OnlyDirty)
+        if (Vector && !HvpIsBlockSet(Vector, BlockIndex))
         {
-            LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-            if (BlockIndex == ~0U || BlockIndex < LastIndex)
-            {
-                break;
-            }
+            BlockIndex++;
+            continue;
+        }
+
+        /* Extend the run as long as the blocks are adjacent in memory */
+        BlockPtr = BlockList[BlockIndex].BlockAddress;
+        RunLength = 1;
+        while (BlockIndex + RunLength < RegistryHive->Storage[Stable].Length &&
+               (!Vector || HvpIsBlockSet(Vector, BlockIndex + RunLength)) &&
+               BlockList[BlockIndex + RunLength].BlockAddress == BlockPtr + RunLength * HBLOCK_SIZE)
+        {
+            RunLength++;
         }
 
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
 
-        /* Write hive block */
+        /* Write hive blocks */
         Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
+                                          &FileOffset, (PVOID)BlockPtr,
+                                          RunLength * HBLOCK_SIZE);
         if (!Success)
         {
             return FALSE;
         }
 
-        BlockIndex++;
+        BlockIndex += RunLength;
     }
 
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
@@ -239,30 +298,80 @@ HvpWriteHive(
     return TRUE;
 }
 
+/**
+ * @name HvpResetLog
+ *
+ * Forget about the logged blocks once the primary holds all of them. The
+ * entries left in the log file are stale from now on, since its header
+ * no longer matches the primary sequence, and the next sync starts over.
+ */
+static VOID CMAPI
+HvpResetLog(
+    PHHIVE RegistryHive)
+{
+    RegistryHive->LogSize = 0;
+    if (RegistryHive->LogVector.Buffer)
+        RtlClearAllBits(&RegistryHive->LogVector);
+}
+
+/**
+ * @name HvSyncHive
+ *
+ * Flush the dirty blocks to disk. Hives with a log get every burst of
+ * updates appended to it first, then the primary catches up with the log.
+ * With HIVE_DELTA_LOG the primary is only brought up to date once the log
+ * grows past HV_LOG_RECONCILE_SIZE or the hive gets written out in full,
+ * and until then a sync is just the log append.
+ */
 BOOLEAN CMAPI
 HvSyncHive(
     PHHIVE RegistryHive)
 {
+    BOOLEAN Dirty;
+
     ASSERT(RegistryHive->ReadOnly == FALSE);
 
-    if (RtlFindSetBits(&RegistryHive->DirtyVector, 1, 0) == ~0U)
+    Dirty = (RtlFindSetBits(&RegistryHive->DirtyVector, 1, 0) != ~0U);
+    if (!Dirty)
     {
-        return TRUE;
+        /* Logged blocks, e.g. from a replay, may still have to reach the primary */
+        if (!RegistryHive->Log || RegistryHive->LogSize == 0 ||
+            (RegistryHive->HiveFlags & HIVE_DELTA_LOG))
+        {
+            return TRUE;
+        }
     }
 
     /* Update hive header modification time */
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
-    /* Update log file */
-    if (!HvpWriteLog(RegistryHive))
+    if (!RegistryHive->Log)
     {
-        return FALSE;
+        /* Update hive file */
+        if (!HvpWriteHive(RegistryHive, &RegistryHive->DirtyVector))
+        {
+            return FALSE;
+        }
     }
-
-    /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, TRUE))
+    else
     {
-        return FALSE;
+        /* Update log file */
+        if (Dirty && !HvpWriteLog(RegistryHive))
+        {
+            return FALSE;
+        }
+
+        /* Update hive file from the log */
+        if (!(RegistryHive->HiveFlags & HIVE_DELTA_LOG) ||
+            RegistryHive->LogSize >= HV_LOG_RECONCILE_SIZE)
+        {
+            if (!HvpWriteHive(RegistryHive, &RegistryHive->LogVector))
+            {
+                return FALSE;
+            }
+
+            HvpResetLog(RegistryHive);
+        }
     }
 
     /* Clear dirty bitmap. */
@@ -291,10 +400,13 @@ HvWriteHive(
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
     /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, FALSE))
+    if (!HvpWriteHive(RegistryHive, NULL))
     {
         return FALSE;
     }
 
+    /* Whatever was logged is in the primary now */
+    HvpResetLog(RegistryHive);
+
     return TRUE;
 }
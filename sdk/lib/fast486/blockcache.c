@@ -0,0 +1,619 @@
+/*
+ * PROJECT:     Fast486 386/486 CPU Emulation Library
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Cache of pre-decoded basic blocks
+ */
+
+/*
+ * NOTE: A block is a run of simple instructions (register moves and
+ * arithmetic, stack pushes and pops, short branches) starting at a given
+ * linear address. They are decoded once into micro-ops, which are then
+ * executed one by one, so that single-stepping, traps and interrupts keep
+ * working exactly like in the interpreter. The first instruction that is
+ * not simple ends the block and is left to the interpreter.
+ *
+ * Blocks are only built from RAM mapped in the host TLB. They keep a copy
+ * of their code bytes, which is compared against memory whenever a block
+ * is entered, so that code modified by the host or by the guest is always
+ * decoded again. The interpreter leaves the block after every instruction,
+ * so the only guest writes into the block being executed are the pushes of
+ * its own micro-ops, which drop it.
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include <windef.h>
+
+// #define NDEBUG
+#include <debug.h>
+
+#include <fast486.h>
+#include "common.h"
+#include "opcodes.h"
+
+/* DEFINES ********************************************************************/
+
+#define BLOCK_INDEX(x) ((((x) >> 4) ^ ((x) >> 12)) & (FAST486_BLOCK_CACHE_SIZE - 1))
+
+typedef enum _FAST486_MICRO_OP_TYPE
+{
+    FAST486_UOP_NOP,
+    FAST486_UOP_INC,
+    FAST486_UOP_DEC,
+    FAST486_UOP_PUSH,
+    FAST486_UOP_POP,
+    FAST486_UOP_MOV_IMM,
+    FAST486_UOP_MOV_BYTE_IMM,
+    FAST486_UOP_MOV,
+    FAST486_UOP_MOV_BYTE,
+    FAST486_UOP_ALU,
+    FAST486_UOP_ALU_BYTE,
+    FAST486_UOP_ALU_IMM,
+    FAST486_UOP_ALU_BYTE_IMM,
+
+    /* Everything from here on ends the block */
+    FAST486_UOP_JCC,
+    FAST486_UOP_JMP,
+    FAST486_UOP_LOOP
+} FAST486_MICRO_OP_TYPE;
+
+/* PRIVATE FUNCTIONS **********************************************************/
+
+FORCEINLINE
+PUCHAR
+Fast486GetByteRegister(PFAST486_STATE State, UCHAR Register)
+{
+    /* AL, CL, DL, BL, then AH, CH, DH, BH */
+    return (Register & 0x04) ? &State->GeneralRegs[Register & 0x03].HighByte
+                             : &State->GeneralRegs[Register & 0x03].LowByte;
+}
+
+static
+BOOLEAN
+Fast486DecodeMicroOp(const UCHAR *Code,
+                     ULONG Available,
+                     BOOLEAN Size,
+                     PFAST486_MICRO_OP MicroOp)
+{
+    UCHAR Opcode = Code[0];
+    UCHAR ImmediateSize = Size ? sizeof(ULONG) : sizeof(USHORT);
+    UCHAR ModRm;
+
+    MicroOp->Register = Opcode & 0x07;
+    MicroOp->Length = 1;
+
+    if (Opcode == 0x90)
+    {
+        MicroOp->Type = FAST486_UOP_NOP;
+    }
+    else if ((Opcode & 0xF0) == 0x40)
+    {
+        MicroOp->Type = (Opcode & 0x08) ? FAST486_UOP_DEC : FAST486_UOP_INC;
+    }
+    else if ((Opcode & 0xF0) == 0x50)
+    {
+        MicroOp->Type = (Opcode & 0x08) ? FAST486_UOP_POP : FAST486_UOP_PUSH;
+    }
+    else if ((Opcode & 0xF8) == 0xB0)
+    {
+        MicroOp->Type = FAST486_UOP_MOV_BYTE_IMM;
+        MicroOp->Length = 1 + sizeof(UCHAR);
+        if (Available < MicroOp->Length) return FALSE;
+
+        MicroOp->Immediate = Code[1];
+    }
+    else if ((Opcode & 0xF8) == 0xB8)
+    {
+        MicroOp->Type = FAST486_UOP_MOV_IMM;
+        MicroOp->Length = 1 + ImmediateSize;
+        if (Available < MicroOp->Length) return FALSE;
+
+        MicroOp->Immediate = Size ? *(ULONG UNALIGNED *)&Code[1]
+                                  : *(USHORT UNALIGNED *)&Code[1];
+    }
+    else if (((Opcode & 0xFC) == 0x88) || ((Opcode < 0x40) && ((Opcode & 0x07) < 0x04)))
+    {
+        /* MOV and the ALU instructions with a ModR/M byte */
+        if (Available < 2) return FALSE;
+        ModRm = Code[1];
+
+        /* Only the register to register forms are simple */
+        if ((ModRm >> 6) != 3) return FALSE;
+
+        if (Opcode >= 0x40)
+        {
+            MicroOp->Type = (Opcode & 1) ? FAST486_UOP_MOV : FAST486_UOP_MOV_BYTE;
+        }
+        else
+        {
+            MicroOp->Operation = Opcode >> 3;
+
+            /* ADC and SBB have their own flag rules in the interpreter */
+            if ((MicroOp->Operation == 2) || (MicroOp->Operation == 3)) return FALSE;
+
+            MicroOp->Type = (Opcode & 1) ? FAST486_UOP_ALU : FAST486_UOP_ALU_BYTE;
+        }
+
+        if (Opcode & FAST486_OPCODE_WRITE_REG)
+        {
+            MicroOp->Register = (ModRm >> 3) & 0x07;
+            MicroOp->SecondRegister = ModRm & 0x07;
+        }
+        else
+        {
+            MicroOp->Register = ModRm & 0x07;
+            MicroOp->SecondRegister = (ModRm >> 3) & 0x07;
+        }
+
+        MicroOp->Length = 2;
+    }
+    else if ((Opcode < 0x40) && ((Opcode & 0x07) < 0x06))
+    {
+        /* ALU instructions on AL/(E)AX with an immediate */
+        MicroOp->Operation = Opcode >> 3;
+        if ((MicroOp->Operation == 2) || (MicroOp->Operation == 3)) return FALSE;
+
+        MicroOp->Register = FAST486_REG_EAX;
+
+        if (!(Opcode & 1))
+        {
+            MicroOp->Type = FAST486_UOP_ALU_BYTE_IMM;
+            MicroOp->Length = 1 + sizeof(UCHAR);
+            if (Available < MicroOp->Length) return FALSE;
+
+            MicroOp->Immediate = Code[1];
+        }
+        else
+        {
+            MicroOp->Type = FAST486_UOP_ALU_IMM;
+            MicroOp->Length = 1 + ImmediateSize;
+            if (Available < MicroOp->Length) return FALSE;
+
+            MicroOp->Immediate = Size ? *(ULONG UNALIGNED *)&Code[1]
+                                      : *(USHORT UNALIGNED *)&Code[1];
+        }
+    }
+    else if ((Opcode == 0x80) || (Opcode == 0x81) || (Opcode == 0x83))
+    {
+        /* Group 1, all of it goes through Fast486ArithmeticOperation */
+        if (Available < 2) return FALSE;
+        ModRm = Code[1];
+
+        if ((ModRm >> 6) != 3) return FALSE;
+
+        MicroOp->Operation = (ModRm >> 3) & 0x07;
+        MicroOp->Register = ModRm & 0x07;
+
+        if (Opcode == 0x80)
+        {
+            MicroOp->Type = FAST486_UOP_ALU_BYTE_IMM;
+            MicroOp->Length = 2 + sizeof(UCHAR);
+            if (Available < MicroOp->Length) return FALSE;
+
+            MicroOp->Immediate = Code[2];
+        }
+        else if (Opcode == 0x81)
+        {
+            MicroOp->Type = FAST486_UOP_ALU_IMM;
+            MicroOp->Length = 2 + ImmediateSize;
+            if (Available < MicroOp->Length) return FALSE;
+
+            MicroOp->Immediate = Size ? *(ULONG UNALIGNED *)&Code[2]
+                                      : *(USHORT UNALIGNED *)&Code[2];
+        }
+        else
+        {
+            MicroOp->Type = FAST486_UOP_ALU_IMM;
+            MicroOp->Length = 2 + sizeof(CHAR);
+            if (Available < MicroOp->Length) return FALSE;
+
+            /* Sign-extend the immediate */
+            MicroOp->Immediate = (LONG)(CHAR)Code[2];
+        }
+    }
+    else if (((Opcode & 0xF0) == 0x70) || (Opcode == 0xEB) || ((Opcode >= 0xE0) && (Opcode <= 0xE2)))
+    {
+        /* Short branches */
+        if ((Opcode & 0xF0) == 0x70) MicroOp->Type = FAST486_UOP_JCC;
+        else if (Opcode == 0xEB) MicroOp->Type = FAST486_UOP_JMP;
+        else MicroOp->Type = FAST486_UOP_LOOP;
+
+        MicroOp->Operation = Opcode;
+        MicroOp->Length = 1 + sizeof(CHAR);
+        if (Available < MicroOp->Length) return FALSE;
+
+        MicroOp->Immediate = (LONG)(CHAR)Code[1];
+    }
+    else
+    {
+        /* Not a simple instruction */
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+Fast486DecodeBlock(PFAST486_BLOCK Block,
+                   const UCHAR *Code,
+                   ULONG Available,
+                   BOOLEAN Size)
+{
+    PFAST486_MICRO_OP MicroOp;
+    ULONG Position = 0;
+
+    Block->Size = Size;
+    Block->Count = 0;
+
+    while ((Block->Count < FAST486_BLOCK_MAX_OPS) && (Position < Available))
+    {
+        MicroOp = &Block->Ops[Block->Count];
+
+        if (!Fast486DecodeMicroOp(&Code[Position], Available - Position, Size, MicroOp))
+        {
+            /* The interpreter takes it from here */
+            break;
+        }
+
+        MicroOp->Offset = (UCHAR)Position;
+        Position += MicroOp->Length;
+        Block->Count++;
+
+        /* Branches end the block */
+        if (MicroOp->Type >= FAST486_UOP_JCC) break;
+    }
+
+    /*
+     * Keep at least the first byte, so that a block starting with a complex
+     * instruction is remembered and not decoded again every time.
+     */
+    Block->Length = (UCHAR)max(Position, 1);
+    RtlCopyMemory(Block->Code, Code, Block->Length);
+}
+
+static
+PFAST486_BLOCK
+Fast486GetBlock(PFAST486_STATE State,
+                ULONG LinearAddress,
+                ULONG Offset)
+{
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_BLOCK Block = &State->BlockCache->Blocks[BLOCK_INDEX(LinearAddress)];
+    PUCHAR Code;
+    ULONG Available;
+
+    /* Let the interpreter raise the exception */
+    if (Offset > CodeSegment->Limit) return NULL;
+
+    /* Only code in RAM is cached, and it can't fault when read from there */
+    Code = Fast486LookupHostTlb(State, LinearAddress, sizeof(UCHAR), FALSE, TRUE);
+    if (Code == NULL) return NULL;
+
+    /* A block stays within a page and within the code segment */
+    Available = min(FAST486_PAGE_SIZE - PAGE_OFFSET(LinearAddress), FAST486_BLOCK_MAX_LENGTH);
+    if ((CodeSegment->Limit - Offset) < (Available - 1)) Available = CodeSegment->Limit - Offset + 1;
+
+    /* IP wraps around in 16-bit code */
+    if (!CodeSegment->Size && ((0x10000 - Offset) < Available)) Available = 0x10000 - Offset;
+
+    if ((Block->Length != 0)
+        && (Block->Address == LinearAddress)
+        && (Block->Size == CodeSegment->Size)
+        && (Block->Length <= Available)
+        && RtlEqualMemory(Block->Code, Code, Block->Length))
+    {
+        /* The code didn't change since we decoded it */
+        return Block;
+    }
+
+    Block->Address = LinearAddress;
+    Fast486DecodeBlock(Block, Code, Available, CodeSegment->Size);
+
+    return Block;
+}
+
+static
+VOID
+Fast486ExecuteMicroOp(PFAST486_STATE State,
+                      PFAST486_MICRO_OP MicroOp,
+                      BOOLEAN Size)
+{
+    ULONG Value;
+    UCHAR Bits = Size ? 32 : 16;
+
+    switch (MicroOp->Type)
+    {
+        case FAST486_UOP_NOP:
+        {
+            break;
+        }
+
+        case FAST486_UOP_INC:
+        {
+            if (Size)
+            {
+                Value = ++State->GeneralRegs[MicroOp->Register].Long;
+
+                State->Flags.Of = (Value == SIGN_FLAG_LONG);
+                State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
+            }
+            else
+            {
+                Value = ++State->GeneralRegs[MicroOp->Register].LowWord;
+
+                State->Flags.Of = (Value == SIGN_FLAG_WORD);
+                State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
+            }
+
+            State->Flags.Zf = (Value == 0);
+            State->Flags.Af = ((Value & 0x0F) == 0);
+            State->Flags.Pf = Fast486CalculateParity(LOBYTE(Value));
+            break;
+        }
+
+        case FAST486_UOP_DEC:
+        {
+            if (Size)
+            {
+                Value = --State->GeneralRegs[MicroOp->Register].Long;
+
+                State->Flags.Of = (Value == (SIGN_FLAG_LONG - 1));
+                State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
+            }
+            else
+            {
+                Value = --State->GeneralRegs[MicroOp->Register].LowWord;
+
+                State->Flags.Of = (Value == (SIGN_FLAG_WORD - 1));
+                State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
+            }
+
+            State->Flags.Zf = (Value == 0);
+            State->Flags.Af = ((Value & 0x0F) == 0x0F);
+            State->Flags.Pf = Fast486CalculateParity(LOBYTE(Value));
+            break;
+        }
+
+        case FAST486_UOP_PUSH:
+        {
+            PFAST486_SEG_REG StackSegment = &State->SegmentRegs[FAST486_REG_SS];
+            PFAST486_BLOCK Block = State->CurrentBlock;
+            ULONG LinearAddress;
+
+            if (!Fast486StackPush(State, State->GeneralRegs[MicroOp->Register].Long))
+            {
+                /* Exception occurred */
+                State->CurrentBlock = NULL;
+                break;
+            }
+
+            /* The value is now at SS:[ESP] */
+            LinearAddress = StackSegment->Base + (StackSegment->Size
+                                                  ? State->GeneralRegs[FAST486_REG_ESP].Long
+                                                  : State->GeneralRegs[FAST486_REG_ESP].LowWord);
+
+            if ((LinearAddress < (Block->Address + Block->Length))
+                && ((LinearAddress + (Size ? sizeof(ULONG) : sizeof(USHORT))) > Block->Address))
+            {
+                /* The code being run is overwritten, it has to be decoded again */
+                State->CurrentBlock = NULL;
+            }
+
+            break;
+        }
+
+        case FAST486_UOP_POP:
+        {
+            if (!Fast486StackPop(State, &Value))
+            {
+                /* Exception occurred */
+                State->CurrentBlock = NULL;
+                break;
+            }
+
+            if (Size) State->GeneralRegs[MicroOp->Register].Long = Value;
+            else State->GeneralRegs[MicroOp->Register].LowWord = LOWORD(Value);
+            break;
+        }
+
+        case FAST486_UOP_MOV_IMM:
+        {
+            if (Size) State->GeneralRegs[MicroOp->Register].Long = MicroOp->Immediate;
+            else State->GeneralRegs[MicroOp->Register].LowWord = LOWORD(MicroOp->Immediate);
+            break;
+        }
+
+        case FAST486_UOP_MOV_BYTE_IMM:
+        {
+            *Fast486GetByteRegister(State, MicroOp->Register) = LOBYTE(MicroOp->Immediate);
+            break;
+        }
+
+        case FAST486_UOP_MOV:
+        {
+            if (Size)
+            {
+                State->GeneralRegs[MicroOp->Register].Long =
+                    State->GeneralRegs[MicroOp->SecondRegister].Long;
+            }
+            else
+            {
+                State->GeneralRegs[MicroOp->Register].LowWord =
+                    State->GeneralRegs[MicroOp->SecondRegister].LowWord;
+            }
+
+            break;
+        }
+
+        case FAST486_UOP_MOV_BYTE:
+        {
+            *Fast486GetByteRegister(State, MicroOp->Register) =
+                *Fast486GetByteRegister(State, MicroOp->SecondRegister);
+            break;
+        }
+
+        case FAST486_UOP_ALU:
+        case FAST486_UOP_ALU_IMM:
+        {
+            ULONG SecondValue = (MicroOp->Type == FAST486_UOP_ALU)
+                                ? State->GeneralRegs[MicroOp->SecondRegister].Long
+                                : MicroOp->Immediate;
+
+            Value = Fast486ArithmeticOperation(State,
+                                               MicroOp->Operation,
+                                               State->GeneralRegs[MicroOp->Register].Long,
+                                               SecondValue,
+                                               Bits);
+
+            /* CMP only updates the flags */
+            if (MicroOp->Operation == 7) break;
+
+            if (Size) State->GeneralRegs[MicroOp->Register].Long = Value;
+            else State->GeneralRegs[MicroOp->Register].LowWord = LOWORD(Value);
+            break;
+        }
+
+        case FAST486_UOP_ALU_BYTE:
+        case FAST486_UOP_ALU_BYTE_IMM:
+        {
+            PUCHAR Register = Fast486GetByteRegister(State, MicroOp->Register);
+            ULONG SecondValue = (MicroOp->Type == FAST486_UOP_ALU_BYTE)
+                                ? *Fast486GetByteRegister(State, MicroOp->SecondRegister)
+                                : MicroOp->Immediate;
+
+            Value = Fast486ArithmeticOperation(State,
+                                               MicroOp->Operation,
+                                               *Register,
+                                               SecondValue,
+                                               8);
+
+            /* CMP only updates the flags */
+            if (MicroOp->Operation != 7) *Register = LOBYTE(Value);
+            break;
+        }
+
+        case FAST486_UOP_JCC:
+        {
+            BOOLEAN Jump = FALSE;
+
+            /* Same conditions as Fast486OpcodeShortConditionalJmp */
+            switch ((MicroOp->Operation & 0x0F) >> 1)
+            {
+                case 0: Jump = State->Flags.Of; break;
+                case 1: Jump = State->Flags.Cf; break;
+                case 2: Jump = State->Flags.Zf; break;
+                case 3: Jump = State->Flags.Cf || State->Flags.Zf; break;
+                case 4: Jump = State->Flags.Sf; break;
+                case 5: Jump = State->Flags.Pf; break;
+                case 6: Jump = State->Flags.Sf != State->Flags.Of; break;
+                case 7: Jump = (State->Flags.Sf != State->Flags.Of) || State->Flags.Zf; break;
+            }
+
+            if (MicroOp->Operation & 1)
+            {
+                /* Invert the result */
+                Jump = !Jump;
+            }
+
+            if (!Jump) break;
+
+            /* Fall through */
+        }
+
+        case FAST486_UOP_JMP:
+        {
+            ULONG NewInstPtr = State->InstPtr.Long + MicroOp->Immediate;
+
+            if (!Size)
+            {
+                /* Clear the top half of EIP */
+                NewInstPtr &= 0xFFFF;
+            }
+
+            /* Same check as Fast486OpcodeShortJump */
+            if (NewInstPtr > State->SegmentRegs[FAST486_REG_CS].Limit)
+            {
+                /* The target is outside the code segment */
+                Fast486Exception(State, FAST486_EXCEPTION_GP);
+                State->CurrentBlock = NULL;
+                break;
+            }
+
+            /* Move the instruction pointer */
+            State->InstPtr.Long = NewInstPtr;
+            break;
+        }
+
+        case FAST486_UOP_LOOP:
+        {
+            BOOLEAN Condition;
+
+            if (Size) Condition = ((--State->GeneralRegs[FAST486_REG_ECX].Long) != 0);
+            else Condition = ((--State->GeneralRegs[FAST486_REG_ECX].LowWord) != 0);
+
+            /* LOOPNZ and LOOPZ */
+            if (MicroOp->Operation == 0xE0) Condition = Condition && !State->Flags.Zf;
+            else if (MicroOp->Operation == 0xE1) Condition = Condition && State->Flags.Zf;
+
+            if (Condition)
+            {
+                if (Size) State->InstPtr.Long += MicroOp->Immediate;
+                else State->InstPtr.LowWord += LOWORD(MicroOp->Immediate);
+            }
+
+            break;
+        }
+
+        default:
+        {
+            /* Shouldn't happen */
+            ASSERT(FALSE);
+        }
+    }
+}
+
+/* PUBLIC FUNCTIONS ***********************************************************/
+
+BOOLEAN
+FASTCALL
+Fast486ExecuteCachedInstruction(PFAST486_STATE State)
+{
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_BLOCK Block = State->CurrentBlock;
+    PFAST486_MICRO_OP MicroOp;
+    ULONG Offset, LinearAddress;
+
+    Offset = CodeSegment->Size ? State->InstPtr.Long : State->InstPtr.LowWord;
+    LinearAddress = CodeSegment->Base + Offset;
+
+    if ((Block == NULL)
+        || (State->CurrentOp >= Block->Count)
+        || (LinearAddress != (Block->Address + Block->Ops[State->CurrentOp].Offset)))
+    {
+        /* We are not following the current block anymore, find the next one */
+        Block = Fast486GetBlock(State, LinearAddress, Offset);
+        State->CurrentBlock = Block;
+        State->CurrentOp = 0;
+
+        if (Block == NULL) return FALSE;
+    }
+
+    if (State->CurrentOp >= Block->Count)
+    {
+        /* This one is not simple, use the interpreter */
+        State->CurrentBlock = NULL;
+        return FALSE;
+    }
+
+    MicroOp = &Block->Ops[State->CurrentOp++];
+
+    /* Skip the instruction, exceptions go back to SavedInstPtr anyway */
+    if (CodeSegment->Size) State->InstPtr.Long += MicroOp->Length;
+    else State->InstPtr.LowWord += MicroOp->Length;
+
+    Fast486ExecuteMicroOp(State, MicroOp, Block->Size);
+    return TRUE;
+}
+
+/* EOF */
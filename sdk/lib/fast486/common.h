@@ -70,6 +70,7 @@ if (State->PrefixFlags & FAST486_PREFIX_LOCK)\
 #define GET_ADDR_PTE(x) (((x) >> 12) & 0x3FF)
 #define INVALID_TLB_FIELD 0xFFFFFFFF
 #define NUM_TLB_ENTRIES 0x100000
+#define HOST_TLB_INDEX(x) (((x) >> 12) & (FAST486_HOST_TLB_ENTRIES - 1))
 
 typedef struct _FAST486_MOD_REG_RM
 {
@@ -194,6 +195,13 @@ Fast486CallGate
     BOOLEAN Call
 );
 
+BOOLEAN
+FASTCALL
+Fast486ExecuteCachedInstruction
+(
+    PFAST486_STATE State
+);
+
 /* INLINED FUNCTIONS **********************************************************/
 
 #include "common.inl"
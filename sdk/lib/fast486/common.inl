@@ -145,16 +145,125 @@ Fast486GetPageTableEntry(PFAST486_STATE State,
     return TableEntry.Value;
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushHostTlb(PFAST486_STATE State)
+{
+    ULONG i;
+
+    if (State->HostTlbEmpty) return;
+
+    for (i = 0; i < FAST486_HOST_TLB_ENTRIES; i++)
+    {
+        State->HostTlb[i].LinearPage = INVALID_TLB_FIELD;
+    }
+
+    State->HostTlbEmpty = TRUE;
+}
+
 FORCEINLINE
 VOID
 FASTCALL
 Fast486FlushTlb(PFAST486_STATE State)
 {
+    /* The host TLB caches translations too, so it always goes */
+    Fast486FlushHostTlb(State);
+
     if (!State->Tlb || State->TlbEmpty) return;
     RtlFillMemory(State->Tlb, NUM_TLB_ENTRIES * sizeof(ULONG), 0xFF);
     State->TlbEmpty = TRUE;
 }
 
+FORCEINLINE
+PUCHAR
+FASTCALL
+Fast486LookupHostTlb(PFAST486_STATE State,
+                     ULONG LinearAddress,
+                     ULONG Size,
+                     BOOLEAN Write,
+                     BOOLEAN CheckPrivilege)
+{
+    PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[HOST_TLB_INDEX(LinearAddress)];
+    PUCHAR HostPage = Write ? Entry->WritePage : Entry->ReadPage;
+
+    /* The access must stay within a single cached page */
+    if ((Entry->LinearPage != PAGE_ALIGN(LinearAddress))
+        || (HostPage == NULL)
+        || ((PAGE_OFFSET(LinearAddress) + Size) > FAST486_PAGE_SIZE))
+    {
+        return NULL;
+    }
+
+    /* Supervisor pages can only be used directly from ring 0 */
+    if (CheckPrivilege && !Entry->Usermode && (Fast486GetCurrentPrivLevel(State) > 0))
+    {
+        return NULL;
+    }
+
+    return HostPage + PAGE_OFFSET(LinearAddress);
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FillHostTlb(PFAST486_STATE State,
+                   ULONG LinearAddress,
+                   ULONG PhysicalAddress,
+                   BOOLEAN Write,
+                   BOOLEAN Usermode)
+{
+    PFAST486_HOST_TLB_ENTRY Entry;
+    PUCHAR HostPage;
+
+    if (State->MemMapCallback == NULL) return;
+
+    /* Ask the host whether this page is plain RAM */
+    HostPage = State->MemMapCallback(State, PAGE_ALIGN(PhysicalAddress), Write);
+    if (HostPage == NULL) return;
+
+    Entry = &State->HostTlb[HOST_TLB_INDEX(LinearAddress)];
+
+    if (Entry->LinearPage != PAGE_ALIGN(LinearAddress))
+    {
+        /* Evict whatever page was using this slot */
+        Entry->LinearPage = PAGE_ALIGN(LinearAddress);
+        Entry->Usermode = Usermode;
+        Entry->WritePage = NULL;
+    }
+
+    Entry->ReadPage = HostPage;
+    if (Write) Entry->WritePage = HostPage;
+
+    State->HostTlbEmpty = FALSE;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486CopyHostMemory(PVOID Destination, const VOID *Source, ULONG Size)
+{
+    /* Most accesses are small, avoid the call overhead for them */
+    switch (Size)
+    {
+        case sizeof(UCHAR):
+            *(PUCHAR)Destination = *(const UCHAR *)Source;
+            break;
+
+        case sizeof(USHORT):
+            *(USHORT UNALIGNED *)Destination = *(const USHORT UNALIGNED *)Source;
+            break;
+
+        case sizeof(ULONG):
+            *(ULONG UNALIGNED *)Destination = *(const ULONG UNALIGNED *)Source;
+            break;
+
+        default:
+            RtlMoveMemory(Destination, Source, Size);
+            break;
+    }
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -164,6 +273,16 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
                         ULONG Size,
                         BOOLEAN CheckPrivilege)
 {
+    PUCHAR HostAddress;
+
+    /* Try the host TLB first, RAM can be read without the callbacks */
+    HostAddress = Fast486LookupHostTlb(State, LinearAddress, Size, FALSE, CheckPrivilege);
+    if (HostAddress != NULL)
+    {
+        Fast486CopyHostMemory(Buffer, HostAddress, Size);
+        return TRUE;
+    }
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -213,6 +332,16 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
                                    (PVOID)((ULONG_PTR)Buffer + BufferOffset),
                                    PageLength);
 
+            /* Cache the translation for the next access */
+            if (TableEntry.Present)
+            {
+                Fast486FillHostTlb(State,
+                                   Page,
+                                   TableEntry.Address << 12,
+                                   FALSE,
+                                   TableEntry.Usermode);
+            }
+
             BufferOffset += PageLength;
         }
     }
@@ -220,6 +349,9 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
     {
         /* Read the memory */
         State->MemReadCallback(State, LinearAddress, Buffer, Size);
+
+        /* Without paging, linear and physical addresses are the same */
+        Fast486FillHostTlb(State, LinearAddress, LinearAddress, FALSE, TRUE);
     }
 
     return TRUE;
@@ -234,6 +366,16 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                          ULONG Size,
                          BOOLEAN CheckPrivilege)
 {
+    PUCHAR HostAddress;
+
+    /* Try the host TLB first, RAM can be written without the callbacks */
+    HostAddress = Fast486LookupHostTlb(State, LinearAddress, Size, TRUE, CheckPrivilege);
+    if (HostAddress != NULL)
+    {
+        Fast486CopyHostMemory(HostAddress, Buffer, Size);
+        return TRUE;
+    }
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -286,6 +428,20 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                                     (PVOID)((ULONG_PTR)Buffer + BufferOffset),
                                     PageLength);
 
+            /*
+             * Cache the translation for the next access. Only writable pages
+             * qualify, and the dirty bit has just been set, so later writes
+             * don't need to walk the page tables again.
+             */
+            if (TableEntry.Present && TableEntry.Writeable)
+            {
+                Fast486FillHostTlb(State,
+                                   Page,
+                                   TableEntry.Address << 12,
+                                   TRUE,
+                                   TableEntry.Usermode);
+            }
+
             BufferOffset += PageLength;
         }
     }
@@ -293,6 +449,9 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
     {
         /* Write the memory */
         State->MemWriteCallback(State, LinearAddress, Buffer, Size);
+
+        /* Without paging, linear and physical addresses are the same */
+        Fast486FillHostTlb(State, LinearAddress, LinearAddress, TRUE, TRUE);
     }
 
     return TRUE;
@@ -1013,6 +1172,130 @@ Fast486CalculateParity(UCHAR Number)
     return (0x9669 >> ((Number & 0x0F) ^ (Number >> 4))) & 1;
 }
 
+FORCEINLINE
+ULONG
+FASTCALL
+Fast486ArithmeticOperation(PFAST486_STATE State,
+                           INT Operation,
+                           ULONG FirstValue,
+                           ULONG SecondValue,
+                           UCHAR Bits)
+{
+    ULONG Result;
+    ULONG SignFlag = 1 << (Bits - 1);
+    ULONG MaxValue = (SignFlag - 1) | SignFlag;
+
+    /* Make sure the values don't exceed the maximum for their size */
+    FirstValue &= MaxValue;
+    SecondValue &= MaxValue;
+
+    /* Check which operation is this */
+    switch (Operation)
+    {
+        /* ADD */
+        case 0:
+        {
+            Result = (FirstValue + SecondValue) & MaxValue;
+
+            /* Update CF, OF and AF */
+            State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
+            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
+                              && ((FirstValue & SignFlag) != (Result & SignFlag));
+            State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
+
+            break;
+        }
+
+        /* OR */
+        case 1:
+        {
+            Result = FirstValue | SecondValue;
+            State->Flags.Cf = State->Flags.Of = FALSE;
+            break;
+        }
+
+        /* ADC */
+        case 2:
+        {
+            INT Carry = State->Flags.Cf ? 1 : 0;
+
+            Result = (FirstValue + SecondValue + Carry) & MaxValue;
+
+            /* Update CF, OF and AF */
+            State->Flags.Cf = ((SecondValue == MaxValue) && (Carry == 1))
+                              || ((Result < FirstValue) && (Result < (SecondValue + Carry)));
+            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
+                              && ((FirstValue & SignFlag) != (Result & SignFlag));
+            State->Flags.Af = ((FirstValue ^ SecondValue ^ Result) & 0x10) != 0;
+
+            break;
+        }
+
+        /* SBB */
+        case 3:
+        {
+            INT Carry = State->Flags.Cf ? 1 : 0;
+
+            Result = (FirstValue - SecondValue - Carry) & MaxValue;
+
+            /* Update CF, OF and AF */
+            State->Flags.Cf = Carry
+                              ? (FirstValue <= SecondValue)
+                              : (FirstValue < SecondValue);
+            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
+                              && ((FirstValue & SignFlag) != (Result & SignFlag));
+            State->Flags.Af = ((FirstValue ^ SecondValue ^ Result) & 0x10) != 0;
+
+            break;
+        }
+
+        /* AND */
+        case 4:
+        {
+            Result = FirstValue & SecondValue;
+            State->Flags.Cf = State->Flags.Of = FALSE;
+            break;
+        }
+
+        /* SUB or CMP */
+        case 5:
+        case 7:
+        {
+            Result = (FirstValue - SecondValue) & MaxValue;
+
+            /* Update CF, OF and AF */
+            State->Flags.Cf = (FirstValue < SecondValue);
+            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
+                              && ((FirstValue & SignFlag) != (Result & SignFlag));
+            State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
+
+            break;
+        }
+
+        /* XOR */
+        case 6:
+        {
+            Result = FirstValue ^ SecondValue;
+            State->Flags.Cf = State->Flags.Of = FALSE;
+            break;
+        }
+
+        default:
+        {
+            /* Shouldn't happen */
+            ASSERT(FALSE);
+        }
+    }
+
+    /* Update ZF, SF and PF */
+    State->Flags.Zf = (Result == 0);
+    State->Flags.Sf = ((Result & SignFlag) != 0);
+    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
+
+    /* Return the result */
+    return Result;
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
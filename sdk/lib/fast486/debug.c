@@ -66,6 +66,12 @@ NextInst:
             {
                 State->SavedInstPtr = State->InstPtr;
                 State->SavedStackPtr = State->GeneralRegs[FAST486_REG_ESP];
+
+                /* Run it from the block cache if it is a simple instruction */
+                if ((State->BlockCache != NULL) && Fast486ExecuteCachedInstruction(State))
+                {
+                    goto CheckInterrupts;
+                }
             }
 
             /* Perform an instruction fetch */
@@ -87,8 +93,13 @@ NextInst:
 
             /* A non-prefix opcode has been executed, reset the prefix flags */
             State->PrefixFlags = 0;
+
+            /* The interpreter may have changed anything, leave the block */
+            State->CurrentBlock = NULL;
         }
 
+CheckInterrupts:
+
         /*
          * Check if there is an interrupt to execute, or a hardware interrupt signal
          * while interrupts are enabled.
@@ -110,6 +121,7 @@ NextInst:
 
             /* Acknowledge the interrupt and perform it */
             Fast486PerformInterrupt(State, State->IntAckCallback(State));
+            State->CurrentBlock = NULL;
 
             /* Clear the interrupt status */
             State->IntSignaled = FALSE;
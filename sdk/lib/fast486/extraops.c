@@ -645,6 +645,11 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeLoadControlReg)
         /* Flush the TLB */
         Fast486FlushTlb(State);
     }
+    else if (ModRegRm.Register == (INT)FAST486_REG_CR0)
+    {
+        /* Toggling paging or write protection changes the host TLB rules */
+        Fast486FlushHostTlb(State);
+    }
 
     /* Load a value to the control register */
     State->ControlRegisters[ModRegRm.Register] = Value;
@@ -108,6 +108,7 @@ Fast486Initialize(PFAST486_STATE         State,
                   FAST486_BOP_PROC       BopCallback,
                   FAST486_INT_ACK_PROC   IntAckCallback,
                   FAST486_FPU_PROC       FpuCallback,
+                  FAST486_MEM_MAP_PROC   MemMapCallback,
                   PULONG                 Tlb)
 {
     /* Set the callbacks (or use default ones if some are NULL) */
@@ -119,6 +120,9 @@ Fast486Initialize(PFAST486_STATE         State,
     State->IntAckCallback   = (IntAckCallback   ? IntAckCallback   : Fast486IntAckCallback  );
     State->FpuCallback      = (FpuCallback      ? FpuCallback      : Fast486FpuCallback     );
 
+    /* There is no default memory map, without one the host TLB stays empty */
+    State->MemMapCallback   = MemMapCallback;
+
     /* Set the TLB (if given) */
     State->Tlb = Tlb;
 
@@ -132,7 +136,7 @@ Fast486Reset(PFAST486_STATE State)
 {
     FAST486_SEG_REGS i;
 
-    /* Save the callbacks and TLB */
+    /* Save the callbacks, TLB and block cache */
     FAST486_MEM_READ_PROC  MemReadCallback  = State->MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback = State->MemWriteCallback;
     FAST486_IO_READ_PROC   IoReadCallback   = State->IoReadCallback;
@@ -140,7 +144,9 @@ Fast486Reset(PFAST486_STATE State)
     FAST486_BOP_PROC       BopCallback      = State->BopCallback;
     FAST486_INT_ACK_PROC   IntAckCallback   = State->IntAckCallback;
     FAST486_FPU_PROC       FpuCallback      = State->FpuCallback;
+    FAST486_MEM_MAP_PROC   MemMapCallback   = State->MemMapCallback;
     PULONG                 Tlb              = State->Tlb;
+    PFAST486_BLOCK_CACHE   BlockCache       = State->BlockCache;
 
     /* Clear the entire structure */
     RtlZeroMemory(State, sizeof(*State));
@@ -186,7 +192,7 @@ Fast486Reset(PFAST486_STATE State)
     State->FpuTag = 0xFFFF;
 #endif
 
-    /* Restore the callbacks and TLB */
+    /* Restore the callbacks, TLB and block cache */
     State->MemReadCallback  = MemReadCallback;
     State->MemWriteCallback = MemWriteCallback;
     State->IoReadCallback   = IoReadCallback;
@@ -194,7 +200,9 @@ Fast486Reset(PFAST486_STATE State)
     State->BopCallback      = BopCallback;
     State->IntAckCallback   = IntAckCallback;
     State->FpuCallback      = FpuCallback;
+    State->MemMapCallback   = MemMapCallback;
     State->Tlb              = Tlb;
+    State->BlockCache       = BlockCache;
 
     /* Flush the TLB */
     Fast486FlushTlb(State);
@@ -260,4 +268,41 @@ Fast486Rewind(PFAST486_STATE State)
 #endif
 }
 
+VOID
+NTAPI
+Fast486InvalidateMemoryMap(PFAST486_STATE State)
+{
+    /*
+     * The host changed what backs the physical address space (e.g. it
+     * installed a memory hook or toggled the A20 line), so the host
+     * pointers we cached may be stale.
+     */
+    Fast486FlushHostTlb(State);
+    State->CurrentBlock = NULL;
+
+#ifndef FAST486_NO_PREFETCH
+    State->PrefetchValid = FALSE;
+#endif
+}
+
+VOID
+NTAPI
+Fast486SetBlockCache(PFAST486_STATE State, PFAST486_BLOCK_CACHE BlockCache)
+{
+    ULONG i;
+
+    if (BlockCache != NULL)
+    {
+        /* Start with all the blocks empty */
+        for (i = 0; i < FAST486_BLOCK_CACHE_SIZE; i++)
+        {
+            BlockCache->Blocks[i].Length = 0;
+        }
+    }
+
+    /* A NULL block cache turns the feature off */
+    State->BlockCache = BlockCache;
+    State->CurrentBlock = NULL;
+}
+
 /* EOF */
@@ -619,14 +619,23 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeShortConditionalJmp)
 
     if (Jump)
     {
-        /* Move the instruction pointer */
-        State->InstPtr.Long += Offset;
+        ULONG NewInstPtr = State->InstPtr.Long + Offset;
 
         if (!Size)
         {
             /* Clear the top half of EIP */
-            State->InstPtr.Long &= 0xFFFF;
+            NewInstPtr &= 0xFFFF;
         }
+
+        if (NewInstPtr > State->SegmentRegs[FAST486_REG_CS].Limit)
+        {
+            /* The target is outside the code segment */
+            Fast486Exception(State, FAST486_EXCEPTION_GP);
+            return;
+        }
+
+        /* Move the instruction pointer */
+        State->InstPtr.Long = NewInstPtr;
     }
 }
 
@@ -943,6 +952,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOut)
 FAST486_OPCODE_HANDLER(Fast486OpcodeShortJump)
 {
     CHAR Offset = 0;
+    ULONG NewInstPtr;
     BOOLEAN Size = State->SegmentRegs[FAST486_REG_CS].Size;
 
     TOGGLE_OPSIZE(Size);
@@ -957,14 +967,23 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeShortJump)
         return;
     }
 
-    /* Move the instruction pointer */
-    State->InstPtr.Long += Offset;
+    NewInstPtr = State->InstPtr.Long + Offset;
 
     if (!Size)
     {
         /* Clear the top half of EIP */
-        State->InstPtr.Long &= 0xFFFF;
+        NewInstPtr &= 0xFFFF;
     }
+
+    if (NewInstPtr > State->SegmentRegs[FAST486_REG_CS].Limit)
+    {
+        /* The target is outside the code segment */
+        Fast486Exception(State, FAST486_EXCEPTION_GP);
+        return;
+    }
+
+    /* Move the instruction pointer */
+    State->InstPtr.Long = NewInstPtr;
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeMovRegImm)
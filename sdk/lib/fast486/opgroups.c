@@ -32,130 +32,6 @@
 
 /* PRIVATE FUNCTIONS **********************************************************/
 
-static
-inline
-ULONG
-Fast486ArithmeticOperation(PFAST486_STATE State,
-                           INT Operation,
-                           ULONG FirstValue,
-                           ULONG SecondValue,
-                           UCHAR Bits)
-{
-    ULONG Result;
-    ULONG SignFlag = 1 << (Bits - 1);
-    ULONG MaxValue = (SignFlag - 1) | SignFlag;
-
-    /* Make sure the values don't exceed the maximum for their size */
-    FirstValue &= MaxValue;
-    SecondValue &= MaxValue;
-
-    /* Check which operation is this */
-    switch (Operation)
-    {
-        /* ADD */
-        case 0:
-        {
-            Result = (FirstValue + SecondValue) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-
-            break;
-        }
-
-        /* OR */
-        case 1:
-        {
-            Result = FirstValue | SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
-            break;
-        }
-
-        /* ADC */
-        case 2:
-        {
-            INT Carry = State->Flags.Cf ? 1 : 0;
-
-            Result = (FirstValue + SecondValue + Carry) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = ((SecondValue == MaxValue) && (Carry == 1))
-                              || ((Result < FirstValue) && (Result < (SecondValue + Carry)));
-            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = ((FirstValue ^ SecondValue ^ Result) & 0x10) != 0;
-
-            break;
-        }
-
-        /* SBB */
-        case 3:
-        {
-            INT Carry = State->Flags.Cf ? 1 : 0;
-
-            Result = (FirstValue - SecondValue - Carry) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = Carry
-                              ? (FirstValue <= SecondValue)
-                              : (FirstValue < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = ((FirstValue ^ SecondValue ^ Result) & 0x10) != 0;
-
-            break;
-        }
-
-        /* AND */
-        case 4:
-        {
-            Result = FirstValue & SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
-            break;
-        }
-
-        /* SUB or CMP */
-        case 5:
-        case 7:
-        {
-            Result = (FirstValue - SecondValue) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = (FirstValue < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-
-            break;
-        }
-
-        /* XOR */
-        case 6:
-        {
-            Result = FirstValue ^ SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
-            break;
-        }
-
-        default:
-        {
-            /* Shouldn't happen */
-            ASSERT(FALSE);
-        }
-    }
-
-    /* Update ZF, SF and PF */
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SignFlag) != 0);
-    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
-
-    /* Return the result */
-    return Result;
-}
-
 static
 inline
 ULONG
@@ -2284,6 +2160,12 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeGroup0F01)
                 State->Tlb[ModRegRm.MemoryAddress >> 12] = INVALID_TLB_FIELD;
             }
 
+            /*
+             * The host TLB is small and INVLPG is rare, so drop all of it
+             * rather than work out which segment the operand refers to.
+             */
+            Fast486FlushHostTlb(State);
+
             break;
         }
 
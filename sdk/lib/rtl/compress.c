@@ -20,6 +20,33 @@
 #define COMPRESSION_FORMAT_MASK  0x00FF
 #define COMPRESSION_ENGINE_MASK  0xFF00
 
+/* LZNT1 compressor parameters */
+#define LZNT1_CHUNK_SIZE         0x1000
+#define LZNT1_HASH_BITS          12
+#define LZNT1_HASH_SIZE          (1 << LZNT1_HASH_BITS)
+#define LZNT1_MIN_MATCH          3
+#define LZNT1_NIL                0xFFFF
+#define LZNT1_STANDARD_PROBES    16
+
+/* RtlDecompressChunks work splitting */
+#define RTLP_MAX_CHUNK_SLICES       8
+#define RTLP_MIN_CHUNKS_PER_SLICE   4
+
+/* TYPES ********************************************************************/
+
+/* Hash chains over the chunk being compressed, positions are chunk relative */
+typedef struct _LZNT1_WORKSPACE
+{
+    USHORT HashHead[LZNT1_HASH_SIZE];
+    USHORT HashChain[LZNT1_CHUNK_SIZE];
+} LZNT1_WORKSPACE, *PLZNT1_WORKSPACE;
+
+/* hash the next LZNT1_MIN_MATCH bytes */
+static inline ULONG lznt1_hash(const UCHAR *ptr)
+{
+    ULONG value = (ptr[0] << 16) | (ptr[1] << 8) | ptr[2];
+    return (value * 2654435761U) >> (32 - LZNT1_HASH_BITS);
+}
 
 
 
@@ -216,28 +243,188 @@ out:
 }
 
 
+/* find the longest match for the data at src + pos within the current chunk */
+static ULONG lznt1_find_match(UCHAR *src, ULONG src_size, ULONG pos, ULONG max_probes,
+                              LZNT1_WORKSPACE *workspace, ULONG *displacement)
+{
+    ULONG displacement_bits, max_length, length, best_length = 0;
+    USHORT candidate;
+
+    if (pos + LZNT1_MIN_MATCH > src_size)
+        return 0;
+
+    /* same length / displacement split as the decompressor uses */
+    for (displacement_bits = 12; displacement_bits > 4; displacement_bits--)
+        if ((1 << (displacement_bits - 1)) < pos) break;
+    max_length = min((1 << (16 - displacement_bits)) + 2, src_size - pos);
+
+    /* walk the hash chain, from the closest candidate to the farthest one */
+    candidate = workspace->HashHead[lznt1_hash(src + pos)];
+    while (candidate != LZNT1_NIL && max_probes--)
+    {
+        /* cheap rejection before comparing the whole thing */
+        if (src[candidate + best_length] == src[pos + best_length])
+        {
+            for (length = 0; length < max_length; length++)
+                if (src[candidate + length] != src[pos + length]) break;
+
+            if (length > best_length)
+            {
+                best_length = length;
+                *displacement = pos - candidate;
+                if (length == max_length) break;
+            }
+        }
+        candidate = workspace->HashChain[candidate];
+    }
+
+    return (best_length >= LZNT1_MIN_MATCH) ? best_length : 0;
+}
+
+/* add all positions up to (but not including) limit to the hash chains */
+static void lznt1_insert_hashes(UCHAR *src, ULONG src_size, ULONG *hashed, ULONG limit,
+                                LZNT1_WORKSPACE *workspace)
+{
+    ULONG hash;
+
+    for (; *hashed < limit; (*hashed)++)
+    {
+        if (*hashed + LZNT1_MIN_MATCH > src_size)
+            continue;
+
+        hash = lznt1_hash(src + *hashed);
+        workspace->HashChain[*hashed] = workspace->HashHead[hash];
+        workspace->HashHead[hash] = (USHORT)*hashed;
+    }
+}
+
+/* compress a single LZNT1 chunk, returns NULL if the result doesn't fit into dst */
+static PUCHAR lznt1_compress_chunk(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size,
+                                   USHORT engine, LZNT1_WORKSPACE *workspace)
+{
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *flags_ptr;
+    ULONG pos = 0, hashed = 0, length = 0, displacement = 0;
+    ULONG next_length, next_displacement, displacement_bits, max_probes, bit;
+    BOOLEAN have_match = FALSE, lazy;
+    UCHAR flags;
+
+    /* the maximum engine searches the whole window and evaluates matches lazily */
+    lazy = (engine == COMPRESSION_ENGINE_MAXIMUM);
+    max_probes = lazy ? LZNT1_CHUNK_SIZE : LZNT1_STANDARD_PROBES;
+
+    RtlFillMemory(workspace->HashHead, sizeof(workspace->HashHead), 0xFF);
+
+    while (pos < src_size)
+    {
+        /* reserve the flags byte for the next 8 entities */
+        if (dst_cur >= dst_end) return NULL;
+        flags_ptr = dst_cur++;
+        flags = 0;
+
+        for (bit = 0; bit < 8 && pos < src_size; bit++)
+        {
+            if (!have_match)
+            {
+                lznt1_insert_hashes(src, src_size, &hashed, pos, workspace);
+                length = lznt1_find_match(src, src_size, pos, max_probes, workspace, &displacement);
+            }
+            have_match = FALSE;
+
+            /* if the next position gives a longer match, emit a literal first */
+            if (lazy && length && pos + 1 < src_size)
+            {
+                lznt1_insert_hashes(src, src_size, &hashed, pos + 1, workspace);
+                next_length = lznt1_find_match(src, src_size, pos + 1, max_probes,
+                                               workspace, &next_displacement);
+                if (next_length > length)
+                {
+                    if (dst_cur >= dst_end) return NULL;
+                    *dst_cur++ = src[pos++];
+
+                    length = next_length;
+                    displacement = next_displacement;
+                    have_match = TRUE;
+                    continue;
+                }
+            }
+
+            if (length)
+            {
+                /* backwards reference */
+                if (dst_cur + sizeof(WORD) > dst_end) return NULL;
+
+                for (displacement_bits = 12; displacement_bits > 4; displacement_bits--)
+                    if ((1 << (displacement_bits - 1)) < pos) break;
+
+                *(WORD *)dst_cur = (WORD)(((displacement - 1) << (16 - displacement_bits)) |
+                                          (length - LZNT1_MIN_MATCH));
+                dst_cur += sizeof(WORD);
+                flags |= 1 << bit;
+                pos += length;
+            }
+            else
+            {
+                /* uncompressed data */
+                if (dst_cur >= dst_end) return NULL;
+                *dst_cur++ = src[pos++];
+            }
+        }
+
+        *flags_ptr = flags;
+    }
+
+    return dst_cur;
+}
+
 static NTSTATUS
 RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
-                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
+                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace,
+                        USHORT engine)
 {
         UCHAR *src_cur = src, *src_end = src + src_size;
         UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-        ULONG block_size;
+        ULONG block_size, limit;
+        UCHAR *ptr;
+
+        if (engine != COMPRESSION_ENGINE_STANDARD && engine != COMPRESSION_ENGINE_MAXIMUM)
+            return STATUS_NOT_SUPPORTED;
 
         while (src_cur < src_end)
         {
             /* determine size of current chunk */
-            block_size = min(0x1000, src_end - src_cur);
-            if (dst_cur + sizeof(WORD) + block_size > dst_end)
+            block_size = min(LZNT1_CHUNK_SIZE, src_end - src_cur);
+            if (dst_cur + sizeof(WORD) > dst_end)
                 return STATUS_BUFFER_TOO_SMALL;
 
-            /* write (uncompressed) chunk header */
-            *(WORD *)dst_cur = 0x3000 | (block_size - 1);
-            dst_cur += sizeof(WORD);
+            /* try to compress it, it's only worth it if it gets smaller */
+            ptr = NULL;
+            if (workspace)
+            {
+                limit = min(block_size - 1, dst_end - dst_cur - sizeof(WORD));
+                ptr = lznt1_compress_chunk(dst_cur + sizeof(WORD), limit, src_cur, block_size,
+                                           engine, (LZNT1_WORKSPACE *)workspace);
+            }
+
+            if (ptr)
+            {
+                /* write compressed chunk header */
+                *(WORD *)dst_cur = 0xB000 | (ptr - dst_cur - sizeof(WORD) - 1);
+                dst_cur = ptr;
+            }
+            else
+            {
+                if (dst_cur + sizeof(WORD) + block_size > dst_end)
+                    return STATUS_BUFFER_TOO_SMALL;
+
+                /* write (uncompressed) chunk header */
+                *(WORD *)dst_cur = 0x3000 | (block_size - 1);
+                dst_cur += sizeof(WORD);
+
+                /* write chunk content */
+                memcpy(dst_cur, src_cur, block_size);
+                dst_cur += block_size;
+            }
 
-            /* write chunk content */
-            memcpy(dst_cur, src_cur, block_size);
-            dst_cur += block_size;
             src_cur += block_size;
         }
 
@@ -253,16 +440,12 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
                        PULONG BufferAndWorkSpaceSize,
                        PULONG FragmentWorkSpaceSize)
 {
-   if (Engine == COMPRESSION_ENGINE_STANDARD)
+   /* Both engines share the hash chain workspace, they differ in how far they search */
+   if ((Engine == COMPRESSION_ENGINE_STANDARD) ||
+       (Engine == COMPRESSION_ENGINE_MAXIMUM))
    {
-      *BufferAndWorkSpaceSize = 0x8010;
-      *FragmentWorkSpaceSize = 0x1000;
-      return(STATUS_SUCCESS);
-   }
-   else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
-   {
-      *BufferAndWorkSpaceSize = 0x10;
-      *FragmentWorkSpaceSize = 0x1000;
+      *BufferAndWorkSpaceSize = sizeof(LZNT1_WORKSPACE);
+      *FragmentWorkSpaceSize = LZNT1_CHUNK_SIZE;
       return(STATUS_SUCCESS);
    }
 
@@ -284,7 +467,7 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                   IN PVOID WorkSpace)
 {
    USHORT Format = CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
-   /* USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK; */
+   USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
 
    if ((Format == COMPRESSION_FORMAT_NONE) ||
          (Format == COMPRESSION_FORMAT_DEFAULT))
@@ -297,14 +480,52 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                                      CompressedBufferSize,
                                      UncompressedChunkSize,
                                      FinalCompressedSize,
-                                     WorkSpace));
+                                     WorkSpace,
+                                     Engine));
 
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
 
 
+static BOOLEAN
+RtlpIsZeroChunk(IN PUCHAR Buffer,
+                IN ULONG Size)
+{
+    ULONG Aligned = Size & ~(sizeof(ULONG) - 1);
+
+    if (RtlCompareMemoryUlong(Buffer, Aligned, 0) != Aligned)
+        return FALSE;
+
+    while (Aligned < Size)
+    {
+        if (Buffer[Aligned++]) return FALSE;
+    }
+
+    return TRUE;
+}
+
+static NTSTATUS
+RtlpValidateChunkInfo(IN PCOMPRESSED_DATA_INFO CompressedDataInfo)
+{
+    USHORT Format = CompressedDataInfo->CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
+
+    if ((Format == COMPRESSION_FORMAT_NONE) ||
+        (Format == COMPRESSION_FORMAT_DEFAULT))
+        return STATUS_INVALID_PARAMETER;
+
+    if (Format != COMPRESSION_FORMAT_LZNT1)
+        return STATUS_UNSUPPORTED_COMPRESSION;
+
+    /* Chunks are made of whole LZNT1 chunks, at most 32 KB */
+    if ((CompressedDataInfo->ChunkShift < 9) ||
+        (CompressedDataInfo->ChunkShift > 15))
+        return STATUS_INVALID_PARAMETER;
+
+    return STATUS_SUCCESS;
+}
+
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlCompressChunks(IN PUCHAR UncompressedBuffer,
@@ -315,12 +536,129 @@ RtlCompressChunks(IN PUCHAR UncompressedBuffer,
                   IN ULONG CompressedDataInfoLength,
                   IN PVOID WorkSpace)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    USHORT Engine = CompressedDataInfo->CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
+    PUCHAR Source = UncompressedBuffer, Destination = CompressedBuffer;
+    ULONG ChunkSize, NumberOfChunks, Chunk, BlockSize, Remaining, FinalSize;
+    NTSTATUS Status;
+
+    Status = RtlpValidateChunkInfo(CompressedDataInfo);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    ChunkSize = 1 << CompressedDataInfo->ChunkShift;
+    NumberOfChunks = (UncompressedBufferSize + ChunkSize - 1) >> CompressedDataInfo->ChunkShift;
+    if ((NumberOfChunks > MAXUSHORT) ||
+        (CompressedDataInfoLength < FIELD_OFFSET(COMPRESSED_DATA_INFO, CompressedChunkSizes[NumberOfChunks])))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    for (Chunk = 0; Chunk < NumberOfChunks; Chunk++)
+    {
+        BlockSize = min(ChunkSize, UncompressedBufferSize - (Chunk << CompressedDataInfo->ChunkShift));
+        Remaining = CompressedBufferSize - (ULONG)(Destination - CompressedBuffer);
+
+        /* Chunks of zeroes take no space at all */
+        if (RtlpIsZeroChunk(Source, BlockSize))
+        {
+            CompressedDataInfo->CompressedChunkSizes[Chunk] = 0;
+            Source += BlockSize;
+            continue;
+        }
+
+        /* A chunk is only kept compressed if it ends up smaller than ChunkSize */
+        Status = RtlpCompressBufferLZNT1(Source, BlockSize,
+                                         Destination, min(Remaining, ChunkSize - 1),
+                                         LZNT1_CHUNK_SIZE, &FinalSize, WorkSpace, Engine);
+        if (Status == STATUS_BUFFER_TOO_SMALL)
+        {
+            /* Store it as is, ChunkSize bytes tell the reader it isn't compressed */
+            if (Remaining < ChunkSize)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            RtlCopyMemory(Destination, Source, BlockSize);
+            RtlZeroMemory(Destination + BlockSize, ChunkSize - BlockSize);
+            FinalSize = ChunkSize;
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            return Status;
+        }
+
+        CompressedDataInfo->CompressedChunkSizes[Chunk] = FinalSize;
+        Destination += FinalSize;
+        Source += BlockSize;
+    }
+
+    CompressedDataInfo->NumberOfChunks = (USHORT)NumberOfChunks;
+    return STATUS_SUCCESS;
+}
+
+typedef struct _RTLP_DECOMPRESS_CHUNKS
+{
+    PUCHAR UncompressedBuffer;
+    ULONG UncompressedBufferSize;
+    PCOMPRESSED_DATA_INFO CompressedDataInfo;
+    ULONG ChunkSize;
+    ULONG NumberOfChunks;
+    ULONG ChunksPerSlice;
+    PUCHAR SliceSource[RTLP_MAX_CHUNK_SLICES];
+    /* First chunk that is in the tail rather than the buffer, if any */
+    ULONG TailChunk;
+    PUCHAR CompressedTail;
+    volatile LONG Status;
+} RTLP_DECOMPRESS_CHUNKS, *PRTLP_DECOMPRESS_CHUNKS;
+
+static VOID
+NTAPI
+RtlpDecompressChunkSlice(IN PVOID Context,
+                         IN ULONG Slice)
+{
+    PRTLP_DECOMPRESS_CHUNKS Job = Context;
+    ULONG Chunk, LastChunk, CompressedSize, BlockSize, FinalSize;
+    PUCHAR Source, Destination;
+    NTSTATUS Status;
+
+    Chunk = Slice * Job->ChunksPerSlice;
+    LastChunk = min(Chunk + Job->ChunksPerSlice, Job->NumberOfChunks);
+    Source = Job->SliceSource[Slice];
+
+    for (; Chunk < LastChunk; Chunk++)
+    {
+        if (Chunk == Job->TailChunk)
+            Source = Job->CompressedTail;
+
+        CompressedSize = Job->CompressedDataInfo->CompressedChunkSizes[Chunk];
+        Destination = Job->UncompressedBuffer + Chunk * Job->ChunkSize;
+        BlockSize = min(Job->ChunkSize, Job->UncompressedBufferSize - Chunk * Job->ChunkSize);
+        FinalSize = 0;
+
+        if (CompressedSize == Job->ChunkSize)
+        {
+            /* Stored as is */
+            RtlCopyMemory(Destination, Source, BlockSize);
+            FinalSize = BlockSize;
+        }
+        else if (CompressedSize)
+        {
+            Status = RtlDecompressBuffer(Job->CompressedDataInfo->CompressionFormatAndEngine,
+                                         Destination, BlockSize,
+                                         Source, CompressedSize,
+                                         &FinalSize);
+            if (!NT_SUCCESS(Status))
+            {
+                InterlockedCompareExchange(&Job->Status, Status, STATUS_SUCCESS);
+                return;
+            }
+        }
+
+        /* Whatever the chunk didn't cover is zeroes */
+        if (FinalSize < BlockSize)
+            RtlZeroMemory(Destination + FinalSize, BlockSize - FinalSize);
+
+        Source += CompressedSize;
+    }
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlDecompressChunks(OUT PUCHAR UncompressedBuffer,
@@ -331,8 +669,82 @@ RtlDecompressChunks(OUT PUCHAR UncompressedBuffer,
                     IN ULONG CompressedTailSize,
                     IN PCOMPRESSED_DATA_INFO CompressedDataInfo)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    RTLP_DECOMPRESS_CHUNKS Job;
+    PUCHAR Source, SourceEnd;
+    ULONG Chunk, Slices, CompressedSize, Zeroed;
+    BOOLEAN InTail = FALSE;
+    NTSTATUS Status;
+
+    Status = RtlpValidateChunkInfo(CompressedDataInfo);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Job.UncompressedBuffer = UncompressedBuffer;
+    Job.UncompressedBufferSize = UncompressedBufferSize;
+    Job.CompressedDataInfo = CompressedDataInfo;
+    Job.ChunkSize = 1 << CompressedDataInfo->ChunkShift;
+    Job.NumberOfChunks = min(CompressedDataInfo->NumberOfChunks,
+                             (UncompressedBufferSize + Job.ChunkSize - 1) >> CompressedDataInfo->ChunkShift);
+    Job.TailChunk = MAXULONG;
+    Job.CompressedTail = CompressedTail;
+    Job.Status = STATUS_SUCCESS;
+
+    /*
+     * Spreading only pays off with a few chunks per worker. The workers run in
+     * another context, so they can only be given system space buffers.
+     */
+    Slices = 1;
+    if ((CompressedDataInfo->Reserved & COMPRESSED_DATA_INFO_PARALLEL) &&
+        ((PVOID)UncompressedBuffer > MmHighestUserAddress) &&
+        ((PVOID)CompressedBuffer > MmHighestUserAddress) &&
+        (!CompressedTail || (PVOID)CompressedTail > MmHighestUserAddress))
+    {
+        Slices = min(Job.NumberOfChunks / RTLP_MIN_CHUNKS_PER_SLICE, RTLP_MAX_CHUNK_SLICES);
+        Slices = max(Slices, 1);
+    }
+    Job.ChunksPerSlice = (Job.NumberOfChunks + Slices - 1) / Slices;
+
+    /* Locate every chunk up front, once the buffer runs out the rest is in the tail */
+    Source = CompressedBuffer;
+    SourceEnd = CompressedBuffer + CompressedBufferSize;
+    for (Chunk = 0; Chunk < Job.NumberOfChunks; Chunk++)
+    {
+        CompressedSize = CompressedDataInfo->CompressedChunkSizes[Chunk];
+
+        if (CompressedSize > Job.ChunkSize)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        if ((ULONG)(SourceEnd - Source) < CompressedSize)
+        {
+            if (InTail || !CompressedTail ||
+                (CompressedTailSize < CompressedSize))
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            Source = CompressedTail;
+            SourceEnd = CompressedTail + CompressedTailSize;
+            Job.TailChunk = Chunk;
+            InTail = TRUE;
+        }
+
+        if (!(Chunk % Job.ChunksPerSlice))
+            Job.SliceSource[Chunk / Job.ChunksPerSlice] = Source;
+
+        Source += CompressedSize;
+    }
+
+    if (Slices > 1)
+        RtlpRunInParallel(RtlpDecompressChunkSlice, &Job, Slices);
+    else if (Job.NumberOfChunks)
+        RtlpDecompressChunkSlice(&Job, 0);
+
+    if (!NT_SUCCESS(Job.Status))
+        return Job.Status;
+
+    /* Chunks past the end of the description are all zeroes */
+    Zeroed = Job.NumberOfChunks * Job.ChunkSize;
+    if (Zeroed < UncompressedBufferSize)
+        RtlZeroMemory(UncompressedBuffer + Zeroed, UncompressedBufferSize - Zeroed);
+
+    return STATUS_SUCCESS;
 }
 
 /*
@@ -9,7 +9,8 @@
 /* NOTE: This functionality can be optimized for releasing single
    threads or for releasing all waiting threads at once. This
    implementation is optimized for releasing a single thread at a time.
-   It wakes up sleeping threads in FIFO order. */
+   It wakes up sleeping threads in FIFO order. Sleeping threads wait
+   on the address of their own wait entry. */
 
 /* INCLUDES ******************************************************************/
 
@@ -30,17 +31,13 @@ typedef struct _COND_VAR_WAIT_ENTRY
     /* ListEntry must have an alignment of at least 32-bits, since we
        want COND_VAR_ADDRESS_MASK to cover all of the address. */
     LIST_ENTRY ListEntry;
-    PVOID WaitKey;
+    LONG Woken;
     BOOLEAN ListRemovalHandled;
 } COND_VAR_WAIT_ENTRY, * PCOND_VAR_WAIT_ENTRY;
 
 #define CONTAINING_COND_VAR_WAIT_ENTRY(address, field) \
     CONTAINING_RECORD(address, COND_VAR_WAIT_ENTRY, field)
 
-/* GLOBALS *******************************************************************/
-
-static HANDLE CondVarKeyedEventHandle = NULL;
-
 /* INTERNAL FUNCTIONS ********************************************************/
 
 FORCEINLINE
@@ -265,11 +262,8 @@ InternalWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
     PCOND_VAR_WAIT_ENTRY CONST HeadEntry = InternalLockCondVar(ConditionVariable, NULL, NULL);
     PCOND_VAR_WAIT_ENTRY Entry;
     PCOND_VAR_WAIT_ENTRY NextEntry;
-    LARGE_INTEGER Timeout;
     PCOND_VAR_WAIT_ENTRY RemoveOnUnlockEntry;
 
-    ASSERT(CondVarKeyedEventHandle != NULL);
-
     if (HeadEntry == NULL)
     {
         /* There is noone there to wake up. In this case do nothing
@@ -277,7 +271,6 @@ InternalWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
         return;
     }
 
-    Timeout.QuadPart = 0;
     RemoveOnUnlockEntry = NULL;
 
     /* Release sleeping threads. We will iterate from the last entry on
@@ -287,8 +280,6 @@ InternalWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
          Entry != NULL;
          Entry = NextEntry)
     {
-        NTSTATUS Status;
-
         if (HeadEntry == Entry)
         {
             /* After the current entry we've iterated through the
@@ -302,19 +293,12 @@ InternalWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
             NextEntry = CONTAINING_COND_VAR_WAIT_ENTRY(Entry->ListEntry.Blink, ListEntry);
         }
 
-        /* Wake the thread associated with this event. We will
-           immediately return if we failed (zero timeout). */
-        Status = NtReleaseKeyedEvent(CondVarKeyedEventHandle,
-                                     &Entry->WaitKey,
-                                     FALSE,
-                                     &Timeout);
-
-        if (!NT_SUCCESS(Status))
-        {
-            /* We failed to wake a thread. We'll keep trying. */
-            ASSERT(STATUS_INVALID_HANDLE != Status);
-            continue;
-        }
+        /* Wake the thread associated with this entry. Unlike a keyed
+           event release this can't fail: either the thread is still
+           about to wait and sees Woken, or it is already blocked on
+           the address and gets released. */
+        (void)InterlockedExchange(&Entry->Woken, TRUE);
+        RtlWakeAddressSingle(&Entry->Woken);
 
         /* We've woken a thread and will make sure this thread
            is removed from the list. */
@@ -375,9 +359,9 @@ InternalSleep(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
        held again on return. */
 
     COND_VAR_WAIT_ENTRY OwnEntry;
-    NTSTATUS Status;
+    LONG NotWoken = FALSE;
+    NTSTATUS Status = STATUS_SUCCESS;
 
-    ASSERT(CondVarKeyedEventHandle != NULL);
     ASSERT((CriticalSection == NULL) != (SRWLock == NULL));
 
     RtlZeroMemory(&OwnEntry, sizeof(OwnEntry));
@@ -404,13 +388,19 @@ InternalSleep(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
         RtlLeaveCriticalSection(CriticalSection);
     }
 
-    /* Now sleep using the caller provided timeout. */
-    Status = NtWaitForKeyedEvent(CondVarKeyedEventHandle,
-                                 &OwnEntry.WaitKey,
-                                 FALSE,
-                                 (PLARGE_INTEGER)TimeOut);
+    /* Now sleep using the caller provided timeout. The address may be
+       woken spuriously if a stale wake hits our stack, so recheck. */
+    while (OwnEntry.Woken == FALSE)
+    {
+        Status = RtlWaitOnAddress(&OwnEntry.Woken,
+                                  &NotWoken,
+                                  sizeof(OwnEntry.Woken),
+                                  (PLARGE_INTEGER)TimeOut);
+        if (Status != STATUS_SUCCESS)
+            break;
+    }
 
-    ASSERT(STATUS_INVALID_HANDLE != Status);
+    ASSERT(STATUS_INVALID_PARAMETER != Status);
 
     if (!*InternalGetListRemovalHandledFlag(&OwnEntry))
     {
@@ -451,25 +441,10 @@ InternalSleep(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
         RtlEnterCriticalSection(CriticalSection);
     }
 
-    /* Return whatever NtWaitForKeyedEvent returned. */
+    /* Return whatever RtlWaitOnAddress returned. */
     return Status;
 }
 
-VOID
-RtlpInitializeKeyedEvent(VOID)
-{
-    ASSERT(CondVarKeyedEventHandle == NULL);
-    NtCreateKeyedEvent(&CondVarKeyedEventHandle, EVENT_ALL_ACCESS, NULL, 0);
-}
-
-VOID
-RtlpCloseKeyedEvent(VOID)
-{
-    ASSERT(CondVarKeyedEventHandle != NULL);
-    NtClose(CondVarKeyedEventHandle);
-    CondVarKeyedEventHandle = NULL;
-}
-
 /* EXPORTED FUNCTIONS ********************************************************/
 
 VOID
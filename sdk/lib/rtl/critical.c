@@ -34,73 +34,18 @@ extern HANDLE LdrpShutdownThreadId;
     (((CriticalSection)->DebugInfo != NULL) && \
      ((CriticalSection)->DebugInfo != LongToPtr(-1)))
 
-/*++
- * RtlpCreateCriticalSectionSem
- *
- *     Checks if an Event has been created for the critical section.
- *
- * Params:
- *     None
- *
- * Returns:
- *     None. Raises an exception if the system call failed.
- *
- * Remarks:
- *     None
- *
- *--*/
-_At_(CriticalSection->LockSemaphore, _Post_notnull_)
-VOID
-NTAPI
-RtlpCreateCriticalSectionSem(PRTL_CRITICAL_SECTION CriticalSection)
-{
-    HANDLE hEvent = CriticalSection->LockSemaphore;
-    HANDLE hNewEvent;
-    NTSTATUS Status;
-
-    /* Check if we have an event */
-    if (!hEvent)
-    {
-        /* No, so create it */
-        Status = NtCreateEvent(&hNewEvent,
-                               EVENT_ALL_ACCESS,
-                               NULL,
-                               SynchronizationEvent,
-                               FALSE);
-        if (!NT_SUCCESS(Status))
-        {
-            DPRINT1("Failed to Create Event!\n");
-
-            /*
-             * Use INVALID_HANDLE_VALUE (-1) to signal that
-             * the global keyed event must be used.
-             */
-            hNewEvent = INVALID_HANDLE_VALUE;
-        }
-
-        DPRINT("Created Event: %p\n", hNewEvent);
-
-        /* Exchange the LockSemaphore field with the new handle, if it is still 0 */
-        if (InterlockedCompareExchangePointer((PVOID*)&CriticalSection->LockSemaphore,
-                                              (PVOID)hNewEvent,
-                                               NULL) != NULL)
-        {
-            /* Someone else just created an event */
-            if (hNewEvent != INVALID_HANDLE_VALUE)
-            {
-                DPRINT("Closing already created event: %p\n", hNewEvent);
-                NtClose(hNewEvent);
-            }
-        }
-    }
-
-    return;
-}
+/*
+ * LockSemaphore doesn't hold an event handle anymore. It is a wake token
+ * set by the releasing thread and consumed by the waiting one, and waiters
+ * block on its address. That keeps the event semantics of the old
+ * implementation, without a kernel object per contended critical section.
+ */
+#define CRITSECT_WAKE_TOKEN ((HANDLE)1)
 
 /*++
  * RtlpWaitForCriticalSection
  *
- *     Slow path of RtlEnterCriticalSection. Waits on an Event Object.
+ *     Slow path of RtlEnterCriticalSection. Waits for the wake token.
  *
  * Params:
  *     CriticalSection - Critical section to acquire.
@@ -119,9 +64,10 @@ RtlpWaitForCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
     NTSTATUS Status;
     EXCEPTION_RECORD ExceptionRecord;
     BOOLEAN LastChance = FALSE;
+    HANDLE NoToken = NULL;
 
     /* Increase the Debug Entry count */
-    DPRINT("Waiting on Critical Section Event: %p %p\n",
+    DPRINT("Waiting on Critical Section: %p %p\n",
             CriticalSection,
             CriticalSection->LockSemaphore);
 
@@ -139,74 +85,62 @@ RtlpWaitForCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
         return STATUS_SUCCESS;
     }
 
-    /* Do we have an Event yet? */
-    if (!CriticalSection->LockSemaphore)
-    {
-        RtlpCreateCriticalSectionSem(CriticalSection);
-    }
-
     for (;;)
     {
         /* Increase the number of times we've had contention */
         if (CRITSECT_HAS_DEBUG_INFO(CriticalSection))
             CriticalSection->DebugInfo->ContentionCount++;
 
-        /* Check if allocating the event failed */
-        if (CriticalSection->LockSemaphore == INVALID_HANDLE_VALUE)
-        {
-            /* Use the global keyed event (NULL as keyed event handle) */
-            Status = NtWaitForKeyedEvent(NULL,
-                                         CriticalSection,
-                                         FALSE,
-                                         (RtlpTimeoutDisable ? NULL : &RtlpTimeout));
-        }
-        else
-        {
-            /* Wait on the Event */
-            Status = NtWaitForSingleObject(CriticalSection->LockSemaphore,
-                                           FALSE,
-                                           (RtlpTimeoutDisable ? NULL : &RtlpTimeout));
-        }
-
-        /* We have Timed out */
-        if (Status == STATUS_TIMEOUT)
+        for (;;)
         {
-            /* Is this the 2nd time we've timed out? */
-            if (LastChance)
+            /* Consume the wake token if the owner left one for us */
+            if (InterlockedCompareExchangePointer((PVOID*)&CriticalSection->LockSemaphore,
+                                                  NULL,
+                                                  CRITSECT_WAKE_TOKEN) == CRITSECT_WAKE_TOKEN)
             {
-                ERROR_DBGBREAK("Deadlock: 0x%p\n", CriticalSection);
-
-                /* Yes it is, we are raising an exception */
-                ExceptionRecord.ExceptionCode    = STATUS_POSSIBLE_DEADLOCK;
-                ExceptionRecord.ExceptionFlags   = 0;
-                ExceptionRecord.ExceptionRecord  = NULL;
-                ExceptionRecord.ExceptionAddress = RtlRaiseException;
-                ExceptionRecord.NumberParameters = 1;
-                ExceptionRecord.ExceptionInformation[0] = (ULONG_PTR)CriticalSection;
-                RtlRaiseException(&ExceptionRecord);
+                /* If we are here, everything went fine */
+                return STATUS_SUCCESS;
             }
 
-            /* One more try */
-            LastChance = TRUE;
+            /* Wait for the token to show up */
+            Status = RtlWaitOnAddress(&CriticalSection->LockSemaphore,
+                                      &NoToken,
+                                      sizeof(NoToken),
+                                      (RtlpTimeoutDisable ? NULL : &RtlpTimeout));
+            if (Status == STATUS_TIMEOUT)
+                break;
         }
-        else
+
+        /* We have Timed out. Is this the 2nd time we've timed out? */
+        if (LastChance)
         {
-            /* If we are here, everything went fine */
-            return STATUS_SUCCESS;
+            ERROR_DBGBREAK("Deadlock: 0x%p\n", CriticalSection);
+
+            /* Yes it is, we are raising an exception */
+            ExceptionRecord.ExceptionCode    = STATUS_POSSIBLE_DEADLOCK;
+            ExceptionRecord.ExceptionFlags   = 0;
+            ExceptionRecord.ExceptionRecord  = NULL;
+            ExceptionRecord.ExceptionAddress = RtlRaiseException;
+            ExceptionRecord.NumberParameters = 1;
+            ExceptionRecord.ExceptionInformation[0] = (ULONG_PTR)CriticalSection;
+            RtlRaiseException(&ExceptionRecord);
         }
+
+        /* One more try */
+        LastChance = TRUE;
     }
 }
 
 /*++
  * RtlpUnWaitCriticalSection
  *
- *     Slow path of RtlLeaveCriticalSection. Fires an Event Object.
+ *     Slow path of RtlLeaveCriticalSection. Hands the wake token to a waiter.
  *
  * Params:
  *     CriticalSection - Critical section to release.
  *
  * Returns:
- *     None. Raises an exception if the system call failed.
+ *     None.
  *
  * Remarks:
  *     None
@@ -216,40 +150,14 @@ VOID
 NTAPI
 RtlpUnWaitCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 {
-    NTSTATUS Status;
-
-    /* Do we have an Event yet? */
-    if (!CriticalSection->LockSemaphore)
-    {
-        RtlpCreateCriticalSectionSem(CriticalSection);
-    }
-
-    /* Signal the Event */
-    DPRINT("Signaling Critical Section Event: %p, %p\n",
-            CriticalSection,
-            CriticalSection->LockSemaphore);
-
-    /* Check if this critical section needs to use the keyed event */
-    if (CriticalSection->LockSemaphore == INVALID_HANDLE_VALUE)
-    {
-        /* Release keyed event */
-        Status = NtReleaseKeyedEvent(NULL, CriticalSection, FALSE, &RtlpTimeout);
-    }
-    else
-    {
-        /* Set the event */
-        Status = NtSetEvent(CriticalSection->LockSemaphore, NULL);
-    }
-
-    if (!NT_SUCCESS(Status))
-    {
-        /* We've failed */
-        DPRINT1("Signaling Failed for: %p, %p, 0x%08lx\n",
-                CriticalSection,
-                CriticalSection->LockSemaphore,
-                Status);
-        RtlRaiseStatus(Status);
-    }
+    /* Signal the waiters */
+    DPRINT("Signaling Critical Section: %p\n", CriticalSection);
+
+    /* Like an auto-reset event, the token stays set until a waiter
+       consumes it, so a waiter that didn't block yet can't miss it */
+    (void)InterlockedExchangePointer((PVOID*)&CriticalSection->LockSemaphore,
+                                     CRITSECT_WAKE_TOKEN);
+    RtlWakeAddressSingle(&CriticalSection->LockSemaphore);
 }
 
 /*++
@@ -400,8 +308,9 @@ RtlDeleteCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 
     DPRINT("Deleting Critical Section: %p\n", CriticalSection);
 
-    /* Close the Event Object Handle if it exists */
-    if (CriticalSection->LockSemaphore)
+    /* Close the Event Object Handle if someone put one there */
+    if (CriticalSection->LockSemaphore &&
+        CriticalSection->LockSemaphore != CRITSECT_WAKE_TOKEN)
     {
         /* In case NtClose fails, return the status */
         Status = NtClose(CriticalSection->LockSemaphore);
@@ -1766,6 +1766,10 @@ RtlDestroyHeap(HANDLE HeapPtr) /* [in] Handle of heap */
                             MEM_RELEASE);
     }
 
+    /* Tear down the front end heap, its memory goes away with the segments */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP)
+        RtlpDestroyLowFragHeap(Heap);
+
     /* Delete tags and remove heap from the process heaps list in user mode */
     if (RtlpGetMode() == UserMode)
     {
@@ -2051,13 +2055,7 @@ RtlAllocateHeap(IN PVOID HeapPtr,
                 IN SIZE_T Size)
 {
     PHEAP Heap = (PHEAP)HeapPtr;
-    SIZE_T AllocationSize;
-    SIZE_T Index;
-    UCHAR EntryFlags = HEAP_ENTRY_BUSY;
-    BOOLEAN HeapLocked = FALSE;
-    PHEAP_VIRTUAL_ALLOC_ENTRY VirtualBlock = NULL;
-    PHEAP_ENTRY_EXTRA Extra;
-    NTSTATUS Status;
+    PVOID Block;
 
     /* Force flags */
     Flags |= Heap->ForceFlags;
@@ -2081,6 +2079,34 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     //DPRINT("RtlAllocateHeap(%p %x %x)\n", Heap, Flags, Size);
 
+    /* Small blocks without extra stuff are served by the front end heap if it's enabled */
+    if ((Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP) &&
+        (Size <= HEAP_LFH_MAX_BLOCK_SIZE) &&
+        !(Flags & HEAP_EXTRA_FLAGS_MASK) &&
+        !Heap->PseudoTagEntries)
+    {
+        Block = RtlpLowFragHeapAllocate(Heap, Flags, Size);
+        if (Block) return Block;
+
+        /* Let the back end deal with the failure */
+    }
+
+    return RtlpAllocateHeapBackEnd(Heap, Flags, Size);
+}
+
+PVOID NTAPI
+RtlpAllocateHeapBackEnd(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size)
+{
+    SIZE_T AllocationSize;
+    SIZE_T Index;
+    UCHAR EntryFlags = HEAP_ENTRY_BUSY;
+    BOOLEAN HeapLocked = FALSE;
+    PHEAP_VIRTUAL_ALLOC_ENTRY VirtualBlock = NULL;
+    PHEAP_ENTRY_EXTRA Extra;
+    NTSTATUS Status;
+
     /* Calculate allocation size and index */
     if (Size)
         AllocationSize = Size;
@@ -2275,7 +2301,7 @@ BOOLEAN NTAPI RtlFreeHeap(
     USHORT TagIndex = 0;
     SIZE_T BlockSize;
     PHEAP_VIRTUAL_ALLOC_ENTRY VirtualEntry;
-    BOOLEAN Locked = FALSE;
+    BOOLEAN Locked = FALSE, LowFragEntry = FALSE;
     NTSTATUS Status;
 
     /* Freeing NULL pointer is a legal operation */
@@ -2295,10 +2321,14 @@ BOOLEAN NTAPI RtlFreeHeap(
     /* Protect with SEH in case the pointer is not valid */
     _SEH2_TRY
     {
+        /* Check whether this entry belongs to the front end heap */
+        LowFragEntry = (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP) &&
+                       RtlpIsLowFragHeapEntry(HeapEntry);
+
         /* Check this entry, fail if it's invalid */
         if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
             (((ULONG_PTR)Ptr & 0x7) != 0) ||
-            (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
+            (!LowFragEntry && (HeapEntry->SegmentOffset >= HEAP_SEGMENTS)))
         {
             /* This is an invalid block */
             DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
@@ -2315,6 +2345,19 @@ BOOLEAN NTAPI RtlFreeHeap(
     }
     _SEH2_END;
 
+    /* Front end heap blocks don't need the heap lock */
+    if (LowFragEntry)
+    {
+        if (!RtlpLowFragHeapFree(Heap, HeapEntry))
+        {
+            DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
     /* Lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2706,6 +2749,13 @@ RtlReAllocateHeap(HANDLE HeapPtr,
         return NULL;
     }
 
+    /* Front end heap blocks are resized by the front end heap */
+    if ((Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP) &&
+        RtlpIsLowFragHeapEntry((PHEAP_ENTRY)Ptr - 1))
+    {
+        return RtlpLowFragHeapReAllocate(Heap, Flags, Ptr, Size);
+    }
+
     /* Calculate allocation size and index */
     if (Size)
         AllocationSize = Size;
@@ -3216,6 +3266,11 @@ RtlSizeHeap(
     {
         EntrySize = RtlpGetSizeOfBigBlock(HeapEntry);
     }
+    else if (RtlpIsLowFragHeapEntry(HeapEntry))
+    {
+        /* Front end heap blocks keep the requested size in the header */
+        EntrySize = HeapEntry->Size;
+    }
     else
     {
         /* Calculate it */
@@ -3279,6 +3334,14 @@ RtlpValidateHeapEntry(
     if ((ULONG_PTR)HeapEntry & (HEAP_ENTRY_SIZE - 1)) goto invalid_entry;
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY)) goto invalid_entry;
 
+    /* Front end heap blocks are checked against their subsegment */
+    if ((Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP) &&
+        RtlpIsLowFragHeapEntry(HeapEntry))
+    {
+        if (!RtlpValidateLowFragHeapEntry(Heap, HeapEntry)) goto invalid_entry;
+        return TRUE;
+    }
+
     BigAllocation = HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC;
     Segment = Heap->Segments[HeapEntry->SegmentOffset];
 
@@ -4074,13 +4137,18 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
         }
 
         /* Check for a special magic value for enabling LFH */
-        if (*(PULONG)HeapInformation != 2)
+        if (*(PULONG)HeapInformation != HEAP_FRONT_LOWFRAGHEAP)
         {
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        /* Enabling it for all heaps is not supported */
+        if (!HeapHandle)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        return RtlpActivateLowFragHeap((PHEAP)HeapHandle);
     }
 
     return STATUS_SUCCESS;
@@ -54,6 +54,19 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* Front end heap types, as reported by HeapCompatibilityInformation */
+#define HEAP_FRONT_NONE          0
+#define HEAP_FRONT_LOOKASIDE     1
+#define HEAP_FRONT_LOWFRAGHEAP   2
+
+/* Low fragmentation heap definitions */
+#define HEAP_LFH_BUCKETS                128
+#define HEAP_LFH_MAX_BLOCK_SIZE         (16 * 1024)
+#define HEAP_LFH_SEGMENT_OFFSET         0xFE
+#define HEAP_LFH_SUBSEGMENT_SIGNATURE   0x5346484C /* 'LHFS' */
+#define HEAP_LFH_MIN_SUBSEGMENT_BLOCKS  4
+#define HEAP_LFH_MAX_SUBSEGMENT_SIZE    (64 * 1024)
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -313,6 +326,59 @@ typedef struct _HEAP_VIRTUAL_ALLOC_ENTRY
     HEAP_ENTRY BusyBlock;
 } HEAP_VIRTUAL_ALLOC_ENTRY, *PHEAP_VIRTUAL_ALLOC_ENTRY;
 
+/* Low fragmentation heap structures.
+ *
+ * Blocks handed out by the LFH carry a regular HEAP_ENTRY header, so that
+ * RtlFreeHeap & co. can recognize them, with the following field meanings:
+ *   Size          - number of bytes requested by the caller
+ *   Flags         - HEAP_ENTRY_BUSY and the user settable flags
+ *   PreviousSize  - offset (in heap entries) of the block from its subsegment
+ *   SegmentOffset - always HEAP_LFH_SEGMENT_OFFSET
+ * Subsegments themselves are ordinary busy blocks of the back end heap.
+ */
+typedef struct _HEAP_LFH_BUCKET
+{
+    PHEAP_LOCK Lock;
+    LIST_ENTRY AvailableList;
+    LIST_ENTRY FullList;
+    ULONG BlockUnits;
+    ULONG SubSegmentBlocks;
+    ULONG Allocations;
+    ULONG Frees;
+    ULONG SubSegmentsCreated;
+    ULONG SubSegmentsReleased;
+    HEAP_LOCK LockStorage;
+} HEAP_LFH_BUCKET, *PHEAP_LFH_BUCKET;
+
+typedef struct _HEAP_LFH
+{
+    struct _HEAP *Heap;
+    HEAP_LFH_BUCKET Buckets[HEAP_LFH_BUCKETS];
+} HEAP_LFH, *PHEAP_LFH;
+
+typedef struct _HEAP_LFH_SUBSEGMENT
+{
+    LIST_ENTRY ListEntry;
+    PHEAP_LFH_BUCKET Bucket;
+    PHEAP_LFH Lfh;
+    ULONG Signature;
+    USHORT BlockCount;
+    USHORT FreeCount;
+    USHORT NextUnused;
+    USHORT Reserved;
+    SINGLE_LIST_ENTRY FreeBlocks;
+} HEAP_LFH_SUBSEGMENT, *PHEAP_LFH_SUBSEGMENT;
+
+#define HEAP_LFH_SUBSEGMENT_HEADER_SIZE \
+    ROUND_UP(sizeof(HEAP_LFH_SUBSEGMENT), HEAP_ENTRY_SIZE)
+
+FORCEINLINE BOOLEAN
+RtlpIsLowFragHeapEntry(PHEAP_ENTRY HeapEntry)
+{
+    return !(HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC) &&
+           (HeapEntry->SegmentOffset == HEAP_LFH_SEGMENT_OFFSET);
+}
+
 /* Global variables */
 extern RTL_CRITICAL_SECTION RtlpProcessHeapsListLock;
 extern BOOLEAN RtlpPageHeapEnabled;
@@ -338,6 +404,37 @@ RtlpValidateHeapEntry(PHEAP Heap, PHEAP_ENTRY HeapEntry);
 BOOLEAN NTAPI
 RtlpValidateHeapHeaders(PHEAP Heap, BOOLEAN Recalculate);
 
+PVOID NTAPI
+RtlpAllocateHeapBackEnd(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size);
+
+/* heaplfh.c */
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap);
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap);
+
+PVOID NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry);
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size);
+
+BOOLEAN NTAPI
+RtlpValidateLowFragHeapEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry);
+
 /* heapdbg.c */
 HANDLE NTAPI
 RtlDebugCreateHeap(ULONG Flags,
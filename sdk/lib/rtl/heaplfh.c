@@ -0,0 +1,468 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            lib/rtl/heaplfh.c
+ * PURPOSE:         RTL Low Fragmentation Heap (front end allocator)
+ */
+
+/* Useful references:
+   http://illmatics.com/Understanding_the_LFH.pdf
+*/
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+/*
+ * Buckets follow the same granularity scheme as the Windows LFH:
+ * 32 buckets with 8 bytes granularity (up to 256 bytes), then 6 groups of
+ * 16 buckets each, doubling the granularity with every group (up to 16 KB).
+ */
+static
+ULONG
+RtlpLowFragHeapBucketIndex(SIZE_T Size)
+{
+    SIZE_T Base = 256, Granularity = 16;
+    ULONG Group = 0;
+
+    if (!Size) Size = 1;
+
+    if (Size <= 256)
+        return (ULONG)((Size - 1) >> 3);
+
+    while (Size > Base * 2)
+    {
+        Base *= 2;
+        Granularity *= 2;
+        Group++;
+    }
+
+    return 32 + Group * 16 + (ULONG)((Size - Base - 1) / Granularity);
+}
+
+static
+SIZE_T
+RtlpLowFragHeapBucketSize(ULONG Index)
+{
+    ULONG Group;
+
+    if (Index < 32)
+        return (Index + 1) << 3;
+
+    Group = (Index - 32) / 16;
+    return (256 << Group) + ((Index - 32) % 16 + 1) * (16 << Group);
+}
+
+static
+PHEAP_LFH_SUBSEGMENT
+RtlpLowFragHeapGetSubSegment(PHEAP_ENTRY HeapEntry)
+{
+    return (PHEAP_LFH_SUBSEGMENT)(HeapEntry - HeapEntry->PreviousSize);
+}
+
+static
+PHEAP_LFH_SUBSEGMENT
+RtlpLowFragHeapCreateSubSegment(PHEAP Heap,
+                                PHEAP_LFH_BUCKET Bucket)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    SIZE_T BlockSize, Size;
+    ULONG BlockCount;
+
+    /* Read the sizing hint, it's only updated under the bucket lock */
+    BlockSize = (SIZE_T)Bucket->BlockUnits << HEAP_ENTRY_SHIFT;
+    BlockCount = Bucket->SubSegmentBlocks;
+    Size = HEAP_LFH_SUBSEGMENT_HEADER_SIZE + BlockCount * BlockSize;
+
+    /* Subsegments come from the back end, never call it with a bucket lock held */
+    SubSegment = RtlpAllocateHeapBackEnd(Heap, 0, Size);
+    if (!SubSegment) return NULL;
+
+    SubSegment->Bucket = Bucket;
+    SubSegment->Lfh = Heap->FrontEndHeap;
+    SubSegment->Signature = HEAP_LFH_SUBSEGMENT_SIGNATURE;
+    SubSegment->BlockCount = (USHORT)BlockCount;
+    SubSegment->FreeCount = (USHORT)BlockCount;
+    SubSegment->NextUnused = 0;
+    SubSegment->Reserved = 0;
+    SubSegment->FreeBlocks.Next = NULL;
+
+    return SubSegment;
+}
+
+static
+PHEAP_ENTRY
+RtlpLowFragHeapPopBlock(PHEAP_LFH_BUCKET Bucket,
+                        PHEAP_LFH_SUBSEGMENT SubSegment)
+{
+    PSINGLE_LIST_ENTRY FreeLink;
+    PHEAP_ENTRY Block;
+
+    ASSERT(SubSegment->FreeCount != 0);
+
+    FreeLink = PopEntryList(&SubSegment->FreeBlocks);
+    if (FreeLink)
+    {
+        /* Reuse a previously freed block */
+        Block = (PHEAP_ENTRY)FreeLink - 1;
+    }
+    else
+    {
+        /* Carve a block which was never handed out yet */
+        ASSERT(SubSegment->NextUnused < SubSegment->BlockCount);
+        Block = (PHEAP_ENTRY)((PUCHAR)SubSegment + HEAP_LFH_SUBSEGMENT_HEADER_SIZE) +
+                SubSegment->NextUnused * Bucket->BlockUnits;
+        SubSegment->NextUnused++;
+    }
+
+    /* Move the subsegment to the full list once it's exhausted */
+    if (--SubSegment->FreeCount == 0)
+    {
+        RemoveEntryList(&SubSegment->ListEntry);
+        InsertTailList(&Bucket->FullList, &SubSegment->ListEntry);
+    }
+
+    return Block;
+}
+
+/* FUNCTIONS *****************************************************************/
+
+NTSTATUS
+NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH Lfh;
+    PHEAP_LFH_BUCKET Bucket;
+    PHEAP_LOCK Lock;
+    SIZE_T BlockSize;
+    ULONG Index, BlockCount;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* The LFH can't be used on special, unlocked, over-aligned or non-growable heaps */
+    if (RtlpHeapIsSpecial(Heap->Flags | Heap->ForceFlags) ||
+        (Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_CREATE_ALIGN_16 |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)) ||
+        !(Heap->Flags & HEAP_GROWABLE))
+    {
+        DPRINT1("HEAP: LFH can't be enabled on heap %p with flags 0x%08lx\n", Heap, Heap->Flags);
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* Serialize against other threads enabling it */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    /* Already enabled, nothing to do */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP)
+        goto Quit;
+
+    /* Some other front end is active, it can't be switched */
+    if (Heap->FrontEndHeapType != HEAP_FRONT_NONE)
+    {
+        Status = STATUS_UNSUCCESSFUL;
+        goto Quit;
+    }
+
+    /* Allocate the LFH descriptor from the back end, we own the heap lock */
+    Lfh = RtlpAllocateHeapBackEnd(Heap,
+                                  HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY,
+                                  sizeof(HEAP_LFH));
+    if (!Lfh)
+    {
+        Status = STATUS_NO_MEMORY;
+        goto Quit;
+    }
+
+    Lfh->Heap = Heap;
+
+    for (Index = 0; Index < HEAP_LFH_BUCKETS; Index++)
+    {
+        Bucket = &Lfh->Buckets[Index];
+
+        /* In kernel mode the lock is allocated separately */
+        Lock = &Bucket->LockStorage;
+        Status = RtlInitializeHeapLock(&Lock);
+        if (!NT_SUCCESS(Status))
+        {
+            /* Undo what we did so far */
+            while (Index--)
+                RtlDeleteHeapLock(Lfh->Buckets[Index].Lock);
+
+            RtlFreeHeap(Heap, HEAP_NO_SERIALIZE, Lfh);
+            goto Quit;
+        }
+        Bucket->Lock = Lock;
+
+        InitializeListHead(&Bucket->AvailableList);
+        InitializeListHead(&Bucket->FullList);
+
+        /* Blocks have a heap entry header in front of the user data */
+        BlockSize = ROUND_UP(RtlpLowFragHeapBucketSize(Index), HEAP_ENTRY_SIZE) + HEAP_ENTRY_SIZE;
+        Bucket->BlockUnits = (ULONG)(BlockSize >> HEAP_ENTRY_SHIFT);
+
+        /* Start with a page worth of blocks, it grows as the bucket gets used */
+        BlockCount = (ULONG)(PAGE_SIZE / BlockSize);
+        Bucket->SubSegmentBlocks = max(BlockCount, HEAP_LFH_MIN_SUBSEGMENT_BLOCKS);
+    }
+
+    /* Publish the front end before announcing its type */
+    InterlockedExchangePointer(&Heap->FrontEndHeap, Lfh);
+    Heap->FrontEndHeapType = HEAP_FRONT_LOWFRAGHEAP;
+
+Quit:
+    RtlLeaveHeapLock(Heap->LockVariable);
+    return Status;
+}
+
+VOID
+NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH Lfh = Heap->FrontEndHeap;
+    ULONG Index;
+
+    /* Subsegments and the descriptor live in the heap, only locks need to go */
+    for (Index = 0; Index < HEAP_LFH_BUCKETS; Index++)
+        RtlDeleteHeapLock(Lfh->Buckets[Index].Lock);
+
+    Heap->FrontEndHeapType = HEAP_FRONT_NONE;
+    Heap->FrontEndHeap = NULL;
+}
+
+PVOID
+NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size)
+{
+    PHEAP_LFH Lfh = Heap->FrontEndHeap;
+    PHEAP_LFH_BUCKET Bucket;
+    PHEAP_LFH_SUBSEGMENT SubSegment, NewSubSegment = NULL;
+    PHEAP_ENTRY Block;
+    SIZE_T MaxBlocks;
+
+    Bucket = &Lfh->Buckets[RtlpLowFragHeapBucketIndex(Size)];
+
+    RtlEnterHeapLock(Bucket->Lock, TRUE);
+
+    while (IsListEmpty(&Bucket->AvailableList))
+    {
+        if (NewSubSegment)
+        {
+            /* Put the new subsegment in use */
+            InsertHeadList(&Bucket->AvailableList, &NewSubSegment->ListEntry);
+            Bucket->SubSegmentsCreated++;
+
+            /* Next time, get a bigger one */
+            MaxBlocks = (HEAP_LFH_MAX_SUBSEGMENT_SIZE - HEAP_LFH_SUBSEGMENT_HEADER_SIZE) /
+                        ((SIZE_T)Bucket->BlockUnits << HEAP_ENTRY_SHIFT);
+            if (Bucket->SubSegmentBlocks * 2 <= MaxBlocks)
+                Bucket->SubSegmentBlocks *= 2;
+
+            NewSubSegment = NULL;
+            break;
+        }
+
+        /* Drop the lock while the back end is called, to respect lock ordering */
+        RtlLeaveHeapLock(Bucket->Lock);
+
+        NewSubSegment = RtlpLowFragHeapCreateSubSegment(Heap, Bucket);
+        if (!NewSubSegment) return NULL;
+
+        RtlEnterHeapLock(Bucket->Lock, TRUE);
+    }
+
+    /* Pick up the most recently used subsegment */
+    SubSegment = CONTAINING_RECORD(Bucket->AvailableList.Flink,
+                                   HEAP_LFH_SUBSEGMENT,
+                                   ListEntry);
+    Block = RtlpLowFragHeapPopBlock(Bucket, SubSegment);
+    Bucket->Allocations++;
+
+    RtlLeaveHeapLock(Bucket->Lock);
+
+    /* Another thread refilled the bucket meanwhile, give our subsegment back */
+    if (NewSubSegment)
+        RtlFreeHeap(Heap, 0, NewSubSegment);
+
+    /* Initialize the block header */
+    Block->Size = (USHORT)Size;
+    Block->Flags = HEAP_ENTRY_BUSY | (UCHAR)((Flags & HEAP_SETTABLE_USER_FLAGS) >> 4);
+    Block->SmallTagIndex = 0;
+    Block->PreviousSize = (USHORT)(Block - (PHEAP_ENTRY)SubSegment);
+    Block->SegmentOffset = HEAP_LFH_SEGMENT_OFFSET;
+    Block->UnusedBytes = 0;
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(Block + 1, Size);
+
+    return Block + 1;
+}
+
+BOOLEAN
+NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment, ReleaseSubSegment = NULL;
+    PHEAP_LFH_BUCKET Bucket;
+
+    if (!RtlpValidateLowFragHeapEntry(Heap, HeapEntry))
+        return FALSE;
+
+    SubSegment = RtlpLowFragHeapGetSubSegment(HeapEntry);
+    Bucket = SubSegment->Bucket;
+
+    RtlEnterHeapLock(Bucket->Lock, TRUE);
+
+    /* Catch double frees */
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY))
+    {
+        RtlLeaveHeapLock(Bucket->Lock);
+        return FALSE;
+    }
+
+    HeapEntry->Flags = 0;
+    PushEntryList(&SubSegment->FreeBlocks, (PSINGLE_LIST_ENTRY)(HeapEntry + 1));
+    Bucket->Frees++;
+
+    if (SubSegment->FreeCount++ == 0)
+    {
+        /* It was full, make it available again */
+        RemoveEntryList(&SubSegment->ListEntry);
+        InsertHeadList(&Bucket->AvailableList, &SubSegment->ListEntry);
+    }
+    else if ((SubSegment->FreeCount == SubSegment->BlockCount) &&
+             (Bucket->AvailableList.Flink != Bucket->AvailableList.Blink))
+    {
+        /* It's empty and not the only one, give it back to the back end */
+        RemoveEntryList(&SubSegment->ListEntry);
+        Bucket->SubSegmentsReleased++;
+        ReleaseSubSegment = SubSegment;
+    }
+
+    RtlLeaveHeapLock(Bucket->Lock);
+
+    if (ReleaseSubSegment)
+    {
+        ReleaseSubSegment->Signature = 0;
+        RtlFreeHeap(Heap, 0, ReleaseSubSegment);
+    }
+
+    return TRUE;
+}
+
+PVOID
+NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size)
+{
+    PHEAP_ENTRY HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    SIZE_T OldSize, Capacity;
+    PVOID NewPtr;
+    EXCEPTION_RECORD ExceptionRecord;
+
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
+        !RtlpValidateLowFragHeapEntry(Heap, HeapEntry))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    SubSegment = RtlpLowFragHeapGetSubSegment(HeapEntry);
+    OldSize = HeapEntry->Size;
+    Capacity = (SIZE_T)(SubSegment->Bucket->BlockUnits - 1) << HEAP_ENTRY_SHIFT;
+
+    /* Resize in place when the block is big enough and no extra stuff is wanted */
+    if ((Size <= Capacity) && !(Flags & HEAP_EXTRA_FLAGS_MASK))
+    {
+        if ((Size > OldSize) && (Flags & HEAP_ZERO_MEMORY))
+            RtlZeroMemory((PCHAR)Ptr + OldSize, Size - OldSize);
+
+        HeapEntry->Size = (USHORT)Size;
+
+        /* Copy user settable flags */
+        HeapEntry->Flags &= ~HEAP_ENTRY_SETTABLE_FLAGS;
+        HeapEntry->Flags |= (UCHAR)((Flags & HEAP_SETTABLE_USER_FLAGS) >> 4);
+
+        return Ptr;
+    }
+
+    if (Flags & HEAP_REALLOC_IN_PLACE_ONLY)
+    {
+        DPRINT1("Realloc in place failed, but it was the only option\n");
+        NewPtr = NULL;
+    }
+    else
+    {
+        /* Move it, possibly to another bucket or to the back end */
+        NewPtr = RtlAllocateHeap(Heap, Flags & ~HEAP_ZERO_MEMORY, Size);
+        if (NewPtr)
+        {
+            RtlMoveMemory(NewPtr, Ptr, min(Size, OldSize));
+
+            /* Zero remaining part if required */
+            if ((Size > OldSize) && (Flags & HEAP_ZERO_MEMORY))
+                RtlZeroMemory((PCHAR)NewPtr + OldSize, Size - OldSize);
+
+            RtlpLowFragHeapFree(Heap, HeapEntry);
+        }
+    }
+
+    /* Generate an exception if required */
+    if (!NewPtr && (Flags & HEAP_GENERATE_EXCEPTIONS))
+    {
+        ExceptionRecord.ExceptionCode = STATUS_NO_MEMORY;
+        ExceptionRecord.ExceptionRecord = NULL;
+        ExceptionRecord.NumberParameters = 1;
+        ExceptionRecord.ExceptionFlags = 0;
+        ExceptionRecord.ExceptionInformation[0] = Size;
+
+        RtlRaiseException(&ExceptionRecord);
+    }
+
+    return NewPtr;
+}
+
+BOOLEAN
+NTAPI
+RtlpValidateLowFragHeapEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    ULONG_PTR Offset;
+
+    SubSegment = RtlpLowFragHeapGetSubSegment(HeapEntry);
+
+    /* The subsegment must be ours */
+    if ((SubSegment->Signature != HEAP_LFH_SUBSEGMENT_SIGNATURE) ||
+        (SubSegment->Lfh != Heap->FrontEndHeap))
+    {
+        DPRINT1("HEAP: Invalid LFH entry %p in heap %p\n", HeapEntry, Heap);
+        return FALSE;
+    }
+
+    /* And the entry must be at a block boundary within it */
+    Offset = (PUCHAR)HeapEntry - ((PUCHAR)SubSegment + HEAP_LFH_SUBSEGMENT_HEADER_SIZE);
+    if ((Offset % ((SIZE_T)SubSegment->Bucket->BlockUnits << HEAP_ENTRY_SHIFT)) ||
+        (Offset >= (SIZE_T)SubSegment->NextUnused * (SubSegment->Bucket->BlockUnits << HEAP_ENTRY_SHIFT)))
+    {
+        DPRINT1("HEAP: Misaligned LFH entry %p in heap %p\n", HeapEntry, Heap);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* EOF */
@@ -110,6 +110,13 @@ KPROCESSOR_MODE
 NTAPI
 RtlpGetMode(VOID);
 
+VOID
+NTAPI
+RtlpRunInParallel(
+    IN PRTLP_PARALLEL_ROUTINE Routine,
+    IN PVOID Context,
+    IN ULONG Count);
+
 BOOLEAN
 NTAPI
 RtlpCaptureStackLimits(
@@ -232,6 +239,27 @@ extern HANDLE TimerThreadHandle;
 NTSTATUS
 RtlpInitializeTimerThread(VOID);
 
+#if (_WIN32_WINNT >= 0x0600)
+/* For threadpool.c, from condvar.c */
+VOID
+NTAPI
+RtlInitializeConditionVariable(OUT PRTL_CONDITION_VARIABLE ConditionVariable);
+
+VOID
+NTAPI
+RtlWakeConditionVariable(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable);
+
+VOID
+NTAPI
+RtlWakeAllConditionVariable(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable);
+
+NTSTATUS
+NTAPI
+RtlSleepConditionVariableCS(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
+                            IN OUT PRTL_CRITICAL_SECTION CriticalSection,
+                            IN const LARGE_INTEGER * TimeOut OPTIONAL);
+#endif /* _WIN32_WINNT >= 0x0600 */
+
 #endif /* !_BLDR_ */
 
 /* bitmap64.c */
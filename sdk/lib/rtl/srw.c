@@ -46,6 +46,9 @@
                              RTL_SRWLOCK_SHARED | RTL_SRWLOCK_CONTENTION_LOCK)
 #define RTL_SRWLOCK_BITS    4
 
+/* Number of spins before a waiter parks on its wait block */
+#define RTL_SRWLOCK_SPIN_COUNT  256
+
 typedef struct _RTLP_SRWLOCK_SHARED_WAKE
 {
     LONG Wake;
@@ -129,6 +132,7 @@ RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
     {
         (void)InterlockedOr(&FirstWaitBlock->Wake,
                             TRUE);
+        RtlWakeAddressSingle((PVOID)&FirstWaitBlock->Wake);
     }
     else
     {
@@ -143,6 +147,7 @@ RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
 
             (void)InterlockedOr((PLONG)&WakeChain->Wake,
                                 TRUE);
+            RtlWakeAddressSingle((PVOID)&WakeChain->Wake);
 
             WakeChain = NextWake;
         } while (WakeChain != NULL);
@@ -182,6 +187,7 @@ RtlpReleaseWaitBlockLockLastShared(IN OUT PRTL_SRWLOCK SRWLock,
 
     (void)InterlockedOr(&FirstWaitBlock->Wake,
                         TRUE);
+    RtlWakeAddressSingle((PVOID)&FirstWaitBlock->Wake);
 }
 
 
@@ -227,12 +233,33 @@ RtlpAcquireWaitBlockLock(IN OUT PRTL_SRWLOCK SRWLock)
 }
 
 
+static VOID
+NTAPI
+RtlpWaitForSRWLockWake(IN volatile LONG *Wake,
+                       IN OUT PULONG SpinCount)
+{
+    LONG NotWoken = FALSE;
+
+    if (*SpinCount < RTL_SRWLOCK_SPIN_COUNT)
+    {
+        (*SpinCount)++;
+        YieldProcessor();
+        return;
+    }
+
+    /* Spinning didn't help, park until the releasing thread sets the
+       wake flag. The caller rechecks the lock state either way. */
+    RtlWaitOnAddress(Wake, &NotWoken, sizeof(NotWoken), NULL);
+}
+
+
 static VOID
 NTAPI
 RtlpAcquireSRWLockExclusiveWait(IN OUT PRTL_SRWLOCK SRWLock,
                                 IN PRTLP_SRWLOCK_WAITBLOCK WaitBlock)
 {
     LONG_PTR CurrentValue;
+    ULONG SpinCount = 0;
 
     while (1)
     {
@@ -257,7 +284,7 @@ RtlpAcquireSRWLockExclusiveWait(IN OUT PRTL_SRWLOCK SRWLock,
             }
         }
 
-        YieldProcessor();
+        RtlpWaitForSRWLockWake(&WaitBlock->Wake, &SpinCount);
     }
 }
 
@@ -268,11 +295,13 @@ RtlpAcquireSRWLockSharedWait(IN OUT PRTL_SRWLOCK SRWLock,
                              IN OUT PRTLP_SRWLOCK_WAITBLOCK FirstWait  OPTIONAL,
                              IN OUT PRTLP_SRWLOCK_SHARED_WAKE WakeChain)
 {
+    ULONG SpinCount = 0;
+
     if (FirstWait != NULL)
     {
         while (WakeChain->Wake == 0)
         {
-            YieldProcessor();
+            RtlpWaitForSRWLockWake(&WakeChain->Wake, &SpinCount);
         }
     }
     else
@@ -306,7 +335,7 @@ RtlpAcquireSRWLockSharedWait(IN OUT PRTL_SRWLOCK SRWLock,
                 }
             }
 
-            YieldProcessor();
+            RtlpWaitForSRWLockWake(&WakeChain->Wake, &SpinCount);
         }
     }
 }
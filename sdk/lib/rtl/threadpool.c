@@ -0,0 +1,1928 @@
+/*
+ * PROJECT:     ReactOS System Libraries
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Vista thread pool (Tp* routines)
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* From workitem.c */
+extern PRTL_START_POOL_THREAD RtlpStartThreadFunc;
+extern PRTL_EXIT_POOL_THREAD RtlpExitThreadFunc;
+
+/* INTERNAL TYPES ************************************************************/
+
+#define TPP_DEFAULT_MAX_WORKERS     500
+/* Workers the pool starts for a backlog on top of one per processor */
+#define TPP_EXTRA_WORKERS           2
+#define TPP_WAITS_PER_THREAD        (MAXIMUM_WAIT_OBJECTS - 1)
+#define TPP_MS_TO_100NS(x)          ((LONGLONG)(x) * 10000)
+
+/* Idle workers above the pool minimum and idle wait threads go away after this */
+#define TPP_IDLE_TIMEOUT            TPP_MS_TO_100NS(-5000)
+
+/* How long the I/O thread backs off when it can't queue a completion */
+#define TPP_IO_RETRY_DELAY          TPP_MS_TO_100NS(-10)
+
+typedef enum _TPP_OBJECT_TYPE
+{
+    TppSimpleObject,
+    TppWorkObject,
+    TppTimerObject,
+    TppWaitObject,
+    TppIoObject
+} TPP_OBJECT_TYPE;
+
+/* The Vista headers only know the V1 environment, Windows 7 appends these */
+typedef struct _TPP_CALLBACK_ENVIRON_V3
+{
+    TP_CALLBACK_ENVIRON V1;
+    TP_CALLBACK_PRIORITY CallbackPriority;
+    DWORD Size;
+} TPP_CALLBACK_ENVIRON_V3, *PTPP_CALLBACK_ENVIRON_V3;
+
+struct _TP_POOL
+{
+    LONG ReferenceCount;
+    BOOLEAN Shutdown;
+    RTL_CRITICAL_SECTION Lock;
+    /* Protected by the lock */
+    LIST_ENTRY Queues[TP_CALLBACK_PRIORITY_COUNT];
+    RTL_CONDITION_VARIABLE WorkAvailable;
+    RTL_CONDITION_VARIABLE CallbackDone;
+    ULONG QueuedCallbacks;
+    ULONG Workers;
+    ULONG BusyWorkers;
+    ULONG MinWorkers;
+    ULONG MaxWorkers;
+};
+
+struct _TP_CLEANUP_GROUP
+{
+    LONG ReferenceCount;
+    RTL_CRITICAL_SECTION Lock;
+    LIST_ENTRY Members;
+};
+
+typedef struct _TPP_IO_COMPLETION
+{
+    PVOID ApcContext;
+    IO_STATUS_BLOCK IoStatus;
+} TPP_IO_COMPLETION, *PTPP_IO_COMPLETION;
+
+typedef struct _TPP_WAIT_THREAD
+{
+    LIST_ENTRY ListEntry;
+    LIST_ENTRY Waits;
+    ULONG NumberOfWaits;
+    HANDLE UpdateEvent;
+} TPP_WAIT_THREAD, *PTPP_WAIT_THREAD;
+
+typedef struct _TPP_OBJECT
+{
+    LONG ReferenceCount;
+    LONG Shutdown;
+    TPP_OBJECT_TYPE Type;
+    PTP_POOL Pool;
+    PVOID Context;
+    TP_CALLBACK_PRIORITY Priority;
+    BOOLEAN LongFunction;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+
+    /* Protected by the cleanup group lock */
+    PTP_CLEANUP_GROUP CleanupGroup;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK GroupCancelCallback;
+    LIST_ENTRY GroupEntry;
+    BOOLEAN GroupMember;
+
+    /* Protected by the pool lock */
+    LIST_ENTRY PoolEntry;
+    ULONG PendingCallbacks;
+    ULONG RunningCallbacks;
+    ULONG AssociatedCallbacks;
+
+    union
+    {
+        struct
+        {
+            PTP_SIMPLE_CALLBACK Callback;
+        } Simple;
+        struct
+        {
+            PTP_WORK_CALLBACK Callback;
+        } Work;
+        struct
+        {
+            PTP_TIMER_CALLBACK Callback;
+            /* Protected by the timer lock */
+            LIST_ENTRY TimerEntry;
+            LONGLONG DueTime;
+            LONG Period;
+            LONG WindowLength;
+            BOOLEAN Armed;
+            BOOLEAN Set;
+        } Timer;
+        struct
+        {
+            PTP_WAIT_CALLBACK Callback;
+            /* Protected by the wait lock */
+            PTPP_WAIT_THREAD Thread;
+            LIST_ENTRY WaitEntry;
+            HANDLE Handle;
+            LONGLONG Timeout;
+            ULONG Generation;
+            /* Protected by the pool lock */
+            ULONG SignaledCallbacks;
+        } Wait;
+        struct
+        {
+            PTP_IO_CALLBACK Callback;
+            /* Protected by the pool lock */
+            ULONG PendingIo;
+            BOOLEAN Released;
+            BOOLEAN PortReferenced;
+            /* Ring of CompletionSize entries, the oldest at CompletionHead */
+            PTPP_IO_COMPLETION Completions;
+            ULONG CompletionHead;
+            ULONG CompletionCount;
+            ULONG CompletionSize;
+        } Io;
+    } u;
+} TPP_OBJECT, *PTPP_OBJECT;
+
+struct _TP_CALLBACK_INSTANCE
+{
+    PTPP_OBJECT Object;
+    BOOLEAN Associated;
+    BOOLEAN MayRunLong;
+
+    /* Actions run once the callback returns */
+    PRTL_CRITICAL_SECTION CriticalSection;
+    HANDLE Mutex;
+    HANDLE Semaphore;
+    ULONG SemaphoreReleaseCount;
+    HANDLE Event;
+    PVOID Dll;
+};
+
+/* GLOBALS *******************************************************************/
+
+static RTL_RUN_ONCE TppInitOnce = RTL_RUN_ONCE_INIT;
+static TP_POOL TppDefaultPool;
+
+/* Timers, sorted by due time */
+static RTL_CRITICAL_SECTION TppTimerLock;
+static RTL_CONDITION_VARIABLE TppTimerUpdate;
+static LIST_ENTRY TppTimerList;
+static BOOLEAN TppTimerThreadStarted;
+
+/* Threads waiting on behalf of wait objects */
+static RTL_CRITICAL_SECTION TppWaitLock;
+static LIST_ENTRY TppWaitThreadList;
+static ULONG TppWaitGeneration;
+
+/* Completion port shared by all I/O objects */
+static RTL_CRITICAL_SECTION TppIoLock;
+static HANDLE TppIoPort;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+VOID
+TppInitializePool(
+    _Out_ PTP_POOL Pool)
+{
+    ULONG i;
+
+    Pool->ReferenceCount = 1;
+    Pool->Shutdown = FALSE;
+    RtlInitializeCriticalSection(&Pool->Lock);
+    for (i = 0; i < TP_CALLBACK_PRIORITY_COUNT; i++)
+        InitializeListHead(&Pool->Queues[i]);
+    RtlInitializeConditionVariable(&Pool->WorkAvailable);
+    RtlInitializeConditionVariable(&Pool->CallbackDone);
+    Pool->QueuedCallbacks = 0;
+    Pool->Workers = 0;
+    Pool->BusyWorkers = 0;
+    Pool->MinWorkers = 0;
+    Pool->MaxWorkers = TPP_DEFAULT_MAX_WORKERS;
+}
+
+static
+ULONG
+NTAPI
+TppInitialize(
+    _Inout_ PRTL_RUN_ONCE RunOnce,
+    _Inout_opt_ PVOID Parameter,
+    _Inout_opt_ PVOID *Context)
+{
+    /* The default pool is never released */
+    TppInitializePool(&TppDefaultPool);
+
+    RtlInitializeCriticalSection(&TppTimerLock);
+    RtlInitializeConditionVariable(&TppTimerUpdate);
+    InitializeListHead(&TppTimerList);
+
+    RtlInitializeCriticalSection(&TppWaitLock);
+    InitializeListHead(&TppWaitThreadList);
+
+    RtlInitializeCriticalSection(&TppIoLock);
+
+    return TRUE;
+}
+
+static
+NTSTATUS
+TppStartThread(
+    _In_ PTHREAD_START_ROUTINE StartRoutine,
+    _In_ PVOID Parameter)
+{
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+
+    /* Pool threads are created suspended */
+    Status = RtlpStartThreadFunc(StartRoutine, Parameter, &ThreadHandle);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to start a thread pool thread: 0x%lx\n", Status);
+        return Status;
+    }
+
+    NtResumeThread(ThreadHandle, NULL);
+    NtClose(ThreadHandle);
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+TppReleasePool(
+    _Inout_ PTP_POOL Pool)
+{
+    if (InterlockedDecrement(&Pool->ReferenceCount)) return;
+
+    ASSERT(Pool != &TppDefaultPool);
+    ASSERT(Pool->Workers == 0);
+
+    RtlDeleteCriticalSection(&Pool->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+}
+
+static
+VOID
+TppReleaseCleanupGroup(
+    _Inout_ PTP_CLEANUP_GROUP CleanupGroup)
+{
+    if (InterlockedDecrement(&CleanupGroup->ReferenceCount)) return;
+
+    ASSERT(IsListEmpty(&CleanupGroup->Members));
+
+    RtlDeleteCriticalSection(&CleanupGroup->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+}
+
+static
+VOID
+TppReleaseObject(
+    _Inout_ PTPP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->ReferenceCount)) return;
+
+    ASSERT(!Object->GroupMember);
+    ASSERT(Object->PendingCallbacks == 0);
+
+    if (Object->Type == TppIoObject && Object->u.Io.Completions)
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Object->u.Io.Completions);
+
+    if (Object->CleanupGroup)
+        TppReleaseCleanupGroup(Object->CleanupGroup);
+
+    TppReleasePool(Object->Pool);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+}
+
+static
+ULONG
+NTAPI
+TppWorkerThread(
+    _In_ PVOID Parameter);
+
+/* The pool lock must be held */
+static
+NTSTATUS
+TppStartWorker(
+    _Inout_ PTP_POOL Pool)
+{
+    NTSTATUS Status;
+
+    /* The worker owns a pool reference until it exits */
+    InterlockedIncrement(&Pool->ReferenceCount);
+    Pool->Workers++;
+
+    Status = TppStartThread(TppWorkerThread, Pool);
+    if (!NT_SUCCESS(Status))
+    {
+        Pool->Workers--;
+        InterlockedDecrement(&Pool->ReferenceCount);
+    }
+
+    return Status;
+}
+
+/* The pool lock must be held */
+static
+ULONG
+TppWorkerLimit(
+    _In_ PTP_POOL Pool)
+{
+    ULONG Limit;
+
+    /* More workers than processors only add contention, so past this the
+       existing ones drain the queue. Long callbacks still get their own. */
+    Limit = NtCurrentPeb()->NumberOfProcessors + TPP_EXTRA_WORKERS;
+    Limit = max(Limit, Pool->MinWorkers);
+    return min(Limit, Pool->MaxWorkers);
+}
+
+/* The pool lock must be held */
+static
+NTSTATUS
+TppSubmitLocked(
+    _Inout_ PTPP_OBJECT Object,
+    _In_ BOOLEAN Signaled)
+{
+    PTP_POOL Pool = Object->Pool;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* Every pending callback holds a reference */
+    InterlockedIncrement(&Object->ReferenceCount);
+
+    if (Object->PendingCallbacks++ == 0)
+        InsertTailList(&Pool->Queues[Object->Priority], &Object->PoolEntry);
+    if (Object->Type == TppWaitObject && Signaled)
+        Object->u.Wait.SignaledCallbacks++;
+    Pool->QueuedCallbacks++;
+
+    /* Grow the pool when every worker already has something to do */
+    if (Pool->Workers - Pool->BusyWorkers < Pool->QueuedCallbacks &&
+        Pool->Workers < TppWorkerLimit(Pool))
+    {
+        Status = TppStartWorker(Pool);
+        if (!NT_SUCCESS(Status) && Pool->Workers != 0)
+        {
+            /* An existing worker will get to it eventually */
+            Status = STATUS_SUCCESS;
+        }
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        /* Nobody would ever run it, take it back */
+        if (--Object->PendingCallbacks == 0)
+            RemoveEntryList(&Object->PoolEntry);
+        if (Object->Type == TppWaitObject && Signaled)
+            Object->u.Wait.SignaledCallbacks--;
+        Pool->QueuedCallbacks--;
+
+        /* The caller still has a reference, so this one can't be the last */
+        InterlockedDecrement(&Object->ReferenceCount);
+        return Status;
+    }
+
+    RtlWakeConditionVariable(&Pool->WorkAvailable);
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+TppSubmit(
+    _Inout_ PTPP_OBJECT Object,
+    _In_ BOOLEAN Signaled)
+{
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&Object->Pool->Lock);
+    Status = TppSubmitLocked(Object, Signaled);
+    RtlLeaveCriticalSection(&Object->Pool->Lock);
+
+    return Status;
+}
+
+static
+VOID
+TppCancel(
+    _Inout_ PTPP_OBJECT Object)
+{
+    PTP_POOL Pool = Object->Pool;
+    ULONG Canceled;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    Canceled = Object->PendingCallbacks;
+    if (Canceled)
+    {
+        RemoveEntryList(&Object->PoolEntry);
+        Pool->QueuedCallbacks -= Canceled;
+        Object->PendingCallbacks = 0;
+    }
+
+    if (Object->Type == TppWaitObject)
+        Object->u.Wait.SignaledCallbacks = 0;
+    else if (Object->Type == TppIoObject)
+        Object->u.Io.CompletionHead = Object->u.Io.CompletionCount = 0;
+
+    RtlWakeAllConditionVariable(&Pool->CallbackDone);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    /* Drop the references the canceled callbacks were holding */
+    while (Canceled--)
+        TppReleaseObject(Object);
+}
+
+/* The pool lock must be held */
+static
+BOOLEAN
+TppIsObjectFinished(
+    _In_ PTPP_OBJECT Object,
+    _In_ BOOLEAN GroupWait)
+{
+    if (Object->PendingCallbacks) return FALSE;
+    if (Object->Type == TppIoObject && Object->u.Io.PendingIo) return FALSE;
+
+    /* Cleanup groups also wait for disassociated callbacks */
+    if (GroupWait) return (Object->RunningCallbacks == 0);
+    return (Object->AssociatedCallbacks == 0);
+}
+
+static
+VOID
+TppWaitForObject(
+    _Inout_ PTPP_OBJECT Object,
+    _In_ BOOLEAN GroupWait)
+{
+    PTP_POOL Pool = Object->Pool;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    while (!TppIsObjectFinished(Object, GroupWait))
+    {
+        RtlSleepConditionVariableCS(&Pool->CallbackDone, &Pool->Lock, NULL);
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+static
+VOID
+TppDisarmTimer(
+    _Inout_ PTPP_OBJECT Timer)
+{
+    RtlEnterCriticalSection(&TppTimerLock);
+    if (Timer->u.Timer.Armed)
+    {
+        RemoveEntryList(&Timer->u.Timer.TimerEntry);
+        Timer->u.Timer.Armed = FALSE;
+    }
+    RtlLeaveCriticalSection(&TppTimerLock);
+}
+
+/* The wait lock must be held */
+static
+VOID
+TppDisarmWaitLocked(
+    _Inout_ PTPP_OBJECT Wait)
+{
+    PTPP_WAIT_THREAD Thread = Wait->u.Wait.Thread;
+
+    if (!Thread) return;
+
+    RemoveEntryList(&Wait->u.Wait.WaitEntry);
+    Thread->NumberOfWaits--;
+    Wait->u.Wait.Thread = NULL;
+
+    /* Have the thread rebuild its handle array */
+    NtSetEvent(Thread->UpdateEvent, NULL);
+}
+
+static
+VOID
+TppReleaseIoPort(
+    _Inout_ PTPP_OBJECT Io)
+{
+    BOOLEAN Release = FALSE;
+
+    /* The completion port reference goes away once no I/O can complete anymore */
+    RtlEnterCriticalSection(&Io->Pool->Lock);
+    if (Io->u.Io.Released && Io->u.Io.PendingIo == 0 && Io->u.Io.PortReferenced)
+    {
+        Io->u.Io.PortReferenced = FALSE;
+        Release = TRUE;
+    }
+    RtlLeaveCriticalSection(&Io->Pool->Lock);
+
+    if (Release) TppReleaseObject(Io);
+}
+
+/* Makes sure nothing new gets queued for an object which is going away */
+static
+VOID
+TppDisarmObject(
+    _Inout_ PTPP_OBJECT Object)
+{
+    switch (Object->Type)
+    {
+        case TppTimerObject:
+            TppDisarmTimer(Object);
+            break;
+
+        case TppWaitObject:
+            RtlEnterCriticalSection(&TppWaitLock);
+            TppDisarmWaitLocked(Object);
+            RtlLeaveCriticalSection(&TppWaitLock);
+            break;
+
+        case TppIoObject:
+            RtlEnterCriticalSection(&Object->Pool->Lock);
+            Object->u.Io.Released = TRUE;
+            RtlLeaveCriticalSection(&Object->Pool->Lock);
+            TppReleaseIoPort(Object);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Drops the owner reference of an object, either for the caller or for a cleanup group */
+static
+VOID
+TppShutdownObject(
+    _Inout_ PTPP_OBJECT Object)
+{
+    PTP_CLEANUP_GROUP CleanupGroup = Object->CleanupGroup;
+
+    if (CleanupGroup)
+    {
+        RtlEnterCriticalSection(&CleanupGroup->Lock);
+        if (Object->GroupMember)
+        {
+            RemoveEntryList(&Object->GroupEntry);
+            Object->GroupMember = FALSE;
+        }
+        RtlLeaveCriticalSection(&CleanupGroup->Lock);
+    }
+
+    TppDisarmObject(Object);
+
+    /* The object can be released by its owner and by its cleanup group at the same time */
+    if (!InterlockedExchange(&Object->Shutdown, TRUE))
+        TppReleaseObject(Object);
+}
+
+static
+NTSTATUS
+TppAllocateObject(
+    _In_ TPP_OBJECT_TYPE Type,
+    _In_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON Environment,
+    _Out_ PTPP_OBJECT *ObjectReturn)
+{
+    TP_CALLBACK_PRIORITY Priority = TP_CALLBACK_PRIORITY_NORMAL;
+    PTP_POOL Pool = NULL;
+    PTP_CLEANUP_GROUP CleanupGroup = NULL;
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    if (Environment)
+    {
+        if (Environment->Version == 3)
+        {
+            Priority = ((PTPP_CALLBACK_ENVIRON_V3)Environment)->CallbackPriority;
+            if ((ULONG)Priority >= TP_CALLBACK_PRIORITY_COUNT)
+                return STATUS_INVALID_PARAMETER;
+        }
+        else if (Environment->Version != 1)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        Pool = Environment->Pool;
+        CleanupGroup = Environment->CleanupGroup;
+    }
+
+    Status = RtlRunOnceExecuteOnce(&TppInitOnce, TppInitialize, NULL, NULL);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Object = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Object));
+    if (!Object) return STATUS_NO_MEMORY;
+
+    /* One reference for the owner, which is either the caller or a cleanup group */
+    Object->ReferenceCount = 1;
+    Object->Type = Type;
+    Object->Context = Context;
+    Object->Priority = Priority;
+
+    Object->Pool = Pool ? Pool : &TppDefaultPool;
+    InterlockedIncrement(&Object->Pool->ReferenceCount);
+
+    if (Environment)
+    {
+        Object->LongFunction = (Environment->u.s.LongFunction != 0);
+        Object->FinalizationCallback = Environment->FinalizationCallback;
+        Object->GroupCancelCallback = Environment->CleanupGroupCancelCallback;
+    }
+
+    if (CleanupGroup)
+    {
+        InterlockedIncrement(&CleanupGroup->ReferenceCount);
+        Object->CleanupGroup = CleanupGroup;
+
+        RtlEnterCriticalSection(&CleanupGroup->Lock);
+        InsertTailList(&CleanupGroup->Members, &Object->GroupEntry);
+        Object->GroupMember = TRUE;
+        RtlLeaveCriticalSection(&CleanupGroup->Lock);
+    }
+
+    *ObjectReturn = Object;
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+TppCompleteInstance(
+    _In_ PTP_CALLBACK_INSTANCE Instance)
+{
+    /* Same order as Windows */
+    if (Instance->CriticalSection)
+        RtlLeaveCriticalSection(Instance->CriticalSection);
+    if (Instance->Mutex)
+        NtReleaseMutant(Instance->Mutex, NULL);
+    if (Instance->Semaphore)
+        NtReleaseSemaphore(Instance->Semaphore, Instance->SemaphoreReleaseCount, NULL);
+    if (Instance->Event)
+        NtSetEvent(Instance->Event, NULL);
+    if (Instance->Dll)
+        LdrUnloadDll(Instance->Dll);
+}
+
+/* Called and returns with the pool lock held */
+static
+VOID
+TppExecuteCallback(
+    _Inout_ PTP_POOL Pool)
+{
+    TP_CALLBACK_INSTANCE Instance;
+    TPP_IO_COMPLETION Completion;
+    TP_WAIT_RESULT WaitResult = WAIT_OBJECT_0;
+    PTPP_OBJECT Object = NULL;
+    PLIST_ENTRY Queue;
+    ULONG Priority;
+
+    /* Higher priority queues are always drained first */
+    for (Priority = 0; Priority < TP_CALLBACK_PRIORITY_COUNT; Priority++)
+    {
+        Queue = &Pool->Queues[Priority];
+        if (!IsListEmpty(Queue))
+        {
+            Object = CONTAINING_RECORD(Queue->Flink, TPP_OBJECT, PoolEntry);
+            break;
+        }
+    }
+
+    if (!Object) return;
+
+    /* Objects with more callbacks pending go to the back of their queue */
+    RemoveEntryList(&Object->PoolEntry);
+    if (--Object->PendingCallbacks)
+        InsertTailList(Queue, &Object->PoolEntry);
+    Pool->QueuedCallbacks--;
+
+    if (Object->Type == TppWaitObject)
+    {
+        if (Object->u.Wait.SignaledCallbacks)
+        {
+            Object->u.Wait.SignaledCallbacks--;
+            WaitResult = WAIT_OBJECT_0;
+        }
+        else
+        {
+            WaitResult = WAIT_TIMEOUT;
+        }
+    }
+    else if (Object->Type == TppIoObject)
+    {
+        ASSERT(Object->u.Io.CompletionCount != 0);
+
+        Completion = Object->u.Io.Completions[Object->u.Io.CompletionHead];
+        Object->u.Io.CompletionHead = (Object->u.Io.CompletionHead + 1) % Object->u.Io.CompletionSize;
+        Object->u.Io.CompletionCount--;
+    }
+
+    Object->RunningCallbacks++;
+    Object->AssociatedCallbacks++;
+    Pool->BusyWorkers++;
+
+    /* Don't let a long callback hold up the rest of the backlog */
+    if (Object->LongFunction &&
+        Pool->QueuedCallbacks &&
+        Pool->BusyWorkers >= Pool->Workers &&
+        Pool->Workers < Pool->MaxWorkers)
+    {
+        TppStartWorker(Pool);
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    RtlZeroMemory(&Instance, sizeof(Instance));
+    Instance.Object = Object;
+    Instance.Associated = TRUE;
+    Instance.MayRunLong = Object->LongFunction;
+
+    switch (Object->Type)
+    {
+        case TppSimpleObject:
+            Object->u.Simple.Callback(&Instance, Object->Context);
+            break;
+
+        case TppWorkObject:
+            Object->u.Work.Callback(&Instance, Object->Context, (PTP_WORK)Object);
+            break;
+
+        case TppTimerObject:
+            Object->u.Timer.Callback(&Instance, Object->Context, (PTP_TIMER)Object);
+            break;
+
+        case TppWaitObject:
+            Object->u.Wait.Callback(&Instance, Object->Context, (PTP_WAIT)Object, WaitResult);
+            break;
+
+        case TppIoObject:
+            Object->u.Io.Callback(&Instance,
+                                  Object->Context,
+                                  Completion.ApcContext,
+                                  &Completion.IoStatus,
+                                  (PTP_IO)Object);
+            break;
+    }
+
+    if (Object->FinalizationCallback)
+        Object->FinalizationCallback(&Instance, Object->Context);
+
+    TppCompleteInstance(&Instance);
+
+    /* Simple callbacks release themselves after running once */
+    if (Object->Type == TppSimpleObject)
+        TppShutdownObject(Object);
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->BusyWorkers--;
+    Object->RunningCallbacks--;
+    if (Instance.Associated)
+        Object->AssociatedCallbacks--;
+    RtlWakeAllConditionVariable(&Pool->CallbackDone);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    /* Drop the reference of the callback, which can be the last one */
+    TppReleaseObject(Object);
+
+    RtlEnterCriticalSection(&Pool->Lock);
+}
+
+static
+ULONG
+NTAPI
+TppWorkerThread(
+    _In_ PVOID Parameter)
+{
+    PTP_POOL Pool = Parameter;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+
+    Timeout.QuadPart = TPP_IDLE_TIMEOUT;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    for (;;)
+    {
+        if (Pool->QueuedCallbacks)
+        {
+            TppExecuteCallback(Pool);
+            continue;
+        }
+
+        /* Workers of a released pool leave once the queues are drained */
+        if (Pool->Shutdown) break;
+
+        Status = RtlSleepConditionVariableCS(&Pool->WorkAvailable,
+                                             &Pool->Lock,
+                                             (Pool->Workers > Pool->MinWorkers) ? &Timeout : NULL);
+
+        if (Status == STATUS_TIMEOUT &&
+            !Pool->QueuedCallbacks &&
+            Pool->Workers > Pool->MinWorkers)
+        {
+            break;
+        }
+    }
+
+    Pool->Workers--;
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    TppReleasePool(Pool);
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+/* The timer lock must be held */
+static
+VOID
+TppInsertTimerLocked(
+    _Inout_ PTPP_OBJECT Timer)
+{
+    PLIST_ENTRY ListEntry;
+    PTPP_OBJECT Other;
+
+    /* Keep the list sorted by due time, ties fire in the order they were set */
+    for (ListEntry = TppTimerList.Flink; ListEntry != &TppTimerList; ListEntry = ListEntry->Flink)
+    {
+        Other = CONTAINING_RECORD(ListEntry, TPP_OBJECT, u.Timer.TimerEntry);
+        if (Other->u.Timer.DueTime > Timer->u.Timer.DueTime) break;
+    }
+
+    InsertTailList(ListEntry, &Timer->u.Timer.TimerEntry);
+    Timer->u.Timer.Armed = TRUE;
+}
+
+static
+ULONG
+NTAPI
+TppTimerThread(
+    _In_ PVOID Parameter)
+{
+    LIST_ENTRY Periodic;
+    PLIST_ENTRY ListEntry;
+    PTPP_OBJECT Timer;
+    LARGE_INTEGER Now, WakeTime;
+    LONGLONG Deadline;
+
+    InitializeListHead(&Periodic);
+
+    RtlEnterCriticalSection(&TppTimerLock);
+    for (;;)
+    {
+        NtQuerySystemTime(&Now);
+
+        /* Fire everything which is due */
+        while (!IsListEmpty(&TppTimerList))
+        {
+            Timer = CONTAINING_RECORD(TppTimerList.Flink, TPP_OBJECT, u.Timer.TimerEntry);
+            if (Timer->u.Timer.DueTime > Now.QuadPart) break;
+
+            RemoveEntryList(&Timer->u.Timer.TimerEntry);
+            Timer->u.Timer.Armed = FALSE;
+
+            TppSubmit(Timer, FALSE);
+
+            if (Timer->u.Timer.Period)
+            {
+                /* Don't try to catch up on missed periods */
+                Timer->u.Timer.DueTime += TPP_MS_TO_100NS(Timer->u.Timer.Period);
+                if (Timer->u.Timer.DueTime <= Now.QuadPart)
+                    Timer->u.Timer.DueTime = Now.QuadPart + TPP_MS_TO_100NS(Timer->u.Timer.Period);
+
+                InsertTailList(&Periodic, &Timer->u.Timer.TimerEntry);
+            }
+        }
+
+        while (!IsListEmpty(&Periodic))
+        {
+            ListEntry = RemoveHeadList(&Periodic);
+            TppInsertTimerLocked(CONTAINING_RECORD(ListEntry, TPP_OBJECT, u.Timer.TimerEntry));
+        }
+
+        /*
+         * Sleep until the earliest deadline, which is the due time plus the window length.
+         * Since the list is sorted by due time, nothing after a timer due later than the
+         * current deadline can move it forward. Timers whose window overlaps get batched.
+         */
+        Deadline = MAXLONGLONG;
+        for (ListEntry = TppTimerList.Flink; ListEntry != &TppTimerList; ListEntry = ListEntry->Flink)
+        {
+            Timer = CONTAINING_RECORD(ListEntry, TPP_OBJECT, u.Timer.TimerEntry);
+            if (Timer->u.Timer.DueTime >= Deadline) break;
+
+            Deadline = min(Deadline, Timer->u.Timer.DueTime + TPP_MS_TO_100NS(Timer->u.Timer.WindowLength));
+        }
+
+        /* A positive time out is absolute */
+        WakeTime.QuadPart = Deadline;
+        RtlSleepConditionVariableCS(&TppTimerUpdate,
+                                    &TppTimerLock,
+                                    (Deadline != MAXLONGLONG) ? &WakeTime : NULL);
+    }
+
+    return 0;
+}
+
+/* The wait lock must be held */
+static
+BOOLEAN
+TppIsWaitArmedLocked(
+    _In_ PTPP_WAIT_THREAD Thread,
+    _In_ PTPP_OBJECT Wait,
+    _In_ ULONG Generation)
+{
+    PLIST_ENTRY ListEntry;
+
+    /* The wait may have been freed since the handle array was built, so don't touch it */
+    for (ListEntry = Thread->Waits.Flink; ListEntry != &Thread->Waits; ListEntry = ListEntry->Flink)
+    {
+        if (CONTAINING_RECORD(ListEntry, TPP_OBJECT, u.Wait.WaitEntry) == Wait)
+            return (Wait->u.Wait.Generation == Generation);
+    }
+
+    return FALSE;
+}
+
+static
+ULONG
+NTAPI
+TppWaitThread(
+    _In_ PVOID Parameter)
+{
+    PTPP_WAIT_THREAD Thread = Parameter;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    PTPP_OBJECT Waits[MAXIMUM_WAIT_OBJECTS];
+    ULONG Generations[MAXIMUM_WAIT_OBJECTS];
+    PLIST_ENTRY ListEntry, NextEntry;
+    LARGE_INTEGER Now, Timeout, ZeroTimeout;
+    PTPP_OBJECT Wait;
+    LONGLONG Deadline;
+    BOOLEAN Signaled;
+    NTSTATUS Status;
+    ULONG Count, Index;
+
+    ZeroTimeout.QuadPart = 0;
+    Handles[0] = Thread->UpdateEvent;
+
+    RtlEnterCriticalSection(&TppWaitLock);
+    for (;;)
+    {
+        NtQuerySystemTime(&Now);
+
+        /* Fire the waits which timed out, and build the handle array for the others */
+        Count = 1;
+        Deadline = MAXLONGLONG;
+        for (ListEntry = Thread->Waits.Flink; ListEntry != &Thread->Waits; ListEntry = NextEntry)
+        {
+            NextEntry = ListEntry->Flink;
+            Wait = CONTAINING_RECORD(ListEntry, TPP_OBJECT, u.Wait.WaitEntry);
+
+            if (Wait->u.Wait.Timeout <= Now.QuadPart)
+            {
+                /* Still report objects which got signaled in the mean time */
+                Signaled = (NtWaitForSingleObject(Wait->u.Wait.Handle, FALSE, &ZeroTimeout) == STATUS_WAIT_0);
+
+                TppDisarmWaitLocked(Wait);
+                TppSubmit(Wait, Signaled);
+                continue;
+            }
+
+            Handles[Count] = Wait->u.Wait.Handle;
+            Waits[Count] = Wait;
+            Generations[Count] = Wait->u.Wait.Generation;
+            Deadline = min(Deadline, Wait->u.Wait.Timeout);
+            Count++;
+        }
+
+        if (Count == 1)
+        {
+            Timeout.QuadPart = TPP_IDLE_TIMEOUT;
+        }
+        else
+        {
+            Timeout.QuadPart = Deadline;
+        }
+
+        RtlLeaveCriticalSection(&TppWaitLock);
+
+        Status = NtWaitForMultipleObjects(Count,
+                                          Handles,
+                                          WaitAny,
+                                          FALSE,
+                                          (Deadline != MAXLONGLONG || Count == 1) ? &Timeout : NULL);
+
+        RtlEnterCriticalSection(&TppWaitLock);
+
+        if (Status >= STATUS_WAIT_1 && Status < STATUS_WAIT_0 + Count)
+        {
+            Index = Status - STATUS_WAIT_0;
+        }
+        else if (Status >= STATUS_ABANDONED_WAIT_0 + 1 && Status < STATUS_ABANDONED_WAIT_0 + Count)
+        {
+            Index = Status - STATUS_ABANDONED_WAIT_0;
+        }
+        else if (Status == STATUS_TIMEOUT && Count == 1 && Thread->NumberOfWaits == 0)
+        {
+            /* Idle for a while, go away */
+            break;
+        }
+        else
+        {
+            if (!NT_SUCCESS(Status))
+            {
+                /* Some handle went bad, drop the waits that use it */
+                DPRINT1("Thread pool wait failed: 0x%lx\n", Status);
+
+                for (Index = 1; Index < Count; Index++)
+                {
+                    if (!TppIsWaitArmedLocked(Thread, Waits[Index], Generations[Index])) continue;
+
+                    Status = NtWaitForSingleObject(Handles[Index], FALSE, &ZeroTimeout);
+                    if (!NT_SUCCESS(Status)) TppDisarmWaitLocked(Waits[Index]);
+                }
+            }
+            continue;
+        }
+
+        /* Only report the signal if the wait wasn't changed while we were waiting */
+        if (TppIsWaitArmedLocked(Thread, Waits[Index], Generations[Index]))
+        {
+            Wait = Waits[Index];
+            TppDisarmWaitLocked(Wait);
+            TppSubmit(Wait, TRUE);
+        }
+    }
+
+    RemoveEntryList(&Thread->ListEntry);
+    RtlLeaveCriticalSection(&TppWaitLock);
+
+    NtClose(Thread->UpdateEvent);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Thread);
+
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+/* The wait lock must be held */
+static
+PTPP_WAIT_THREAD
+TppGetWaitThreadLocked(VOID)
+{
+    PLIST_ENTRY ListEntry;
+    PTPP_WAIT_THREAD Thread;
+    NTSTATUS Status;
+
+    for (ListEntry = TppWaitThreadList.Flink; ListEntry != &TppWaitThreadList; ListEntry = ListEntry->Flink)
+    {
+        Thread = CONTAINING_RECORD(ListEntry, TPP_WAIT_THREAD, ListEntry);
+        if (Thread->NumberOfWaits < TPP_WAITS_PER_THREAD) return Thread;
+    }
+
+    Thread = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*Thread));
+    if (!Thread) return NULL;
+
+    InitializeListHead(&Thread->Waits);
+    Thread->NumberOfWaits = 0;
+
+    Status = NtCreateEvent(&Thread->UpdateEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Thread);
+        return NULL;
+    }
+
+    /* The thread blocks on the wait lock until we're done */
+    InsertTailList(&TppWaitThreadList, &Thread->ListEntry);
+
+    Status = TppStartThread(TppWaitThread, Thread);
+    if (!NT_SUCCESS(Status))
+    {
+        RemoveEntryList(&Thread->ListEntry);
+        NtClose(Thread->UpdateEvent);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Thread);
+        return NULL;
+    }
+
+    return Thread;
+}
+
+/* The pool lock must be held */
+static
+BOOLEAN
+TppQueueIoCompletionLocked(
+    _Inout_ PTPP_OBJECT Io,
+    _In_ PVOID ApcContext,
+    _In_ PIO_STATUS_BLOCK IoStatus)
+{
+    PTPP_IO_COMPLETION Completions;
+    ULONG Size, Tail;
+
+    if (Io->u.Io.CompletionCount == Io->u.Io.CompletionSize)
+    {
+        Size = max(Io->u.Io.CompletionSize * 2, 4);
+        if (Io->u.Io.Completions)
+        {
+            Completions = RtlReAllocateHeap(RtlGetProcessHeap(),
+                                            0,
+                                            Io->u.Io.Completions,
+                                            Size * sizeof(TPP_IO_COMPLETION));
+        }
+        else
+        {
+            Completions = RtlAllocateHeap(RtlGetProcessHeap(), 0, Size * sizeof(TPP_IO_COMPLETION));
+        }
+
+        if (!Completions) return FALSE;
+
+        /* The ring is full, so if it wraps, move the part up to the
+           old end over to the new end to keep it in order */
+        if (Io->u.Io.CompletionHead)
+        {
+            RtlMoveMemory(&Completions[Io->u.Io.CompletionHead + Size - Io->u.Io.CompletionSize],
+                          &Completions[Io->u.Io.CompletionHead],
+                          (Io->u.Io.CompletionSize - Io->u.Io.CompletionHead) * sizeof(TPP_IO_COMPLETION));
+            Io->u.Io.CompletionHead += Size - Io->u.Io.CompletionSize;
+        }
+
+        Io->u.Io.Completions = Completions;
+        Io->u.Io.CompletionSize = Size;
+    }
+
+    Tail = (Io->u.Io.CompletionHead + Io->u.Io.CompletionCount) % Io->u.Io.CompletionSize;
+    Io->u.Io.Completions[Tail].ApcContext = ApcContext;
+    Io->u.Io.Completions[Tail].IoStatus = *IoStatus;
+    Io->u.Io.CompletionCount++;
+
+    if (!NT_SUCCESS(TppSubmitLocked(Io, FALSE)))
+    {
+        Io->u.Io.CompletionCount--;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+ULONG
+NTAPI
+TppIoThread(
+    _In_ PVOID Parameter)
+{
+    IO_STATUS_BLOCK IoStatus;
+    PVOID Key, ApcContext;
+    LARGE_INTEGER Delay;
+    PTPP_OBJECT Io;
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Delay.QuadPart = TPP_IO_RETRY_DELAY;
+
+    for (;;)
+    {
+        Status = NtRemoveIoCompletion(TppIoPort, &Key, &ApcContext, &IoStatus, NULL);
+        if (Status != STATUS_SUCCESS || !Key) continue;
+
+        Io = Key;
+        Pool = Io->Pool;
+
+        RtlEnterCriticalSection(&Pool->Lock);
+
+        if (Io->u.Io.PendingIo) Io->u.Io.PendingIo--;
+
+        /* The port won't report this completion again, so hold on to it
+           until there is memory for it and a worker to run it */
+        while (!TppQueueIoCompletionLocked(Io, ApcContext, &IoStatus))
+        {
+            RtlLeaveCriticalSection(&Pool->Lock);
+            NtDelayExecution(FALSE, &Delay);
+            RtlEnterCriticalSection(&Pool->Lock);
+        }
+
+        RtlWakeAllConditionVariable(&Pool->CallbackDone);
+        RtlLeaveCriticalSection(&Pool->Lock);
+
+        TppReleaseIoPort(Io);
+    }
+
+    return 0;
+}
+
+static
+NTSTATUS
+TppStartIoPort(VOID)
+{
+    HANDLE Port;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&TppIoLock);
+
+    if (!TppIoPort)
+    {
+        Status = NtCreateIoCompletion(&Port, IO_COMPLETION_ALL_ACCESS, NULL, 0);
+        if (NT_SUCCESS(Status))
+        {
+            TppIoPort = Port;
+            Status = TppStartThread(TppIoThread, NULL);
+            if (!NT_SUCCESS(Status))
+            {
+                TppIoPort = NULL;
+                NtClose(Port);
+            }
+        }
+    }
+
+    RtlLeaveCriticalSection(&TppIoLock);
+    return Status;
+}
+
+/* PUBLIC FUNCTIONS **********************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocPool(
+    _Out_ PTP_POOL *PoolReturn,
+    _Reserved_ PVOID Reserved)
+{
+    PTP_POOL Pool;
+
+    if (Reserved) DPRINT1("TpAllocPool: ignoring reserved parameter %p\n", Reserved);
+
+    Pool = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*Pool));
+    if (!Pool) return STATUS_NO_MEMORY;
+
+    TppInitializePool(Pool);
+
+    *PoolReturn = Pool;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleasePool(
+    _Inout_ PTP_POOL Pool)
+{
+    /* Idle workers leave, busy ones once the queued callbacks ran */
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->Shutdown = TRUE;
+    RtlWakeAllConditionVariable(&Pool->WorkAvailable);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    TppReleasePool(Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetPoolMaxThreads(
+    _Inout_ PTP_POOL Pool,
+    _In_ ULONG MaxThreads)
+{
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MaxWorkers = max(MaxThreads, 1);
+    Pool->MinWorkers = min(Pool->MinWorkers, Pool->MaxWorkers);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+NTAPI
+TpSetPoolMinThreads(
+    _Inout_ PTP_POOL Pool,
+    _In_ ULONG MinThreads)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    while (Pool->Workers < MinThreads)
+    {
+        Status = TppStartWorker(Pool);
+        if (!NT_SUCCESS(Status)) break;
+    }
+
+    if (NT_SUCCESS(Status))
+    {
+        Pool->MinWorkers = MinThreads;
+        Pool->MaxWorkers = max(Pool->MaxWorkers, MinThreads);
+    }
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+    return NT_SUCCESS(Status);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocCleanupGroup(
+    _Out_ PTP_CLEANUP_GROUP *CleanupGroupReturn)
+{
+    PTP_CLEANUP_GROUP CleanupGroup;
+
+    CleanupGroup = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*CleanupGroup));
+    if (!CleanupGroup) return STATUS_NO_MEMORY;
+
+    CleanupGroup->ReferenceCount = 1;
+    RtlInitializeCriticalSection(&CleanupGroup->Lock);
+    InitializeListHead(&CleanupGroup->Members);
+
+    *CleanupGroupReturn = CleanupGroup;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroup(
+    _Inout_ PTP_CLEANUP_GROUP CleanupGroup)
+{
+    TppReleaseCleanupGroup(CleanupGroup);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroupMembers(
+    _Inout_ PTP_CLEANUP_GROUP CleanupGroup,
+    _In_ BOOL CancelPendingCallbacks,
+    _Inout_opt_ PVOID CleanupParameter)
+{
+    LIST_ENTRY Members;
+    PLIST_ENTRY ListEntry;
+    PTPP_OBJECT Object;
+
+    InitializeListHead(&Members);
+
+    /* Take the members over, each with a reference so that they can't vanish under us */
+    RtlEnterCriticalSection(&CleanupGroup->Lock);
+    while (!IsListEmpty(&CleanupGroup->Members))
+    {
+        ListEntry = RemoveHeadList(&CleanupGroup->Members);
+        Object = CONTAINING_RECORD(ListEntry, TPP_OBJECT, GroupEntry);
+
+        Object->GroupMember = FALSE;
+        InterlockedIncrement(&Object->ReferenceCount);
+        InsertTailList(&Members, ListEntry);
+    }
+    RtlLeaveCriticalSection(&CleanupGroup->Lock);
+
+    /* Stop timers and waits first, so that nothing gets queued anymore */
+    for (ListEntry = Members.Flink; ListEntry != &Members; ListEntry = ListEntry->Flink)
+    {
+        Object = CONTAINING_RECORD(ListEntry, TPP_OBJECT, GroupEntry);
+
+        TppDisarmObject(Object);
+        if (CancelPendingCallbacks) TppCancel(Object);
+    }
+
+    while (!IsListEmpty(&Members))
+    {
+        ListEntry = RemoveHeadList(&Members);
+        Object = CONTAINING_RECORD(ListEntry, TPP_OBJECT, GroupEntry);
+
+        TppWaitForObject(Object, TRUE);
+
+        if (CancelPendingCallbacks && Object->GroupCancelCallback)
+            Object->GroupCancelCallback(Object->Context, CleanupParameter);
+
+        /* Release the owner reference, unless the owner already did */
+        if (!InterlockedExchange(&Object->Shutdown, TRUE))
+            TppReleaseObject(Object);
+
+        TppReleaseObject(Object);
+    }
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackSetEventOnCompletion(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _In_ HANDLE Event)
+{
+    Instance->Event = Event;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseSemaphoreOnCompletion(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _In_ HANDLE Semaphore,
+    _In_ ULONG ReleaseCount)
+{
+    Instance->Semaphore = Semaphore;
+    Instance->SemaphoreReleaseCount = ReleaseCount;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseMutexOnCompletion(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _In_ HANDLE Mutex)
+{
+    Instance->Mutex = Mutex;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackLeaveCriticalSectionOnCompletion(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _Inout_ PRTL_CRITICAL_SECTION CriticalSection)
+{
+    Instance->CriticalSection = CriticalSection;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackUnloadDllOnCompletion(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _In_ PVOID DllHandle)
+{
+    Instance->Dll = DllHandle;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance)
+{
+    PTP_POOL Pool = Instance->Object->Pool;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (Instance->MayRunLong) return STATUS_SUCCESS;
+
+    /* Make sure this callback doesn't hold up the others */
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (Pool->BusyWorkers >= Pool->Workers)
+    {
+        if (Pool->Workers < Pool->MaxWorkers)
+            Status = TppStartWorker(Pool);
+        else
+            Status = STATUS_TOO_MANY_THREADS;
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    Instance->MayRunLong = TRUE;
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpDisassociateCallback(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance)
+{
+    PTPP_OBJECT Object = Instance->Object;
+
+    if (!Instance->Associated) return;
+
+    /* TpWaitForXxx no longer waits for this callback */
+    RtlEnterCriticalSection(&Object->Pool->Lock);
+    Object->AssociatedCallbacks--;
+    RtlWakeAllConditionVariable(&Object->Pool->CallbackDone);
+    RtlLeaveCriticalSection(&Object->Pool->Lock);
+
+    Instance->Associated = FALSE;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSimpleTryPost(
+    _In_ PTP_SIMPLE_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocateObject(TppSimpleObject, Context, CallbackEnviron, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Object->u.Simple.Callback = Callback;
+
+    Status = TppSubmit(Object, FALSE);
+    if (!NT_SUCCESS(Status)) TppShutdownObject(Object);
+
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWork(
+    _Out_ PTP_WORK *WorkReturn,
+    _In_ PTP_WORK_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocateObject(TppWorkObject, Context, CallbackEnviron, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Object->u.Work.Callback = Callback;
+
+    *WorkReturn = (PTP_WORK)Object;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWork(
+    _Inout_ PTP_WORK Work)
+{
+    TppShutdownObject((PTPP_OBJECT)Work);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpPostWork(
+    _Inout_ PTP_WORK Work)
+{
+    TppSubmit((PTPP_OBJECT)Work, FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWork(
+    _Inout_ PTP_WORK Work,
+    _In_ BOOL CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks) TppCancel((PTPP_OBJECT)Work);
+    TppWaitForObject((PTPP_OBJECT)Work, FALSE);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocTimer(
+    _Out_ PTP_TIMER *TimerReturn,
+    _In_ PTP_TIMER_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocateObject(TppTimerObject, Context, CallbackEnviron, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Object->u.Timer.Callback = Callback;
+
+    /* All timers share one thread */
+    RtlEnterCriticalSection(&TppTimerLock);
+    if (!TppTimerThreadStarted)
+    {
+        Status = TppStartThread(TppTimerThread, NULL);
+        TppTimerThreadStarted = NT_SUCCESS(Status);
+    }
+    RtlLeaveCriticalSection(&TppTimerLock);
+
+    if (!NT_SUCCESS(Status))
+    {
+        TppShutdownObject(Object);
+        return Status;
+    }
+
+    *TimerReturn = (PTP_TIMER)Object;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseTimer(
+    _Inout_ PTP_TIMER Timer)
+{
+    TppShutdownObject((PTPP_OBJECT)Timer);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetTimer(
+    _Inout_ PTP_TIMER Timer,
+    _In_opt_ PLARGE_INTEGER DueTime,
+    _In_ ULONG Period,
+    _In_opt_ ULONG WindowLength)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Timer;
+    LARGE_INTEGER Now;
+
+    RtlEnterCriticalSection(&TppTimerLock);
+
+    if (Object->u.Timer.Armed)
+    {
+        RemoveEntryList(&Object->u.Timer.TimerEntry);
+        Object->u.Timer.Armed = FALSE;
+    }
+
+    /* A timer stays set after it fired, until it is explicitly reset */
+    Object->u.Timer.Set = (DueTime != NULL);
+
+    if (DueTime && !Object->Shutdown)
+    {
+        NtQuerySystemTime(&Now);
+
+        if (DueTime->QuadPart < 0)
+            Object->u.Timer.DueTime = Now.QuadPart - DueTime->QuadPart;
+        else if (DueTime->QuadPart == 0)
+            Object->u.Timer.DueTime = Now.QuadPart;
+        else
+            Object->u.Timer.DueTime = DueTime->QuadPart;
+
+        Object->u.Timer.Period = Period;
+        Object->u.Timer.WindowLength = WindowLength;
+
+        TppInsertTimerLocked(Object);
+        RtlWakeConditionVariable(&TppTimerUpdate);
+    }
+
+    RtlLeaveCriticalSection(&TppTimerLock);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+NTAPI
+TpIsTimerSet(
+    _In_ PTP_TIMER Timer)
+{
+    return ((PTPP_OBJECT)Timer)->u.Timer.Set;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForTimer(
+    _Inout_ PTP_TIMER Timer,
+    _In_ BOOL CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks) TppCancel((PTPP_OBJECT)Timer);
+    TppWaitForObject((PTPP_OBJECT)Timer, FALSE);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWait(
+    _Out_ PTP_WAIT *WaitReturn,
+    _In_ PTP_WAIT_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocateObject(TppWaitObject, Context, CallbackEnviron, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Object->u.Wait.Callback = Callback;
+
+    *WaitReturn = (PTP_WAIT)Object;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWait(
+    _Inout_ PTP_WAIT Wait)
+{
+    TppShutdownObject((PTPP_OBJECT)Wait);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetWait(
+    _Inout_ PTP_WAIT Wait,
+    _In_opt_ HANDLE Handle,
+    _In_opt_ PLARGE_INTEGER Timeout)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Wait;
+    PTPP_WAIT_THREAD Thread;
+    LARGE_INTEGER Now;
+
+    RtlEnterCriticalSection(&TppWaitLock);
+
+    TppDisarmWaitLocked(Object);
+
+    /* Waits are one-shot, a NULL handle only disarms */
+    if (Handle && !Object->Shutdown)
+    {
+        NtQuerySystemTime(&Now);
+
+        if (!Timeout)
+            Object->u.Wait.Timeout = MAXLONGLONG;
+        else if (Timeout->QuadPart <= 0)
+            Object->u.Wait.Timeout = Now.QuadPart - Timeout->QuadPart;
+        else
+            Object->u.Wait.Timeout = Timeout->QuadPart;
+
+        Thread = TppGetWaitThreadLocked();
+        if (Thread)
+        {
+            Object->u.Wait.Handle = Handle;
+            Object->u.Wait.Generation = ++TppWaitGeneration;
+            Object->u.Wait.Thread = Thread;
+            InsertTailList(&Thread->Waits, &Object->u.Wait.WaitEntry);
+            Thread->NumberOfWaits++;
+
+            NtSetEvent(Thread->UpdateEvent, NULL);
+        }
+        else
+        {
+            DPRINT1("No thread to wait on %p\n", Handle);
+        }
+    }
+
+    RtlLeaveCriticalSection(&TppWaitLock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWait(
+    _Inout_ PTP_WAIT Wait,
+    _In_ BOOL CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks) TppCancel((PTPP_OBJECT)Wait);
+    TppWaitForObject((PTPP_OBJECT)Wait, FALSE);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocIoCompletion(
+    _Out_ PTP_IO *IoReturn,
+    _In_ HANDLE File,
+    _In_ PTP_IO_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    FILE_COMPLETION_INFORMATION CompletionInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocateObject(TppIoObject, Context, CallbackEnviron, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Object->u.Io.Callback = Callback;
+
+    Status = TppStartIoPort();
+    if (NT_SUCCESS(Status))
+    {
+        /* The object is the completion key */
+        CompletionInfo.Port = TppIoPort;
+        CompletionInfo.Key = Object;
+        Status = NtSetInformationFile(File,
+                                      &IoStatusBlock,
+                                      &CompletionInfo,
+                                      sizeof(CompletionInfo),
+                                      FileCompletionInformation);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        TppShutdownObject(Object);
+        return Status;
+    }
+
+    /* Completions can show up until the object is released with no I/O pending */
+    InterlockedIncrement(&Object->ReferenceCount);
+    Object->u.Io.PortReferenced = TRUE;
+
+    *IoReturn = (PTP_IO)Object;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseIoCompletion(
+    _Inout_ PTP_IO Io)
+{
+    TppShutdownObject((PTPP_OBJECT)Io);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpStartAsyncIoOperation(
+    _Inout_ PTP_IO Io)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Io;
+
+    RtlEnterCriticalSection(&Object->Pool->Lock);
+    Object->u.Io.PendingIo++;
+    RtlLeaveCriticalSection(&Object->Pool->Lock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCancelAsyncIoOperation(
+    _Inout_ PTP_IO Io)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Io;
+
+    /* The operation failed synchronously, no completion will show up */
+    RtlEnterCriticalSection(&Object->Pool->Lock);
+    if (Object->u.Io.PendingIo) Object->u.Io.PendingIo--;
+    RtlWakeAllConditionVariable(&Object->Pool->CallbackDone);
+    RtlLeaveCriticalSection(&Object->Pool->Lock);
+
+    TppReleaseIoPort(Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForIoCompletion(
+    _Inout_ PTP_IO Io,
+    _In_ BOOL CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks) TppCancel((PTPP_OBJECT)Io);
+    TppWaitForObject((PTPP_OBJECT)Io, FALSE);
+}
+
+/* EOF */
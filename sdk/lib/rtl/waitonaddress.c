@@ -0,0 +1,267 @@
+/*
+ * PROJECT:     ReactOS System Libraries
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Address based wait primitive (RtlWaitOnAddress and friends)
+ */
+
+/* NOTE: Waiters are queued in FIFO order on a bucket picked by hashing the
+   address they wait on. Every waiter blocks on the global keyed event with
+   its own wait block as the key, so waiters on unrelated addresses never
+   contend on anything but their (rarely shared) bucket lock. */
+
+/* INCLUDES ******************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* INTERNAL TYPES ************************************************************/
+
+#define RTLP_ADDRESS_WAIT_BUCKET_SHIFT  7
+#define RTLP_ADDRESS_WAIT_BUCKETS       (1 << RTLP_ADDRESS_WAIT_BUCKET_SHIFT)
+#define RTLP_ADDRESS_WAIT_SPIN_COUNT    100
+
+typedef struct _RTLP_ADDRESS_WAIT_BLOCK
+{
+    struct _RTLP_ADDRESS_WAIT_BLOCK *Next;
+    struct _RTLP_ADDRESS_WAIT_BLOCK *Prev;
+    const volatile VOID *Address;
+    BOOLEAN Signaled;
+} RTLP_ADDRESS_WAIT_BLOCK, *PRTLP_ADDRESS_WAIT_BLOCK;
+
+typedef struct DECLSPEC_CACHEALIGN _RTLP_ADDRESS_WAIT_BUCKET
+{
+    LONG Lock;
+    PRTLP_ADDRESS_WAIT_BLOCK Head;
+    PRTLP_ADDRESS_WAIT_BLOCK Tail;
+} RTLP_ADDRESS_WAIT_BUCKET, *PRTLP_ADDRESS_WAIT_BUCKET;
+
+/* GLOBALS *******************************************************************/
+
+static RTLP_ADDRESS_WAIT_BUCKET RtlpAddressWaitBuckets[RTLP_ADDRESS_WAIT_BUCKETS];
+
+/* INTERNAL FUNCTIONS ********************************************************/
+
+static
+PRTLP_ADDRESS_WAIT_BUCKET
+RtlpGetAddressWaitBucket(
+    _In_ const volatile VOID *Address)
+{
+    ULONG Key;
+
+    /* Fold the address and scramble it, so that neighbouring lock
+       words don't all end up in the same bucket */
+    Key = (ULONG)((ULONG_PTR)Address >> 2);
+#ifdef _WIN64
+    Key ^= (ULONG)((ULONG_PTR)Address >> 32);
+#endif
+    Key *= 0x9E3779B1;
+
+    return &RtlpAddressWaitBuckets[Key >> (32 - RTLP_ADDRESS_WAIT_BUCKET_SHIFT)];
+}
+
+static
+VOID
+RtlpLockAddressWaitBucket(
+    _Inout_ PRTLP_ADDRESS_WAIT_BUCKET Bucket)
+{
+    ULONG SpinCount = 0;
+
+    while (InterlockedExchange(&Bucket->Lock, 1) != 0)
+    {
+        do
+        {
+            /* The owner only holds the lock for a few list operations,
+               but give up our quantum if it got preempted meanwhile */
+            if (++SpinCount < RTLP_ADDRESS_WAIT_SPIN_COUNT)
+                YieldProcessor();
+            else
+                NtYieldExecution();
+        } while (*(volatile LONG *)&Bucket->Lock != 0);
+    }
+}
+
+FORCEINLINE
+VOID
+RtlpUnlockAddressWaitBucket(
+    _Inout_ PRTLP_ADDRESS_WAIT_BUCKET Bucket)
+{
+    (void)InterlockedExchange(&Bucket->Lock, 0);
+}
+
+static
+BOOLEAN
+RtlpIsAddressEqual(
+    _In_ const volatile VOID *Address,
+    _In_ PVOID CompareAddress,
+    _In_ SIZE_T AddressSize)
+{
+    switch (AddressSize)
+    {
+        case sizeof(UCHAR):
+            return *(const volatile UCHAR *)Address == *(PUCHAR)CompareAddress;
+        case sizeof(USHORT):
+            return *(const volatile USHORT *)Address == *(PUSHORT)CompareAddress;
+        case sizeof(ULONG):
+            return *(const volatile ULONG *)Address == *(PULONG)CompareAddress;
+        default:
+            return *(const volatile ULONGLONG *)Address == *(PULONGLONG)CompareAddress;
+    }
+}
+
+static
+VOID
+RtlpRemoveAddressWaitBlock(
+    _Inout_ PRTLP_ADDRESS_WAIT_BUCKET Bucket,
+    _Inout_ PRTLP_ADDRESS_WAIT_BLOCK WaitBlock)
+{
+    if (WaitBlock->Prev)
+        WaitBlock->Prev->Next = WaitBlock->Next;
+    else
+        Bucket->Head = WaitBlock->Next;
+
+    if (WaitBlock->Next)
+        WaitBlock->Next->Prev = WaitBlock->Prev;
+    else
+        Bucket->Tail = WaitBlock->Prev;
+}
+
+static
+VOID
+RtlpWakeAddress(
+    _In_ PVOID Address,
+    _In_ BOOLEAN WakeAll)
+{
+    PRTLP_ADDRESS_WAIT_BUCKET Bucket = RtlpGetAddressWaitBucket(Address);
+    PRTLP_ADDRESS_WAIT_BLOCK WaitBlock, NextBlock, WakeList = NULL, *WakeTail = &WakeList;
+
+    /* Don't bother taking the lock if no one waits on this bucket. The
+       barrier orders the caller's update of the value against our check,
+       pairing with the one between queueing and comparing in the waiter. */
+    MemoryBarrier();
+    if (*(PRTLP_ADDRESS_WAIT_BLOCK volatile *)&Bucket->Head == NULL)
+        return;
+
+    RtlpLockAddressWaitBucket(Bucket);
+
+    for (WaitBlock = Bucket->Head; WaitBlock != NULL; WaitBlock = NextBlock)
+    {
+        NextBlock = WaitBlock->Next;
+        if (WaitBlock->Address != Address)
+            continue;
+
+        /* Dequeue the waiter and chain it on our wake list. Once Signaled
+           is set, the waiter is committed to consume our release. */
+        RtlpRemoveAddressWaitBlock(Bucket, WaitBlock);
+        WaitBlock->Signaled = TRUE;
+        WaitBlock->Next = NULL;
+        *WakeTail = WaitBlock;
+        WakeTail = &WaitBlock->Next;
+
+        if (!WakeAll)
+            break;
+    }
+
+    RtlpUnlockAddressWaitBucket(Bucket);
+
+    /* Release the waiters outside of the bucket lock. A wait block may go
+       away as soon as its owner is released, so fetch the link first. */
+    for (WaitBlock = WakeList; WaitBlock != NULL; WaitBlock = NextBlock)
+    {
+        NextBlock = WaitBlock->Next;
+        NtReleaseKeyedEvent(NULL, WaitBlock, FALSE, NULL);
+    }
+}
+
+/* EXPORTED FUNCTIONS ********************************************************/
+
+NTSTATUS
+NTAPI
+RtlWaitOnAddress(
+    _In_ const volatile VOID *Address,
+    _In_ PVOID CompareAddress,
+    _In_ SIZE_T AddressSize,
+    _In_opt_ PLARGE_INTEGER Timeout)
+{
+    PRTLP_ADDRESS_WAIT_BUCKET Bucket;
+    RTLP_ADDRESS_WAIT_BLOCK WaitBlock;
+    NTSTATUS Status;
+
+    if (AddressSize != sizeof(UCHAR) && AddressSize != sizeof(USHORT) &&
+        AddressSize != sizeof(ULONG) && AddressSize != sizeof(ULONGLONG))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Cheap check first, the value might have changed already */
+    if (!RtlpIsAddressEqual(Address, CompareAddress, AddressSize))
+        return STATUS_SUCCESS;
+
+    WaitBlock.Address = Address;
+    WaitBlock.Signaled = FALSE;
+    WaitBlock.Next = NULL;
+
+    Bucket = RtlpGetAddressWaitBucket(Address);
+    RtlpLockAddressWaitBucket(Bucket);
+
+    WaitBlock.Prev = Bucket->Tail;
+    if (Bucket->Tail)
+        Bucket->Tail->Next = &WaitBlock;
+    else
+        Bucket->Head = &WaitBlock;
+    Bucket->Tail = &WaitBlock;
+
+    /* Check again now that we are queued. Whoever changes the value after
+       this point will find us on the queue when it wakes the address. */
+    MemoryBarrier();
+    if (!RtlpIsAddressEqual(Address, CompareAddress, AddressSize))
+    {
+        RtlpRemoveAddressWaitBlock(Bucket, &WaitBlock);
+        RtlpUnlockAddressWaitBucket(Bucket);
+        return STATUS_SUCCESS;
+    }
+
+    RtlpUnlockAddressWaitBucket(Bucket);
+
+    Status = NtWaitForKeyedEvent(NULL, &WaitBlock, FALSE, Timeout);
+    if (Status != STATUS_SUCCESS)
+    {
+        RtlpLockAddressWaitBucket(Bucket);
+
+        if (!WaitBlock.Signaled)
+        {
+            /* Nobody dequeued us, so we simply timed out */
+            RtlpRemoveAddressWaitBlock(Bucket, &WaitBlock);
+            RtlpUnlockAddressWaitBucket(Bucket);
+            return Status;
+        }
+
+        RtlpUnlockAddressWaitBucket(Bucket);
+
+        /* A waker dequeued us right before the timeout and is about to
+           release our key. Pick it up, or it would block forever. */
+        NtWaitForKeyedEvent(NULL, &WaitBlock, FALSE, NULL);
+        Status = STATUS_SUCCESS;
+    }
+
+    return Status;
+}
+
+VOID
+NTAPI
+RtlWakeAddressSingle(
+    _In_ PVOID Address)
+{
+    RtlpWakeAddress(Address, FALSE);
+}
+
+VOID
+NTAPI
+RtlWakeAddressAll(
+    _In_ PVOID Address)
+{
+    RtlpWakeAddress(Address, TRUE);
+}
+
+/* EOF */
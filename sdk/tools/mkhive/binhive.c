@@ -50,6 +50,9 @@ ExportBinaryHive(
 
     fseek(File, 0, SEEK_SET);
 
+    /* Merge the free space left behind and drop it from the end of the hive */
+    HvCompactFreeCells(&CmHive->Hive);
+
     CmHive->FileHandles[HFILE_TYPE_PRIMARY] = (HANDLE)File;
     ret = HvWriteHive(&CmHive->Hive);
     fclose(File);
@@ -0,0 +1,293 @@
+/*
+ * PROJECT:     ReactOS hive maker
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Hive cell allocator benchmark and consistency test
+ */
+
+/*
+ * Builds a SOFTWARE hive the way mkhive does, optionally seeded from the
+ * INF files given on the command line, then keeps rewriting a set of
+ * values with random sizes and deletes half of them. The hive size and
+ * its free space are reported before and after HvCompactFreeCells, and
+ * every value left is read back to make sure the allocator didn't lose
+ * or overwrite any data.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "mkhive.h"
+
+#define BENCH_KEYS      128
+#define BENCH_VALUES    16
+#define BENCH_ROUNDS    64
+#define BENCH_MAX_DATA  4096
+
+/* GLOBALS ******************************************************************/
+
+static ULONG BenchSeed = 1;
+static ULONG BenchLength[BENCH_KEYS][BENCH_VALUES];
+static UCHAR BenchData[BENCH_MAX_DATA];
+static UCHAR BenchReadBack[BENCH_MAX_DATA];
+
+/* FUNCTIONS ****************************************************************/
+
+static ULONG
+BenchRandom(VOID)
+{
+    BenchSeed = BenchSeed * 1103515245 + 12345;
+    return (BenchSeed >> 16) & 0x7FFF;
+}
+
+static VOID
+BenchName(
+    OUT PWCHAR Buffer,
+    IN PCSTR Prefix,
+    IN ULONG Number)
+{
+    CHAR Name[32];
+    ULONG i;
+
+    sprintf(Name, "%s%u", Prefix, (unsigned int)Number);
+    for (i = 0; Name[i]; i++)
+        Buffer[i] = (WCHAR)Name[i];
+    Buffer[i] = UNICODE_NULL;
+}
+
+static VOID
+PrintHiveStatistics(
+    IN PCSTR Stage,
+    IN PHHIVE Hive)
+{
+    PDUAL Dual = &Hive->Storage[Stable];
+    ULONG BlockIndex, Offset;
+    ULONG FreeCells = 0, FreeBytes = 0, LargestFree = 0;
+    PHBIN Bin;
+    PHCELL Cell;
+
+    for (BlockIndex = 0; BlockIndex < Dual->Length; BlockIndex += Bin->Size / HBLOCK_SIZE)
+    {
+        Bin = (PHBIN)Dual->BlockList[BlockIndex].BinAddress;
+        for (Offset = sizeof(HBIN); Offset < Bin->Size; Offset += ABS_VALUE(Cell->Size))
+        {
+            Cell = (PHCELL)((ULONG_PTR)Bin + Offset);
+            if (Cell->Size <= 0)
+                continue;
+
+            FreeCells++;
+            FreeBytes += Cell->Size;
+            if ((ULONG)Cell->Size > LargestFree)
+                LargestFree = Cell->Size;
+        }
+    }
+
+    printf("  %-14s %8u bytes, %6u free cells, %8u bytes free, largest %u\n",
+           Stage,
+           (unsigned int)Hive->BaseBlock->Length,
+           (unsigned int)FreeCells,
+           (unsigned int)FreeBytes,
+           (unsigned int)LargestFree);
+}
+
+static BOOL
+UpdateValues(
+    IN HKEY BenchKey,
+    IN ULONG Round)
+{
+    WCHAR Name[32];
+    HKEY Key;
+    ULONG i, j;
+
+    for (i = 0; i < BENCH_KEYS; i++)
+    {
+        BenchName(Name, "Key", i);
+        if (RegCreateKeyW(BenchKey, Name, &Key) != ERROR_SUCCESS)
+            return FALSE;
+
+        for (j = 0; j < BENCH_VALUES; j++)
+        {
+            /* Mostly small values with an occasional large one, like
+               the settings a real SOFTWARE hive is full of */
+            BenchLength[i][j] = (BenchRandom() % 8) ? 8 + BenchRandom() % 256
+                                                    : 8 + BenchRandom() % (BENCH_MAX_DATA - 8);
+            memset(BenchData, (UCHAR)(i + j + Round), BenchLength[i][j]);
+
+            BenchName(Name, "Value", j);
+            if (RegSetValueExW(Key, Name, 0, REG_BINARY, BenchData, BenchLength[i][j]) != ERROR_SUCCESS)
+            {
+                RegCloseKey(Key);
+                return FALSE;
+            }
+        }
+
+        RegCloseKey(Key);
+    }
+
+    return TRUE;
+}
+
+static BOOL
+DeleteValues(
+    IN HKEY BenchKey)
+{
+    WCHAR Name[32];
+    HKEY Key;
+    ULONG i, j;
+
+    for (i = 0; i < BENCH_KEYS; i++)
+    {
+        BenchName(Name, "Key", i);
+        if (RegOpenKeyW(BenchKey, Name, &Key) != ERROR_SUCCESS)
+            return FALSE;
+
+        for (j = (i & 1); j < BENCH_VALUES; j += 2)
+        {
+            BenchName(Name, "Value", j);
+            if (RegDeleteValueW(Key, Name) != ERROR_SUCCESS)
+            {
+                RegCloseKey(Key);
+                return FALSE;
+            }
+            BenchLength[i][j] = 0;
+        }
+
+        RegCloseKey(Key);
+    }
+
+    return TRUE;
+}
+
+static BOOL
+VerifyValues(
+    IN HKEY BenchKey,
+    IN ULONG Round)
+{
+    WCHAR Name[32];
+    HKEY Key;
+    ULONG i, j, k, Type, Length;
+    LONG Error;
+
+    for (i = 0; i < BENCH_KEYS; i++)
+    {
+        BenchName(Name, "Key", i);
+        if (RegOpenKeyW(BenchKey, Name, &Key) != ERROR_SUCCESS)
+            return FALSE;
+
+        for (j = 0; j < BENCH_VALUES; j++)
+        {
+            BenchName(Name, "Value", j);
+            Length = sizeof(BenchReadBack);
+            Error = RegQueryValueExW(Key, Name, NULL, &Type, BenchReadBack, &Length);
+
+            if (BenchLength[i][j] == 0)
+            {
+                if (Error != ERROR_FILE_NOT_FOUND)
+                    goto Mismatch;
+                continue;
+            }
+
+            if (Error != ERROR_SUCCESS || Type != REG_BINARY || Length != BenchLength[i][j])
+                goto Mismatch;
+
+            for (k = 0; k < Length; k++)
+            {
+                if (BenchReadBack[k] != (UCHAR)(i + j + Round))
+                    goto Mismatch;
+            }
+        }
+
+        RegCloseKey(Key);
+    }
+
+    return TRUE;
+
+Mismatch:
+    fprintf(stderr, "Value %u of key %u is corrupted\n", (unsigned int)j, (unsigned int)i);
+    RegCloseKey(Key);
+    return FALSE;
+}
+
+int main(int argc, char *argv[])
+{
+    INT ret = -1;
+    INT i;
+    PHHIVE Hive = NULL;
+    HKEY BenchKey;
+    ULONG Round;
+    clock_t Start;
+
+    printf("Hive cell allocator benchmark\n");
+
+    RegInitializeRegistry("SOFTWARE");
+
+    /* Start from a real hive if we were given the INF files to build it */
+    for (i = 1; i < argc; ++i)
+    {
+        if (!ImportRegistryFile(argv[i]))
+            goto Quit;
+    }
+
+    for (i = 0; i < MAX_NUMBER_OF_REGISTRY_HIVES; ++i)
+    {
+        if (strcmp(RegistryHives[i].HiveName, "SOFTWARE") == 0)
+            Hive = &RegistryHives[i].CmHive->Hive;
+    }
+    ASSERT(Hive);
+
+    PrintHiveStatistics("initial", Hive);
+
+    if (RegCreateKeyW(NULL, L"Registry\\Machine\\SOFTWARE\\HiveBench", &BenchKey) != ERROR_SUCCESS)
+        goto Quit;
+
+    Start = clock();
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+    {
+        if (!UpdateValues(BenchKey, Round))
+        {
+            fprintf(stderr, "Updating the values failed in round %u\n", (unsigned int)Round);
+            goto Close;
+        }
+    }
+    printf("  %u value updates took %u ms\n",
+           (unsigned int)(BENCH_ROUNDS * BENCH_KEYS * BENCH_VALUES),
+           (unsigned int)((clock() - Start) * 1000 / CLOCKS_PER_SEC));
+
+    PrintHiveStatistics("after updates", Hive);
+
+    if (!DeleteValues(BenchKey))
+    {
+        fprintf(stderr, "Deleting the values failed\n");
+        goto Close;
+    }
+
+    PrintHiveStatistics("after deletes", Hive);
+
+    Start = clock();
+    HvCompactFreeCells(Hive);
+    printf("  compaction took %u ms\n",
+           (unsigned int)((clock() - Start) * 1000 / CLOCKS_PER_SEC));
+
+    PrintHiveStatistics("compacted", Hive);
+
+    if (!VerifyValues(BenchKey, BENCH_ROUNDS - 1))
+        goto Close;
+
+    /* Success */
+    ret = 0;
+
+Close:
+    RegCloseKey(BenchKey);
+
+Quit:
+    RegShutdownRegistry();
+
+    if (ret == 0)
+        printf("  Done.\n");
+
+    return ret;
+}
+
+/* EOF */
@@ -0,0 +1,390 @@
+/*
+ * PROJECT:     ReactOS hive maker
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Hive sync benchmark and log replay test
+ */
+
+/*
+ * Creates a hive backed by temporary files and keeps applying bursts of
+ * cell updates to it, syncing after each burst. This is done without a
+ * log, with a log that is written back to the primary on every sync, and
+ * with HIVE_DELTA_LOG. The writes, flushes and bytes that reach the files
+ * are counted, and the hive is loaded back from the files at the end to
+ * check that primary and log together hold exactly what is in memory.
+ * The last sync of the logged modes gets its primary writes dropped, as
+ * if the system went down in the middle of it, so the replay has to
+ * repair a torn primary.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "mkhive.h"
+
+#define SYNC_CELLS      4096
+#define SYNC_BURSTS     256
+#define SYNC_BURST_SIZE 24
+#define SYNC_MAX_CELL   512
+
+/* GLOBALS ******************************************************************/
+
+typedef enum _SYNC_MODE
+{
+    SyncNoLog,
+    SyncLog,
+    SyncDeltaLog,
+    SyncModeMax
+} SYNC_MODE;
+
+static const char *SyncModeNames[SyncModeMax] = { "no log", "log", "delta log" };
+
+typedef struct _SYNC_HIVE
+{
+    HHIVE Hive;
+    FILE *Files[HFILE_TYPE_MAX];
+    ULONG Writes;
+    ULONG Flushes;
+    ULONGLONG BytesWritten;
+    LONG PrimaryWritesLeft;
+} SYNC_HIVE, *PSYNC_HIVE;
+
+static ULONG SyncSeed = 1;
+static HCELL_INDEX SyncCells[SYNC_CELLS];
+
+/* FUNCTIONS ****************************************************************/
+
+static ULONG
+SyncRandom(VOID)
+{
+    SyncSeed = SyncSeed * 1103515245 + 12345;
+    return (SyncSeed >> 16) & 0x7FFF;
+}
+
+static PVOID
+NTAPI
+SyncAllocate(
+    IN SIZE_T Size,
+    IN BOOLEAN Paged,
+    IN ULONG Tag)
+{
+    return malloc((size_t)Size);
+}
+
+static VOID
+NTAPI
+SyncFree(
+    IN PVOID Ptr,
+    IN ULONG Quota)
+{
+    free(Ptr);
+}
+
+static BOOLEAN
+NTAPI
+SyncFileRead(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    OUT PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    PSYNC_HIVE SyncHive = CONTAINING_RECORD(RegistryHive, SYNC_HIVE, Hive);
+    FILE *File = SyncHive->Files[FileType];
+
+    if (!File || fseek(File, *FileOffset, SEEK_SET) != 0)
+        return FALSE;
+
+    return (fread(Buffer, 1, BufferLength, File) == BufferLength);
+}
+
+static BOOLEAN
+NTAPI
+SyncFileWrite(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    IN PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    PSYNC_HIVE SyncHive = CONTAINING_RECORD(RegistryHive, SYNC_HIVE, Hive);
+    FILE *File = SyncHive->Files[FileType];
+
+    /* The system went down, nothing more reaches the primary */
+    if (FileType == HFILE_TYPE_PRIMARY && SyncHive->PrimaryWritesLeft >= 0)
+    {
+        if (SyncHive->PrimaryWritesLeft == 0)
+            return FALSE;
+        SyncHive->PrimaryWritesLeft--;
+    }
+
+    if (!File || fseek(File, *FileOffset, SEEK_SET) != 0)
+        return FALSE;
+
+    SyncHive->Writes++;
+    SyncHive->BytesWritten += BufferLength;
+    return (fwrite(Buffer, 1, BufferLength, File) == BufferLength);
+}
+
+static BOOLEAN
+NTAPI
+SyncFileSetSize(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN ULONG FileSize,
+    IN ULONG OldFileSize)
+{
+    return TRUE;
+}
+
+static BOOLEAN
+NTAPI
+SyncFileFlush(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    PLARGE_INTEGER FileOffset,
+    ULONG Length)
+{
+    PSYNC_HIVE SyncHive = CONTAINING_RECORD(RegistryHive, SYNC_HIVE, Hive);
+    FILE *File = SyncHive->Files[FileType];
+
+    if (!File)
+        return FALSE;
+
+    SyncHive->Flushes++;
+    return (fflush(File) == 0);
+}
+
+static NTSTATUS
+InitializeSyncHive(
+    IN OUT PSYNC_HIVE SyncHive,
+    IN ULONG OperationType,
+    IN SYNC_MODE Mode)
+{
+    return HvInitialize(&SyncHive->Hive,
+                        OperationType,
+                        (Mode == SyncDeltaLog) ? HIVE_DELTA_LOG : 0,
+                        (Mode == SyncNoLog) ? HFILE_TYPE_PRIMARY : HFILE_TYPE_LOG,
+                        NULL,
+                        SyncAllocate,
+                        SyncFree,
+                        SyncFileSetSize,
+                        SyncFileWrite,
+                        SyncFileRead,
+                        SyncFileFlush,
+                        1,
+                        NULL);
+}
+
+static VOID
+FillCell(
+    IN PHHIVE Hive,
+    IN HCELL_INDEX CellIndex,
+    IN UCHAR Pattern)
+{
+    PUCHAR Data = (PUCHAR)HvGetCell(Hive, CellIndex);
+
+    memset(Data, Pattern, HvGetCellSize(Hive, Data));
+    HvReleaseCell(Hive, CellIndex);
+}
+
+static BOOL
+UpdateBurst(
+    IN PHHIVE Hive,
+    IN ULONG Burst)
+{
+    HCELL_INDEX NewCell;
+    ULONG i, Index;
+
+    for (i = 0; i < SYNC_BURST_SIZE; i++)
+    {
+        Index = SyncRandom() % SYNC_CELLS;
+
+        /* Every now and then a value changes size */
+        if ((SyncRandom() % 8) == 0)
+        {
+            NewCell = HvReallocateCell(Hive, SyncCells[Index], 16 + SyncRandom() % SYNC_MAX_CELL);
+            if (NewCell == HCELL_NIL)
+                return FALSE;
+            SyncCells[Index] = NewCell;
+        }
+
+        if (!HvMarkCellDirty(Hive, SyncCells[Index], FALSE))
+            return FALSE;
+        FillCell(Hive, SyncCells[Index], (UCHAR)(Burst + i));
+    }
+
+    return TRUE;
+}
+
+static BOOL
+CompareHives(
+    IN PHHIVE Hive,
+    IN PHHIVE Loaded)
+{
+    PDUAL Dual = &Hive->Storage[Stable];
+    ULONG BlockIndex, Offset;
+    PHBIN Bin, LoadedBin;
+    PHCELL Cell, LoadedCell;
+
+    if (Dual->Length != Loaded->Storage[Stable].Length)
+    {
+        fprintf(stderr, "Loaded hive has %u blocks instead of %u\n",
+                (unsigned int)Loaded->Storage[Stable].Length,
+                (unsigned int)Dual->Length);
+        return FALSE;
+    }
+
+    /* Free cells hold the free list links, which a load rebuilds in its
+       own order, so only compare the layout and the used cells */
+    for (BlockIndex = 0; BlockIndex < Dual->Length; BlockIndex += Bin->Size / HBLOCK_SIZE)
+    {
+        Bin = (PHBIN)Dual->BlockList[BlockIndex].BinAddress;
+        LoadedBin = (PHBIN)Loaded->Storage[Stable].BlockList[BlockIndex].BinAddress;
+        if (memcmp(Bin, LoadedBin, sizeof(HBIN)) != 0)
+            goto Mismatch;
+
+        for (Offset = sizeof(HBIN); Offset < Bin->Size; Offset += ABS_VALUE(Cell->Size))
+        {
+            Cell = (PHCELL)((ULONG_PTR)Bin + Offset);
+            LoadedCell = (PHCELL)((ULONG_PTR)LoadedBin + Offset);
+            if (Cell->Size != LoadedCell->Size ||
+                (Cell->Size < 0 && memcmp(Cell, LoadedCell, -Cell->Size) != 0))
+            {
+                goto Mismatch;
+            }
+        }
+    }
+
+    return TRUE;
+
+Mismatch:
+    fprintf(stderr, "Bin at block %u differs\n", (unsigned int)BlockIndex);
+    return FALSE;
+}
+
+static BOOL
+RunMode(
+    IN SYNC_MODE Mode)
+{
+    SYNC_HIVE SyncHive, LoadedHive;
+    PHHIVE Hive = &SyncHive.Hive;
+    ULONG Burst, i;
+    clock_t Start, Elapsed = 0;
+    BOOL Success = FALSE;
+
+    memset(&SyncHive, 0, sizeof(SyncHive));
+    SyncHive.PrimaryWritesLeft = -1;
+    SyncHive.Files[HFILE_TYPE_PRIMARY] = tmpfile();
+    if (Mode != SyncNoLog)
+        SyncHive.Files[HFILE_TYPE_LOG] = tmpfile();
+
+    if (!SyncHive.Files[HFILE_TYPE_PRIMARY] ||
+        (Mode != SyncNoLog && !SyncHive.Files[HFILE_TYPE_LOG]))
+    {
+        fprintf(stderr, "Creating the hive files failed\n");
+        goto Quit;
+    }
+
+    SyncSeed = 1;
+    if (!NT_SUCCESS(InitializeSyncHive(&SyncHive, HINIT_CREATE, Mode)))
+    {
+        fprintf(stderr, "Creating the hive failed\n");
+        goto Quit;
+    }
+
+    if (!CmCreateRootNode(Hive, L"HiveSync"))
+        goto Free;
+
+    for (i = 0; i < SYNC_CELLS; i++)
+    {
+        SyncCells[i] = HvAllocateCell(Hive, 16 + SyncRandom() % SYNC_MAX_CELL, Stable, HCELL_NIL);
+        if (SyncCells[i] == HCELL_NIL)
+            goto Free;
+        FillCell(Hive, SyncCells[i], (UCHAR)i);
+    }
+
+    /* Start from a hive that is entirely on disk */
+    if (!HvWriteHive(Hive))
+        goto Free;
+    RtlClearAllBits(&Hive->DirtyVector);
+    Hive->DirtyCount = 0;
+    SyncHive.Writes = SyncHive.Flushes = 0;
+    SyncHive.BytesWritten = 0;
+
+    for (Burst = 0; Burst < SYNC_BURSTS; Burst++)
+    {
+        if (!UpdateBurst(Hive, Burst))
+        {
+            fprintf(stderr, "Updating the cells failed in burst %u\n", (unsigned int)Burst);
+            goto Free;
+        }
+
+        /* Crash in the middle of the last sync, right after the primary
+           header and the first run of blocks were written */
+        if (Burst == SYNC_BURSTS - 1 && Mode != SyncNoLog)
+            SyncHive.PrimaryWritesLeft = 2;
+
+        Start = clock();
+        if (!HvSyncHive(Hive) && SyncHive.PrimaryWritesLeft < 0)
+        {
+            fprintf(stderr, "Syncing failed in burst %u\n", (unsigned int)Burst);
+            goto Free;
+        }
+        Elapsed += clock() - Start;
+    }
+
+    printf("  %-10s %6u bytes/sync, %5.2f writes/sync, %5.2f flushes/sync, %6u us/sync, %u KB log\n",
+           SyncModeNames[Mode],
+           (unsigned int)(SyncHive.BytesWritten / SYNC_BURSTS),
+           (double)SyncHive.Writes / SYNC_BURSTS,
+           (double)SyncHive.Flushes / SYNC_BURSTS,
+           (unsigned int)((ULONGLONG)Elapsed * 1000000 / CLOCKS_PER_SEC / SYNC_BURSTS),
+           (unsigned int)(Hive->LogSize / 1024));
+
+    /* Load the hive back as it is on disk */
+    memset(&LoadedHive, 0, sizeof(LoadedHive));
+    LoadedHive.PrimaryWritesLeft = -1;
+    memcpy(LoadedHive.Files, SyncHive.Files, sizeof(LoadedHive.Files));
+    if (!NT_SUCCESS(InitializeSyncHive(&LoadedHive, HINIT_FILE, Mode)))
+    {
+        fprintf(stderr, "Loading the %s hive failed\n", SyncModeNames[Mode]);
+        goto Free;
+    }
+
+    Success = CompareHives(Hive, &LoadedHive.Hive);
+    HvFree(&LoadedHive.Hive);
+
+Free:
+    HvFree(Hive);
+
+Quit:
+    for (i = 0; i < HFILE_TYPE_MAX; i++)
+    {
+        if (SyncHive.Files[i])
+            fclose(SyncHive.Files[i]);
+    }
+
+    return Success;
+}
+
+int main(int argc, char *argv[])
+{
+    SYNC_MODE Mode;
+
+    printf("Hive sync benchmark, %u bursts of %u cell updates\n",
+           (unsigned int)SYNC_BURSTS, (unsigned int)SYNC_BURST_SIZE);
+
+    for (Mode = SyncNoLog; Mode < SyncModeMax; Mode++)
+    {
+        if (!RunMode(Mode))
+            return -1;
+    }
+
+    printf("  Done.\n");
+    return 0;
+}
+
+/* EOF */
@@ -670,7 +670,6 @@ RegSetValueExW(
     UNICODE_STRING ValueNameString;
 
     PVOID DataCell;
-    ULONG DataCellSize;
     NTSTATUS Status;
 
     if (dwType == REG_LINK)
@@ -743,20 +742,17 @@ RegSetValueExW(
     if (!NT_SUCCESS(Status))
         return ERROR_GEN_FAILURE; // STATUS_UNSUCCESSFUL;
 
-    /* Get size of the allocated cell (if any) */
+    /* Get the allocated cell (if any) */
     if (!(ValueCell->DataLength & CM_KEY_VALUE_SPECIAL_SIZE) &&
          (ValueCell->DataLength & ~CM_KEY_VALUE_SPECIAL_SIZE) != 0)
     {
         DataCell = HvGetCell(Hive, ValueCell->Data);
         if (!DataCell)
             return ERROR_GEN_FAILURE; // STATUS_UNSUCCESSFUL;
-
-        DataCellSize = (ULONG)(-HvGetCellSize(Hive, DataCell));
     }
     else
     {
         DataCell = NULL;
-        DataCellSize = 0;
     }
 
     if (cbData <= sizeof(HCELL_INDEX))
@@ -772,13 +768,27 @@ RegSetValueExW(
     }
     else
     {
-        if (cbData > DataCellSize)
+        if (DataCell)
         {
-            /* New data size is larger than the current, destroy current
-             * data block and allocate a new one. */
+            /* Resize the current data block. This gives back the space
+             * we don't need any longer, or moves the data elsewhere if
+             * the block can't grow in place. */
             HCELL_INDEX NewOffset;
 
-            DPRINT("ValueCell->DataLength %u\n", ValueCell->DataLength);
+            NewOffset = HvReallocateCell(Hive, ValueCell->Data, cbData);
+            if (NewOffset == HCELL_NIL)
+            {
+                DPRINT("HvReallocateCell() has failed!\n");
+                return ERROR_GEN_FAILURE; // STATUS_UNSUCCESSFUL;
+            }
+
+            ValueCell->Data = NewOffset;
+            DataCell = (PVOID)HvGetCell(Hive, NewOffset);
+        }
+        else
+        {
+            /* Allocate a new data block */
+            HCELL_INDEX NewOffset;
 
             NewOffset = HvAllocateCell(Hive, cbData, Stable, HCELL_NIL);
             if (NewOffset == HCELL_NIL)
@@ -787,9 +797,6 @@ RegSetValueExW(
                 return ERROR_GEN_FAILURE; // STATUS_UNSUCCESSFUL;
             }
 
-            if (DataCell)
-                HvFreeCell(Hive, ValueCell->Data);
-
             ValueCell->Data = NewOffset;
             DataCell = (PVOID)HvGetCell(Hive, NewOffset);
         }
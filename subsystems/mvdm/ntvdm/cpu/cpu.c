@@ -231,6 +231,7 @@ BOOLEAN CpuInitialize(VOID)
                       EmulatorBiosOperation,
                       EmulatorIntAcknowledge,
                       EmulatorFpu,
+                      EmulatorMapMemory,
                       NULL /* TODO: Use a TLB */);
 
     /* Initialize the software callback system and register the emulator BOPs */
@@ -272,8 +272,36 @@ VOID FASTCALL EmulatorCopyMemory(PFAST486_STATE State, ULONG DestAddress, ULONG
     // It is freed when NTVDM termiantes.
 }
 
+PVOID FASTCALL EmulatorMapMemory(PFAST486_STATE State, ULONG Address, BOOLEAN Write)
+{
+    PMEM_HOOK Hook;
+
+    UNREFERENCED_PARAMETER(State);
+
+    /* If the A20 line is disabled, mask bit 20 */
+    if (!A20Line) Address &= ~(1 << 20);
+
+    /* Nothing but RAM can be accessed directly */
+    if (Address >= MAX_ADDRESS) return NULL;
+
+    /*
+     * Hooked pages must go through EmulatorReadMemory/EmulatorWriteMemory,
+     * except for reads of pages whose hook only cares about writes (ROMs).
+     */
+    Hook = PageTable[Address >> 12];
+    if (Hook && (Write || Hook->hVdd || Hook->FastReadHandler)) return NULL;
+
+    return REAL_TO_PHYS(Address & ~(PAGE_SIZE - 1));
+}
+
 VOID EmulatorSetA20(BOOLEAN Enabled)
 {
+    if (A20Line != Enabled)
+    {
+        /* The pages above 1 MB now map somewhere else */
+        Fast486InvalidateMemoryMap(&EmulatorContext);
+    }
+
     A20Line = Enabled;
 }
 
@@ -346,6 +374,9 @@ MemInstallFastMemoryHook(PVOID Address,
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
 
+    /* The CPU may have cached direct pointers to these pages */
+    Fast486InvalidateMemoryMap(&EmulatorContext);
+
     return TRUE;
 }
 
@@ -542,6 +573,9 @@ VDDInstallMemoryHook(IN HANDLE hVdd,
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
 
+    /* The CPU may have cached direct pointers to these pages */
+    Fast486InvalidateMemoryMap(&EmulatorContext);
+
     return TRUE;
 }
 
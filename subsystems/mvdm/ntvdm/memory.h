@@ -65,6 +65,15 @@ EmulatorCopyMemory
     ULONG Size
 );
 
+PVOID
+FASTCALL
+EmulatorMapMemory
+(
+    PFAST486_STATE State,
+    ULONG Address,
+    BOOLEAN Write
+);
+
 VOID EmulatorSetA20(BOOLEAN Enabled);
 BOOLEAN EmulatorGetA20(VOID);
 
@@ -0,0 +1,297 @@
+/*
+ * PROJECT:     ReactOS Virtual DOS Machine
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Fast486 instruction throughput benchmark
+ */
+
+/*
+ * Runs a few small loops, typical of DOS programs, through the Fast486
+ * emulator in several configurations: with every memory access going
+ * through the callbacks, with the host TLB, and with the host TLB and the
+ * block cache. It reports the number of emulated instructions per second
+ * for each of them, and checks that they all end in the same CPU and
+ * memory state.
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <windows.h>
+
+#include <fast486.h>
+
+/* DEFINES ********************************************************************/
+
+#define MEMORY_SIZE         0x110000
+#define CODE_SEGMENT        0x0000
+#define CODE_OFFSET         0x1000
+#define DATA_SEGMENT        0x2000
+#define STACK_SEGMENT       0x3000
+#define STACK_OFFSET        0xFFFE
+#define DEFAULT_STEP_COUNT  10000000
+
+/* PRIVATE VARIABLES **********************************************************/
+
+static PUCHAR GuestMemory;
+static ULONG CallbackCount;
+
+typedef struct _BENCH_WORKLOAD
+{
+    LPCSTR Name;
+    BOOLEAN Size;
+    const UCHAR *Code;
+    ULONG CodeSize;
+} BENCH_WORKLOAD, *PBENCH_WORKLOAD;
+
+typedef struct _BENCH_CONFIG
+{
+    LPCSTR Name;
+    BOOLEAN HostTlb;
+    BOOLEAN BlockCache;
+} BENCH_CONFIG, *PBENCH_CONFIG;
+
+/*
+ * 0000:1000  B9 00 00     mov  cx, 0
+ * 0000:1003  8B 07        mov  ax, [bx]
+ * 0000:1005  01 04        add  [si], ax
+ * 0000:1007  83 C3 02     add  bx, 2
+ * 0000:100A  83 C6 02     add  si, 2
+ * 0000:100D  50           push ax
+ * 0000:100E  58           pop  ax
+ * 0000:100F  E2 F2        loop 1003
+ * 0000:1011  EB ED        jmp  1000
+ */
+static const UCHAR MemoryLoop16[] =
+{
+    0xB9, 0x00, 0x00,
+    0x8B, 0x07,
+    0x01, 0x04,
+    0x83, 0xC3, 0x02,
+    0x83, 0xC6, 0x02,
+    0x50,
+    0x58,
+    0xE2, 0xF2,
+    0xEB, 0xED
+};
+
+/*
+ * 0000:1000  B9 00 00     mov  cx, 0
+ * 0000:1003  01 C8        add  ax, cx
+ * 0000:1005  31 C3        xor  bx, ax
+ * 0000:1007  83 C2 03     add  dx, 3
+ * 0000:100A  89 D6        mov  si, dx
+ * 0000:100C  47           inc  di
+ * 0000:100D  39 F7        cmp  di, si
+ * 0000:100F  75 01        jnz  1012
+ * 0000:1011  90           nop
+ * 0000:1012  E2 EF        loop 1003
+ * 0000:1014  EB EA        jmp  1000
+ */
+static const UCHAR RegisterLoop16[] =
+{
+    0xB9, 0x00, 0x00,
+    0x01, 0xC8,
+    0x31, 0xC3,
+    0x83, 0xC2, 0x03,
+    0x89, 0xD6,
+    0x47,
+    0x39, 0xF7,
+    0x75, 0x01,
+    0x90,
+    0xE2, 0xEF,
+    0xEB, 0xEA
+};
+
+/* The same loop with a 32-bit code segment */
+static const UCHAR RegisterLoop32[] =
+{
+    0xB9, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0xC8,
+    0x31, 0xC3,
+    0x83, 0xC2, 0x03,
+    0x89, 0xD6,
+    0x47,
+    0x39, 0xF7,
+    0x75, 0x01,
+    0x90,
+    0xE2, 0xEF,
+    0xEB, 0xE8
+};
+
+static const BENCH_WORKLOAD Workloads[] =
+{
+    { "memory16",   FALSE, MemoryLoop16,   sizeof(MemoryLoop16)   },
+    { "register16", FALSE, RegisterLoop16, sizeof(RegisterLoop16) },
+    { "register32", TRUE,  RegisterLoop32, sizeof(RegisterLoop32) },
+};
+
+static const BENCH_CONFIG Configs[] =
+{
+    { "callbacks",   FALSE, FALSE },
+    { "host TLB",    TRUE,  FALSE },
+    { "block cache", TRUE,  TRUE  },
+};
+
+/* PRIVATE FUNCTIONS **********************************************************/
+
+static VOID
+FASTCALL
+BenchReadMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    CallbackCount++;
+
+    if (Address >= MEMORY_SIZE || Size > MEMORY_SIZE - Address)
+    {
+        FillMemory(Buffer, Size, 0xFF);
+        return;
+    }
+
+    CopyMemory(Buffer, GuestMemory + Address, Size);
+}
+
+static VOID
+FASTCALL
+BenchWriteMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    CallbackCount++;
+
+    if (Address >= MEMORY_SIZE || Size > MEMORY_SIZE - Address) return;
+    CopyMemory(GuestMemory + Address, Buffer, Size);
+}
+
+static PVOID
+FASTCALL
+BenchMapMemory(PFAST486_STATE State, ULONG Address, BOOLEAN Write)
+{
+    UNREFERENCED_PARAMETER(State);
+    UNREFERENCED_PARAMETER(Write);
+
+    /* The whole guest address space is plain RAM */
+    if (Address >= MEMORY_SIZE) return NULL;
+    return GuestMemory + (Address & ~(FAST486_PAGE_SIZE - 1));
+}
+
+static ULONG
+Checksum(PFAST486_STATE State)
+{
+    ULONG i, Sum = 0;
+
+    for (i = 0; i < MEMORY_SIZE; i++) Sum = (Sum << 1 | Sum >> 31) ^ GuestMemory[i];
+    for (i = 0; i < FAST486_NUM_GEN_REGS; i++) Sum = (Sum << 1 | Sum >> 31) ^ State->GeneralRegs[i].Long;
+
+    Sum = (Sum << 1 | Sum >> 31) ^ State->Flags.Long;
+    Sum = (Sum << 1 | Sum >> 31) ^ State->InstPtr.Long;
+
+    return Sum;
+}
+
+static ULONG
+RunBenchmark(const BENCH_WORKLOAD *Workload, const BENCH_CONFIG *Config, ULONG StepCount)
+{
+    static FAST486_STATE State;
+    static FAST486_BLOCK_CACHE BlockCache;
+    LARGE_INTEGER Frequency, Start, End;
+    ULONGLONG Elapsed;
+    ULONG i;
+
+    /* Start from the same memory contents every time */
+    ZeroMemory(GuestMemory, MEMORY_SIZE);
+    CopyMemory(GuestMemory + (CODE_SEGMENT << 4) + CODE_OFFSET,
+               Workload->Code,
+               Workload->CodeSize);
+
+    Fast486Initialize(&State,
+                      BenchReadMemory,
+                      BenchWriteMemory,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      Config->HostTlb ? BenchMapMemory : NULL,
+                      NULL);
+
+    Fast486SetBlockCache(&State, Config->BlockCache ? &BlockCache : NULL);
+
+    Fast486ExecuteAt(&State, CODE_SEGMENT, CODE_OFFSET);
+    Fast486SetStack(&State, STACK_SEGMENT, STACK_OFFSET);
+    Fast486SetSegment(&State, FAST486_REG_DS, DATA_SEGMENT);
+    State.GeneralRegs[FAST486_REG_EBX].Long = 0x0000;
+    State.GeneralRegs[FAST486_REG_ESI].Long = 0x0100;
+
+    /* Run the 32-bit workloads in a big real mode code segment */
+    State.SegmentRegs[FAST486_REG_CS].Size = Workload->Size;
+
+    CallbackCount = 0;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < StepCount; i++) Fast486StepInto(&State);
+
+    QueryPerformanceCounter(&End);
+
+    Elapsed = max(End.QuadPart - Start.QuadPart, 1);
+    printf("%-12s %-12s %10lu instructions/s, %10lu memory callbacks\n",
+           Workload->Name,
+           Config->Name,
+           (ULONG)((ULONGLONG)StepCount * Frequency.QuadPart / Elapsed),
+           CallbackCount);
+
+    return Checksum(&State);
+}
+
+/* PUBLIC FUNCTIONS ***********************************************************/
+
+int main(int argc, char *argv[])
+{
+    ULONG StepCount = DEFAULT_STEP_COUNT;
+    ULONG Reference, Sum;
+    ULONG i, j;
+    int Result = 0;
+
+    if (argc > 1) StepCount = strtoul(argv[1], NULL, 0);
+    if (StepCount == 0)
+    {
+        printf("Usage: fast486bench [instruction count]\n");
+        return 1;
+    }
+
+    GuestMemory = VirtualAlloc(NULL, MEMORY_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (GuestMemory == NULL)
+    {
+        printf("Cannot allocate the guest memory, error %lu\n", GetLastError());
+        return 1;
+    }
+
+    printf("Running %lu instructions per configuration\n", StepCount);
+
+    for (i = 0; i < ARRAYSIZE(Workloads); i++)
+    {
+        Reference = RunBenchmark(&Workloads[i], &Configs[0], StepCount);
+
+        for (j = 1; j < ARRAYSIZE(Configs); j++)
+        {
+            Sum = RunBenchmark(&Workloads[i], &Configs[j], StepCount);
+
+            /* Every configuration has to end in the same state */
+            if (Sum != Reference)
+            {
+                printf("FAILED: %s with %s differs (0x%08lx != 0x%08lx)\n",
+                       Workloads[i].Name, Configs[j].Name, Sum, Reference);
+                Result = 1;
+            }
+        }
+    }
+
+    VirtualFree(GuestMemory, 0, MEM_RELEASE);
+    return Result;
+}
+
+/* EOF */
@@ -134,6 +134,10 @@ typedef struct _SHARED_FACE {
   PSHARED_MEM   Memory;
   SHARED_FACE_CACHE EnglishUS;
   SHARED_FACE_CACHE UserLanguage;
+  /* Rendered glyphs (FONT_CACHE_ENTRY), most recently used first */
+  LIST_ENTRY    GlyphCacheListHead;
+  PLIST_ENTRY   GlyphCacheBuckets;
+  UINT          GlyphCacheNumEntries;
 } SHARED_FACE, *PSHARED_FACE;
 
 typedef struct _FONTGDI {
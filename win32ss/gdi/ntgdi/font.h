@@ -10,6 +10,15 @@ typedef struct _FONT_ENTRY
     BYTE NotEnum;
 } FONT_ENTRY, *PFONT_ENTRY;
 
+/* Hash index of the global font list by family and face name */
+typedef struct _FONT_NAME_INDEX_ENTRY
+{
+    LIST_ENTRY HashEntry;
+    UNICODE_STRING Name;
+    ULONG Sequence;
+    PFONT_ENTRY FontEntry;
+} FONT_NAME_INDEX_ENTRY, *PFONT_NAME_INDEX_ENTRY;
+
 typedef struct _FONT_ENTRY_MEM
 {
     LIST_ENTRY ListEntry;
@@ -55,6 +64,8 @@ typedef struct _FONT_CACHE_HASHED
 typedef struct _FONT_CACHE_ENTRY
 {
     LIST_ENTRY ListEntry;
+    LIST_ENTRY HashEntry;
+    LIST_ENTRY LruEntry;
     FT_BitmapGlyph BitmapGlyph;
     DWORD dwHash;
     FONT_CACHE_HASHED Hashed;
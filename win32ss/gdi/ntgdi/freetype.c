@@ -88,10 +88,24 @@ static BOOL             g_RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
     ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* Glyph cache limits, for all faces together and for each face */
+#define MAX_FONT_CACHE 4096
+#define MAX_FACE_FONT_CACHE 256
+#define FONT_CACHE_BUCKETS 64
 
-static LIST_ENTRY g_FontCacheListHead;
+/* Glyphs of all faces, most recently used first */
+static LIST_ENTRY g_FontCacheLruHead;
 static UINT g_FontCacheNumEntries;
+static ULONG g_FontCacheHits;
+static ULONG g_FontCacheMisses;
+static ULONG g_FontCacheEvictions;
+
+/* Name index of g_FontListHead, protected by g_FontListLock */
+#define FONT_NAME_INDEX_BUCKETS 256
+
+static LIST_ENTRY g_FontNameIndex[FONT_NAME_INDEX_BUCKETS];
+static ULONG g_FontNameIndexSequence;
+static BOOL g_FontNameIndexIncomplete = FALSE;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -222,6 +236,12 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Memory = Memory;
         SharedFaceCache_Init(&Ptr->EnglishUS);
         SharedFaceCache_Init(&Ptr->UserLanguage);
+        InitializeListHead(&Ptr->GlyphCacheListHead);
+        Ptr->GlyphCacheBuckets = NULL;
+        Ptr->GlyphCacheNumEntries = 0;
+
+        /* Let the glyph cache find its way back from the face */
+        Face->generic.data = Ptr;
 
         SharedMem_AddRef(Memory);
         DPRINT("Creating SharedFace for %s\n", Face->family_name ? Face->family_name : "<NULL>");
@@ -254,36 +274,37 @@ SharedFace_AddRef(PSHARED_FACE Ptr)
 }
 
 static void
-RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
+RemoveCachedEntry(PSHARED_FACE SharedFace, PFONT_CACHE_ENTRY Entry)
 {
     ASSERT_FREETYPE_LOCK_HELD();
 
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
+    RemoveEntryList(&Entry->HashEntry);
+    RemoveEntryList(&Entry->LruEntry);
     ExFreePoolWithTag(Entry, TAG_FONT);
+    SharedFace->GlyphCacheNumEntries--;
     g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
+    ASSERT(SharedFace->GlyphCacheNumEntries <= MAX_FACE_FONT_CACHE);
 }
 
 static void
-RemoveCacheEntries(FT_Face Face)
+RemoveCacheEntries(PSHARED_FACE SharedFace)
 {
-    PLIST_ENTRY CurrentEntry, NextEntry;
     PFONT_CACHE_ENTRY FontEntry;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
-         CurrentEntry = NextEntry)
+    while (!IsListEmpty(&SharedFace->GlyphCacheListHead))
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        NextEntry = CurrentEntry->Flink;
+        FontEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Flink, FONT_CACHE_ENTRY, ListEntry);
+        RemoveCachedEntry(SharedFace, FontEntry);
+    }
 
-        if (FontEntry->Hashed.Face == Face)
-        {
-            RemoveCachedEntry(FontEntry);
-        }
+    if (SharedFace->GlyphCacheBuckets)
+    {
+        ExFreePoolWithTag(SharedFace->GlyphCacheBuckets, TAG_FONT);
+        SharedFace->GlyphCacheBuckets = NULL;
     }
 }
 
@@ -327,7 +348,7 @@ SharedFace_Release(PSHARED_FACE Ptr)
     if (Ptr->RefCount == 0)
     {
         DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name ? Ptr->Face->family_name : "<NULL>");
-        RemoveCacheEntries(Ptr->Face);
+        RemoveCacheEntries(Ptr);
         FT_Done_Face(Ptr->Face);
         SharedMem_Release(Ptr->Memory);
         SharedFaceCache_Release(&Ptr->EnglishUS);
@@ -658,8 +679,14 @@ InitFontSupport(VOID)
 {
     ULONG ulError;
 
+    ULONG i;
+
     InitializeListHead(&g_FontListHead);
-    InitializeListHead(&g_FontCacheListHead);
+    for (i = 0; i < FONT_NAME_INDEX_BUCKETS; ++i)
+    {
+        InitializeListHead(&g_FontNameIndex[i]);
+    }
+    InitializeListHead(&g_FontCacheLruHead);
     g_FontCacheNumEntries = 0;
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
@@ -1046,6 +1073,9 @@ UINT FASTCALL IntGetCharSet(INT nIndex, FT_ULong CodePageRange1)
 /* pixels to points */
 #define PX2PT(pixels) FT_MulDiv((pixels), 72, 96)
 
+static VOID
+IntAddFontNameIndex(PFONT_ENTRY FontEntry);
+
 static INT FASTCALL
 IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
                           PSHARED_FACE SharedFace, FT_Long FontIndex, INT CharSetIndex)
@@ -1312,6 +1342,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
         /* global font */
         IntLockGlobalFonts();
         InsertTailList(&g_FontListHead, &Entry->ListEntry);
+        IntAddFontNameIndex(Entry);
         IntUnLockGlobalFonts();
     }
 
@@ -3101,17 +3132,25 @@ IntGetHash(IN LPCVOID pv, IN DWORD cdw)
 static FT_BitmapGlyph
 IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY CurrentEntry, BucketHead;
     PFONT_CACHE_ENTRY FontEntry;
     DWORD dwHash = pCache->dwHash;
+    PSHARED_FACE SharedFace = pCache->Hashed.Face->generic.data;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    if (!SharedFace->GlyphCacheBuckets)
+    {
+        ++g_FontCacheMisses;
+        return NULL;
+    }
+
+    BucketHead = &SharedFace->GlyphCacheBuckets[dwHash % FONT_CACHE_BUCKETS];
+    for (CurrentEntry = BucketHead->Flink;
+         CurrentEntry != BucketHead;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
         if (FontEntry->dwHash == dwHash &&
             FontEntry->Hashed.GlyphIndex == pCache->Hashed.GlyphIndex &&
             FontEntry->Hashed.Face == pCache->Hashed.Face &&
@@ -3125,16 +3164,32 @@ IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
         }
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == BucketHead)
     {
+        ++g_FontCacheMisses;
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
+    ++g_FontCacheHits;
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&SharedFace->GlyphCacheListHead, &FontEntry->ListEntry);
+    RemoveEntryList(&FontEntry->LruEntry);
+    InsertHeadList(&g_FontCacheLruHead, &FontEntry->LruEntry);
     return FontEntry->BitmapGlyph;
 }
 
+VOID FASTCALL
+IntGetGlyphCacheStatistics(PGLYPH_CACHE_STATISTICS Statistics)
+{
+    /* The counters only change with the FreeType lock held, but a
+       snapshot is all we need here. Don't lock, so that the debugger
+       can call us as well. */
+    Statistics->Hits = g_FontCacheHits;
+    Statistics->Misses = g_FontCacheMisses;
+    Statistics->Evictions = g_FontCacheEvictions;
+    Statistics->Entries = g_FontCacheNumEntries;
+}
+
 /* no cache */
 static FT_BitmapGlyph
 IntGetBitmapGlyphNoCache(
@@ -3189,9 +3244,28 @@ IntGetBitmapGlyphWithCache(
     PFONT_CACHE_ENTRY NewEntry;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
+    PSHARED_FACE SharedFace = Cache->Hashed.Face->generic.data;
+    UINT i;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
+    if (!SharedFace->GlyphCacheBuckets)
+    {
+        SharedFace->GlyphCacheBuckets = ExAllocatePoolWithTag(PagedPool,
+                                                              FONT_CACHE_BUCKETS * sizeof(LIST_ENTRY),
+                                                              TAG_FONT);
+        if (!SharedFace->GlyphCacheBuckets)
+        {
+            DPRINT1("Alloc failure caching glyph.\n");
+            return NULL;
+        }
+
+        for (i = 0; i < FONT_CACHE_BUCKETS; ++i)
+        {
+            InitializeListHead(&SharedFace->GlyphCacheBuckets[i]);
+        }
+    }
+
     error = FT_Get_Glyph(GlyphSlot, &GlyphCopy);
     if (error)
     {
@@ -3233,11 +3307,26 @@ IntGetBitmapGlyphWithCache(
     NewEntry->dwHash = Cache->dwHash;
     NewEntry->Hashed = Cache->Hashed;
 
-    InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(&SharedFace->GlyphCacheListHead, &NewEntry->ListEntry);
+    InsertHeadList(&SharedFace->GlyphCacheBuckets[NewEntry->dwHash % FONT_CACHE_BUCKETS],
+                   &NewEntry->HashEntry);
+    InsertHeadList(&g_FontCacheLruHead, &NewEntry->LruEntry);
+    ++SharedFace->GlyphCacheNumEntries;
+    ++g_FontCacheNumEntries;
+
+    /* Make room by dropping the least recently used glyph of this face,
+       or of all faces once the whole cache is full */
+    if (SharedFace->GlyphCacheNumEntries > MAX_FACE_FONT_CACHE)
+    {
+        NewEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
+        RemoveCachedEntry(SharedFace, NewEntry);
+        ++g_FontCacheEvictions;
+    }
+    else if (g_FontCacheNumEntries > MAX_FONT_CACHE)
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        NewEntry = CONTAINING_RECORD(g_FontCacheLruHead.Blink, FONT_CACHE_ENTRY, LruEntry);
+        RemoveCachedEntry(NewEntry->Hashed.Face->generic.data, NewEntry);
+        ++g_FontCacheEvictions;
     }
 
     return BitmapGlyph;
@@ -4689,6 +4778,10 @@ ftGdiGetFontData(
 
 #define GOT_PENALTY(name, value) Penalty += (value)
 
+/* Any font whose names don't match the requested face name gets at least
+   this penalty, see FindBestFontFromNameIndex */
+#define FONT_PENALTY_FACENAME 10000
+
 // NOTE: See Table 1. of https://msdn.microsoft.com/en-us/library/ms969909.aspx
 static UINT
 GetFontPenalty(const LOGFONTW *               LogFont,
@@ -4820,7 +4913,7 @@ GetFontPenalty(const LOGFONTW *               LogFont,
             /* FaceName Penalty 10000 */
             /* Requested a face name, but the candidate's face name
                does not match. */
-            GOT_PENALTY("FaceName", 10000);
+            GOT_PENALTY("FaceName", FONT_PENALTY_FACENAME);
         }
     }
 
@@ -5036,6 +5129,37 @@ GetFontPenalty(const LOGFONTW *               LogFont,
 
 #undef GOT_PENALTY
 
+static BOOL
+GetFontEntryPenalty(FONTGDI *FontGDI, const LOGFONTW *LogFont,
+                    OUTLINETEXTMETRICW **pOtm, UINT *pOtmSize, ULONG *Penalty)
+{
+    UINT OtmSize;
+
+    /* get text metrics */
+    OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL);
+    if (OtmSize > *pOtmSize)
+    {
+        if (*pOtm)
+            ExFreePoolWithTag(*pOtm, GDITAG_TEXT);
+        *pOtm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+        *pOtmSize = (*pOtm ? OtmSize : 0);
+    }
+
+    if (!*pOtm)
+        return FALSE;
+
+    IntLockFreeType();
+    IntRequestFontSize(NULL, FontGDI, LogFont->lfWidth, LogFont->lfHeight);
+    IntUnLockFreeType();
+
+    OtmSize = IntGetOutlineTextMetrics(FontGDI, OtmSize, *pOtm);
+    if (!OtmSize)
+        return FALSE;
+
+    *Penalty = GetFontPenalty(LogFont, *pOtm, FontGDI->SharedFace->Face->style_name);
+    return TRUE;
+}
+
 static __inline VOID
 FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
                      const LOGFONTW *LogFont,
@@ -5046,8 +5170,7 @@ FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
     PFONT_ENTRY CurrentEntry;
     FONTGDI *FontGDI;
     OUTLINETEXTMETRICW *Otm = NULL;
-    UINT OtmSize, OldOtmSize = 0;
-    FT_Face Face;
+    UINT OtmSize;
 
     ASSERT(FontObj);
     ASSERT(MatchPenalty);
@@ -5055,8 +5178,10 @@ FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
     ASSERT(Head);
 
     /* Start with a pretty big buffer */
-    OldOtmSize = 0x200;
-    Otm = ExAllocatePoolWithTag(PagedPool, OldOtmSize, GDITAG_TEXT);
+    OtmSize = 0x200;
+    Otm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+    if (!Otm)
+        OtmSize = 0;
 
     /* get the FontObj of lowest penalty */
     for (Entry = Head->Flink; Entry != Head; Entry = Entry->Flink)
@@ -5065,41 +5190,170 @@ FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
 
         FontGDI = CurrentEntry->Font;
         ASSERT(FontGDI);
-        Face = FontGDI->SharedFace->Face;
 
-        /* get text metrics */
-        OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL);
-        if (OtmSize > OldOtmSize)
+        /* update FontObj if lowest penalty */
+        if (!GetFontEntryPenalty(FontGDI, LogFont, &Otm, &OtmSize, &Penalty))
+            continue;
+
+        if (*MatchPenalty == 0xFFFFFFFF || Penalty < *MatchPenalty)
         {
-            if (Otm)
-                ExFreePoolWithTag(Otm, GDITAG_TEXT);
-            Otm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+            *FontObj = GDIToObj(FontGDI, FONT);
+            *MatchPenalty = Penalty;
         }
+    }
 
-        /* update FontObj if lowest penalty */
-        if (Otm)
-        {
-            IntLockFreeType();
-            IntRequestFontSize(NULL, FontGDI, LogFont->lfWidth, LogFont->lfHeight);
-            IntUnLockFreeType();
+    if (Otm)
+        ExFreePoolWithTag(Otm, GDITAG_TEXT);
+}
 
-            OtmSize = IntGetOutlineTextMetrics(FontGDI, OtmSize, Otm);
-            if (!OtmSize)
-                continue;
+static ULONG
+IntFontNameHash(PCWSTR Name, USHORT Length)
+{
+    ULONG Hash = 0;
 
-            OldOtmSize = OtmSize;
+    /* Case insensitive, the same way as _wcsicmp compares */
+    while (Length-- > 0)
+    {
+        Hash = Hash * 31 + towlower(*Name++);
+    }
 
-            Penalty = GetFontPenalty(LogFont, Otm, Face->style_name);
-            if (*MatchPenalty == 0xFFFFFFFF || Penalty < *MatchPenalty)
-            {
-                *FontObj = GDIToObj(FontGDI, FONT);
-                *MatchPenalty = Penalty;
-            }
+    return Hash;
+}
+
+static VOID
+IntInsertFontNameIndex(PFONT_ENTRY FontEntry, PUNICODE_STRING Name, ULONG Sequence)
+{
+    PFONT_NAME_INDEX_ENTRY IndexEntry;
+    ULONG Hash;
+
+    ASSERT_GLOBALFONTS_LOCK_HELD();
+
+    if (Name->Length == 0)
+        return;
+
+    IndexEntry = ExAllocatePoolWithTag(PagedPool,
+                                       sizeof(FONT_NAME_INDEX_ENTRY) + Name->Length + sizeof(UNICODE_NULL),
+                                       TAG_FONT);
+    if (!IndexEntry)
+    {
+        /* A font missing from the index could be a better match than the
+           ones we find through it, so stop trusting the index */
+        DPRINT1("Failed to index font %wZ\n", Name);
+        g_FontNameIndexIncomplete = TRUE;
+        return;
+    }
+
+    IndexEntry->Name.Buffer = (PWSTR)(IndexEntry + 1);
+    IndexEntry->Name.MaximumLength = Name->Length + sizeof(UNICODE_NULL);
+    RtlCopyUnicodeString(&IndexEntry->Name, Name);
+    IndexEntry->Sequence = Sequence;
+    IndexEntry->FontEntry = FontEntry;
+
+    Hash = IntFontNameHash(Name->Buffer, Name->Length / sizeof(WCHAR));
+    InsertTailList(&g_FontNameIndex[Hash % FONT_NAME_INDEX_BUCKETS], &IndexEntry->HashEntry);
+}
+
+/* Indexes a new entry of g_FontListHead by the names GetFontPenalty looks at */
+static VOID
+IntAddFontNameIndex(PFONT_ENTRY FontEntry)
+{
+    PSHARED_FACE SharedFace = FontEntry->Font->SharedFace;
+    UNICODE_STRING FamilyName, FaceName;
+    ULONG Sequence;
+    NTSTATUS Status;
+
+    ASSERT_GLOBALFONTS_LOCK_HELD();
+
+    Sequence = g_FontNameIndexSequence++;
+
+    RtlInitUnicodeString(&FamilyName, NULL);
+    RtlInitUnicodeString(&FaceName, NULL);
+
+    Status = IntGetFontLocalizedName(&FamilyName, SharedFace, TT_NAME_ID_FONT_FAMILY, gusLanguageID);
+    if (NT_SUCCESS(Status))
+        Status = IntGetFontLocalizedName(&FaceName, SharedFace, TT_NAME_ID_FULL_NAME, gusLanguageID);
+
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to get the names of a font: 0x%lx\n", Status);
+        g_FontNameIndexIncomplete = TRUE;
+    }
+    else
+    {
+        IntInsertFontNameIndex(FontEntry, &FamilyName, Sequence);
+        if (!RtlEqualUnicodeString(&FamilyName, &FaceName, TRUE))
+            IntInsertFontNameIndex(FontEntry, &FaceName, Sequence);
+    }
+
+    RtlFreeUnicodeString(&FamilyName);
+    RtlFreeUnicodeString(&FaceName);
+}
+
+/*
+ * Looks for the best match among the system fonts named like the requested
+ * face. Returns TRUE if no other system font can do better, i.e. the caller
+ * doesn't need to go through the whole g_FontListHead anymore.
+ */
+static BOOL
+FindBestFontFromNameIndex(FONTOBJ **FontObj, ULONG *MatchPenalty,
+                          const LOGFONTW *LogFont)
+{
+    PLIST_ENTRY Entry, BucketHead;
+    PFONT_NAME_INDEX_ENTRY IndexEntry;
+    FONTGDI *FontGDI, *BestFontGDI = NULL;
+    OUTLINETEXTMETRICW *Otm = NULL;
+    UINT OtmSize = 0;
+    ULONG Penalty, BestPenalty = 0xFFFFFFFF, BestSequence = 0, Hash;
+    BYTE CharSet = LogFont->lfCharSet;
+
+    ASSERT_GLOBALFONTS_LOCK_HELD();
+
+    if (LogFont->lfFaceName[0] == UNICODE_NULL || g_FontNameIndexIncomplete)
+        return FALSE;
+
+    Hash = IntFontNameHash(LogFont->lfFaceName,
+                           (USHORT)wcsnlen(LogFont->lfFaceName, _countof(LogFont->lfFaceName)));
+    BucketHead = &g_FontNameIndex[Hash % FONT_NAME_INDEX_BUCKETS];
+
+    for (Entry = BucketHead->Flink; Entry != BucketHead; Entry = Entry->Flink)
+    {
+        IndexEntry = CONTAINING_RECORD(Entry, FONT_NAME_INDEX_ENTRY, HashEntry);
+        FontGDI = IndexEntry->FontEntry->Font;
+
+        if (_wcsicmp(IndexEntry->Name.Buffer, LogFont->lfFaceName) != 0)
+            continue;
+
+        /* A font of another charset gets the CharSet penalty, it can't
+           make it below FONT_PENALTY_FACENAME anyway */
+        if (CharSet != DEFAULT_CHARSET && CharSet != ANSI_CHARSET &&
+            CharSet != FontGDI->CharSet)
+        {
+            continue;
+        }
+
+        if (!GetFontEntryPenalty(FontGDI, LogFont, &Otm, &OtmSize, &Penalty))
+            continue;
+
+        /* On a tie, the font that came first in g_FontListHead wins */
+        if (Penalty < BestPenalty ||
+            (Penalty == BestPenalty && IndexEntry->Sequence < BestSequence))
+        {
+            BestFontGDI = FontGDI;
+            BestPenalty = Penalty;
+            BestSequence = IndexEntry->Sequence;
         }
     }
 
     if (Otm)
         ExFreePoolWithTag(Otm, GDITAG_TEXT);
+
+    if (BestFontGDI && (*MatchPenalty == 0xFFFFFFFF || BestPenalty < *MatchPenalty))
+    {
+        *FontObj = GDIToObj(BestFontGDI, FONT);
+        *MatchPenalty = BestPenalty;
+    }
+
+    return (*MatchPenalty < FONT_PENALTY_FACENAME);
 }
 
 static
@@ -5237,10 +5491,13 @@ TextIntRealizeFont(HFONT FontHandle, PTEXTOBJ pTextObj)
                          &Win32Process->PrivateFontListHead);
     IntUnLockProcessPrivateFonts(Win32Process);
 
-    /* Search system fonts */
+    /* Search system fonts, by name first */
     IntLockGlobalFonts();
-    FindBestFontFromList(&TextObj->Font, &MatchPenalty, &SubstitutedLogFont,
-                         &g_FontListHead);
+    if (!FindBestFontFromNameIndex(&TextObj->Font, &MatchPenalty, &SubstitutedLogFont))
+    {
+        FindBestFontFromList(&TextObj->Font, &MatchPenalty, &SubstitutedLogFont,
+                             &g_FontListHead);
+    }
     IntUnLockGlobalFonts();
 
     if (NULL == TextObj->Font)
@@ -69,6 +69,7 @@ KdbCommand_Gdi_help(VOID)
              "- handle <handle> - Displays information about a handle\n"
              "- entry <entry> - Displays an ENTRY, <entry> can be a pointer or index\n"
              "- baseobject <object> - Displays a BASEOBJECT\n"
+             "- glyphcache - Displays the glyph cache statistics\n"
 #if DBG_ENABLE_EVENT_LOGGING
              "- eventlist <object> - Displays the eventlist for an object\n"
 #endif
@@ -278,6 +279,22 @@ KdbCommand_Gdi_baseobject(char *argv)
 {
 }
 
+static
+VOID
+KdbCommand_Gdi_glyphcache(VOID)
+{
+    GLYPH_CACHE_STATISTICS Statistics;
+    ULONG Lookups;
+
+    IntGetGlyphCacheStatistics(&Statistics);
+    Lookups = Statistics.Hits + Statistics.Misses;
+
+    DbgPrint("Glyph cache: %lu entries, %lu hits, %lu misses (%lu%% hit rate), %lu evictions\n",
+             Statistics.Entries, Statistics.Hits, Statistics.Misses,
+             Lookups ? (ULONG)((ULONGLONG)Statistics.Hits * 100 / Lookups) : 0,
+             Statistics.Evictions);
+}
+
 #if DBG_ENABLE_EVENT_LOGGING
 static
 VOID
@@ -347,6 +364,10 @@ DbgGdiKdbgCliCallback(
     {
         KdbCommand_Gdi_baseobject(argv[1]);
     }
+    else if (stricmp(argv[0], "!gdi.glyphcache") == 0)
+    {
+        KdbCommand_Gdi_glyphcache();
+    }
 #if DBG_ENABLE_EVENT_LOGGING
     else if (stricmp(argv[0], "!gdi.eventlist") == 0)
     {
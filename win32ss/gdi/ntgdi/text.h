@@ -100,6 +100,14 @@ TEXTOBJ_UnlockText(PLFONT plfnt)
     LFONT_ShareUnlockFont(plfnt);
 }
 
+typedef struct _GLYPH_CACHE_STATISTICS
+{
+    ULONG Hits;
+    ULONG Misses;
+    ULONG Evictions;
+    ULONG Entries;
+} GLYPH_CACHE_STATISTICS, *PGLYPH_CACHE_STATISTICS;
+
 /* dwFlags for IntGdiAddFontResourceEx */
 #define AFRX_WRITE_REGISTRY 0x1
 #define AFRX_ALTERNATIVE_PATH 0x2
@@ -110,6 +118,7 @@ NTSTATUS FASTCALL TextIntRealizeFont(HFONT,PTEXTOBJ);
 NTSTATUS FASTCALL TextIntCreateFontIndirect(CONST LPLOGFONTW lf, HFONT *NewFont);
 BYTE FASTCALL IntCharSetFromCodePage(UINT uCodePage);
 BOOL FASTCALL InitFontSupport(VOID);
+VOID FASTCALL IntGetGlyphCacheStatistics(PGLYPH_CACHE_STATISTICS Statistics);
 BOOL FASTCALL IntIsFontRenderingEnabled(VOID);
 BOOL FASTCALL IntIsFontRenderingEnabled(VOID);
 VOID FASTCALL IntEnableFontRendering(BOOL Enable);